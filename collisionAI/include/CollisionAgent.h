@@ -29,7 +29,7 @@
 class CollisionAgent : public SteerLib::AgentInterface
 {
 public:
-    CollisionAgent();
+    CollisionAgent(CollisionAIModule * module);
     ~CollisionAgent();
 	void reset(const SteerLib::AgentInitialConditions & initialConditions, SteerLib::EngineInterface * engineInfo);
 	void updateAI(float timeStamp, float dt, unsigned int frameNumber);
@@ -63,6 +63,8 @@ public:
 
 
 protected:
+	/// The state shared with the other agents of the module that created this agent.
+	CollisionAIGlobals::ModuleContext * _context;
 	/// Updates position, velocity, and orientation of the agent, given the force and dt time step.
 	void _doEulerStep(const Util::Vector & steeringDecisionForce, float dt);
 
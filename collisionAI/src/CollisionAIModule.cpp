@@ -19,25 +19,6 @@
 #include "obstacles/GJK_EPA.h"
 
 
-// globally accessible to the CollisionAI plugin
-SteerLib::EngineInterface*  gEngine;
-SteerLib::GridDatabase2D*   gSpatialDatabase;
-
-namespace CollisionAIGlobals
-{
-	unsigned int gLongTermPlanningPhaseInterval;
-	unsigned int gMidTermPlanningPhaseInterval;
-	unsigned int gShortTermPlanningPhaseInterval;
-	unsigned int gPredictivePhaseInterval;
-	unsigned int gReactivePhaseInterval;
-	unsigned int gPerceptivePhaseInterval;
-	bool gUseDynamicPhaseScheduling;
-	bool gShowStats;
-	bool gShowAllStats;
-
-	PhaseProfilers * gPhaseProfilers;
-}
-
 using namespace CollisionAIGlobals;
 
 PLUGIN_API SteerLib::ModuleInterface * createModule()
@@ -53,13 +34,15 @@ PLUGIN_API void destroyModule( SteerLib::ModuleInterface*  module )
 
 void CollisionAIModule::init( const SteerLib::OptionDictionary & options, SteerLib::EngineInterface * engineInfo )
 {
-	gEngine = engineInfo;
-	gSpatialDatabase = engineInfo->getSpatialDatabase();
+	// the phase intervals and profilers start out zero, until options or initializeSimulation() set them.
+	_context = ModuleContext();
+	_context.engine = engineInfo;
+	_context.spatialDatabase = engineInfo->getSpatialDatabase();
 
-	gUseDynamicPhaseScheduling = false;
-	gShowStats = false;
+	_context.useDynamicPhaseScheduling = false;
+	_context.showStats = false;
 	logStats = false;
-	gShowAllStats = false;
+	_context.showAllStats = false;
     logFilename = "CollisionAI.log";
 
 	SteerLib::OptionDictionary::const_iterator optionIter;
@@ -67,7 +50,7 @@ void CollisionAIModule::init( const SteerLib::OptionDictionary & options, SteerL
 		std::stringstream value((*optionIter).second);
 		if ((*optionIter).first == "")
 		{
-			value >> gLongTermPlanningPhaseInterval;
+			value >> _context.longTermPlanningPhaseInterval;
 		}
 		else if ((*optionIter).first == "ailogFileName")
 		{
@@ -76,11 +59,11 @@ void CollisionAIModule::init( const SteerLib::OptionDictionary & options, SteerL
 		}
 		else if ((*optionIter).first == "stats")
 		{
-			gShowStats = Util::getBoolFromString(value.str());
+			_context.showStats = Util::getBoolFromString(value.str());
 		}
 		else if ((*optionIter).first == "allstats")
 		{
-			gShowAllStats = Util::getBoolFromString(value.str());
+			_context.showAllStats = Util::getBoolFromString(value.str());
 		}
 		else
 		{
@@ -120,21 +103,21 @@ void CollisionAIModule::initializeSimulation()
 	//
 	// initialize the performance profilers
 	//
-	gPhaseProfilers = new PhaseProfilers;
-	gPhaseProfilers->aiProfiler.reset();
-	gPhaseProfilers->longTermPhaseProfiler.reset();
-	gPhaseProfilers->midTermPhaseProfiler.reset();
-	gPhaseProfilers->shortTermPhaseProfiler.reset();
-	gPhaseProfilers->perceptivePhaseProfiler.reset();
-	gPhaseProfilers->predictivePhaseProfiler.reset();
-	gPhaseProfilers->reactivePhaseProfiler.reset();
-	gPhaseProfilers->steeringPhaseProfiler.reset();
+	_context.phaseProfilers = new PhaseProfilers;
+	_context.phaseProfilers->aiProfiler.reset();
+	_context.phaseProfilers->longTermPhaseProfiler.reset();
+	_context.phaseProfilers->midTermPhaseProfiler.reset();
+	_context.phaseProfilers->shortTermPhaseProfiler.reset();
+	_context.phaseProfilers->perceptivePhaseProfiler.reset();
+	_context.phaseProfilers->predictivePhaseProfiler.reset();
+	_context.phaseProfilers->reactivePhaseProfiler.reset();
+	_context.phaseProfilers->steeringPhaseProfiler.reset();
 
 }
 
 void CollisionAIModule::preprocessSimulation()
 {
-    std::set<SteerLib::ObstacleInterface*> _obstacles = gEngine->getObstacles();
+    std::set<SteerLib::ObstacleInterface*> _obstacles = _context.engine->getObstacles();
 
     std::vector<std::vector<Util::Vector>> polyVects;
     std::vector<Util::Vector> vects;
@@ -180,27 +163,27 @@ void CollisionAIModule::cleanupSimulation()
 	{
 		LogObject logObject;
 
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getNumTimesExecuted());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getTotalTicksAccumulated());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getMinTicks());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getMaxTicks());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getMinExecutionTimeMills());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getMaxExecutionTimeMills());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getAverageExecutionTimeMills());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getTotalTime());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getTickFrequency());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getNumTimesExecuted());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getTotalTicksAccumulated());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getMinTicks());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getMaxTicks());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getMinExecutionTimeMills());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getMaxExecutionTimeMills());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getAverageExecutionTimeMills());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getTotalTime());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getTickFrequency());
 
 		_logger->writeLogObject(logObject);
 
 		// cleanup profileing metrics for next simulation/scenario
-		gPhaseProfilers->aiProfiler.reset();
-		gPhaseProfilers->longTermPhaseProfiler.reset();
-		gPhaseProfilers->midTermPhaseProfiler.reset();
-		gPhaseProfilers->shortTermPhaseProfiler.reset();
-		gPhaseProfilers->perceptivePhaseProfiler.reset();
-		gPhaseProfilers->predictivePhaseProfiler.reset();
-		gPhaseProfilers->reactivePhaseProfiler.reset();
-		gPhaseProfilers->steeringPhaseProfiler.reset();
+		_context.phaseProfilers->aiProfiler.reset();
+		_context.phaseProfilers->longTermPhaseProfiler.reset();
+		_context.phaseProfilers->midTermPhaseProfiler.reset();
+		_context.phaseProfilers->shortTermPhaseProfiler.reset();
+		_context.phaseProfilers->perceptivePhaseProfiler.reset();
+		_context.phaseProfilers->predictivePhaseProfiler.reset();
+		_context.phaseProfilers->reactivePhaseProfiler.reset();
+		_context.phaseProfilers->steeringPhaseProfiler.reset();
 	}
 
 	// kdTree_->deleteObstacleTree(kdTree_->obstacleTree_);
@@ -213,7 +196,7 @@ void CollisionAIModule::finish()
 
 SteerLib::AgentInterface * CollisionAIModule::createAgent()
 {
-    return new CollisionAgent;
+    return new CollisionAgent(this);
 }
 
 void CollisionAIModule::destroyAgent( SteerLib::AgentInterface * agent )
@@ -16,8 +16,9 @@
 #define MAX_SPEED 1.3f
 #define AGENT_MASS 1.0f
 
-CollisionAgent::CollisionAgent()
+CollisionAgent::CollisionAgent(CollisionAIModule * module)
 {
+	_context = module->getContext();
 	_enabled = false;
 }
 
@@ -25,14 +26,14 @@ CollisionAgent::~CollisionAgent()
 {
 	if (_enabled) {
 		Util::AxisAlignedBox bounds(__position.x-_radius, __position.x+_radius, 0.0f, 0.0f, __position.z-_radius, __position.z+_radius);
-		gSpatialDatabase->removeObject( this, bounds);
+		_context->spatialDatabase->removeObject( this, bounds);
 	}
 }
 
 void CollisionAgent::disable()
 {
 	Util::AxisAlignedBox bounds(__position.x-_radius, __position.x+_radius, 0.0f, 0.0f, __position.z-_radius, __position.z+_radius);
-	gSpatialDatabase->removeObject( this, bounds);
+	_context->spatialDatabase->removeObject( this, bounds);
 	_enabled = false;
 }
 
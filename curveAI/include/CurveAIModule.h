@@ -14,11 +14,6 @@
 #include "Logger.h"
 
 
-
-// globally accessible to the curveAI plugin
-extern SteerLib::EngineInterface * gEngine;
-extern SteerLib::GridDatabase2D * gSpatialDatabase;
-
 namespace CurveAIGlobals {
 
 	struct PhaseProfilers {
@@ -34,17 +29,24 @@ namespace CurveAIGlobals {
 	};
 
 
-	extern unsigned int gLongTermPlanningPhaseInterval;
-	extern unsigned int gMidTermPlanningPhaseInterval;
-	extern unsigned int gShortTermPlanningPhaseInterval;
-	extern unsigned int gPredictivePhaseInterval;
-	extern unsigned int gReactivePhaseInterval;
-	extern unsigned int gPerceptivePhaseInterval;
-	extern bool gUseDynamicPhaseScheduling;
-	extern bool gShowStats;
-	extern bool gShowAllStats;
-
-	extern PhaseProfilers * gPhaseProfilers;
+	/// @brief The state shared by all agents of one CurveAIModule.
+	///
+	/// Every module instance owns its own context, and its agents reach it through the module that created them,
+	/// so that several engines can each load this plugin in the same process.
+	struct ModuleContext {
+		SteerLib::EngineInterface * engine;
+		SteerLib::GridDatabase2D * spatialDatabase;
+		unsigned int longTermPlanningPhaseInterval;
+		unsigned int midTermPlanningPhaseInterval;
+		unsigned int shortTermPlanningPhaseInterval;
+		unsigned int predictivePhaseInterval;
+		unsigned int reactivePhaseInterval;
+		unsigned int perceptivePhaseInterval;
+		bool useDynamicPhaseScheduling;
+		bool showStats;
+		bool showAllStats;
+		PhaseProfilers * phaseProfilers;
+	};
 }
 
 
@@ -79,6 +81,9 @@ public:
 	SteerLib::AgentInterface * createAgent();
 	void destroyAgent( SteerLib::AgentInterface * agent );
 
+	/// Returns the state shared by the agents of this module.
+	inline CurveAIGlobals::ModuleContext * getContext() { return &_context; }
+
 	void preprocessFrame(float timeStamp, float dt, unsigned int frameNumber);
 	void postprocessFrame(float timeStamp, float dt, unsigned int frameNumber);
 	void preprocessSimulation();
@@ -86,6 +91,7 @@ public:
 	void cleanupSimulation();
 
 protected:
+	CurveAIGlobals::ModuleContext _context;
 	std::string logFilename; // = "AI.log";
 	bool logStats; // = false;
 	Logger * _logger;
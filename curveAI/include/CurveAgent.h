@@ -18,7 +18,7 @@
 class CurveAgent : public SteerLib::AgentInterface
 {
 public:
-	CurveAgent();
+	CurveAgent(CurveAIModule * module);
 	~CurveAgent();
 	void reset(const SteerLib::AgentInitialConditions & initialConditions, SteerLib::EngineInterface * engineInfo);
 	void updateAI(float timeStamp, float dt, unsigned int frameNumber);
@@ -52,6 +52,8 @@ public:
 
 
 protected:
+	/// The state shared with the other agents of the module that created this agent.
+	CurveAIGlobals::ModuleContext * _context;
 	/// Updates position, velocity, and orientation of the agent, given the force and dt time step.
 	void _doEulerStep(const Util::Vector & steeringDecisionForce, float dt);
 	bool _enabled;
@@ -21,8 +21,9 @@
 #define MAX_SPEED 1.3f
 #define AGENT_MASS 1.0f
 
-CurveAgent::CurveAgent()
+CurveAgent::CurveAgent(CurveAIModule * module)
 {
+	_context = module->getContext();
 	_enabled = false;
 
 	// Set curve type here
@@ -34,14 +35,14 @@ CurveAgent::~CurveAgent()
 {
 	if (_enabled) {
 		Util::AxisAlignedBox bounds(__position.x - _radius, __position.x + _radius, 0.0f, 0.0f, __position.z - _radius, __position.z + _radius);
-		gSpatialDatabase->removeObject(this, bounds);
+		_context->spatialDatabase->removeObject(this, bounds);
 	}
 }
 
 void CurveAgent::disable()
 {
 	Util::AxisAlignedBox bounds(__position.x - _radius, __position.x + _radius, 0.0f, 0.0f, __position.z - _radius, __position.z + _radius);
-	gSpatialDatabase->removeObject(this, bounds);
+	_context->spatialDatabase->removeObject(this, bounds);
 	_enabled = false;
 }
 
@@ -74,11 +75,11 @@ void CurveAgent::reset(const SteerLib::AgentInitialConditions & initialCondition
 
 	if (!_enabled) {
 		// if the agent was not enabled, then it does not already exist in the database, so add it.
-		gSpatialDatabase->addObject(this, newBounds);
+		_context->spatialDatabase->addObject(this, newBounds);
 	}
 	else {
 		// if the agent was enabled, then the agent already existed in the database, so update it instead of adding it.
-		gSpatialDatabase->updateObject(this, oldBounds, newBounds);
+		_context->spatialDatabase->updateObject(this, oldBounds, newBounds);
 	}
 
 	_enabled = true;
@@ -93,7 +94,7 @@ void CurveAgent::reset(const SteerLib::AgentInitialConditions & initialCondition
 			_goalQueue.push_back(initialConditions.goals[i]);
 			if (initialConditions.goals[i].targetIsRandom) {
 				// if the goal is random, we must randomly generate the goal.
-				_goalQueue.back().targetLocation = gSpatialDatabase->randomPositionWithoutCollisions(1.0f, true);
+				_goalQueue.back().targetLocation = _context->spatialDatabase->randomPositionWithoutCollisions(1.0f, true, engineInfo->getRandomStream(this));
 			}
 		}
 		else {
@@ -121,7 +122,7 @@ void CurveAgent::updateAI(float timeStamp, float dt, unsigned int frameNumber)
 {
 	//For this function, we assume that all goals are of type GOAL_TYPE_SEEK_STATIC_TARGET.
 	//The error check for this was performed in reset().
-	Util::AutomaticFunctionProfiler profileThisFunction(&CurveAIGlobals::gPhaseProfilers->aiProfiler);
+	Util::AutomaticFunctionProfiler profileThisFunction(&_context->phaseProfilers->aiProfiler);
 	Util::Point newPosition;
 
 	//Move one step on hermiteCurve
@@ -134,7 +135,7 @@ void CurveAgent::updateAI(float timeStamp, float dt, unsigned int frameNumber)
 	//Update the database with the new agent's setup
 	Util::AxisAlignedBox oldBounds(__position.x - _radius, __position.x + _radius, 0.0f, 0.0f, __position.z - _radius, __position.z + _radius);
 	Util::AxisAlignedBox newBounds(newPosition.x - _radius, newPosition.x + _radius, 0.0f, 0.0f, newPosition.z - _radius, newPosition.z + _radius);
-	gSpatialDatabase->updateObject(this, oldBounds, newBounds);
+	_context->spatialDatabase->updateObject(this, oldBounds, newBounds);
 
 	//Update current position
 	__position = newPosition;
@@ -145,13 +146,13 @@ void CurveAgent::draw()
 {
 #ifdef ENABLE_GUI
 	// if the agent is selected, do some annotations just for demonstration
-	if (gEngine->isAgentSelected(this)) {
+	if (_context->engine->isAgentSelected(this)) {
 		Util::Ray ray;
 		ray.initWithUnitInterval(__position, _forward);
 		float t = 0.0f;
 		SteerLib::SpatialDatabaseItem * objectFound;
 		Util::DrawLib::drawLine(ray.pos, ray.eval(1.0f));
-		if (gSpatialDatabase->trace(ray, t, objectFound, this, false)) {
+		if (_context->spatialDatabase->trace(ray, t, objectFound, this, false)) {
 			//Util::DrawLib::drawStar(__position, _forward, _radius, Util::gOrange);
 			Util::DrawLib::drawMyAgent(__position, _forward, _radius, Util::gOrange);
 		}
@@ -198,7 +199,7 @@ void CurveAgent::_doEulerStep(const Util::Vector & steeringDecisionForce, float
 	// update the database with the new agent's setup
 	Util::AxisAlignedBox oldBounds(__position.x - _radius, __position.x + _radius, 0.0f, 0.0f, __position.z - _radius, __position.z + _radius);
 	Util::AxisAlignedBox newBounds(newPosition.x - _radius, newPosition.x + _radius, 0.0f, 0.0f, newPosition.z - _radius, newPosition.z + _radius);
-	gSpatialDatabase->updateObject(this, oldBounds, newBounds);
+	_context->spatialDatabase->updateObject(this, oldBounds, newBounds);
 
 	__position = newPosition;
 }
\ No newline at end of file
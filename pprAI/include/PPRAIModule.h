@@ -30,65 +30,50 @@ namespace PPRGlobals {
 		Util::PerformanceProfiler predictivePhaseProfiler;
 		Util::PerformanceProfiler reactivePhaseProfiler;
 		Util::PerformanceProfiler steeringPhaseProfiler;
+
+		/// Adds the calls recorded by another set of profilers, e.g. those of a different thread.
+		void addStatistics(const PhaseProfilers & other) {
+			aiProfiler.addStatistics(other.aiProfiler);
+			drawProfiler.addStatistics(other.drawProfiler);
+			longTermPhaseProfiler.addStatistics(other.longTermPhaseProfiler);
+			midTermPhaseProfiler.addStatistics(other.midTermPhaseProfiler);
+			shortTermPhaseProfiler.addStatistics(other.shortTermPhaseProfiler);
+			perceptivePhaseProfiler.addStatistics(other.perceptivePhaseProfiler);
+			predictivePhaseProfiler.addStatistics(other.predictivePhaseProfiler);
+			reactivePhaseProfiler.addStatistics(other.reactivePhaseProfiler);
+			steeringPhaseProfiler.addStatistics(other.steeringPhaseProfiler);
+		}
 	};
 
 
-	extern SteerLib::EngineInterface * gEngine;
-	extern SteerLib::GridDatabase2D * gSpatialDatabase;
-	extern unsigned int gLongTermPlanningPhaseInterval;
-	extern unsigned int gMidTermPlanningPhaseInterval;
-	extern unsigned int gShortTermPlanningPhaseInterval;
-	extern unsigned int gPredictivePhaseInterval;
-	extern unsigned int gReactivePhaseInterval;
-	extern unsigned int gPerceptivePhaseInterval;
-	extern bool gUseDynamicPhaseScheduling;
-	extern bool gShowStats;
-	extern bool gShowAllStats;
-
-
-	// Adding a bunch of parameters so they can be changed via input
-	extern float ped_max_speed;
-	extern float ped_typical_speed ;
-	extern float ped_max_force  ;
-	extern float ped_max_speed_factor  ;
-	extern float ped_faster_speed_factor ;
-	extern float ped_slightly_faster_speed_factor;
-	extern float ped_typical_speed_factor   ;
-	extern float ped_slightly_slower_speed_factor;
-	extern float ped_slower_speed_factor;
-	extern float ped_cornering_turn_rate;
-	extern float ped_adjustment_turn_rate;
-	extern float ped_faster_avoidance_turn_rate;
-	extern float ped_typical_avoidance_turn_rate;
-	extern float ped_braking_rate ;
-	extern float ped_comfort_zone   ;
-	extern float ped_query_radius  ;
-	extern float ped_similar_direction_dot_product_threshold;
-	extern float ped_same_direction_dot_product_threshold;
-	extern float ped_oncoming_prediction_threshold;
-	extern float ped_oncoming_reaction_threshold;
-	extern float ped_wrong_direction_dot_product_threshold;
-	extern float ped_threat_distance_threshold;
-	extern float ped_threat_min_time_threshold;
-	extern float ped_threat_max_time_threshold;
-	extern float ped_predictive_anticipation_factor ;
-	extern float ped_reactive_anticipation_factor;
-	extern float ped_crowd_influence_factor;
-	extern float ped_facing_static_object_threshold;
-	extern float ped_ordinary_steering_strength;
-	extern float ped_oncoming_threat_avoidance_strength;
-	extern float ped_cross_threat_avoidance_strength;
-	extern float ped_max_turning_rate;
-	extern int ped_feeling_crowded_threshold;
-	extern float ped_scoot_rate ;
-	extern float ped_reached_target_distance_threshold ;
-	extern float ped_dynamic_collision_padding;
-	extern int ped_furthest_local_target_distance;
-	extern int ped_next_waypoint_distance;
-	extern int ped_max_num_waypoints;
-
-
-	extern PhaseProfilers * gPhaseProfilers;
+	/// @brief The state shared by all agents of one PPRAIModule.
+	///
+	/// Every module instance owns its own context, and its agents reach it through the module that created them,
+	/// so that several engines can each load this plugin in the same process.
+	struct ModuleContext {
+		SteerLib::EngineInterface * engine;
+		SteerLib::GridDatabase2D * spatialDatabase;
+		unsigned int longTermPlanningPhaseInterval;
+		unsigned int midTermPlanningPhaseInterval;
+		unsigned int shortTermPlanningPhaseInterval;
+		unsigned int predictivePhaseInterval;
+		unsigned int reactivePhaseInterval;
+		unsigned int perceptivePhaseInterval;
+		bool useDynamicPhaseScheduling;
+		/// Spreads the fixed phase intervals of different agents across frames, using the engine's SteerLib::MultiRateScheduler.
+		bool staggerPhases;
+		bool showStats;
+		bool showAllStats;
+		/// The statistics of the whole simulation; the profilers of all threads are added into it when the simulation is cleaned up.
+		PhaseProfilers * phaseProfilers;
+		/// One set of profilers per engine thread, so that agents updated in parallel never record into the same profiler.
+		std::vector<PhaseProfilers> threadPhaseProfilers;
+
+		/// Returns the profilers of the calling thread.
+		PhaseProfilers & getThreadPhaseProfilers() { return threadPhaseProfilers[engine->getIndexOfCurrentThread()]; }
+		/// The parameters given to every new agent, before its own behaviour is applied.
+		PPRParameters parameters;
+	};
 }
 
 class PPRAIModule : public SteerLib::ModuleInterface
@@ -107,10 +92,17 @@ public:
 	SteerLib::AgentInterface * createAgent();
 	void destroyAgent( SteerLib::AgentInterface * agent ) { if (agent) delete agent;  agent = NULL; }
 
+	/// Returns the state shared by the agents of this module.
+	inline PPRGlobals::ModuleContext * getContext() { return &_context; }
+
 	void initializeSimulation();
 	void cleanupSimulation();
 
+protected:
+	PPRGlobals::ModuleContext _context;
+
 private:
+	bool logStats;
 	bool logToFie;
 	std::string logFilename;
 	Logger * _pprLogger;
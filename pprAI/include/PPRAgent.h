@@ -24,11 +24,11 @@
 //======================================================================================
 
 class PPRAgent;
+class PPRAIModule;
 
 namespace PPRGlobals {
-	// NOTE this is forward declared for an inline function defined below
-	// other declarations for this namespace belong in PPRAIModule.h
-	extern SteerLib::EngineInterface * gEngine;
+	// declared in PPRAIModule.h
+	struct ModuleContext;
 }
 
 
@@ -84,7 +84,7 @@ class PPRAgent : public SteerLib::AgentInterface
 {
 public:
 	// AgentInterface functionality:
-	PPRAgent();
+	PPRAgent(PPRAIModule * module);
 	~PPRAgent();
 	void reset(const SteerLib::AgentInitialConditions & initialConditions, SteerLib::EngineInterface * engineInfo);
 	void updateAI(float timeStamp, float dt, unsigned int frameNumber);
@@ -133,12 +133,12 @@ public:
 	Util::Point localTargetLocation() { return _localTargetLocation; }
 	Util::Vector localTargetDirection() { return _finalSteeringCommand.targetDirection; }
 	void setParameters(SteerLib::Behaviour behave);
-	bool isSelected() { 
-		return PPRGlobals::gEngine->isAgentSelected(this);
-	}
+	bool isSelected();
 
 
 protected:
+	/// The state shared with the other agents of the module that created this agent.
+	PPRGlobals::ModuleContext * _context;
 	//========================
 	// private functionality:
 	//========================
@@ -168,6 +168,9 @@ protected:
 	inline bool threatListContainsAgent(SteerLib::AgentInterface * agent) { unsigned int dummy; return threatListContainsAgent(agent, dummy); }
 	void disable();
 	void drawPlannedPath();
+	// with the "stagger" option, gets and gives back the offsets of the phases from the engine's scheduler.
+	void choosePhaseOffsets();
+	void releasePhaseOffsets();
 
 	//========================
 	// private data:
@@ -185,7 +188,7 @@ protected:
 	Util::Point _localTargetLocation;
 
 	// PERCEPTION PHASE
-	std::set<SteerLib::SpatialDatabaseItemPtr> _neighbors;
+	std::vector<SteerLib::SpatialDatabaseItemPtr> _neighbors;
 	unsigned int _numAgentsInVisualField;  // different than _neighbors.size(), which includes static objects.
 
 	// PREDICTION PHASE
@@ -212,7 +215,18 @@ protected:
 	unsigned int _nextFrameToRunPredictivePhase;
 	unsigned int _nextFrameToRunReactivePhase;
 
+	// with the "stagger" option, the frame offset (modulo the phase interval) each phase runs at.
+	bool _hasPhaseOffsets;
+	unsigned int _longTermPlanningPhaseOffset;
+	unsigned int _midTermPlanningPhaseOffset;
+	unsigned int _shortTermPlanningPhaseOffset;
+	unsigned int _perceptivePhaseOffset;
+	unsigned int _predictivePhaseOffset;
+	unsigned int _reactivePhaseOffset;
+
 	unsigned int _lastFrameLongTermWasCalled;
+	/// true while a scheduled long-term plan waits in the engine's SteerLib::DeferredWorkQueue.
+	bool _longTermPlanningIsDeferred;
 	unsigned int _lastFrameMidTermWasCalled;
 	unsigned int _lastFrameShortTermWasCalled;
 	unsigned int _lastFramePerceptiveWasCalled;
@@ -27,65 +27,6 @@ using namespace SteerLib;
 #include "LogObject.h"
 #include "LogManager.h"
 
-// todo: make these static?
-namespace PPRGlobals {
-	SteerLib::EngineInterface * gEngine;
-	SteerLib::GridDatabase2D * gSpatialDatabase;
-	unsigned int gLongTermPlanningPhaseInterval;
-	unsigned int gMidTermPlanningPhaseInterval;
-	unsigned int gShortTermPlanningPhaseInterval;
-	unsigned int gPredictivePhaseInterval;
-	unsigned int gReactivePhaseInterval;
-	unsigned int gPerceptivePhaseInterval;
-
-	bool gUseDynamicPhaseScheduling;
-	bool gShowStats;
-	bool logStats;
-	bool gShowAllStats;
-	
-	// Adding a bunch of parameters so they can be changed via input
-	float ped_max_speed;
-	float ped_typical_speed ;
-	float ped_max_force  ;
-	float ped_max_speed_factor  ;
-	float ped_faster_speed_factor ;
-	float ped_slightly_faster_speed_factor;
-	float ped_typical_speed_factor   ;
-	float ped_slightly_slower_speed_factor;
-	float ped_slower_speed_factor;
-	float ped_cornering_turn_rate;
-	float ped_adjustment_turn_rate;
-	float ped_faster_avoidance_turn_rate;
-	float ped_typical_avoidance_turn_rate;
-	float ped_braking_rate ;
-	float ped_comfort_zone   ;
-	float ped_query_radius  ;
-	float ped_similar_direction_dot_product_threshold;
-	float ped_same_direction_dot_product_threshold;
-	float ped_oncoming_prediction_threshold;
-	float ped_oncoming_reaction_threshold;
-	float ped_wrong_direction_dot_product_threshold;
-	float ped_threat_distance_threshold;
-	float ped_threat_min_time_threshold;
-	float ped_threat_max_time_threshold;
-	float ped_predictive_anticipation_factor ;
-	float ped_reactive_anticipation_factor;
-	float ped_crowd_influence_factor;
-	float ped_facing_static_object_threshold;
-	float ped_ordinary_steering_strength;
-	float ped_oncoming_threat_avoidance_strength;
-	float ped_cross_threat_avoidance_strength;
-	float ped_max_turning_rate;
-	int ped_feeling_crowded_threshold;
-	float ped_scoot_rate ;
-	float ped_reached_target_distance_threshold ;
-	float ped_dynamic_collision_padding;
-	int ped_furthest_local_target_distance;
-	int ped_next_waypoint_distance;
-	int ped_max_num_waypoints;
-
-	PhaseProfilers * gPhaseProfilers;
-}
 
 using namespace PPRGlobals;
 
@@ -94,251 +35,258 @@ using namespace PPRGlobals;
 //
 void PPRAIModule::init( const SteerLib::OptionDictionary & options, SteerLib::EngineInterface * engineInfo )
 {
-	gSpatialDatabase = engineInfo->getSpatialDatabase();
-
-	gEngine = engineInfo;
-
-
-	gLongTermPlanningPhaseInterval = LONG_TERM_PLANNING_INTERVAL;
-	gMidTermPlanningPhaseInterval = MID_TERM_PLANNING_INTERVAL;
-	gShortTermPlanningPhaseInterval = SHORT_TERM_PLANNING_INTERVAL;
-	gPerceptivePhaseInterval = PERCEPTIVE_PHASE_INTERVAL;
-	gPredictivePhaseInterval = PREDICTIVE_PHASE_INTERVAL;
-	gReactivePhaseInterval = REACTIVE_PHASE_INTERVAL;
-	gUseDynamicPhaseScheduling = false;
-	gShowStats = false;
+	// the profilers start out NULL, until initializeSimulation() creates them.
+	_context = ModuleContext();
+	_context.spatialDatabase = engineInfo->getSpatialDatabase();
+
+	_context.engine = engineInfo;
+
+
+	_context.longTermPlanningPhaseInterval = LONG_TERM_PLANNING_INTERVAL;
+	_context.midTermPlanningPhaseInterval = MID_TERM_PLANNING_INTERVAL;
+	_context.shortTermPlanningPhaseInterval = SHORT_TERM_PLANNING_INTERVAL;
+	_context.perceptivePhaseInterval = PERCEPTIVE_PHASE_INTERVAL;
+	_context.predictivePhaseInterval = PREDICTIVE_PHASE_INTERVAL;
+	_context.reactivePhaseInterval = REACTIVE_PHASE_INTERVAL;
+	_context.useDynamicPhaseScheduling = false;
+	_context.staggerPhases = false;
+	_context.showStats = false;
 	logStats = false;
-	gShowAllStats = false;
+	_context.showAllStats = false;
 	logFilename = "pprAI.log";
 
 
-	ped_max_speed = PED_MAX_SPEED;
-	ped_typical_speed  = PED_TYPICAL_SPEED ;
-	ped_max_force   = PED_MAX_FORCE  ;
-	ped_max_speed_factor   = PED_MAX_SPEED_FACTOR  ;
-	ped_faster_speed_factor  = PED_FASTER_SPEED_FACTOR ;
-	ped_slightly_faster_speed_factor = PED_SLIGHTLY_FASTER_SPEED_FACTOR;
-	ped_typical_speed_factor    = PED_TYPICAL_SPEED_FACTOR   ;
-	ped_slightly_slower_speed_factor = PED_SLIGHTLY_SLOWER_SPEED_FACTOR;
-	ped_slower_speed_factor = PED_SLOWER_SPEED_FACTOR;
-	ped_cornering_turn_rate = PED_CORNERING_TURN_RATE;
-	ped_adjustment_turn_rate = PED_ADJUSTMENT_TURN_RATE;
-	ped_faster_avoidance_turn_rate = PED_FASTER_AVOIDANCE_TURN_RATE;
-	ped_typical_avoidance_turn_rate = PED_TYPICAL_AVOIDANCE_TURN_RATE;
-	ped_braking_rate  = PED_BRAKING_RATE ;
-	ped_comfort_zone    = PED_COMFORT_ZONE   ;
-	ped_query_radius   = PED_QUERY_RADIUS  ;
-	ped_similar_direction_dot_product_threshold = PED_SIMILAR_DIRECTION_DOT_PRODUCT_THRESHOLD;
-	ped_same_direction_dot_product_threshold = PED_SAME_DIRECTION_DOT_PRODUCT_THRESHOLD;
-	ped_oncoming_prediction_threshold = PED_ONCOMING_PREDICTION_THRESHOLD;
-	ped_oncoming_reaction_threshold = PED_ONCOMING_REACTION_THRESHOLD;
-	ped_wrong_direction_dot_product_threshold = PED_WRONG_DIRECTION_DOT_PRODUCT_THRESHOLD;
-	ped_threat_distance_threshold = PED_THREAT_DISTANCE_THRESHOLD;
-	ped_threat_min_time_threshold = PED_THREAT_MIN_TIME_THRESHOLD;
-	ped_threat_max_time_threshold = PED_THREAT_MAX_TIME_THRESHOLD;
-	ped_predictive_anticipation_factor  = PED_PREDICTIVE_ANTICIPATION_FACTOR ;
-	ped_reactive_anticipation_factor = PED_REACTIVE_ANTICIPATION_FACTOR;
-	ped_crowd_influence_factor = PED_CROWD_INFLUENCE_FACTOR;
-	ped_facing_static_object_threshold = PED_FACING_STATIC_OBJECT_THRESHOLD;
-	ped_ordinary_steering_strength = PED_ORDINARY_STEERING_STRENGTH;
-	ped_oncoming_threat_avoidance_strength = PED_ONCOMING_THREAT_AVOIDANCE_STRENGTH;
-	ped_cross_threat_avoidance_strength = PED_CROSS_THREAT_AVOIDANCE_STRENGTH;
-	ped_max_turning_rate = PED_MAX_TURNING_RATE;
-	ped_feeling_crowded_threshold = PED_FEELING_CROWDED_THRESHOLD;
-	ped_scoot_rate  = PED_SCOOT_RATE ;
-	ped_reached_target_distance_threshold  = PED_REACHED_TARGET_DISTANCE_THRESHOLD ;
-	ped_dynamic_collision_padding = PED_DYNAMIC_COLLISION_PADDING;
-	ped_furthest_local_target_distance = PED_FURTHEST_LOCAL_TARGET_DISTANCE;
-	ped_next_waypoint_distance = PED_NEXT_WAYPOINT_DISTANCE;
-	ped_max_num_waypoints = PED_MAX_NUM_WAYPOINTS;
+	_context.parameters.ped_max_speed = PED_MAX_SPEED;
+	_context.parameters.ped_typical_speed  = PED_TYPICAL_SPEED ;
+	_context.parameters.ped_max_force   = PED_MAX_FORCE  ;
+	_context.parameters.ped_max_speed_factor   = PED_MAX_SPEED_FACTOR  ;
+	_context.parameters.ped_faster_speed_factor  = PED_FASTER_SPEED_FACTOR ;
+	_context.parameters.ped_slightly_faster_speed_factor = PED_SLIGHTLY_FASTER_SPEED_FACTOR;
+	_context.parameters.ped_typical_speed_factor    = PED_TYPICAL_SPEED_FACTOR   ;
+	_context.parameters.ped_slightly_slower_speed_factor = PED_SLIGHTLY_SLOWER_SPEED_FACTOR;
+	_context.parameters.ped_slower_speed_factor = PED_SLOWER_SPEED_FACTOR;
+	_context.parameters.ped_cornering_turn_rate = PED_CORNERING_TURN_RATE;
+	_context.parameters.ped_adjustment_turn_rate = PED_ADJUSTMENT_TURN_RATE;
+	_context.parameters.ped_faster_avoidance_turn_rate = PED_FASTER_AVOIDANCE_TURN_RATE;
+	_context.parameters.ped_typical_avoidance_turn_rate = PED_TYPICAL_AVOIDANCE_TURN_RATE;
+	_context.parameters.ped_braking_rate  = PED_BRAKING_RATE ;
+	_context.parameters.ped_comfort_zone    = PED_COMFORT_ZONE   ;
+	_context.parameters.ped_query_radius   = PED_QUERY_RADIUS  ;
+	_context.parameters.ped_similar_direction_dot_product_threshold = PED_SIMILAR_DIRECTION_DOT_PRODUCT_THRESHOLD;
+	_context.parameters.ped_same_direction_dot_product_threshold = PED_SAME_DIRECTION_DOT_PRODUCT_THRESHOLD;
+	_context.parameters.ped_oncoming_prediction_threshold = PED_ONCOMING_PREDICTION_THRESHOLD;
+	_context.parameters.ped_oncoming_reaction_threshold = PED_ONCOMING_REACTION_THRESHOLD;
+	_context.parameters.ped_wrong_direction_dot_product_threshold = PED_WRONG_DIRECTION_DOT_PRODUCT_THRESHOLD;
+	_context.parameters.ped_threat_distance_threshold = PED_THREAT_DISTANCE_THRESHOLD;
+	_context.parameters.ped_threat_min_time_threshold = PED_THREAT_MIN_TIME_THRESHOLD;
+	_context.parameters.ped_threat_max_time_threshold = PED_THREAT_MAX_TIME_THRESHOLD;
+	_context.parameters.ped_predictive_anticipation_factor  = PED_PREDICTIVE_ANTICIPATION_FACTOR ;
+	_context.parameters.ped_reactive_anticipation_factor = PED_REACTIVE_ANTICIPATION_FACTOR;
+	_context.parameters.ped_crowd_influence_factor = PED_CROWD_INFLUENCE_FACTOR;
+	_context.parameters.ped_facing_static_object_threshold = PED_FACING_STATIC_OBJECT_THRESHOLD;
+	_context.parameters.ped_ordinary_steering_strength = PED_ORDINARY_STEERING_STRENGTH;
+	_context.parameters.ped_oncoming_threat_avoidance_strength = PED_ONCOMING_THREAT_AVOIDANCE_STRENGTH;
+	_context.parameters.ped_cross_threat_avoidance_strength = PED_CROSS_THREAT_AVOIDANCE_STRENGTH;
+	_context.parameters.ped_max_turning_rate = PED_MAX_TURNING_RATE;
+	_context.parameters.ped_feeling_crowded_threshold = PED_FEELING_CROWDED_THRESHOLD;
+	_context.parameters.ped_scoot_rate  = PED_SCOOT_RATE ;
+	_context.parameters.ped_reached_target_distance_threshold  = PED_REACHED_TARGET_DISTANCE_THRESHOLD ;
+	_context.parameters.ped_dynamic_collision_padding = PED_DYNAMIC_COLLISION_PADDING;
+	_context.parameters.ped_furthest_local_target_distance = PED_FURTHEST_LOCAL_TARGET_DISTANCE;
+	_context.parameters.ped_next_waypoint_distance = PED_NEXT_WAYPOINT_DISTANCE;
+	_context.parameters.ped_max_num_waypoints = PED_MAX_NUM_WAYPOINTS;
 
 	SteerLib::OptionDictionary::const_iterator optionIter;
 	for (optionIter = options.begin(); optionIter != options.end(); ++optionIter) {
 		std::stringstream value((*optionIter).second);
 		if ((*optionIter).first == "longplan") {
-			value >> gLongTermPlanningPhaseInterval;
+			value >> _context.longTermPlanningPhaseInterval;
 		}
 		else if ((*optionIter).first == "midplan")
 		{
-			value >> gMidTermPlanningPhaseInterval;
+			value >> _context.midTermPlanningPhaseInterval;
 		}
 		else if ((*optionIter).first == "shortplan")
 		{
-			value >> gShortTermPlanningPhaseInterval;
+			value >> _context.shortTermPlanningPhaseInterval;
 		}
 		else if ((*optionIter).first == "perceptive")
 		{
-			value >> gPerceptivePhaseInterval;
+			value >> _context.perceptivePhaseInterval;
 		}
 		else if ((*optionIter).first == "predictive")
 		{
-			value >> gPredictivePhaseInterval;
+			value >> _context.predictivePhaseInterval;
 		}
 		else if ((*optionIter).first == "reactive")
 		{
-			value >> gReactivePhaseInterval;
+			value >> _context.reactivePhaseInterval;
 		}
 		else if ((*optionIter).first == "dynamic")
 		{
-			gUseDynamicPhaseScheduling = Util::getBoolFromString(value.str());
+			_context.useDynamicPhaseScheduling = Util::getBoolFromString(value.str());
+		}
+		else if ((*optionIter).first == "stagger")
+		{
+			_context.staggerPhases = Util::getBoolFromString(value.str());
 		}
 		else if ((*optionIter).first == "ped_max_speed")
 		{
-			value >> ped_max_speed;
+			value >> _context.parameters.ped_max_speed;
 		}
 		else if ((*optionIter).first == "ped_typical_speed")
 		{
-			value >> ped_typical_speed;
+			value >> _context.parameters.ped_typical_speed;
 		}
 		else if ((*optionIter).first == "ped_max_force")
 		{
 			std::cout << "Setting max_force to: " << value.str();
-			value >> ped_max_force;
+			value >> _context.parameters.ped_max_force;
 		}
 
 		else if ((*optionIter).first == "ped_max_speed_factor")
 		{
-			value >> ped_max_speed_factor;
+			value >> _context.parameters.ped_max_speed_factor;
 		}
 		else if ((*optionIter).first == "ped_faster_speed_factor")
 		{
-			value >> ped_faster_speed_factor;
+			value >> _context.parameters.ped_faster_speed_factor;
 		}
 		else if ((*optionIter).first == "ped_slightly_faster_speed_factor")
 		{
-			value >> ped_slightly_faster_speed_factor;
+			value >> _context.parameters.ped_slightly_faster_speed_factor;
 		}
 		else if ((*optionIter).first == "ped_typical_speed_factor")
 		{
-			value >> ped_typical_speed_factor;
+			value >> _context.parameters.ped_typical_speed_factor;
 		}
 		else if ((*optionIter).first == "ped_slightly_slower_speed_factor")
 		{
-			value >> ped_slightly_slower_speed_factor;
+			value >> _context.parameters.ped_slightly_slower_speed_factor;
 		}
 		else if ((*optionIter).first == "ped_slower_speed_factor")
 		{
-			value >> ped_slower_speed_factor;
+			value >> _context.parameters.ped_slower_speed_factor;
 		}
 		else if ((*optionIter).first == "ped_cornering_turn_rate")
 		{
-			value >> ped_cornering_turn_rate;
+			value >> _context.parameters.ped_cornering_turn_rate;
 		}
 		else if ((*optionIter).first == "ped_adjustment_turn_rate")
 		{
-			value >> ped_adjustment_turn_rate;
+			value >> _context.parameters.ped_adjustment_turn_rate;
 		}
 		else if ((*optionIter).first == "ped_faster_avoidance_turn_rate")
 		{
-			value >> ped_faster_avoidance_turn_rate;
+			value >> _context.parameters.ped_faster_avoidance_turn_rate;
 		}
 		else if ((*optionIter).first == "ped_typical_avoidance_turn_rate")
 		{
-			value >> ped_typical_avoidance_turn_rate;
+			value >> _context.parameters.ped_typical_avoidance_turn_rate;
 		}
 		else if ((*optionIter).first == "ped_braking_rate")
 		{
-			value >> ped_braking_rate;
+			value >> _context.parameters.ped_braking_rate;
 		}
 		else if ((*optionIter).first == "ped_comfort_zone")
 		{
-			value >> ped_comfort_zone;
+			value >> _context.parameters.ped_comfort_zone;
 		}
 		else if ((*optionIter).first == "ped_query_radius")
 		{
-			value >> ped_query_radius;
+			value >> _context.parameters.ped_query_radius;
 		}
 		else if ((*optionIter).first == "ped_similar_direction_dot_product_threshold")
 		{
-			value >> ped_similar_direction_dot_product_threshold;
+			value >> _context.parameters.ped_similar_direction_dot_product_threshold;
 		}
 		else if ((*optionIter).first == "ped_same_direction_dot_product_threshold")
 		{
-			value >> ped_same_direction_dot_product_threshold;
+			value >> _context.parameters.ped_same_direction_dot_product_threshold;
 		}
 		else if ((*optionIter).first == "ped_oncoming_prediction_threshold")
 		{
-			value >> ped_oncoming_prediction_threshold;
+			value >> _context.parameters.ped_oncoming_prediction_threshold;
 		}
 		else if ((*optionIter).first == "ped_oncoming_reaction_threshold")
 		{
-			value >> ped_oncoming_reaction_threshold;
+			value >> _context.parameters.ped_oncoming_reaction_threshold;
 		}
 		else if ((*optionIter).first == "ped_wrong_direction_dot_product_threshold")
 		{
-			value >> ped_wrong_direction_dot_product_threshold;
+			value >> _context.parameters.ped_wrong_direction_dot_product_threshold;
 		}
 		else if ((*optionIter).first == "ped_threat_distance_threshold")
 		{
-			value >> ped_threat_distance_threshold;
+			value >> _context.parameters.ped_threat_distance_threshold;
 		}
 		else if ((*optionIter).first == "ped_threat_min_time_threshold")
 		{
-			value >> ped_threat_min_time_threshold;
+			value >> _context.parameters.ped_threat_min_time_threshold;
 		}
 		else if ((*optionIter).first == "ped_threat_max_time_threshold")
 		{
-			value >> ped_threat_max_time_threshold;
+			value >> _context.parameters.ped_threat_max_time_threshold;
 		}
 		else if ((*optionIter).first == "ped_predictive_anticipation_factor")
 		{
-			value >> ped_predictive_anticipation_factor;
+			value >> _context.parameters.ped_predictive_anticipation_factor;
 		}
 		else if ((*optionIter).first == "ped_reactive_anticipation_factor")
 		{
-			value >> ped_reactive_anticipation_factor;
+			value >> _context.parameters.ped_reactive_anticipation_factor;
 		}
 		else if ((*optionIter).first == "ped_crowd_influence_factor")
 		{
-			value >> ped_crowd_influence_factor;
+			value >> _context.parameters.ped_crowd_influence_factor;
 		}
 		else if ((*optionIter).first == "ped_facing_static_object_threshold")
 		{
-			value >> ped_facing_static_object_threshold;
+			value >> _context.parameters.ped_facing_static_object_threshold;
 		}
 		else if ((*optionIter).first == "ped_ordinary_steering_strength")
 		{
-			value >> ped_ordinary_steering_strength;
+			value >> _context.parameters.ped_ordinary_steering_strength;
 		}
 		else if ((*optionIter).first == "ped_oncoming_threat_avoidance_strength")
 		{
-			value >> ped_oncoming_threat_avoidance_strength;
+			value >> _context.parameters.ped_oncoming_threat_avoidance_strength;
 		}
 		else if ((*optionIter).first == "ped_cross_threat_avoidance_strength")
 		{
-			value >> ped_cross_threat_avoidance_strength;
+			value >> _context.parameters.ped_cross_threat_avoidance_strength;
 		}
 		else if ((*optionIter).first == "ped_max_turning_rate")
 		{
-			value >> ped_max_turning_rate;
+			value >> _context.parameters.ped_max_turning_rate;
 		}
 		else if ((*optionIter).first == "ped_feeling_crowded_threshold")
 		{
-			value >> ped_feeling_crowded_threshold;
+			value >> _context.parameters.ped_feeling_crowded_threshold;
 		}
 		else if ((*optionIter).first == "ped_scoot_rate")
 		{
-			value >> ped_scoot_rate;
+			value >> _context.parameters.ped_scoot_rate;
 		}
 		else if ((*optionIter).first == "ped_reached_target_distance_threshold")
 		{
-			value >> ped_reached_target_distance_threshold;
+			value >> _context.parameters.ped_reached_target_distance_threshold;
 		}
 		else if ((*optionIter).first == "ped_dynamic_collision_padding")
 		{
-			value >> ped_dynamic_collision_padding;
+			value >> _context.parameters.ped_dynamic_collision_padding;
 		}
 		else if ((*optionIter).first == "ped_furthest_local_target_distance")
 		{
-			value >> ped_furthest_local_target_distance;
+			value >> _context.parameters.ped_furthest_local_target_distance;
 		}
 		else if ((*optionIter).first == "ped_next_waypoint_distance")
 		{
-			value >> ped_next_waypoint_distance;
+			value >> _context.parameters.ped_next_waypoint_distance;
 		}
 		else if ((*optionIter).first == "ped_max_num_waypoints")
 		{
-			value >> ped_max_num_waypoints;
+			value >> _context.parameters.ped_max_num_waypoints;
 		}
 		else if ((*optionIter).first == "ailogFileName")
 		{
@@ -347,11 +295,11 @@ void PPRAIModule::init( const SteerLib::OptionDictionary & options, SteerLib::En
 		}
 		else if ((*optionIter).first == "stats")
 		{
-			gShowStats = Util::getBoolFromString(value.str());
+			_context.showStats = Util::getBoolFromString(value.str());
 		}
 		else if ((*optionIter).first == "allstats")
 		{
-			gShowAllStats = Util::getBoolFromString(value.str());
+			_context.showAllStats = Util::getBoolFromString(value.str());
 		}
 		else
 		{
@@ -360,17 +308,20 @@ void PPRAIModule::init( const SteerLib::OptionDictionary & options, SteerLib::En
 	}
 
 
-	if (gShowStats)
+	if (_context.showStats)
 	{
 		std::cout << std::endl;
-		if (!gUseDynamicPhaseScheduling) {
+		if (!_context.useDynamicPhaseScheduling) {
 			std::cout << " PHASE INTERVALS (in frames):\n";
-			std::cout << "   longplan: " << gLongTermPlanningPhaseInterval << "\n";
-			std::cout << "    midplan: " << gMidTermPlanningPhaseInterval << "\n";
-			std::cout << "  shortplan: " << gShortTermPlanningPhaseInterval << "\n";
-			std::cout << " perceptive: " << gPerceptivePhaseInterval << "\n";
-			std::cout << " predictive: " << gPredictivePhaseInterval << "\n";
-			std::cout << "   reactive: " << gReactivePhaseInterval << "\n";
+			std::cout << "   longplan: " << _context.longTermPlanningPhaseInterval << "\n";
+			std::cout << "    midplan: " << _context.midTermPlanningPhaseInterval << "\n";
+			std::cout << "  shortplan: " << _context.shortTermPlanningPhaseInterval << "\n";
+			std::cout << " perceptive: " << _context.perceptivePhaseInterval << "\n";
+			std::cout << " predictive: " << _context.predictivePhaseInterval << "\n";
+			std::cout << "   reactive: " << _context.reactivePhaseInterval << "\n";
+			if (_context.staggerPhases) {
+				std::cout << "  (staggered across agents)\n";
+			}
 		}
 		else {
 			std::cout << " PHASE INTERVALS (in frames):\n";
@@ -388,7 +339,7 @@ void PPRAIModule::init( const SteerLib::OptionDictionary & options, SteerLib::En
 	// print a warning if we are using annotations with too many agents.
 	//
 #ifdef USE_ANNOTATIONS
-	if (gEngine->getAgents().size() > 30) {
+	if (_context.engine->getAgents().size() > 30) {
 		std::cerr << "WARNING: using annotations with a large number of agents will use a lot of memory and will be much slower." << std::endl;
 	}
 #endif
@@ -530,16 +481,17 @@ void PPRAIModule::initializeSimulation()
 	//
 	// initialize the performance profilers
 	//
-	gPhaseProfilers = new PhaseProfilers;
-	gPhaseProfilers->aiProfiler.reset();
-	gPhaseProfilers->longTermPhaseProfiler.reset();
-	gPhaseProfilers->midTermPhaseProfiler.reset();
-	gPhaseProfilers->shortTermPhaseProfiler.reset();
-	gPhaseProfilers->perceptivePhaseProfiler.reset();
-	gPhaseProfilers->predictivePhaseProfiler.reset();
-	gPhaseProfilers->reactivePhaseProfiler.reset();
-	gPhaseProfilers->steeringPhaseProfiler.reset();
-	
+	_context.phaseProfilers = new PhaseProfilers;
+	_context.phaseProfilers->aiProfiler.reset();
+	_context.phaseProfilers->longTermPhaseProfiler.reset();
+	_context.phaseProfilers->midTermPhaseProfiler.reset();
+	_context.phaseProfilers->shortTermPhaseProfiler.reset();
+	_context.phaseProfilers->perceptivePhaseProfiler.reset();
+	_context.phaseProfilers->predictivePhaseProfiler.reset();
+	_context.phaseProfilers->reactivePhaseProfiler.reset();
+	_context.phaseProfilers->steeringPhaseProfiler.reset();
+	_context.threadPhaseProfilers.assign(_context.engine->getNumThreads(), PhaseProfilers());
+
 }
 
 
@@ -548,17 +500,21 @@ void PPRAIModule::initializeSimulation()
 //
 void PPRAIModule::cleanupSimulation()
 {
+	for (unsigned int i=0; i < _context.threadPhaseProfilers.size(); i++) {
+		_context.phaseProfilers->addStatistics(_context.threadPhaseProfilers[i]);
+	}
+	_context.threadPhaseProfilers.assign(_context.threadPhaseProfilers.size(), PhaseProfilers());
 
 	if ( logStats )
 	{
 		LogObject pprLogObject;
-		pprLogObject.addLogData((long long) gLongTermPlanningPhaseInterval);
-		pprLogObject.addLogData((long long) gMidTermPlanningPhaseInterval);
-		pprLogObject.addLogData((long long) gShortTermPlanningPhaseInterval);
-		pprLogObject.addLogData((long long) gPerceptivePhaseInterval);
-		pprLogObject.addLogData((long long) gPredictivePhaseInterval);
-		pprLogObject.addLogData((long long) gReactivePhaseInterval);
-		if (gShowAllStats)
+		pprLogObject.addLogData((long long) _context.longTermPlanningPhaseInterval);
+		pprLogObject.addLogData((long long) _context.midTermPlanningPhaseInterval);
+		pprLogObject.addLogData((long long) _context.shortTermPlanningPhaseInterval);
+		pprLogObject.addLogData((long long) _context.perceptivePhaseInterval);
+		pprLogObject.addLogData((long long) _context.predictivePhaseInterval);
+		pprLogObject.addLogData((long long) _context.reactivePhaseInterval);
+		if (_context.showAllStats)
 		{
 			std::cout << "===================================================\n";
 			std::cout << "PROFILE RESULTS  " << std::endl;
@@ -566,131 +522,131 @@ void PPRAIModule::cleanupSimulation()
 
 			std::cout << "--- Long-term planning ---\n";
 			std::cout << std::endl;
-			gPhaseProfilers->longTermPhaseProfiler.displayStatistics(std::cout);
-		}
-			pprLogObject.addLogData(gPhaseProfilers->longTermPhaseProfiler.getNumTimesExecuted());
-			pprLogObject.addLogData(gPhaseProfilers->longTermPhaseProfiler.getTotalTicksAccumulated());
-			pprLogObject.addLogData(gPhaseProfilers->longTermPhaseProfiler.getMinTicks());
-			pprLogObject.addLogData(gPhaseProfilers->longTermPhaseProfiler.getMaxTicks());
-			pprLogObject.addLogData(gPhaseProfilers->longTermPhaseProfiler.getMinExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->longTermPhaseProfiler.getMaxExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->longTermPhaseProfiler.getAverageExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->longTermPhaseProfiler.getTotalTime());
-			pprLogObject.addLogData(gPhaseProfilers->longTermPhaseProfiler.getTickFrequency());
-
-			if (gShowAllStats)
+			_context.phaseProfilers->longTermPhaseProfiler.displayStatistics(std::cout);
+		}
+			pprLogObject.addLogData(_context.phaseProfilers->longTermPhaseProfiler.getNumTimesExecuted());
+			pprLogObject.addLogData(_context.phaseProfilers->longTermPhaseProfiler.getTotalTicksAccumulated());
+			pprLogObject.addLogData(_context.phaseProfilers->longTermPhaseProfiler.getMinTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->longTermPhaseProfiler.getMaxTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->longTermPhaseProfiler.getMinExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->longTermPhaseProfiler.getMaxExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->longTermPhaseProfiler.getAverageExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->longTermPhaseProfiler.getTotalTime());
+			pprLogObject.addLogData(_context.phaseProfilers->longTermPhaseProfiler.getTickFrequency());
+
+			if (_context.showAllStats)
 			{
 				std::cout << "--- Mid-term planning ---\n";
-				gPhaseProfilers->midTermPhaseProfiler.displayStatistics(std::cout);
+				_context.phaseProfilers->midTermPhaseProfiler.displayStatistics(std::cout);
 				std::cout << std::endl;
 			}
-			pprLogObject.addLogData(gPhaseProfilers->midTermPhaseProfiler.getNumTimesExecuted());
-			pprLogObject.addLogData(gPhaseProfilers->midTermPhaseProfiler.getTotalTicksAccumulated());
-			pprLogObject.addLogData(gPhaseProfilers->midTermPhaseProfiler.getMinTicks());
-			pprLogObject.addLogData(gPhaseProfilers->midTermPhaseProfiler.getMaxTicks());
-			pprLogObject.addLogData(gPhaseProfilers->midTermPhaseProfiler.getMinExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->midTermPhaseProfiler.getMaxExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->midTermPhaseProfiler.getAverageExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->midTermPhaseProfiler.getTotalTime());
-			pprLogObject.addLogData(gPhaseProfilers->midTermPhaseProfiler.getTickFrequency());
-
-			if (gShowAllStats)
+			pprLogObject.addLogData(_context.phaseProfilers->midTermPhaseProfiler.getNumTimesExecuted());
+			pprLogObject.addLogData(_context.phaseProfilers->midTermPhaseProfiler.getTotalTicksAccumulated());
+			pprLogObject.addLogData(_context.phaseProfilers->midTermPhaseProfiler.getMinTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->midTermPhaseProfiler.getMaxTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->midTermPhaseProfiler.getMinExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->midTermPhaseProfiler.getMaxExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->midTermPhaseProfiler.getAverageExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->midTermPhaseProfiler.getTotalTime());
+			pprLogObject.addLogData(_context.phaseProfilers->midTermPhaseProfiler.getTickFrequency());
+
+			if (_context.showAllStats)
 			{
 				std::cout << "--- Short-term planning ---\n";
-				gPhaseProfilers->shortTermPhaseProfiler.displayStatistics(std::cout);
+				_context.phaseProfilers->shortTermPhaseProfiler.displayStatistics(std::cout);
 				std::cout << std::endl;
 			}
-			pprLogObject.addLogData(gPhaseProfilers->shortTermPhaseProfiler.getNumTimesExecuted());
-			pprLogObject.addLogData(gPhaseProfilers->shortTermPhaseProfiler.getTotalTicksAccumulated());
-			pprLogObject.addLogData(gPhaseProfilers->shortTermPhaseProfiler.getMinTicks());
-			pprLogObject.addLogData(gPhaseProfilers->shortTermPhaseProfiler.getMaxTicks());
-			pprLogObject.addLogData(gPhaseProfilers->shortTermPhaseProfiler.getMinExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->shortTermPhaseProfiler.getMaxExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->shortTermPhaseProfiler.getAverageExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->shortTermPhaseProfiler.getTotalTime());
-			pprLogObject.addLogData(gPhaseProfilers->shortTermPhaseProfiler.getTickFrequency());
-
-			if (gShowAllStats)
+			pprLogObject.addLogData(_context.phaseProfilers->shortTermPhaseProfiler.getNumTimesExecuted());
+			pprLogObject.addLogData(_context.phaseProfilers->shortTermPhaseProfiler.getTotalTicksAccumulated());
+			pprLogObject.addLogData(_context.phaseProfilers->shortTermPhaseProfiler.getMinTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->shortTermPhaseProfiler.getMaxTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->shortTermPhaseProfiler.getMinExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->shortTermPhaseProfiler.getMaxExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->shortTermPhaseProfiler.getAverageExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->shortTermPhaseProfiler.getTotalTime());
+			pprLogObject.addLogData(_context.phaseProfilers->shortTermPhaseProfiler.getTickFrequency());
+
+			if (_context.showAllStats)
 			{
 				std::cout << "--- Perceptive phase ---\n";
-				gPhaseProfilers->perceptivePhaseProfiler.displayStatistics(std::cout);
+				_context.phaseProfilers->perceptivePhaseProfiler.displayStatistics(std::cout);
 				std::cout << std::endl;
 			}
-			pprLogObject.addLogData(gPhaseProfilers->perceptivePhaseProfiler.getNumTimesExecuted());
-			pprLogObject.addLogData(gPhaseProfilers->perceptivePhaseProfiler.getTotalTicksAccumulated());
-			pprLogObject.addLogData(gPhaseProfilers->perceptivePhaseProfiler.getMinTicks());
-			pprLogObject.addLogData(gPhaseProfilers->perceptivePhaseProfiler.getMaxTicks());
-			pprLogObject.addLogData(gPhaseProfilers->perceptivePhaseProfiler.getMinExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->perceptivePhaseProfiler.getMaxExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->perceptivePhaseProfiler.getAverageExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->perceptivePhaseProfiler.getTotalTime());
-			pprLogObject.addLogData(gPhaseProfilers->perceptivePhaseProfiler.getTickFrequency());
-
-			if (gShowAllStats)
+			pprLogObject.addLogData(_context.phaseProfilers->perceptivePhaseProfiler.getNumTimesExecuted());
+			pprLogObject.addLogData(_context.phaseProfilers->perceptivePhaseProfiler.getTotalTicksAccumulated());
+			pprLogObject.addLogData(_context.phaseProfilers->perceptivePhaseProfiler.getMinTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->perceptivePhaseProfiler.getMaxTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->perceptivePhaseProfiler.getMinExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->perceptivePhaseProfiler.getMaxExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->perceptivePhaseProfiler.getAverageExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->perceptivePhaseProfiler.getTotalTime());
+			pprLogObject.addLogData(_context.phaseProfilers->perceptivePhaseProfiler.getTickFrequency());
+
+			if (_context.showAllStats)
 			{
 				std::cout << "--- Predictive phase ---\n";
-				gPhaseProfilers->predictivePhaseProfiler.displayStatistics(std::cout);
+				_context.phaseProfilers->predictivePhaseProfiler.displayStatistics(std::cout);
 				std::cout << std::endl;
 			}
-			pprLogObject.addLogData(gPhaseProfilers->predictivePhaseProfiler.getNumTimesExecuted());
-			pprLogObject.addLogData(gPhaseProfilers->predictivePhaseProfiler.getTotalTicksAccumulated());
-			pprLogObject.addLogData(gPhaseProfilers->predictivePhaseProfiler.getMinTicks());
-			pprLogObject.addLogData(gPhaseProfilers->predictivePhaseProfiler.getMaxTicks());
-			pprLogObject.addLogData(gPhaseProfilers->predictivePhaseProfiler.getMinExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->predictivePhaseProfiler.getMaxExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->predictivePhaseProfiler.getAverageExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->predictivePhaseProfiler.getTotalTime());
-			pprLogObject.addLogData(gPhaseProfilers->predictivePhaseProfiler.getTickFrequency());
-
-			if (gShowAllStats)
+			pprLogObject.addLogData(_context.phaseProfilers->predictivePhaseProfiler.getNumTimesExecuted());
+			pprLogObject.addLogData(_context.phaseProfilers->predictivePhaseProfiler.getTotalTicksAccumulated());
+			pprLogObject.addLogData(_context.phaseProfilers->predictivePhaseProfiler.getMinTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->predictivePhaseProfiler.getMaxTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->predictivePhaseProfiler.getMinExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->predictivePhaseProfiler.getMaxExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->predictivePhaseProfiler.getAverageExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->predictivePhaseProfiler.getTotalTime());
+			pprLogObject.addLogData(_context.phaseProfilers->predictivePhaseProfiler.getTickFrequency());
+
+			if (_context.showAllStats)
 			{
 				std::cout << "--- Reactive phase ---\n";
-				gPhaseProfilers->reactivePhaseProfiler.displayStatistics(std::cout);
+				_context.phaseProfilers->reactivePhaseProfiler.displayStatistics(std::cout);
 				std::cout << std::endl;
 			}
-			pprLogObject.addLogData(gPhaseProfilers->reactivePhaseProfiler.getNumTimesExecuted());
-			pprLogObject.addLogData(gPhaseProfilers->reactivePhaseProfiler.getTotalTicksAccumulated());
-			pprLogObject.addLogData(gPhaseProfilers->reactivePhaseProfiler.getMinTicks());
-			pprLogObject.addLogData(gPhaseProfilers->reactivePhaseProfiler.getMaxTicks());
-			pprLogObject.addLogData(gPhaseProfilers->reactivePhaseProfiler.getMinExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->reactivePhaseProfiler.getMaxExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->reactivePhaseProfiler.getAverageExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->reactivePhaseProfiler.getTotalTime());
-			pprLogObject.addLogData(gPhaseProfilers->reactivePhaseProfiler.getTickFrequency());
-
-			if (gShowAllStats)
+			pprLogObject.addLogData(_context.phaseProfilers->reactivePhaseProfiler.getNumTimesExecuted());
+			pprLogObject.addLogData(_context.phaseProfilers->reactivePhaseProfiler.getTotalTicksAccumulated());
+			pprLogObject.addLogData(_context.phaseProfilers->reactivePhaseProfiler.getMinTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->reactivePhaseProfiler.getMaxTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->reactivePhaseProfiler.getMinExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->reactivePhaseProfiler.getMaxExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->reactivePhaseProfiler.getAverageExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->reactivePhaseProfiler.getTotalTime());
+			pprLogObject.addLogData(_context.phaseProfilers->reactivePhaseProfiler.getTickFrequency());
+
+			if (_context.showAllStats)
 			{
 				std::cout << "--- Steering phase ---\n";
-				gPhaseProfilers->steeringPhaseProfiler.displayStatistics(std::cout);
+				_context.phaseProfilers->steeringPhaseProfiler.displayStatistics(std::cout);
 				std::cout << std::endl;
 			}
-			pprLogObject.addLogData(gPhaseProfilers->steeringPhaseProfiler.getNumTimesExecuted());
-			pprLogObject.addLogData(gPhaseProfilers->steeringPhaseProfiler.getTotalTicksAccumulated());
-			pprLogObject.addLogData(gPhaseProfilers->steeringPhaseProfiler.getMinTicks());
-			pprLogObject.addLogData(gPhaseProfilers->steeringPhaseProfiler.getMaxTicks());
-			pprLogObject.addLogData(gPhaseProfilers->steeringPhaseProfiler.getMinExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->steeringPhaseProfiler.getMaxExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->steeringPhaseProfiler.getAverageExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->steeringPhaseProfiler.getTotalTime());
-			pprLogObject.addLogData(gPhaseProfilers->steeringPhaseProfiler.getTickFrequency());
-
-			if (gShowAllStats)
+			pprLogObject.addLogData(_context.phaseProfilers->steeringPhaseProfiler.getNumTimesExecuted());
+			pprLogObject.addLogData(_context.phaseProfilers->steeringPhaseProfiler.getTotalTicksAccumulated());
+			pprLogObject.addLogData(_context.phaseProfilers->steeringPhaseProfiler.getMinTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->steeringPhaseProfiler.getMaxTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->steeringPhaseProfiler.getMinExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->steeringPhaseProfiler.getMaxExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->steeringPhaseProfiler.getAverageExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->steeringPhaseProfiler.getTotalTime());
+			pprLogObject.addLogData(_context.phaseProfilers->steeringPhaseProfiler.getTickFrequency());
+
+			if (_context.showAllStats)
 			{
 				std::cout << "--- TOTAL AI ---\n";
-				gPhaseProfilers->aiProfiler.displayStatistics(std::cout);
+				_context.phaseProfilers->aiProfiler.displayStatistics(std::cout);
 				std::cout << std::endl;
 			}
-			pprLogObject.addLogData(gPhaseProfilers->aiProfiler.getNumTimesExecuted());
-			pprLogObject.addLogData(gPhaseProfilers->aiProfiler.getTotalTicksAccumulated());
-			pprLogObject.addLogData(gPhaseProfilers->aiProfiler.getMinTicks());
-			pprLogObject.addLogData(gPhaseProfilers->aiProfiler.getMaxTicks());
-			pprLogObject.addLogData(gPhaseProfilers->aiProfiler.getMinExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->aiProfiler.getMaxExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->aiProfiler.getAverageExecutionTimeMills());
-			pprLogObject.addLogData(gPhaseProfilers->aiProfiler.getTotalTime());
-			pprLogObject.addLogData(gPhaseProfilers->aiProfiler.getTickFrequency());
-
-			if (gShowAllStats)
+			pprLogObject.addLogData(_context.phaseProfilers->aiProfiler.getNumTimesExecuted());
+			pprLogObject.addLogData(_context.phaseProfilers->aiProfiler.getTotalTicksAccumulated());
+			pprLogObject.addLogData(_context.phaseProfilers->aiProfiler.getMinTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->aiProfiler.getMaxTicks());
+			pprLogObject.addLogData(_context.phaseProfilers->aiProfiler.getMinExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->aiProfiler.getMaxExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->aiProfiler.getAverageExecutionTimeMills());
+			pprLogObject.addLogData(_context.phaseProfilers->aiProfiler.getTotalTime());
+			pprLogObject.addLogData(_context.phaseProfilers->aiProfiler.getTickFrequency());
+
+			if (_context.showAllStats)
 			{
 				std::cout << std::endl;
 
@@ -700,35 +656,35 @@ void PPRAIModule::cleanupSimulation()
 				std::cout << "         because it excludes space-time planning)\n\n";
 			}
 			float totalAgentTime =
-				gPhaseProfilers->midTermPhaseProfiler.getAverageExecutionTime() + 
-				gPhaseProfilers->shortTermPhaseProfiler.getAverageExecutionTime() +
-				gPhaseProfilers->perceptivePhaseProfiler.getAverageExecutionTime() +
-				gPhaseProfilers->predictivePhaseProfiler.getAverageExecutionTime() +
-				gPhaseProfilers->reactivePhaseProfiler.getAverageExecutionTime() +
-				gPhaseProfilers->steeringPhaseProfiler.getAverageExecutionTime();
+				_context.phaseProfilers->midTermPhaseProfiler.getAverageExecutionTime() + 
+				_context.phaseProfilers->shortTermPhaseProfiler.getAverageExecutionTime() +
+				_context.phaseProfilers->perceptivePhaseProfiler.getAverageExecutionTime() +
+				_context.phaseProfilers->predictivePhaseProfiler.getAverageExecutionTime() +
+				_context.phaseProfilers->reactivePhaseProfiler.getAverageExecutionTime() +
+				_context.phaseProfilers->steeringPhaseProfiler.getAverageExecutionTime();
 			float totalAgentTime_5Hz_amortized =   // 5 Hz skips every 4 frames, so scale by 0.25
-				gPhaseProfilers->midTermPhaseProfiler.getAverageExecutionTime() * 0.25f + 
-				gPhaseProfilers->shortTermPhaseProfiler.getAverageExecutionTime() * 0.25f +
-				gPhaseProfilers->perceptivePhaseProfiler.getAverageExecutionTime() * 0.25f +
-				gPhaseProfilers->predictivePhaseProfiler.getAverageExecutionTime() * 0.25f +
-				gPhaseProfilers->reactivePhaseProfiler.getAverageExecutionTime() +  // reactive and steering phases still execute 20 Hz.
-				gPhaseProfilers->steeringPhaseProfiler.getAverageExecutionTime();
+				_context.phaseProfilers->midTermPhaseProfiler.getAverageExecutionTime() * 0.25f + 
+				_context.phaseProfilers->shortTermPhaseProfiler.getAverageExecutionTime() * 0.25f +
+				_context.phaseProfilers->perceptivePhaseProfiler.getAverageExecutionTime() * 0.25f +
+				_context.phaseProfilers->predictivePhaseProfiler.getAverageExecutionTime() * 0.25f +
+				_context.phaseProfilers->reactivePhaseProfiler.getAverageExecutionTime() +  // reactive and steering phases still execute 20 Hz.
+				_context.phaseProfilers->steeringPhaseProfiler.getAverageExecutionTime();
 			float totalAgentTime_4Hz_amortized =    // 4 Hz skips every 5 frames, so scale by 0.2
-				gPhaseProfilers->midTermPhaseProfiler.getAverageExecutionTime() * 0.2f + 
-				gPhaseProfilers->shortTermPhaseProfiler.getAverageExecutionTime() * 0.2f +
-				gPhaseProfilers->perceptivePhaseProfiler.getAverageExecutionTime() * 0.2f +
-				gPhaseProfilers->predictivePhaseProfiler.getAverageExecutionTime() * 0.2f +
-				gPhaseProfilers->reactivePhaseProfiler.getAverageExecutionTime() +  // reactive and steering phases still execute 20 Hz.
-				gPhaseProfilers->steeringPhaseProfiler.getAverageExecutionTime();
-
-			if (gShowAllStats)
+				_context.phaseProfilers->midTermPhaseProfiler.getAverageExecutionTime() * 0.2f + 
+				_context.phaseProfilers->shortTermPhaseProfiler.getAverageExecutionTime() * 0.2f +
+				_context.phaseProfilers->perceptivePhaseProfiler.getAverageExecutionTime() * 0.2f +
+				_context.phaseProfilers->predictivePhaseProfiler.getAverageExecutionTime() * 0.2f +
+				_context.phaseProfilers->reactivePhaseProfiler.getAverageExecutionTime() +  // reactive and steering phases still execute 20 Hz.
+				_context.phaseProfilers->steeringPhaseProfiler.getAverageExecutionTime();
+
+			if (_context.showAllStats)
 			{
-				std::cout << " percent mid-term:   " << gPhaseProfilers->midTermPhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT<< "\n";
-				std::cout << " percent short-term: " << gPhaseProfilers->shortTermPhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT<< "\n";
-				std::cout << " percent perceptive: " << gPhaseProfilers->perceptivePhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT << "\n";
-				std::cout << " percent predictive: " << gPhaseProfilers->predictivePhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT << "\n";
-				std::cout << " percent reactive:   " << gPhaseProfilers->reactivePhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT << "\n";
-				std::cout << " percent steering:   " << gPhaseProfilers->steeringPhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT << "\n";
+				std::cout << " percent mid-term:   " << _context.phaseProfilers->midTermPhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT<< "\n";
+				std::cout << " percent short-term: " << _context.phaseProfilers->shortTermPhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT<< "\n";
+				std::cout << " percent perceptive: " << _context.phaseProfilers->perceptivePhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT << "\n";
+				std::cout << " percent predictive: " << _context.phaseProfilers->predictivePhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT << "\n";
+				std::cout << " percent reactive:   " << _context.phaseProfilers->reactivePhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT << "\n";
+				std::cout << " percent steering:   " << _context.phaseProfilers->steeringPhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT << "\n";
 				std::cout << "\n";
 				std::cout << " Average per agent, no amortization: " << totalAgentTime * 1000.0 << " milliseconds\n";
 				std::cout << " Average per agent, 5Hz (skip 4 frames): " << totalAgentTime_5Hz_amortized * 1000.0 << " milliseconds\n";
@@ -737,55 +693,55 @@ void PPRAIModule::cleanupSimulation()
 			}
 
 
-			pprLogObject.addLogData(gPhaseProfilers->midTermPhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT);
-			pprLogObject.addLogData(gPhaseProfilers->shortTermPhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT);
-			pprLogObject.addLogData(gPhaseProfilers->perceptivePhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT);
-			pprLogObject.addLogData(gPhaseProfilers->predictivePhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT);
-			pprLogObject.addLogData(gPhaseProfilers->reactivePhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT);
-			pprLogObject.addLogData(gPhaseProfilers->steeringPhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT);
+			pprLogObject.addLogData(_context.phaseProfilers->midTermPhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT);
+			pprLogObject.addLogData(_context.phaseProfilers->shortTermPhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT);
+			pprLogObject.addLogData(_context.phaseProfilers->perceptivePhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT);
+			pprLogObject.addLogData(_context.phaseProfilers->predictivePhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT);
+			pprLogObject.addLogData(_context.phaseProfilers->reactivePhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT);
+			pprLogObject.addLogData(_context.phaseProfilers->steeringPhaseProfiler.getAverageExecutionTime()/totalAgentTime * PERCENT);
 			pprLogObject.addLogData(totalAgentTime * TO_MILLISECONDS);
 			pprLogObject.addLogData(totalAgentTime_5Hz_amortized * TO_MILLISECONDS);
 			pprLogObject.addLogData(totalAgentTime_4Hz_amortized * TO_MILLISECONDS);
 
 
 
-		if (gShowStats || gShowAllStats)
+		if (_context.showStats || _context.showAllStats)
 		{
 			std::cout << "--- PROFILE RESULTS (excluding long-term planning) ---\n\n";
 		}
 		float totalTimeForAllAgents =
-			gPhaseProfilers->midTermPhaseProfiler.getTotalTime()+
-			gPhaseProfilers->shortTermPhaseProfiler.getTotalTime() +
-			gPhaseProfilers->perceptivePhaseProfiler.getTotalTime() +
-			gPhaseProfilers->predictivePhaseProfiler.getTotalTime() +
-			gPhaseProfilers->reactivePhaseProfiler.getTotalTime() +
-			gPhaseProfilers->steeringPhaseProfiler.getTotalTime();
+			_context.phaseProfilers->midTermPhaseProfiler.getTotalTime()+
+			_context.phaseProfilers->shortTermPhaseProfiler.getTotalTime() +
+			_context.phaseProfilers->perceptivePhaseProfiler.getTotalTime() +
+			_context.phaseProfilers->predictivePhaseProfiler.getTotalTime() +
+			_context.phaseProfilers->reactivePhaseProfiler.getTotalTime() +
+			_context.phaseProfilers->steeringPhaseProfiler.getTotalTime();
 
 		// TODO: right now this is hacked, later on need to add an arg or access to the engine to get this value correctly:
-		if (gShowStats || gShowAllStats)
+		if (_context.showStats || _context.showAllStats)
 		{
 			std::cerr << " TODO: 20 frames per second is a hard-coded assumption in the following calculations\n";
 		}
 		float baseFrequency = 20.0f;
-		float totalNumberOfFrames = (float)gPhaseProfilers->steeringPhaseProfiler.getNumTimesExecuted();
+		float totalNumberOfFrames = (float)_context.phaseProfilers->steeringPhaseProfiler.getNumTimesExecuted();
 
-		float average_frequency_mid_term = gPhaseProfilers->midTermPhaseProfiler.getNumTimesExecuted()/totalNumberOfFrames * baseFrequency; // << " Hz (skipping " << totalNumberOfFrames/((float)gPhaseProfilers->midTermPhaseProfiler.getNumTimesExecuted()) << " frames)\n";
-		float average_frequency_short_term = gPhaseProfilers->shortTermPhaseProfiler.getNumTimesExecuted()/totalNumberOfFrames * baseFrequency; //  << " Hz (skipping " << totalNumberOfFrames/((float)gPhaseProfilers->shortTermPhaseProfiler.getNumTimesExecuted()) << " frames)\n";
-		float average_frequency_perceptive = gPhaseProfilers->perceptivePhaseProfiler.getNumTimesExecuted()/totalNumberOfFrames * baseFrequency; // << " Hz (skipping " << totalNumberOfFrames/((float)gPhaseProfilers->perceptivePhaseProfiler.getNumTimesExecuted()) << " frames)\n";
-		float average_frequency_predictive = gPhaseProfilers->predictivePhaseProfiler.getNumTimesExecuted()/totalNumberOfFrames * baseFrequency; // << " Hz (skipping " << totalNumberOfFrames/((float)gPhaseProfilers->predictivePhaseProfiler.getNumTimesExecuted()) << " frames)\n";
-		float average_frequency_reactive = gPhaseProfilers->reactivePhaseProfiler.getNumTimesExecuted()/totalNumberOfFrames * baseFrequency; // << " Hz (skipping " << totalNumberOfFrames/((float)gPhaseProfilers->reactivePhaseProfiler.getNumTimesExecuted()) << " frames)\n";
-		float average_frequency_steering = gPhaseProfilers->steeringPhaseProfiler.getNumTimesExecuted()/totalNumberOfFrames * baseFrequency; // << " Hz (skipping " << totalNumberOfFrames/((float)gPhaseProfilers->steeringPhaseProfiler.getNumTimesExecuted()) << " frames)\n";
+		float average_frequency_mid_term = _context.phaseProfilers->midTermPhaseProfiler.getNumTimesExecuted()/totalNumberOfFrames * baseFrequency; // << " Hz (skipping " << totalNumberOfFrames/((float)_context.phaseProfilers->midTermPhaseProfiler.getNumTimesExecuted()) << " frames)\n";
+		float average_frequency_short_term = _context.phaseProfilers->shortTermPhaseProfiler.getNumTimesExecuted()/totalNumberOfFrames * baseFrequency; //  << " Hz (skipping " << totalNumberOfFrames/((float)_context.phaseProfilers->shortTermPhaseProfiler.getNumTimesExecuted()) << " frames)\n";
+		float average_frequency_perceptive = _context.phaseProfilers->perceptivePhaseProfiler.getNumTimesExecuted()/totalNumberOfFrames * baseFrequency; // << " Hz (skipping " << totalNumberOfFrames/((float)_context.phaseProfilers->perceptivePhaseProfiler.getNumTimesExecuted()) << " frames)\n";
+		float average_frequency_predictive = _context.phaseProfilers->predictivePhaseProfiler.getNumTimesExecuted()/totalNumberOfFrames * baseFrequency; // << " Hz (skipping " << totalNumberOfFrames/((float)_context.phaseProfilers->predictivePhaseProfiler.getNumTimesExecuted()) << " frames)\n";
+		float average_frequency_reactive = _context.phaseProfilers->reactivePhaseProfiler.getNumTimesExecuted()/totalNumberOfFrames * baseFrequency; // << " Hz (skipping " << totalNumberOfFrames/((float)_context.phaseProfilers->reactivePhaseProfiler.getNumTimesExecuted()) << " frames)\n";
+		float average_frequency_steering = _context.phaseProfilers->steeringPhaseProfiler.getNumTimesExecuted()/totalNumberOfFrames * baseFrequency; // << " Hz (skipping " << totalNumberOfFrames/((float)_context.phaseProfilers->steeringPhaseProfiler.getNumTimesExecuted()) << " frames)\n";
 
-		if (gShowStats || gShowAllStats)
+		if (_context.showStats || _context.showAllStats)
 		{
 			std::cout << "\n";
 
-			std::cout << " average frequency mid-term:   " << average_frequency_mid_term << " Hz (skipping " << totalNumberOfFrames/((float)gPhaseProfilers->midTermPhaseProfiler.getNumTimesExecuted()) << " frames)\n";
-			std::cout << " average frequency short-term: " << average_frequency_short_term << " Hz (skipping " << totalNumberOfFrames/((float)gPhaseProfilers->shortTermPhaseProfiler.getNumTimesExecuted()) << " frames)\n";
-			std::cout << " average frequency perceptive: " << average_frequency_perceptive << " Hz (skipping " << totalNumberOfFrames/((float)gPhaseProfilers->perceptivePhaseProfiler.getNumTimesExecuted()) << " frames)\n";
-			std::cout << " average frequency predictive: " << average_frequency_predictive << " Hz (skipping " << totalNumberOfFrames/((float)gPhaseProfilers->predictivePhaseProfiler.getNumTimesExecuted()) << " frames)\n";
-			std::cout << " average frequency reactive:   " << average_frequency_reactive << " Hz (skipping " << totalNumberOfFrames/((float)gPhaseProfilers->reactivePhaseProfiler.getNumTimesExecuted()) << " frames)\n";
-			std::cout << " average frequency steering:   " << average_frequency_steering << " Hz (skipping " << totalNumberOfFrames/((float)gPhaseProfilers->steeringPhaseProfiler.getNumTimesExecuted()) << " frames)\n";
+			std::cout << " average frequency mid-term:   " << average_frequency_mid_term << " Hz (skipping " << totalNumberOfFrames/((float)_context.phaseProfilers->midTermPhaseProfiler.getNumTimesExecuted()) << " frames)\n";
+			std::cout << " average frequency short-term: " << average_frequency_short_term << " Hz (skipping " << totalNumberOfFrames/((float)_context.phaseProfilers->shortTermPhaseProfiler.getNumTimesExecuted()) << " frames)\n";
+			std::cout << " average frequency perceptive: " << average_frequency_perceptive << " Hz (skipping " << totalNumberOfFrames/((float)_context.phaseProfilers->perceptivePhaseProfiler.getNumTimesExecuted()) << " frames)\n";
+			std::cout << " average frequency predictive: " << average_frequency_predictive << " Hz (skipping " << totalNumberOfFrames/((float)_context.phaseProfilers->predictivePhaseProfiler.getNumTimesExecuted()) << " frames)\n";
+			std::cout << " average frequency reactive:   " << average_frequency_reactive << " Hz (skipping " << totalNumberOfFrames/((float)_context.phaseProfilers->reactivePhaseProfiler.getNumTimesExecuted()) << " frames)\n";
+			std::cout << " average frequency steering:   " << average_frequency_steering << " Hz (skipping " << totalNumberOfFrames/((float)_context.phaseProfilers->steeringPhaseProfiler.getNumTimesExecuted()) << " frames)\n";
 			std::cout << "\n";
 		}
 
@@ -797,15 +753,15 @@ void PPRAIModule::cleanupSimulation()
 		pprLogObject.addLogData(average_frequency_steering);
 
 
-		float amortized_percent_mid_term = gPhaseProfilers->midTermPhaseProfiler.getTotalTime()/totalTimeForAllAgents * PERCENT;
-		float amortized_percent_short_term = gPhaseProfilers->shortTermPhaseProfiler.getTotalTime()/totalTimeForAllAgents * PERCENT;
-		float amortized_percent_perceptive = gPhaseProfilers->perceptivePhaseProfiler.getTotalTime()/totalTimeForAllAgents * PERCENT;
-		float amortized_percent_predictive = gPhaseProfilers->predictivePhaseProfiler.getTotalTime()/totalTimeForAllAgents * PERCENT;
-		float amortized_percent_reactive = gPhaseProfilers->reactivePhaseProfiler.getTotalTime()/totalTimeForAllAgents * PERCENT;
-		float amortized_percent_steering = gPhaseProfilers->steeringPhaseProfiler.getTotalTime()/totalTimeForAllAgents * PERCENT;
-		float AVERAGE_PER_AGENT_PER_UPDATE = totalTimeForAllAgents / ((float)gPhaseProfilers->steeringPhaseProfiler.getNumTimesExecuted()) * TO_MILLISECONDS;
+		float amortized_percent_mid_term = _context.phaseProfilers->midTermPhaseProfiler.getTotalTime()/totalTimeForAllAgents * PERCENT;
+		float amortized_percent_short_term = _context.phaseProfilers->shortTermPhaseProfiler.getTotalTime()/totalTimeForAllAgents * PERCENT;
+		float amortized_percent_perceptive = _context.phaseProfilers->perceptivePhaseProfiler.getTotalTime()/totalTimeForAllAgents * PERCENT;
+		float amortized_percent_predictive = _context.phaseProfilers->predictivePhaseProfiler.getTotalTime()/totalTimeForAllAgents * PERCENT;
+		float amortized_percent_reactive = _context.phaseProfilers->reactivePhaseProfiler.getTotalTime()/totalTimeForAllAgents * PERCENT;
+		float amortized_percent_steering = _context.phaseProfilers->steeringPhaseProfiler.getTotalTime()/totalTimeForAllAgents * PERCENT;
+		float AVERAGE_PER_AGENT_PER_UPDATE = totalTimeForAllAgents / ((float)_context.phaseProfilers->steeringPhaseProfiler.getNumTimesExecuted()) * TO_MILLISECONDS;
 
-		if (gShowStats || gShowAllStats)
+		if (_context.showStats || _context.showAllStats)
 		{
 			std::cout << " amortized percent mid-term:   " << amortized_percent_mid_term << "\n";
 			std::cout << " amortized percent short-term: " << amortized_percent_short_term << "\n";
@@ -830,14 +786,14 @@ void PPRAIModule::cleanupSimulation()
 
 	}
 
-	gPhaseProfilers->aiProfiler.reset();
-	gPhaseProfilers->longTermPhaseProfiler.reset();
-	gPhaseProfilers->midTermPhaseProfiler.reset();
-	gPhaseProfilers->shortTermPhaseProfiler.reset();
-	gPhaseProfilers->perceptivePhaseProfiler.reset();
-	gPhaseProfilers->predictivePhaseProfiler.reset();
-	gPhaseProfilers->reactivePhaseProfiler.reset();
-	gPhaseProfilers->steeringPhaseProfiler.reset();
+	_context.phaseProfilers->aiProfiler.reset();
+	_context.phaseProfilers->longTermPhaseProfiler.reset();
+	_context.phaseProfilers->midTermPhaseProfiler.reset();
+	_context.phaseProfilers->shortTermPhaseProfiler.reset();
+	_context.phaseProfilers->perceptivePhaseProfiler.reset();
+	_context.phaseProfilers->predictivePhaseProfiler.reset();
+	_context.phaseProfilers->reactivePhaseProfiler.reset();
+	_context.phaseProfilers->steeringPhaseProfiler.reset();
 }
 
 void PPRAIModule::finish()
@@ -848,8 +804,8 @@ void PPRAIModule::finish()
 
 SteerLib::AgentInterface * PPRAIModule::createAgent()
 {
-	PPRAgent * agent = new PPRAgent;
-	agent->_id = gEngine->getAgents().size();
+	PPRAgent * agent = new PPRAgent(this);
+	agent->_id = _context.engine->getAgents().size();
 
 	return agent;
 }
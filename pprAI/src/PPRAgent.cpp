@@ -30,53 +30,18 @@ using std::min;
 //
 // constructor
 //
-PPRAgent::PPRAgent()
+PPRAgent::PPRAgent(PPRAIModule * module)
 {
-	_PPRParams.ped_max_speed = ped_max_speed;
-	_PPRParams.ped_typical_speed   = ped_typical_speed  ;
-	_PPRParams.ped_max_force    = ped_max_force   ;
-	_PPRParams.ped_max_speed_factor    = ped_max_speed_factor   ;
-	_PPRParams.ped_faster_speed_factor   = ped_faster_speed_factor  ;
-	_PPRParams.ped_slightly_faster_speed_factor  = ped_slightly_faster_speed_factor ;
-	_PPRParams.ped_typical_speed_factor     = ped_typical_speed_factor    ;
-	_PPRParams.ped_slightly_slower_speed_factor  = ped_slightly_slower_speed_factor ;
-	_PPRParams.ped_slower_speed_factor  = ped_slower_speed_factor ;
-	_PPRParams.ped_cornering_turn_rate  = ped_cornering_turn_rate ;
-	_PPRParams.ped_adjustment_turn_rate  = ped_adjustment_turn_rate ;
-	_PPRParams.ped_faster_avoidance_turn_rate  = ped_faster_avoidance_turn_rate ;
-	_PPRParams.ped_typical_avoidance_turn_rate  = ped_typical_avoidance_turn_rate ;
-	_PPRParams.ped_braking_rate   = ped_braking_rate  ;
-	_PPRParams.ped_comfort_zone     = ped_comfort_zone    ;
-	_PPRParams.ped_query_radius    = ped_query_radius   ;
-	_PPRParams.ped_similar_direction_dot_product_threshold  = ped_similar_direction_dot_product_threshold ;
-	_PPRParams.ped_same_direction_dot_product_threshold  = ped_same_direction_dot_product_threshold ;
-	_PPRParams.ped_oncoming_prediction_threshold  = ped_oncoming_prediction_threshold ;
-	_PPRParams.ped_oncoming_reaction_threshold  = ped_oncoming_reaction_threshold ;
-	_PPRParams.ped_wrong_direction_dot_product_threshold  = ped_wrong_direction_dot_product_threshold ;
-	_PPRParams.ped_threat_distance_threshold  = ped_threat_distance_threshold ;
-	_PPRParams.ped_threat_min_time_threshold  = ped_threat_min_time_threshold ;
-	_PPRParams.ped_threat_max_time_threshold  = ped_threat_max_time_threshold ;
-	_PPRParams.ped_predictive_anticipation_factor   = ped_predictive_anticipation_factor  ;
-	_PPRParams.ped_reactive_anticipation_factor  = ped_reactive_anticipation_factor ;
-	_PPRParams.ped_crowd_influence_factor  = ped_crowd_influence_factor ;
-	_PPRParams.ped_facing_static_object_threshold  = ped_facing_static_object_threshold ;
-	_PPRParams.ped_ordinary_steering_strength  = ped_ordinary_steering_strength ;
-	_PPRParams.ped_oncoming_threat_avoidance_strength  = ped_oncoming_threat_avoidance_strength ;
-	_PPRParams.ped_cross_threat_avoidance_strength  = ped_cross_threat_avoidance_strength ;
-	_PPRParams.ped_max_turning_rate  = ped_max_turning_rate ;
-	_PPRParams.ped_feeling_crowded_threshold  = ped_feeling_crowded_threshold ;
-	_PPRParams.ped_scoot_rate   = ped_scoot_rate  ;
-	_PPRParams.ped_reached_target_distance_threshold   = ped_reached_target_distance_threshold  ;
-	_PPRParams.ped_dynamic_collision_padding  = ped_dynamic_collision_padding ;
-	_PPRParams.ped_furthest_local_target_distance  = ped_furthest_local_target_distance ;
-	_PPRParams.ped_next_waypoint_distance  = ped_next_waypoint_distance ;
-	_PPRParams.ped_max_num_waypoints  = ped_max_num_waypoints ;
+	_context = module->getContext();
+	_PPRParams = _context->parameters;
 
 
 	// std::cout << "next waypoint dist = " << _PPRParams.ped_next_waypoint_distance << std::endl;
 	_midTermPath = new int[_PPRParams.ped_next_waypoint_distance+2];
 	_enabled = false;
 	_id=0;
+	_hasPhaseOffsets = false;
+	_longTermPlanningIsDeferred = false;
 }
 
 
@@ -86,13 +51,19 @@ PPRAgent::PPRAgent()
 //
 PPRAgent::~PPRAgent()
 {
+	releasePhaseOffsets();
 	if (_enabled) {
 		Util::AxisAlignedBox bounds(_position.x-_radius, _position.x+_radius, 0.0f, 0.0f, _position.z-_radius, _position.z+_radius);
-		gSpatialDatabase->removeObject( this, bounds);
+		_context->spatialDatabase->removeObject( this, bounds);
 	}
 }
 
 
+bool PPRAgent::isSelected()
+{
+	return _context->engine->isAgentSelected(this);
+}
+
 void PPRAgent::setParameters(Behaviour behave)
 {
 	this->_PPRParams.setParameters(behave);
@@ -115,10 +86,10 @@ void PPRAgent::reset(const SteerLib::AgentInitialConditions & initialConditions,
 
 
 	if (!_enabled) {
-		gSpatialDatabase->addObject( dynamic_cast<SpatialDatabaseItemPtr>(this), newBounds);
+		_context->spatialDatabase->addObject( dynamic_cast<SpatialDatabaseItemPtr>(this), newBounds);
 	}
 	else {
-		gSpatialDatabase->updateObject( dynamic_cast<SpatialDatabaseItemPtr>(this), oldBounds, newBounds);
+		_context->spatialDatabase->updateObject( dynamic_cast<SpatialDatabaseItemPtr>(this), oldBounds, newBounds);
 	}
 	_enabled = true;
 
@@ -174,6 +145,7 @@ void PPRAgent::reset(const SteerLib::AgentInitialConditions & initialConditions,
 
 
 	// PHASE SCHEDULERS
+	_longTermPlanningIsDeferred = false;
 	_nextFrameToRunLongTermPlanningPhase = 0;
 	_nextFrameToRunMidTermPlanningPhase = 0;
 	_nextFrameToRunShortTermPlanningPhase = 0;
@@ -186,6 +158,7 @@ void PPRAgent::reset(const SteerLib::AgentInitialConditions & initialConditions,
 	_framesToNextPerceptivePhase = 1;
 	_framesToNextPredictivePhase = 1;
 	_framesToNextReactivePhase = 1;
+	choosePhaseOffsets();
 
 	// GEOMETRY STATE
 	// other geometry state was initialized above using the given initial conditions.
@@ -244,7 +217,7 @@ void PPRAgent::addGoal(const SteerLib::AgentGoalInfo & newGoal) {
 		if (_currentGoal.targetIsRandom) {
 
 			Util::AxisAlignedBox aab = Util::AxisAlignedBox(-100.0f, 100.0f, 0.0f, 0.0f, -100.0f, 100.0f);
-			_currentGoal.targetLocation = gSpatialDatabase->randomPositionInRegionWithoutCollisions(aab, 1.0f, true);
+			_currentGoal.targetLocation = _context->spatialDatabase->randomPositionInRegionWithoutCollisions(aab, 1.0f, true, _context->engine->getRandomStream(this));
 		}
 	}
 }
@@ -259,7 +232,7 @@ void PPRAgent::updateAI(float timeStamp, float dt, unsigned int frameNumber)
 	// std::cout << "updating PPR Agent" << std::endl;
 	if (!_enabled) return;
 
-	AutomaticFunctionProfiler profileThisFunction( &PPRGlobals::gPhaseProfilers->aiProfiler );
+	AutomaticFunctionProfiler profileThisFunction( &_context->getThreadPhaseProfilers().aiProfiler );
 
 	Util::Point oldPosition = position();
 
@@ -276,7 +249,21 @@ void PPRAgent::updateAI(float timeStamp, float dt, unsigned int frameNumber)
 	//
 
 	if (_currentFrameNumber >= _nextFrameToRunLongTermPlanningPhase) {
-		runLongTermPlanningPhase();
+		DeferredWorkQueue & deferredWork = _context->engine->getDeferredWorkQueue();
+		if (deferredWork.isDeferring() && !_waypoints.empty()) {
+			// the agent still has a plan to follow, so in real-time the new plan can wait for spare time at the end of a frame.
+			// plans that are needed right away, when a goal is reached, are made by the mid-term planning phase.
+			if (!_longTermPlanningIsDeferred) {
+				_longTermPlanningIsDeferred = true;
+				deferredWork.defer(this, 0.0f, frameNumber, [this]() {
+					_longTermPlanningIsDeferred = false;
+					if (_enabled) runLongTermPlanningPhase();
+				});
+			}
+		}
+		else {
+			runLongTermPlanningPhase();
+		}
 		_lastFrameLongTermWasCalled = _currentFrameNumber;
 	}
 
@@ -320,7 +307,7 @@ void PPRAgent::updateAI(float timeStamp, float dt, unsigned int frameNumber)
 	}
 
 		
-	if (gUseDynamicPhaseScheduling) {
+	if (_context->useDynamicPhaseScheduling) {
 		_nextFrameToRunLongTermPlanningPhase = _lastFrameLongTermWasCalled + _framesToNextLongTermPlanning;
 		_nextFrameToRunMidTermPlanningPhase = _lastFrameMidTermWasCalled + _framesToNextMidTermPlanning;
 		_nextFrameToRunShortTermPlanningPhase = _lastFrameShortTermWasCalled + _framesToNextShortTermPlanning;
@@ -328,13 +315,22 @@ void PPRAgent::updateAI(float timeStamp, float dt, unsigned int frameNumber)
 		_nextFrameToRunPredictivePhase = _lastFramePredictiveWasCalled + _framesToNextPredictivePhase;
 		_nextFrameToRunReactivePhase = _lastFrameReactiveWasCalled + _framesToNextReactivePhase;
 	}
+	else if (_hasPhaseOffsets) {
+		// the same intervals, but each phase runs on its own offset, so agents do not all run a phase on the same frame.
+		_nextFrameToRunLongTermPlanningPhase = MultiRateScheduler::getNextFrame(_lastFrameLongTermWasCalled, _context->longTermPlanningPhaseInterval, _longTermPlanningPhaseOffset);
+		_nextFrameToRunMidTermPlanningPhase = MultiRateScheduler::getNextFrame(_lastFrameMidTermWasCalled, _context->midTermPlanningPhaseInterval, _midTermPlanningPhaseOffset);
+		_nextFrameToRunShortTermPlanningPhase = MultiRateScheduler::getNextFrame(_lastFrameShortTermWasCalled, _context->shortTermPlanningPhaseInterval, _shortTermPlanningPhaseOffset);
+		_nextFrameToRunPerceptivePhase = MultiRateScheduler::getNextFrame(_lastFramePerceptiveWasCalled, _context->perceptivePhaseInterval, _perceptivePhaseOffset);
+		_nextFrameToRunPredictivePhase = MultiRateScheduler::getNextFrame(_lastFramePredictiveWasCalled, _context->predictivePhaseInterval, _predictivePhaseOffset);
+		_nextFrameToRunReactivePhase = MultiRateScheduler::getNextFrame(_lastFrameReactiveWasCalled, _context->reactivePhaseInterval, _reactivePhaseOffset);
+	}
 	else {
-		_nextFrameToRunLongTermPlanningPhase = _lastFrameLongTermWasCalled + gLongTermPlanningPhaseInterval;
-		_nextFrameToRunMidTermPlanningPhase = _lastFrameMidTermWasCalled + gMidTermPlanningPhaseInterval;
-		_nextFrameToRunShortTermPlanningPhase = _lastFrameShortTermWasCalled + gShortTermPlanningPhaseInterval;
-		_nextFrameToRunPerceptivePhase = _lastFramePerceptiveWasCalled + gPerceptivePhaseInterval;
-		_nextFrameToRunPredictivePhase = _lastFramePredictiveWasCalled + gPredictivePhaseInterval;
-		_nextFrameToRunReactivePhase = _lastFrameReactiveWasCalled + gReactivePhaseInterval;
+		_nextFrameToRunLongTermPlanningPhase = _lastFrameLongTermWasCalled + _context->longTermPlanningPhaseInterval;
+		_nextFrameToRunMidTermPlanningPhase = _lastFrameMidTermWasCalled + _context->midTermPlanningPhaseInterval;
+		_nextFrameToRunShortTermPlanningPhase = _lastFrameShortTermWasCalled + _context->shortTermPlanningPhaseInterval;
+		_nextFrameToRunPerceptivePhase = _lastFramePerceptiveWasCalled + _context->perceptivePhaseInterval;
+		_nextFrameToRunPredictivePhase = _lastFramePredictiveWasCalled + _context->predictivePhaseInterval;
+		_nextFrameToRunReactivePhase = _lastFrameReactiveWasCalled + _context->reactivePhaseInterval;
 	}
 
 
@@ -370,7 +366,7 @@ void PPRAgent::runCognitivePhase()
 	// if the goal asks for a random target, then randomly assign the target location
 	if (_currentGoal.targetIsRandom) {
 		AxisAlignedBox aab = AxisAlignedBox(-100.0f, 100.0f, 0.0f, 0.0f, -100.0f, 100.0f);
-		_currentGoal.targetLocation = gSpatialDatabase->randomPositionInRegionWithoutCollisions(aab, 1.0f, true);
+		_currentGoal.targetLocation = _context->spatialDatabase->randomPositionInRegionWithoutCollisions(aab, 1.0f, true, _context->engine->getRandomStream(this));
 	}
 }
 
@@ -398,17 +394,17 @@ void PPRAgent::runLongTermPlanningPhase()
 		if (!_enabled) return;
 	}
 
-	AutomaticFunctionProfiler profileThisFunction( &PPRGlobals::gPhaseProfilers->longTermPhaseProfiler );
+	AutomaticFunctionProfiler profileThisFunction( &_context->getThreadPhaseProfilers().longTermPhaseProfiler );
 
 	//==========================================================================
 
-	int myIndexPosition = gSpatialDatabase->getCellIndexFromLocation(_position);
-	int goalIndex = gSpatialDatabase->getCellIndexFromLocation(_currentGoal.targetLocation);
+	int myIndexPosition = _context->spatialDatabase->getCellIndexFromLocation(_position);
+	int goalIndex = _context->spatialDatabase->getCellIndexFromLocation(_currentGoal.targetLocation);
 
 	if (myIndexPosition != -1) {
 
 		// run the main a-star search here
-		gSpatialDatabase->planPath(myIndexPosition, goalIndex, longTermPath);
+		_context->spatialDatabase->planPath(myIndexPosition, goalIndex, longTermPath);
 
 
 		// set up the waypoints along this path.
@@ -433,7 +429,7 @@ void PPRAgent::runLongTermPlanningPhase()
 
 				// every time we successfully popped that many nodes in the path, we can add the next one as a waypoint.
 				Point waypoint;
-				gSpatialDatabase->getLocationFromIndex(mostRecentNode,waypoint);
+				_context->spatialDatabase->getLocationFromIndex(mostRecentNode,waypoint);
 				_waypoints.push_back(waypoint);
 			}
 
@@ -447,7 +443,7 @@ void PPRAgent::runLongTermPlanningPhase()
 			int nextWaypointIndex = ((int)longTermAStar.getPath().size())-1 - _PPRParams.ped_next_waypoint_distance;
 			while (nextWaypointIndex > 0) {
 				Point waypoint;
-				gSpatialDatabase->getLocationFromIndex(longTermAStar.getPath()[nextWaypointIndex],waypoint);
+				_context->spatialDatabase->getLocationFromIndex(longTermAStar.getPath()[nextWaypointIndex],waypoint);
 				_waypoints.push_back(waypoint);
 				nextWaypointIndex -= _PPRParams.ped_next_waypoint_distance;
 			}
@@ -496,7 +492,7 @@ void PPRAgent::runMidTermPlanningPhase()
 		if (!_enabled) return;
 	}
 
-	AutomaticFunctionProfiler profileThisFunction( &PPRGlobals::gPhaseProfilers->midTermPhaseProfiler );
+	AutomaticFunctionProfiler profileThisFunction( &_context->getThreadPhaseProfilers().midTermPhaseProfiler );
 
 	// if we reached the current waypoint, then increment to the next waypoint
 	if (reachedCurrentWaypoint()) {
@@ -507,10 +503,10 @@ void PPRAgent::runMidTermPlanningPhase()
 	}
 
 	// compute a local a-star from your current location to the waypoint.
-	int myIndexPosition = gSpatialDatabase->getCellIndexFromLocation(_position.x, _position.z);
-	int waypointIndexPosition = gSpatialDatabase->getCellIndexFromLocation(_waypoints[_currentWaypointIndex].x, _waypoints[_currentWaypointIndex].z);
+	int myIndexPosition = _context->spatialDatabase->getCellIndexFromLocation(_position.x, _position.z);
+	int waypointIndexPosition = _context->spatialDatabase->getCellIndexFromLocation(_waypoints[_currentWaypointIndex].x, _waypoints[_currentWaypointIndex].z);
 
-	gSpatialDatabase->planPath(myIndexPosition, waypointIndexPosition,midTermPathStack);
+	_context->spatialDatabase->planPath(myIndexPosition, waypointIndexPosition,midTermPathStack);
 
 	// copy the local AStar path to your array
 	_midTermPathSize = (int)midTermPathStack.size();
@@ -575,8 +571,8 @@ void PPRAgent::runShortTermPlanningPhase()
 	}
 
 
-	AutomaticFunctionProfiler profileThisFunction( &PPRGlobals::gPhaseProfilers->shortTermPhaseProfiler );
-	int myIndexPosition = gSpatialDatabase->getCellIndexFromLocation(_position.x, _position.z);
+	AutomaticFunctionProfiler profileThisFunction( &_context->getThreadPhaseProfilers().shortTermPhaseProfiler );
+	int myIndexPosition = _context->spatialDatabase->getCellIndexFromLocation(_position.x, _position.z);
 
 
 	closestPathNode = 0;
@@ -593,7 +589,7 @@ void PPRAgent::runShortTermPlanningPhase()
 #endif
 		for (unsigned int i=0; i<_midTermPathSize; i++) {
 			Point tempTargetLocation;
-			gSpatialDatabase->getLocationFromIndex( _midTermPath[i], tempTargetLocation);
+			_context->spatialDatabase->getLocationFromIndex( _midTermPath[i], tempTargetLocation);
 			Vector temp = tempTargetLocation-_position;
 			float distSquared = temp.lengthSquared();
 			if (distSquared < minDistSquared) {
@@ -612,17 +608,17 @@ void PPRAgent::runShortTermPlanningPhase()
 			unsigned int localTargetIndex = closestPathNode;
 			unsigned int furthestTargetIndex = min(_midTermPathSize-1, closestPathNode + _PPRParams.ped_furthest_local_target_distance);
 			unsigned int localTargetCellID = _midTermPath[localTargetIndex];
-			gSpatialDatabase->getLocationFromIndex( localTargetCellID, _localTargetLocation );
+			_context->spatialDatabase->getLocationFromIndex( localTargetCellID, _localTargetLocation );
 			Ray lineOfSightTest1, lineOfSightTest2;
 			lineOfSightTest1.initWithUnitInterval(_position + _radius*_rightSide, _localTargetLocation - (_position + _radius*_rightSide));
 			lineOfSightTest2.initWithUnitInterval(_position - _radius*_rightSide, _localTargetLocation - (_position - _radius*_rightSide));
 			while ( (localTargetIndex <= furthestTargetIndex)
-				&& (!gSpatialDatabase->trace(lineOfSightTest1,dummyt, dummyObject, dynamic_cast<SpatialDatabaseItemPtr>(this),true))
-				&& (!gSpatialDatabase->trace(lineOfSightTest2,dummyt, dummyObject, dynamic_cast<SpatialDatabaseItemPtr>(this),true)))
+				&& (!_context->spatialDatabase->trace(lineOfSightTest1,dummyt, dummyObject, dynamic_cast<SpatialDatabaseItemPtr>(this),true))
+				&& (!_context->spatialDatabase->trace(lineOfSightTest2,dummyt, dummyObject, dynamic_cast<SpatialDatabaseItemPtr>(this),true)))
 			{
 				localTargetIndex++;
 				localTargetCellID = _midTermPath[localTargetIndex];
-				gSpatialDatabase->getLocationFromIndex( localTargetCellID, _localTargetLocation );
+				_context->spatialDatabase->getLocationFromIndex( localTargetCellID, _localTargetLocation );
 				lineOfSightTest1.initWithUnitInterval(_position + _radius*_rightSide, _localTargetLocation - (_position + _radius*_rightSide));
 				lineOfSightTest2.initWithUnitInterval(_position - _radius*_rightSide, _localTargetLocation - (_position - _radius*_rightSide));
 			}
@@ -638,7 +634,7 @@ void PPRAgent::runShortTermPlanningPhase()
 			{
 				// if localTargetIndex is valid
 				localTargetCellID = _midTermPath[localTargetIndex];
-				gSpatialDatabase->getLocationFromIndex( localTargetCellID, _localTargetLocation );
+				_context->spatialDatabase->getLocationFromIndex( localTargetCellID, _localTargetLocation );
 				if ((_localTargetLocation - _waypoints[_currentWaypointIndex]).length() < 2.0f * _PPRParams.ped_reached_target_distance_threshold)
 				{
 					_localTargetLocation = _waypoints[_currentWaypointIndex];
@@ -650,7 +646,7 @@ void PPRAgent::runShortTermPlanningPhase()
 			else {
 				// if localTargetIndex is pointing backwards, then just aim for 2 nodes ahead of the current closestPathNode.
 				localTargetCellID = _midTermPath[closestPathNode+2];
-				gSpatialDatabase->getLocationFromIndex( localTargetCellID, _localTargetLocation );
+				_context->spatialDatabase->getLocationFromIndex( localTargetCellID, _localTargetLocation );
 			}
 		}
 		else
@@ -683,7 +679,7 @@ void PPRAgent::runShortTermPlanningPhase()
 		else if (closestPathNode == _midTermPathSize-1) {
 			// this case is reached when you're very close to your goal, and the planned path is very short.
 			// in this case, just point towards the closest node.
-			gSpatialDatabase->getLocationFromIndex( closestPathNode, _localTargetLocation);
+			_context->spatialDatabase->getLocationFromIndex( closestPathNode, _localTargetLocation);
 		}
 		else {
 			// this case should never be reached
@@ -693,7 +689,7 @@ void PPRAgent::runShortTermPlanningPhase()
 	}
 
 
-	if (gUseDynamicPhaseScheduling) {
+	if (_context->useDynamicPhaseScheduling) {
 		// decimating short-term planning
 		float distanceHeuristic = (_position - _localTargetLocation).length() - 5.0f;
 		if (distanceHeuristic <= 0.0f) {
@@ -719,10 +715,10 @@ void PPRAgent::runPerceptivePhase()
 {
 	if (!_enabled) return;
 
-	AutomaticFunctionProfiler profileThisFunction( &PPRGlobals::gPhaseProfilers->perceptivePhaseProfiler );
+	AutomaticFunctionProfiler profileThisFunction( &_context->getThreadPhaseProfilers().perceptivePhaseProfiler );
 	collectObjectsInVisualField();
 
-	if (gUseDynamicPhaseScheduling) {
+	if (_context->useDynamicPhaseScheduling) {
 		if (_currentSpeed <= 0.4f) {
 			_framesToNextPerceptivePhase = 65;
 		}
@@ -743,7 +739,7 @@ void PPRAgent::runPredictivePhase()
 {
 	if (!_enabled) return;
 
-	AutomaticFunctionProfiler profileThisFunction( &PPRGlobals::gPhaseProfilers->predictivePhaseProfiler );
+	AutomaticFunctionProfiler profileThisFunction( &_context->getThreadPhaseProfilers().predictivePhaseProfiler );
 
 	bool threatListChanged = false;
 	bool alreadyExists = false;
@@ -782,7 +778,7 @@ void PPRAgent::runPredictivePhase()
 	//========================================================
 	if (_steeringState != STEERING_STATE_TURN_TOWARDS_TARGET) {	// ignore threats in the STEERING_STATE_TURN_TOWARDS_TARGET state.
 
-		for (std::set<SteerLib::SpatialDatabaseItemPtr>::iterator neighbor = _neighbors.begin(); neighbor != _neighbors.end(); ++neighbor) {
+		for (std::vector<SteerLib::SpatialDatabaseItemPtr>::iterator neighbor = _neighbors.begin(); neighbor != _neighbors.end(); ++neighbor) {
 		//for (unsigned int i=0; i<_neighbors.size(); i++) {
 
 			// ignore items that are not AI agents.
@@ -1031,7 +1027,7 @@ void PPRAgent::runReactivePhase()
 		if (!_enabled) return;
 	}
 
-	AutomaticFunctionProfiler profileThisFunction( &PPRGlobals::gPhaseProfilers->reactivePhaseProfiler );
+	AutomaticFunctionProfiler profileThisFunction( &_context->getThreadPhaseProfilers().reactivePhaseProfiler );
 
 	FeelerInfo feelers;
 
@@ -1729,13 +1725,13 @@ void PPRAgent::runReactivePhase()
 		}
 		_finalSteeringCommand.aimForTargetDirection = true;
 		_finalSteeringCommand.aimForTargetSpeed = true;
-		_finalSteeringCommand.targetSpeed = ped_typical_speed_factor*_currentGoal.desiredSpeed;
+		_finalSteeringCommand.targetSpeed = _context->parameters.ped_typical_speed_factor*_currentGoal.desiredSpeed;
 	}
 
 
 	_finalSteeringCommand.steeringMode = SteeringCommand::LOCOMOTION_MODE_COMMAND;
 
-	if (gUseDynamicPhaseScheduling) {
+	if (_context->useDynamicPhaseScheduling) {
 	
 		// potentially give a break to perception
 		if (hitSomething) {
@@ -1773,7 +1769,7 @@ void PPRAgent::doSteering()
 	if (!_enabled) return;
 
 
-	AutomaticFunctionProfiler profileThisFunction( &PPRGlobals::gPhaseProfilers->steeringPhaseProfiler );
+	AutomaticFunctionProfiler profileThisFunction( &_context->getThreadPhaseProfilers().steeringPhaseProfiler );
 
 	switch ( _finalSteeringCommand.steeringMode) {
 		case SteeringCommand::LOCOMOTION_MODE_COMMAND:
@@ -1813,7 +1809,7 @@ void PPRAgent::doEulerStepWithForce(const Vector & force)
 	// update the database with the new agent's setup
 	AxisAlignedBox oldBounds = AxisAlignedBox(_position.x - _radius, _position.x + _radius, 0.0f, 0.0f, _position.z - _radius, _position.z + _radius);
 	AxisAlignedBox newBounds = AxisAlignedBox(newPosition.x - _radius, newPosition.x + _radius, 0.0f, 0.0f, newPosition.z - _radius, newPosition.z + _radius);
-	gSpatialDatabase->updateObject( dynamic_cast<SpatialDatabaseItemPtr>(this), oldBounds, newBounds);
+	_context->spatialDatabase->updateObject( dynamic_cast<SpatialDatabaseItemPtr>(this), oldBounds, newBounds);
 
 	_position = newPosition;
 }
@@ -1954,7 +1950,7 @@ void PPRAgent::doCommandBasedSteering()
 void PPRAgent::collectObjectsInVisualField()
 {
 	_neighbors.clear();
-	gSpatialDatabase->getItemsInVisualField(_neighbors, _position.x-_PPRParams.ped_query_radius, _position.x+_PPRParams.ped_query_radius,
+	_context->spatialDatabase->getItemsInVisualField(_neighbors, _position.x-_PPRParams.ped_query_radius, _position.x+_PPRParams.ped_query_radius,
 		_position.z-_PPRParams.ped_query_radius, _position.z+_PPRParams.ped_query_radius, dynamic_cast<SpatialDatabaseItemPtr>(this),
 		_position, _forward, (float)(_PPRParams.ped_query_radius*_PPRParams.ped_query_radius));
 }
@@ -2032,18 +2028,18 @@ bool PPRAgent::updateReactiveFeelers( FeelerInfo & feelers )
 
 	// Adjusting feeler length to compensate for issues with pprAI not being able to choose which direction to turn and
 	// proceeding through an obstacle. SHould make these parameters.
-	myRay.initWithLengthInterval(_position, _forward * (_PPRParams.ped_typical_speed*ped_reactive_anticipation_factor) * 1.1f);
+	myRay.initWithLengthInterval(_position, _forward * (_PPRParams.ped_typical_speed*_context->parameters.ped_reactive_anticipation_factor) * 1.1f);
 	myRightRay.initWithLengthInterval( _position + _radius * _rightSide ,  ((_forward * 0.75f) + 0.1f*_rightSide)* (_PPRParams.ped_typical_speed*_PPRParams.ped_reactive_anticipation_factor));
 	myLeftRay.initWithLengthInterval( _position - _radius * _rightSide,  ((_forward * 0.75f) - 0.1f*_rightSide)* (_PPRParams.ped_typical_speed*_PPRParams.ped_reactive_anticipation_factor));
 	myRSideRay.initWithLengthInterval( _position + _radius * _rightSide,  (0.05f * _forward + 0.1f * _rightSide)* (_PPRParams.ped_typical_speed*_PPRParams.ped_reactive_anticipation_factor));
 	myLSideRay.initWithLengthInterval( _position - _radius * _rightSide,  (0.05f * _forward - 0.1f * _rightSide)* (_PPRParams.ped_typical_speed*_PPRParams.ped_reactive_anticipation_factor));
 
 	SpatialDatabaseItemPtr me = dynamic_cast<SpatialDatabaseItemPtr>(this);
-	gSpatialDatabase->trace(myRay,      feelers.t_front, feelers.object_front, me, false);
-	gSpatialDatabase->trace(myRightRay, feelers.t_right, feelers.object_right, me, false);
-	gSpatialDatabase->trace(myLeftRay,  feelers.t_left,  feelers.object_left,  me, false);
-	gSpatialDatabase->trace(myRSideRay, feelers.t_rside, feelers.object_rside, me, false);
-	gSpatialDatabase->trace(myLSideRay, feelers.t_lside, feelers.object_lside, me, false);
+	_context->spatialDatabase->trace(myRay,      feelers.t_front, feelers.object_front, me, false);
+	_context->spatialDatabase->trace(myRightRay, feelers.t_right, feelers.object_right, me, false);
+	_context->spatialDatabase->trace(myLeftRay,  feelers.t_left,  feelers.object_left,  me, false);
+	_context->spatialDatabase->trace(myRSideRay, feelers.t_rside, feelers.object_rside, me, false);
+	_context->spatialDatabase->trace(myLSideRay, feelers.t_lside, feelers.object_lside, me, false);
 
 #ifdef USE_ANNOTATIONS
 	__myRay = myRay;
@@ -2080,13 +2076,51 @@ void PPRAgent::disable()
 
 	//  1. remove from database
 	AxisAlignedBox b = AxisAlignedBox(_position.x - _radius, _position.x + _radius, 0.0f, 0.0f, _position.z - _radius, _position.z + _radius);
-	gSpatialDatabase->removeObject(dynamic_cast<SpatialDatabaseItemPtr>(this), b);
+	_context->spatialDatabase->removeObject(dynamic_cast<SpatialDatabaseItemPtr>(this), b);
 
 	//  2. set enabled = false
 	_enabled = false;
 }
 
 
+//
+// choosePhaseOffsets() and releasePhaseOffsets()
+//
+void PPRAgent::choosePhaseOffsets()
+{
+	releasePhaseOffsets();
+	if (!_context->staggerPhases || _context->useDynamicPhaseScheduling) {
+		return;
+	}
+
+	MultiRateScheduler & scheduler = _context->engine->getMultiRateScheduler();
+	_longTermPlanningPhaseOffset = scheduler.chooseOffset(_context->longTermPlanningPhaseInterval);
+	_midTermPlanningPhaseOffset = scheduler.chooseOffset(_context->midTermPlanningPhaseInterval);
+	_shortTermPlanningPhaseOffset = scheduler.chooseOffset(_context->shortTermPlanningPhaseInterval);
+	_perceptivePhaseOffset = scheduler.chooseOffset(_context->perceptivePhaseInterval);
+	_predictivePhaseOffset = scheduler.chooseOffset(_context->predictivePhaseInterval);
+	_reactivePhaseOffset = scheduler.chooseOffset(_context->reactivePhaseInterval);
+	_hasPhaseOffsets = true;
+}
+
+// releasing is not thread-safe, so it waits until the agent is reset or destroyed, rather than disabled from updateAI().
+void PPRAgent::releasePhaseOffsets()
+{
+	if (!_hasPhaseOffsets) {
+		return;
+	}
+
+	MultiRateScheduler & scheduler = _context->engine->getMultiRateScheduler();
+	scheduler.releaseOffset(_context->longTermPlanningPhaseInterval, _longTermPlanningPhaseOffset);
+	scheduler.releaseOffset(_context->midTermPlanningPhaseInterval, _midTermPlanningPhaseOffset);
+	scheduler.releaseOffset(_context->shortTermPlanningPhaseInterval, _shortTermPlanningPhaseOffset);
+	scheduler.releaseOffset(_context->perceptivePhaseInterval, _perceptivePhaseOffset);
+	scheduler.releaseOffset(_context->predictivePhaseInterval, _predictivePhaseOffset);
+	scheduler.releaseOffset(_context->reactivePhaseInterval, _reactivePhaseOffset);
+	_hasPhaseOffsets = false;
+}
+
+
 
 //
 // drawPlannedPath()
@@ -2110,10 +2144,10 @@ void PPRAgent::drawPlannedPath()
 		for (unsigned int i=0; i < longTermPath.size() - 1; i++) {
 			Vector xOffset,zOffset;
 			Point center,nextCenter;
-			xOffset.x = 0.5f * gSpatialDatabase->getCellSizeX();
-			zOffset.z = 0.5f * gSpatialDatabase->getCellSizeZ();
-			gSpatialDatabase->getLocationFromIndex(longTermPath._Get_container()[i], center); // DOes not work on LInux
-			gSpatialDatabase->getLocationFromIndex(longTermPath._Get_container()[i+1], nextCenter);
+			xOffset.x = 0.5f * _context->spatialDatabase->getCellSizeX();
+			zOffset.z = 0.5f * _context->spatialDatabase->getCellSizeZ();
+			_context->spatialDatabase->getLocationFromIndex(longTermPath._Get_container()[i], center); // DOes not work on LInux
+			_context->spatialDatabase->getLocationFromIndex(longTermPath._Get_container()[i+1], nextCenter);
 			center.y = 0.01f;
 			nextCenter.y = 0.01f;
 			DrawLib::glColor(gDarkBlue);
@@ -2139,10 +2173,10 @@ void PPRAgent::drawPlannedPath()
 		for (unsigned int i=0; i < longTermPath.size() - 1; i++) {
 			Vector xOffset,zOffset;
 			Point center,nextCenter;
-			xOffset.x = 0.5f * gSpatialDatabase->getCellSizeX();
-			zOffset.z = 0.5f * gSpatialDatabase->getCellSizeZ();
-			gSpatialDatabase->getLocationFromIndex(ltpath->at(i), center);
-			gSpatialDatabase->getLocationFromIndex(ltpath->at(i+1), nextCenter);
+			xOffset.x = 0.5f * _context->spatialDatabase->getCellSizeX();
+			zOffset.z = 0.5f * _context->spatialDatabase->getCellSizeZ();
+			_context->spatialDatabase->getLocationFromIndex(ltpath->at(i), center);
+			_context->spatialDatabase->getLocationFromIndex(ltpath->at(i+1), nextCenter);
 			center.y = 0.01f;
 			nextCenter.y = 0.01f;
 			DrawLib::glColor(gDarkBlue);
@@ -2163,10 +2197,10 @@ void PPRAgent::drawPlannedPath()
 		for (unsigned int i=0; i < _midTermPathSize - 1; i++) {
 			Vector xOffset,zOffset;
 			Point center,nextCenter;
-			xOffset.x = 0.5f * gSpatialDatabase->getCellSizeX();
-			zOffset.z = 0.5f * gSpatialDatabase->getCellSizeZ();
-			gSpatialDatabase->getLocationFromIndex(_midTermPath[i], center);
-			gSpatialDatabase->getLocationFromIndex(_midTermPath[i+1], nextCenter);
+			xOffset.x = 0.5f * _context->spatialDatabase->getCellSizeX();
+			zOffset.z = 0.5f * _context->spatialDatabase->getCellSizeZ();
+			_context->spatialDatabase->getLocationFromIndex(_midTermPath[i], center);
+			_context->spatialDatabase->getLocationFromIndex(_midTermPath[i+1], nextCenter);
 			center.y = 0.02f;
 			nextCenter.y = 0.02f;
 			DrawLib::glColor(gBlue);
@@ -2176,7 +2210,7 @@ void PPRAgent::drawPlannedPath()
 
 	// draw a marker on the closest node you are to the mid-term path (computed from short-term planning)
 	Point closestNodeOnPath;
-	gSpatialDatabase->getLocationFromIndex(_midTermPath[__closestPathNode],closestNodeOnPath);
+	_context->spatialDatabase->getLocationFromIndex(_midTermPath[__closestPathNode],closestNodeOnPath);
 	DrawLib::drawHighlight(closestNodeOnPath + Util::Vector(0, -0.25, 0), Vector(1.0f, 0.0f, 0.0f), 0.5f, gBlue);
 	//drawXZCircle(0.30f, closestNodeOnPath, gBlue, 10);
 
@@ -2201,7 +2235,7 @@ void PPRAgent::draw()
 
 #ifdef ENABLE_GUI
 	if (!_enabled) return;
-	AutomaticFunctionProfiler profileThisFunction( &PPRGlobals::gPhaseProfilers->drawProfiler );
+	AutomaticFunctionProfiler profileThisFunction( &_context->phaseProfilers->drawProfiler );
 
 	/*
 	std::cout << "max speed is " << _PPRParams.ped_max_speed << " and quert radius is " <<
@@ -2303,7 +2337,7 @@ void PPRAgent::draw()
 
 	if (isSelected()) {
 		DrawLib::glColor(gRed);
-		for (std::set<SteerLib::SpatialDatabaseItemPtr>::iterator neighbor = _neighbors.begin(); neighbor != _neighbors.end(); ++neighbor) {
+		for (std::vector<SteerLib::SpatialDatabaseItemPtr>::iterator neighbor = _neighbors.begin(); neighbor != _neighbors.end(); ++neighbor) {
 		//for (unsigned int i=0; i<_neighbors.size(); i++) {
 			if ((*neighbor)->isAgent()) DrawLib::drawLine(_position + verticalOffset, AGENT_PTR((*neighbor))->position() + verticalOffset);
 		}
@@ -2326,7 +2360,7 @@ void PPRAgent::draw()
 #endif  // ifndef USE_ANNOTATIONS
 	// Draw collisions when they happen.
 	std::set<SteerLib::SpatialDatabaseItemPtr> __neighbors;
-	gSpatialDatabase->getItemsInRange(__neighbors, this->position().x-(this->_radius * 3), this->position().x+(this->_radius * 3),
+	_context->spatialDatabase->getItemsInRange(__neighbors, this->position().x-(this->_radius * 3), this->position().x+(this->_radius * 3),
 			this->position().z-(this->_radius * 3), this->position().z+(this->_radius * 3), dynamic_cast<SpatialDatabaseItemPtr>(this));
 
 	for (std::set<SteerLib::SpatialDatabaseItemPtr>::iterator neighbor = __neighbors.begin();  neighbor != __neighbors.end();  neighbor++)
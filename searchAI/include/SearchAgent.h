@@ -28,7 +28,7 @@
 class SearchAgent : public SteerLib::AgentInterface
 {
 public:
-	SearchAgent();
+	SearchAgent(SearchAIModule * module);
 	~SearchAgent();
 	void reset(const SteerLib::AgentInitialConditions & initialConditions, SteerLib::EngineInterface * engineInfo);
 	void updateAI(float timeStamp, float dt, unsigned int frameNumber);
@@ -68,6 +68,8 @@ public:
 	SteerLib::AStarPlanner astar;
 
 protected:
+	/// The state shared with the other agents of the module that created this agent.
+	SearchAIGlobals::ModuleContext * _context;
 
 	bool _enabled;
 	Util::Point __position;
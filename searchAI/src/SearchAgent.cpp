@@ -17,8 +17,9 @@
 #define GOAL_REGION 0.1f
 #define DURATION 15
 
-SearchAgent::SearchAgent()
+SearchAgent::SearchAgent(SearchAIModule * module)
 {
+	_context = module->getContext();
 	_enabled = false;
 }
 
@@ -26,14 +27,14 @@ SearchAgent::~SearchAgent()
 {
 	if (_enabled) {
 		Util::AxisAlignedBox bounds(__position.x-_radius, __position.x+_radius, 0.0f, 0.0f, __position.z-_radius, __position.z+_radius);
-		gSpatialDatabase->removeObject( this, bounds);
+		_context->spatialDatabase->removeObject( this, bounds);
 	}
 }
 
 void SearchAgent::disable()
 {
 	Util::AxisAlignedBox bounds(__position.x-_radius, __position.x+_radius, 0.0f, 0.0f, __position.z-_radius, __position.z+_radius);
-	gSpatialDatabase->removeObject( this, bounds);
+	_context->spatialDatabase->removeObject( this, bounds);
 	_enabled = false;
 }
 
@@ -55,11 +56,11 @@ void SearchAgent::reset(const SteerLib::AgentInitialConditions & initialConditio
 
 	if (!_enabled) {
 		// if the agent was not enabled, then it does not already exist in the database, so add it.
-		gSpatialDatabase->addObject( this, newBounds);
+		_context->spatialDatabase->addObject( this, newBounds);
 	}
 	else {
 		// if the agent was enabled, then the agent already existed in the database, so update it instead of adding it.
-		gSpatialDatabase->updateObject( this, oldBounds, newBounds);
+		_context->spatialDatabase->updateObject( this, oldBounds, newBounds);
 	}
 
 	_enabled = true;
@@ -74,7 +75,7 @@ void SearchAgent::reset(const SteerLib::AgentInitialConditions & initialConditio
 			_goalQueue.push(initialConditions.goals[i]);
 			if (initialConditions.goals[i].targetIsRandom) {
 				// if the goal is random, we must randomly generate the goal.
-				_goalQueue.back().targetLocation = gSpatialDatabase->randomPositionWithoutCollisions(1.0f, true);
+				_goalQueue.back().targetLocation = _context->spatialDatabase->randomPositionWithoutCollisions(1.0f, true, engineInfo->getRandomStream(this));
 			}
 		}
 		else {
@@ -92,7 +93,8 @@ void SearchAgent::computePlan()
 {
 	std::cout<<"\nComputing agent plan ";
 	Util::Point global_goal = _goalQueue.front().targetLocation;
-	if(astar.computePath(__path, __position, _goalQueue.front().targetLocation, gSpatialDatabase))
+	astar.setFrameArena(&_context->engine->getFrameArena());
+	if(astar.computePath(__path, __position, _goalQueue.front().targetLocation, _context->spatialDatabase))
 	{
 
 		while(!_goalQueue.empty())
@@ -120,7 +122,7 @@ void SearchAgent::computePlan()
 
 void SearchAgent::updateAI(float timeStamp, float dt, unsigned int frameNumber)
 {
-	Util::AutomaticFunctionProfiler profileThisFunction( &SearchAIGlobals::gPhaseProfilers->aiProfiler );
+	Util::AutomaticFunctionProfiler profileThisFunction( &_context->phaseProfilers->aiProfiler );
 
 	
 	double steps = (DURATION/(double)__path.size());
@@ -142,13 +144,13 @@ void SearchAgent::draw()
 {
 #ifdef ENABLE_GUI
 	// if the agent is selected, do some annotations just for demonstration
-	if (gEngine->isAgentSelected(this)) {
+	if (_context->engine->isAgentSelected(this)) {
 		Util::Ray ray;
 		ray.initWithUnitInterval(__position, _forward);
 		float t = 0.0f;
 		SteerLib::SpatialDatabaseItem * objectFound;
 		Util::DrawLib::drawLine(ray.pos, ray.eval(1.0f));
-		if (gSpatialDatabase->trace(ray, t, objectFound, this, false)) {
+		if (_context->spatialDatabase->trace(ray, t, objectFound, this, false)) {
 			Util::DrawLib::drawAgentDisc(__position, _forward, _radius, Util::gBlue);
 		}
 		else {
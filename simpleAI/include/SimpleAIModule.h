@@ -13,11 +13,7 @@
 #include "SteerLib.h"
 #include "Logger.h"
 
-
-
-// globally accessible to the simpleAI plugin
-extern SteerLib::EngineInterface * gEngine;
-extern SteerLib::GridDatabase2D * gSpatialDatabase;
+class SimpleAgent;
 
 namespace SimpleAIGlobals {
 
@@ -34,17 +30,24 @@ namespace SimpleAIGlobals {
 	};
 
 
-	extern unsigned int gLongTermPlanningPhaseInterval;
-	extern unsigned int gMidTermPlanningPhaseInterval;
-	extern unsigned int gShortTermPlanningPhaseInterval;
-	extern unsigned int gPredictivePhaseInterval;
-	extern unsigned int gReactivePhaseInterval;
-	extern unsigned int gPerceptivePhaseInterval;
-	extern bool gUseDynamicPhaseScheduling;
-	extern bool gShowStats;
-	extern bool gShowAllStats;
-
-	extern PhaseProfilers * gPhaseProfilers;
+	/// @brief The state shared by all agents of one SimpleAIModule.
+	///
+	/// Every module instance owns its own context, and its agents reach it through the module that created them,
+	/// so that several engines can each load this plugin in the same process.
+	struct ModuleContext {
+		SteerLib::EngineInterface * engine;
+		SteerLib::GridDatabase2D * spatialDatabase;
+		unsigned int longTermPlanningPhaseInterval;
+		unsigned int midTermPlanningPhaseInterval;
+		unsigned int shortTermPlanningPhaseInterval;
+		unsigned int predictivePhaseInterval;
+		unsigned int reactivePhaseInterval;
+		unsigned int perceptivePhaseInterval;
+		bool useDynamicPhaseScheduling;
+		bool showStats;
+		bool showAllStats;
+		PhaseProfilers * phaseProfilers;
+	};
 }
 
 
@@ -79,13 +82,21 @@ public:
 	SteerLib::AgentInterface * createAgent();
 	void destroyAgent( SteerLib::AgentInterface * agent );
 
+	/// Returns the state shared by the agents of this module.
+	inline SimpleAIGlobals::ModuleContext * getContext() { return &_context; }
+
 	void preprocessFrame(float timeStamp, float dt, unsigned int frameNumber);
 	void postprocessFrame(float timeStamp, float dt, unsigned int frameNumber);
 	void preprocessSimulation();
 	void initializeSimulation();
 	void cleanupSimulation();
+	/// All state that changes during the simulation belongs to the agents, which store it themselves.
+	bool supportsCheckpoints() { return true; }
 
 protected:
+	SimpleAIGlobals::ModuleContext _context;
+	/// Agents destroyed by the engine, reused by createAgent() in the next simulation.
+	SteerLib::AgentPool<SimpleAgent> _agentPool;
 	std::string logFilename; // = "AI.log";
 	bool logStats; // = false;
 	Logger * _logger;
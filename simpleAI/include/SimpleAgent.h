@@ -28,7 +28,7 @@
 class SimpleAgent : public SteerLib::AgentInterface
 {
 public:
-	SimpleAgent();
+	SimpleAgent(SimpleAIModule * module);
 	~SimpleAgent();
 	void reset(const SteerLib::AgentInitialConditions & initialConditions, SteerLib::EngineInterface * engineInfo);
 	void updateAI(float timeStamp, float dt, unsigned int frameNumber);
@@ -60,8 +60,17 @@ public:
 	float computePenetration(const Util::Point & p, float radius) { return Util::computeCircleCirclePenetration2D( __position, _radius, p, radius); }
 	//@}
 
+	/// @name Checkpointing
+	//@{
+	bool supportsCheckpoints() { return true; }
+	void writeCheckpoint(SteerLib::CheckpointWriter & out);
+	void readCheckpoint(SteerLib::CheckpointReader & in);
+	//@}
+
 
 protected:
+	/// The state shared with the other agents of the module that created this agent.
+	SimpleAIGlobals::ModuleContext * _context;
 	/// Updates position, velocity, and orientation of the agent, given the force and dt time step.
 	void _doEulerStep(const Util::Vector & steeringDecisionForce, float dt);
 
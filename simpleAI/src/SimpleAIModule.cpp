@@ -16,25 +16,6 @@
 #include "LogManager.h"
 
 
-// globally accessible to the simpleAI plugin
-SteerLib::EngineInterface * gEngine;
-SteerLib::GridDatabase2D * gSpatialDatabase;
-
-namespace SimpleAIGlobals
-{
-	unsigned int gLongTermPlanningPhaseInterval;
-	unsigned int gMidTermPlanningPhaseInterval;
-	unsigned int gShortTermPlanningPhaseInterval;
-	unsigned int gPredictivePhaseInterval;
-	unsigned int gReactivePhaseInterval;
-	unsigned int gPerceptivePhaseInterval;
-	bool gUseDynamicPhaseScheduling;
-	bool gShowStats;
-	bool gShowAllStats;
-
-	PhaseProfilers * gPhaseProfilers;
-}
-
 using namespace SimpleAIGlobals;
 
 PLUGIN_API SteerLib::ModuleInterface * createModule()
@@ -50,13 +31,15 @@ PLUGIN_API void destroyModule( SteerLib::ModuleInterface*  module )
 
 void SimpleAIModule::init( const SteerLib::OptionDictionary & options, SteerLib::EngineInterface * engineInfo )
 {
-	gEngine = engineInfo;
-	gSpatialDatabase = engineInfo->getSpatialDatabase();
+	// the phase intervals and profilers start out zero, until options or initializeSimulation() set them.
+	_context = ModuleContext();
+	_context.engine = engineInfo;
+	_context.spatialDatabase = engineInfo->getSpatialDatabase();
 
-	gUseDynamicPhaseScheduling = false;
-	gShowStats = false;
+	_context.useDynamicPhaseScheduling = false;
+	_context.showStats = false;
 	logStats = false;
-	gShowAllStats = false;
+	_context.showAllStats = false;
 	logFilename = "simpleAI.log";
 
 	SteerLib::OptionDictionary::const_iterator optionIter;
@@ -64,7 +47,7 @@ void SimpleAIModule::init( const SteerLib::OptionDictionary & options, SteerLib:
 		std::stringstream value((*optionIter).second);
 		if ((*optionIter).first == "")
 		{
-			value >> gLongTermPlanningPhaseInterval;
+			value >> _context.longTermPlanningPhaseInterval;
 		}
 		else if ((*optionIter).first == "ailogFileName")
 		{
@@ -73,11 +56,11 @@ void SimpleAIModule::init( const SteerLib::OptionDictionary & options, SteerLib:
 		}
 		else if ((*optionIter).first == "stats")
 		{
-			gShowStats = Util::getBoolFromString(value.str());
+			_context.showStats = Util::getBoolFromString(value.str());
 		}
 		else if ((*optionIter).first == "allstats")
 		{
-			gShowAllStats = Util::getBoolFromString(value.str());
+			_context.showAllStats = Util::getBoolFromString(value.str());
 		}
 		else
 		{
@@ -117,15 +100,15 @@ void SimpleAIModule::initializeSimulation()
 	//
 	// initialize the performance profilers
 	//
-	gPhaseProfilers = new PhaseProfilers;
-	gPhaseProfilers->aiProfiler.reset();
-	gPhaseProfilers->longTermPhaseProfiler.reset();
-	gPhaseProfilers->midTermPhaseProfiler.reset();
-	gPhaseProfilers->shortTermPhaseProfiler.reset();
-	gPhaseProfilers->perceptivePhaseProfiler.reset();
-	gPhaseProfilers->predictivePhaseProfiler.reset();
-	gPhaseProfilers->reactivePhaseProfiler.reset();
-	gPhaseProfilers->steeringPhaseProfiler.reset();
+	_context.phaseProfilers = new PhaseProfilers;
+	_context.phaseProfilers->aiProfiler.reset();
+	_context.phaseProfilers->longTermPhaseProfiler.reset();
+	_context.phaseProfilers->midTermPhaseProfiler.reset();
+	_context.phaseProfilers->shortTermPhaseProfiler.reset();
+	_context.phaseProfilers->perceptivePhaseProfiler.reset();
+	_context.phaseProfilers->predictivePhaseProfiler.reset();
+	_context.phaseProfilers->reactivePhaseProfiler.reset();
+	_context.phaseProfilers->steeringPhaseProfiler.reset();
 
 }
 
@@ -151,27 +134,27 @@ void SimpleAIModule::cleanupSimulation()
 	{
 		LogObject logObject;
 
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getNumTimesExecuted());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getTotalTicksAccumulated());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getMinTicks());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getMaxTicks());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getMinExecutionTimeMills());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getMaxExecutionTimeMills());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getAverageExecutionTimeMills());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getTotalTime());
-		logObject.addLogData(gPhaseProfilers->aiProfiler.getTickFrequency());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getNumTimesExecuted());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getTotalTicksAccumulated());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getMinTicks());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getMaxTicks());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getMinExecutionTimeMills());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getMaxExecutionTimeMills());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getAverageExecutionTimeMills());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getTotalTime());
+		logObject.addLogData(_context.phaseProfilers->aiProfiler.getTickFrequency());
 
 		_logger->writeLogObject(logObject);
 
 		// cleanup profileing metrics for next simulation/scenario
-		gPhaseProfilers->aiProfiler.reset();
-		gPhaseProfilers->longTermPhaseProfiler.reset();
-		gPhaseProfilers->midTermPhaseProfiler.reset();
-		gPhaseProfilers->shortTermPhaseProfiler.reset();
-		gPhaseProfilers->perceptivePhaseProfiler.reset();
-		gPhaseProfilers->predictivePhaseProfiler.reset();
-		gPhaseProfilers->reactivePhaseProfiler.reset();
-		gPhaseProfilers->steeringPhaseProfiler.reset();
+		_context.phaseProfilers->aiProfiler.reset();
+		_context.phaseProfilers->longTermPhaseProfiler.reset();
+		_context.phaseProfilers->midTermPhaseProfiler.reset();
+		_context.phaseProfilers->shortTermPhaseProfiler.reset();
+		_context.phaseProfilers->perceptivePhaseProfiler.reset();
+		_context.phaseProfilers->predictivePhaseProfiler.reset();
+		_context.phaseProfilers->reactivePhaseProfiler.reset();
+		_context.phaseProfilers->steeringPhaseProfiler.reset();
 	}
 
 	// kdTree_->deleteObstacleTree(kdTree_->obstacleTree_);
@@ -179,15 +162,16 @@ void SimpleAIModule::cleanupSimulation()
 
 void SimpleAIModule::finish()
 {
-	// nothing to do here
+	_agentPool.clear();
 }
 
 SteerLib::AgentInterface * SimpleAIModule::createAgent()
 {
-	return new SimpleAgent; 
+	SimpleAgent * agent = _agentPool.acquire();
+	return (agent != NULL) ? agent : new SimpleAgent(this);
 }
 
 void SimpleAIModule::destroyAgent( SteerLib::AgentInterface * agent )
 {
-	delete agent;
+	_agentPool.release(dynamic_cast<SimpleAgent*>(agent));
 }
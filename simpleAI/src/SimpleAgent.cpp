@@ -14,8 +14,9 @@
 #define MAX_SPEED 1.3f
 #define AGENT_MASS 1.0f
 
-SimpleAgent::SimpleAgent()
+SimpleAgent::SimpleAgent(SimpleAIModule * module)
 {
+	_context = module->getContext();
 	_enabled = false;
 }
 
@@ -23,14 +24,14 @@ SimpleAgent::~SimpleAgent()
 {
 	if (_enabled) {
 		Util::AxisAlignedBox bounds(__position.x-_radius, __position.x+_radius, 0.0f, 0.0f, __position.z-_radius, __position.z+_radius);
-		gSpatialDatabase->removeObject( this, bounds);
+		_context->spatialDatabase->removeObject( this, bounds);
 	}
 }
 
 void SimpleAgent::disable()
 {
 	Util::AxisAlignedBox bounds(__position.x-_radius, __position.x+_radius, 0.0f, 0.0f, __position.z-_radius, __position.z+_radius);
-	gSpatialDatabase->removeObject( this, bounds);
+	_context->spatialDatabase->removeObject( this, bounds);
 	_enabled = false;
 }
 
@@ -51,11 +52,11 @@ void SimpleAgent::reset(const SteerLib::AgentInitialConditions & initialConditio
 
 	if (!_enabled) {
 		// if the agent was not enabled, then it does not already exist in the database, so add it.
-		gSpatialDatabase->addObject( this, newBounds);
+		_context->spatialDatabase->addObject( this, newBounds);
 	}
 	else {
 		// if the agent was enabled, then the agent already existed in the database, so update it instead of adding it.
-		gSpatialDatabase->updateObject( this, oldBounds, newBounds);
+		_context->spatialDatabase->updateObject( this, oldBounds, newBounds);
 	}
 
 	_enabled = true;
@@ -64,13 +65,18 @@ void SimpleAgent::reset(const SteerLib::AgentInitialConditions & initialConditio
 		throw Util::GenericException("No goals were specified!\n");
 	}
 
+	// the agent may be reused from the module's pool, so goals of its previous life are dropped.
+	while (!_goalQueue.empty()) {
+		_goalQueue.pop();
+	}
+
 	// iterate over the sequence of goals specified by the initial conditions.
 	for (unsigned int i=0; i<initialConditions.goals.size(); i++) {
 		if (initialConditions.goals[i].goalType == SteerLib::GOAL_TYPE_SEEK_STATIC_TARGET) {
 			_goalQueue.push(initialConditions.goals[i]);
 			if (initialConditions.goals[i].targetIsRandom) {
 				// if the goal is random, we must randomly generate the goal.
-				_goalQueue.back().targetLocation = gSpatialDatabase->randomPositionWithoutCollisions(1.0f, true);
+				_goalQueue.back().targetLocation = _context->spatialDatabase->randomPositionWithoutCollisions(1.0f, true, engineInfo->getRandomStream(this));
 			}
 		}
 		else {
@@ -88,7 +94,7 @@ void SimpleAgent::updateAI(float timeStamp, float dt, unsigned int frameNumber)
 {
 	// for this function, we assume that all goals are of type GOAL_TYPE_SEEK_STATIC_TARGET.
 	// the error check for this was performed in reset().
-	Util::AutomaticFunctionProfiler profileThisFunction( &SimpleAIGlobals::gPhaseProfilers->aiProfiler );
+	Util::AutomaticFunctionProfiler profileThisFunction( &_context->phaseProfilers->aiProfiler );
 
 	Util::Vector vectorToGoal = _goalQueue.front().targetLocation - __position;
 
@@ -115,17 +121,39 @@ void SimpleAgent::updateAI(float timeStamp, float dt, unsigned int frameNumber)
 }
 
 
+void SimpleAgent::writeCheckpoint(SteerLib::CheckpointWriter & out)
+{
+	out.write(_enabled);
+	out.write(__position);
+	out.write(_velocity);
+	out.write(_forward);
+	out.write(_radius);
+	out.writeGoalQueue(_goalQueue);
+}
+
+
+void SimpleAgent::readCheckpoint(SteerLib::CheckpointReader & in)
+{
+	in.read(_enabled);
+	in.read(__position);
+	in.read(_velocity);
+	in.read(_forward);
+	in.read(_radius);
+	in.readGoalQueue(_goalQueue);
+}
+
+
 void SimpleAgent::draw()
 {
 #ifdef ENABLE_GUI
 	// if the agent is selected, do some annotations just for demonstration
-	if (gEngine->isAgentSelected(this)) {
+	if (_context->engine->isAgentSelected(this)) {
 		Util::Ray ray;
 		ray.initWithUnitInterval(__position, _forward);
 		float t = 0.0f;
 		SteerLib::SpatialDatabaseItem * objectFound;
 		Util::DrawLib::drawLine(ray.pos, ray.eval(1.0f));
-		if (gSpatialDatabase->trace(ray, t, objectFound, this, false)) {
+		if (_context->spatialDatabase->trace(ray, t, objectFound, this, false)) {
 			Util::DrawLib::drawAgentDisc(__position, _forward, _radius, Util::gBlue);
 		}
 		else {
@@ -159,7 +187,7 @@ void SimpleAgent::_doEulerStep(const Util::Vector & steeringDecisionForce, float
 	// update the database with the new agent's setup
 	Util::AxisAlignedBox oldBounds(__position.x - _radius, __position.x + _radius, 0.0f, 0.0f, __position.z - _radius, __position.z + _radius);
 	Util::AxisAlignedBox newBounds(newPosition.x - _radius, newPosition.x + _radius, 0.0f, 0.0f, newPosition.z - _radius, newPosition.z + _radius);
-	gSpatialDatabase->updateObject( this, oldBounds, newBounds);
+	_context->spatialDatabase->updateObject( this, oldBounds, newBounds);
 
 	__position = newPosition;
 }
@@ -19,10 +19,7 @@
 #include "SocialForces_Parameters.h"
 #include "Logger.h"
 
-
-// globally accessible to the sfAI plugin
-extern SteerLib::EngineInterface * gEngine;
-// extern SteerLib::GridDatabase2D * gSpatialDatabase;
+class SocialForcesAgent;
 
 
 /**
@@ -66,12 +63,20 @@ class SocialForcesAIModule : public SteerLib::ModuleInterface
         SteerLib::AgentInterface * createAgent();
         void destroyAgent( SteerLib::AgentInterface * agent );
 
+        /// Returns the state shared by the agents of this module.
+        inline SocialForcesGlobals::ModuleContext * getContext() { return &_context; }
+
         void preprocessFrame(float timeStamp, float dt, unsigned int frameNumber);
         void postprocessFrame(float timeStamp, float dt, unsigned int frameNumber);
+        /// All state that changes during the simulation belongs to the agents, which store it themselves.
+        bool supportsCheckpoints() { return true; }
         std::vector<SteerLib::AgentInterface * > agents_;
 
     protected:
 
+        SocialForcesGlobals::ModuleContext _context;
+        /// Agents destroyed by the engine, reused by createAgent() in the next simulation.
+        SteerLib::AgentPool<SocialForcesAgent> _agentPool;
         std::string logFilename; // = "pprAI.log";
         bool logStats; // = false;
         Logger * _rvoLogger;
@@ -21,6 +21,8 @@
 // #include "SocialForcesAIModule.h"
 #include "SocialForces_Parameters.h"
 
+class SocialForcesAIModule;
+
 
 /**
  * @brief Social Forces Agent stuff
@@ -37,10 +39,14 @@
 class SocialForcesAgent : public SteerLib::AgentInterface
 {
     public:
-        SocialForcesAgent();
+        SocialForcesAgent(SocialForcesAIModule * module);
         ~SocialForcesAgent();
         void reset(const SteerLib::AgentInitialConditions & initialConditions, SteerLib::EngineInterface * engineInfo);
+        /// Runs decideAI() and commitAI() back to back, for callers that do not use the two-phase update.
         void updateAI(float timeStamp, float dt, unsigned int frameNumber);
+        bool usesTwoPhaseUpdate() { return true; }
+        void decideAI(float timeStamp, float dt, unsigned int frameNumber);
+        void commitAI(float timeStamp, float dt, unsigned int frameNumber);
         void disable();
         void draw();
 
@@ -66,9 +72,18 @@ class SocialForcesAgent : public SteerLib::AgentInterface
 
         // bool collidesAtTimeWith(const Util::Point & p1, const Util::Vector & rightSide, float otherAgentRadius, float timeStamp, float footX, float footZ);
         void insertAgentNeighbor(const SteerLib::AgentInterface * agent, float &rangeSq) {throw Util::GenericException("clearGoals() not implemented yet for SimpleAgent");}
+
+        /// @name Checkpointing
+        //@{
+        bool supportsCheckpoints() { return true; }
+        void writeCheckpoint(SteerLib::CheckpointWriter & out);
+        void readCheckpoint(SteerLib::CheckpointReader & in);
+        //@}
         // bool compareDist(SteerLib::AgentInterface * a1, SteerLib::AgentInterface * a2 );
 
     protected:
+        /// The state shared with the other agents of the module that created this agent.
+        SocialForcesGlobals::ModuleContext * _context;
         /// Updates position, velocity, and orientation of the agent, given the force and dt time step.
         // void _doEulerStep(const Util::Vector & steeringDecisionForce, float dt);
 
@@ -86,6 +101,8 @@ class SocialForcesAgent : public SteerLib::AgentInterface
         Util::Vector _forward; // normalized version of velocity
         Util::Vector _prefVelocity; // This is the velocity the agent wants to be at
         Util::Vector _newVelocity;
+        /// position decided by decideAI(), applied by commitAI().
+        Util::Point _newPosition;
         Util::Color _color;
         float _radius;
 
@@ -118,10 +135,35 @@ class SocialForcesAgent : public SteerLib::AgentInterface
         Util::Vector calcAgentRepulsionForce(float dt);
         Util::Vector calcWallRepulsionForce(float dt);
 
+        /// Collects items near the agent in a repeatable order: agents by their index in the engine, then obstacles by their bounds.
+        void getNeighborsInOrder(std::vector<SteerLib::SpatialDatabaseItemPtr> & neighbors);
+        /// Like getNeighborsInOrder(), but only the agents or obstacles within maxDistance; agents are measured to their center.
+        void getNearestNeighborsInOrder(std::vector<SteerLib::SpatialDatabaseItemPtr> & neighbors, SteerLib::NeighborFilterEnum filter, float maxDistance);
+        /// Sorts neighbors into the order described for getNeighborsInOrder().
+        void sortNeighbors(std::vector<SteerLib::SpatialDatabaseItemPtr> & neighbors);
+        /// Returns the state another agent had at the start of the frame.
+        SteerLib::FrozenAgentState getFrozenState(SteerLib::AgentInterface * agent);
+
         Util::Vector calcWallNormal(SteerLib::ObstacleInterface* obs);
         std::pair<Util::Point, Util::Point> calcWallPointsFromNormal(SteerLib::ObstacleInterface* obs, Util::Vector normal);
         Util::Vector calcObsNormal(SteerLib::ObstacleInterface* obs);
 
+        /// A neighbor together with the key it is sorted by, so that the key is looked up only once per neighbor.
+        struct OrderedNeighbor {
+            /// 0 for agents in the frozen snapshot, 1 for agents that are not, 2 for obstacles.
+            unsigned int kind;
+            /// the agent's index in the snapshot, or its slot in the engine's agent registry.
+            unsigned int index;
+            Util::AxisAlignedBox bounds;
+            SteerLib::SpatialDatabaseItemPtr item;
+            bool operator<(const OrderedNeighbor & other) const;
+        };
+        /// The results of the neighbor queries of the force calculations; members, and cleared by every query, so that they do not allocate every frame.
+        std::vector<SteerLib::SpatialDatabaseItemPtr> _neighbors;
+        std::vector<SteerLib::NearestNeighbor> _nearestNeighbors;
+        /// Reused by sortNeighbors() so that sorting does not allocate every frame.
+        std::vector<OrderedNeighbor> _orderedNeighbors;
+
         // For midterm planning stores the plan to the current goal
         std::vector<Util::Point> _midTermPath;
         // holds the location of the best local target along the midtermpath
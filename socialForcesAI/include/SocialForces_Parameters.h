@@ -54,39 +54,21 @@ namespace SocialForcesGlobals {
 		Util::PerformanceProfiler predictivePhaseProfiler;
 		Util::PerformanceProfiler reactivePhaseProfiler;
 		Util::PerformanceProfiler steeringPhaseProfiler;
-	};
-
-
-	extern SteerLib::EngineInterface * gEngineInfo;
-	extern SteerLib::GridDatabase2D * gSpatialDatabase;
-	extern unsigned int gLongTermPlanningPhaseInterval;
-	extern unsigned int gMidTermPlanningPhaseInterval;
-	extern unsigned int gShortTermPlanningPhaseInterval;
-	extern unsigned int gPredictivePhaseInterval;
-	extern unsigned int gReactivePhaseInterval;
-	extern unsigned int gPerceptivePhaseInterval;
-	extern bool gUseDynamicPhaseScheduling;
-	extern bool gShowStats;
-	extern bool gShowAllStats;
 
+		/// Adds the calls recorded by another set of profilers, e.g. those of a different thread.
+		void addStatistics(const PhaseProfilers & other) {
+			aiProfiler.addStatistics(other.aiProfiler);
+			drawProfiler.addStatistics(other.drawProfiler);
+			longTermPhaseProfiler.addStatistics(other.longTermPhaseProfiler);
+			midTermPhaseProfiler.addStatistics(other.midTermPhaseProfiler);
+			shortTermPhaseProfiler.addStatistics(other.shortTermPhaseProfiler);
+			perceptivePhaseProfiler.addStatistics(other.perceptivePhaseProfiler);
+			predictivePhaseProfiler.addStatistics(other.predictivePhaseProfiler);
+			reactivePhaseProfiler.addStatistics(other.reactivePhaseProfiler);
+			steeringPhaseProfiler.addStatistics(other.steeringPhaseProfiler);
+		}
+	};
 
-	// Adding a bunch of parameters so they can be changed via input
-	extern float sf_acceleration;
-	extern float sf_personal_space_threshold;
-	extern float sf_agent_repulsion_importance;
-	extern float sf_query_radius;
-	extern float sf_body_force;
-	extern float sf_agent_body_force;
-	extern float sf_sliding_friction_force;
-	extern float sf_agent_b;
-	extern float sf_agent_a;
-	extern float sf_wall_b;
-	extern float sf_wall_a;
-	extern float sf_max_speed;
-
-
-
-	extern PhaseProfilers * gPhaseProfilers;
 }
 
 
@@ -188,6 +170,36 @@ inline std::ostream &operator<<(std::ostream & out, const SocialForcesParameters
 	return out;
 }
 
+namespace SocialForcesGlobals {
+
+	/// @brief The state shared by all agents of one SocialForcesAIModule.
+	///
+	/// Every module instance owns its own context, and its agents reach it through the module that created them,
+	/// so that several engines can each load this plugin in the same process.
+	struct ModuleContext {
+		SteerLib::EngineInterface * engine;
+		SteerLib::GridDatabase2D * spatialDatabase;
+		unsigned int longTermPlanningPhaseInterval;
+		unsigned int midTermPlanningPhaseInterval;
+		unsigned int shortTermPlanningPhaseInterval;
+		unsigned int predictivePhaseInterval;
+		unsigned int reactivePhaseInterval;
+		unsigned int perceptivePhaseInterval;
+		bool useDynamicPhaseScheduling;
+		bool showStats;
+		bool showAllStats;
+		/// The statistics of the whole simulation; the profilers of all threads are added into it when the simulation is cleaned up.
+		PhaseProfilers * phaseProfilers;
+		/// One set of profilers per engine thread, so that agents updated in parallel never record into the same profiler.
+		std::vector<PhaseProfilers> threadPhaseProfilers;
+
+		/// Returns the profilers of the calling thread.
+		PhaseProfilers & getThreadPhaseProfilers() { return threadPhaseProfilers[engine->getIndexOfCurrentThread()]; }
+		/// The parameters given to every new agent, before its own behaviour is applied.
+		SocialForcesParameters parameters;
+	};
+}
+
 
 
 #endif /* SocialForces_PARAMETERS_H_ */
@@ -19,44 +19,6 @@
 #include "LogManager.h"
 
 
-// globally accessible to the sfAI plugin
-SteerLib::EngineInterface * gEngine;
-// SteerLib::GridDatabase2D * gSpatialDatabase;
-
-
-namespace SocialForcesGlobals
-{
-
-    SteerLib::EngineInterface* gEngineInfo;
-    SteerLib::GridDatabase2D*  gSpatialDatabase;
-	unsigned int gLongTermPlanningPhaseInterval;
-	unsigned int gMidTermPlanningPhaseInterval;
-	unsigned int gShortTermPlanningPhaseInterval;
-	unsigned int gPredictivePhaseInterval;
-	unsigned int gReactivePhaseInterval;
-	unsigned int gPerceptivePhaseInterval;
-	bool gUseDynamicPhaseScheduling;
-	bool gShowStats;
-	bool gShowAllStats;
-
-	// Adding a bunch of parameters so they can be changed via input
-	float sf_acceleration;
-	float sf_personal_space_threshold;
-	float sf_agent_repulsion_importance;
-	float sf_query_radius;
-	float sf_body_force;
-	float sf_agent_body_force;
-	float sf_sliding_friction_force;
-	float sf_agent_b;
-	float sf_agent_a;
-	float sf_wall_b;
-	float sf_wall_a;
-	float sf_max_speed;
-
-	PhaseProfilers * gPhaseProfilers;
-}
-
-
 using namespace SocialForcesGlobals;
 
 
@@ -74,28 +36,30 @@ PLUGIN_API void destroyModule( SteerLib::ModuleInterface*  module )
 
 void SocialForcesAIModule::init( const SteerLib::OptionDictionary & options, SteerLib::EngineInterface * engineInfo )
 {
-	gEngine = engineInfo;
-	gSpatialDatabase = engineInfo->getSpatialDatabase();
+	// the phase intervals and profilers start out zero, until options or initializeSimulation() set them.
+	_context = ModuleContext();
+	_context.engine = engineInfo;
+	_context.spatialDatabase = engineInfo->getSpatialDatabase();
 	_data = "";
 
-	gUseDynamicPhaseScheduling = false;
-	gShowStats = false;
+	_context.useDynamicPhaseScheduling = false;
+	_context.showStats = false;
 	logStats = false;
-	gShowAllStats = false;
+	_context.showAllStats = false;
 	logFilename = "sfAI.log";
 
-	sf_acceleration = ACCELERATION;
-	sf_personal_space_threshold = PERSONAL_SPACE_THRESHOLD;
-	sf_agent_repulsion_importance = AGENT_REPULSION_IMPORTANCE;
-	sf_query_radius = QUERY_RADIUS;
-	sf_body_force = BODY_FORCE;
-	sf_agent_body_force = AGENT_BODY_FORCE;
-	sf_sliding_friction_force = SLIDING_FRICTION_FORCE;
-	sf_agent_b = AGENT_B;
-	sf_agent_a = AGENT_A;
-	sf_wall_b = WALL_B;
-	sf_wall_a = WALL_A;
-	sf_max_speed = MAX_SPEED;
+	_context.parameters.sf_acceleration = ACCELERATION;
+	_context.parameters.sf_personal_space_threshold = PERSONAL_SPACE_THRESHOLD;
+	_context.parameters.sf_agent_repulsion_importance = AGENT_REPULSION_IMPORTANCE;
+	_context.parameters.sf_query_radius = QUERY_RADIUS;
+	_context.parameters.sf_body_force = BODY_FORCE;
+	_context.parameters.sf_agent_body_force = AGENT_BODY_FORCE;
+	_context.parameters.sf_sliding_friction_force = SLIDING_FRICTION_FORCE;
+	_context.parameters.sf_agent_b = AGENT_B;
+	_context.parameters.sf_agent_a = AGENT_A;
+	_context.parameters.sf_wall_b = WALL_B;
+	_context.parameters.sf_wall_a = WALL_A;
+	_context.parameters.sf_max_speed = MAX_SPEED;
 
 
 	SteerLib::OptionDictionary::const_iterator optionIter;
@@ -104,57 +68,57 @@ void SocialForcesAIModule::init( const SteerLib::OptionDictionary & options, Ste
 		// std::cout << "option " << (*optionIter).first << " value " << value.str() << std::endl;
 		if ((*optionIter).first == "")
 		{
-			value >> gLongTermPlanningPhaseInterval;
+			value >> _context.longTermPlanningPhaseInterval;
 		}
 		else if ((*optionIter).first == "sf_acceleration")
 		{
-			value >> sf_acceleration;
-			std::cout << "set sf acceleration to " << sf_acceleration << std::endl;
+			value >> _context.parameters.sf_acceleration;
+			std::cout << "set sf acceleration to " << _context.parameters.sf_acceleration << std::endl;
 		}
 		else if ((*optionIter).first == "sf_personal_space_threshold")
 		{
-			value >> sf_personal_space_threshold;
+			value >> _context.parameters.sf_personal_space_threshold;
 		}
 		else if ((*optionIter).first == "sf_agent_repulsion_importance")
 		{
-			value >> sf_agent_repulsion_importance;
+			value >> _context.parameters.sf_agent_repulsion_importance;
 		}
 		else if ((*optionIter).first == "sf_query_radius")
 		{
-			value >> sf_query_radius;
+			value >> _context.parameters.sf_query_radius;
 		}
 		else if ((*optionIter).first == "sf_body_force")
 		{
-			value >> sf_body_force;
+			value >> _context.parameters.sf_body_force;
 		}
 		else if ((*optionIter).first == "sf_agent_body_force")
 		{
-			value >> sf_body_force;
+			value >> _context.parameters.sf_body_force;
 		}
 		else if ((*optionIter).first == "sf_sliding_friction_force")
 		{
-			value >> sf_sliding_friction_force;
-			// std::cout << "*************** set sf_sliding_friction_force to " << sf_sliding_friction_force << std::endl;
+			value >> _context.parameters.sf_sliding_friction_force;
+			// std::cout << "*************** set _context.parameters.sf_sliding_friction_force to " << _context.parameters.sf_sliding_friction_force << std::endl;
 		}
 		else if ((*optionIter).first == "sf_agent_b")
 		{
-			value >> sf_agent_b;
+			value >> _context.parameters.sf_agent_b;
 		}
 		else if ((*optionIter).first == "sf_agent_a")
 		{
-			value >> sf_agent_a;
+			value >> _context.parameters.sf_agent_a;
 		}
 		else if ((*optionIter).first == "sf_wall_b")
 		{
-			value >> sf_wall_b;
+			value >> _context.parameters.sf_wall_b;
 		}
 		else if ((*optionIter).first == "sf_wall_a")
 		{
-			value >> sf_wall_a;
+			value >> _context.parameters.sf_wall_a;
 		}
 		else if ((*optionIter).first == "sf_max_speed")
 		{
-			value >> sf_max_speed;
+			value >> _context.parameters.sf_max_speed;
 		}
 		else if ((*optionIter).first == "ailogFileName")
 		{
@@ -167,11 +131,11 @@ void SocialForcesAIModule::init( const SteerLib::OptionDictionary & options, Ste
 		}
 		else if ((*optionIter).first == "stats")
 		{
-			gShowStats = Util::getBoolFromString(value.str());
+			_context.showStats = Util::getBoolFromString(value.str());
 		}
 		else if ((*optionIter).first == "allstats")
 		{
-			gShowAllStats = Util::getBoolFromString(value.str());
+			_context.showAllStats = Util::getBoolFromString(value.str());
 		}
 		else
 		{
@@ -211,22 +175,23 @@ void SocialForcesAIModule::initializeSimulation()
 	//
 	// initialize the performance profilers
 	//
-	gPhaseProfilers = new PhaseProfilers;
-	gPhaseProfilers->aiProfiler.reset();
-	gPhaseProfilers->longTermPhaseProfiler.reset();
-	gPhaseProfilers->midTermPhaseProfiler.reset();
-	gPhaseProfilers->shortTermPhaseProfiler.reset();
-	gPhaseProfilers->perceptivePhaseProfiler.reset();
-	gPhaseProfilers->predictivePhaseProfiler.reset();
-	gPhaseProfilers->reactivePhaseProfiler.reset();
-	gPhaseProfilers->steeringPhaseProfiler.reset();
+	_context.phaseProfilers = new PhaseProfilers;
+	_context.phaseProfilers->aiProfiler.reset();
+	_context.phaseProfilers->longTermPhaseProfiler.reset();
+	_context.phaseProfilers->midTermPhaseProfiler.reset();
+	_context.phaseProfilers->shortTermPhaseProfiler.reset();
+	_context.phaseProfilers->perceptivePhaseProfiler.reset();
+	_context.phaseProfilers->predictivePhaseProfiler.reset();
+	_context.phaseProfilers->reactivePhaseProfiler.reset();
+	_context.phaseProfilers->steeringPhaseProfiler.reset();
+	_context.threadPhaseProfilers.assign(_context.engine->getNumThreads(), PhaseProfilers());
 
 }
 
 
 void SocialForcesAIModule::finish()
 {
-	// nothing to do here
+	_agentPool.clear();
 }
 
 
@@ -267,7 +232,10 @@ void SocialForcesAIModule::postprocessFrame(float timeStamp, float dt, unsigned
 
 SteerLib::AgentInterface * SocialForcesAIModule::createAgent()
 {
-	SocialForcesAgent * agent = new SocialForcesAgent;
+	SocialForcesAgent * agent = _agentPool.acquire();
+	if (agent == NULL) {
+		agent = new SocialForcesAgent(this);
+	}
 	agent->rvoModule = this;
 	agent->id_ = agents_.size();
 	agents_.push_back(agent);
@@ -304,8 +272,8 @@ void SocialForcesAIModule::destroyAgent( SteerLib::AgentInterface * agent )
 	}*/
 
 
-	// TODO this is going to be a memory leak for now.
-	delete agent;
+	// agents_ is rebuilt by createAgent() in the next simulation; the agent itself waits in the pool until then.
+	_agentPool.release(dynamic_cast<SocialForcesAgent*>(agent));
 	/*
 	if (agent && &agents_ && (agents_.size() > 1))
 	{
@@ -327,33 +295,38 @@ void SocialForcesAIModule::cleanupSimulation()
 {
 	agents_.clear();
 
+	for (unsigned int i=0; i < _context.threadPhaseProfilers.size(); i++) {
+		_context.phaseProfilers->addStatistics(_context.threadPhaseProfilers[i]);
+	}
+	_context.threadPhaseProfilers.assign(_context.threadPhaseProfilers.size(), PhaseProfilers());
+
 	if ( logStats )
 	{
 		LogObject rvoLogObject;
 
-		rvoLogObject.addLogData(gPhaseProfilers->aiProfiler.getNumTimesExecuted());
-		rvoLogObject.addLogData(gPhaseProfilers->aiProfiler.getTotalTicksAccumulated());
-		rvoLogObject.addLogData(gPhaseProfilers->aiProfiler.getMinTicks());
-		rvoLogObject.addLogData(gPhaseProfilers->aiProfiler.getMaxTicks());
-		rvoLogObject.addLogData(gPhaseProfilers->aiProfiler.getMinExecutionTimeMills());
-		rvoLogObject.addLogData(gPhaseProfilers->aiProfiler.getMaxExecutionTimeMills());
-		rvoLogObject.addLogData(gPhaseProfilers->aiProfiler.getAverageExecutionTimeMills());
-		rvoLogObject.addLogData(gPhaseProfilers->aiProfiler.getTotalTime());
-		rvoLogObject.addLogData(gPhaseProfilers->aiProfiler.getTickFrequency());
+		rvoLogObject.addLogData(_context.phaseProfilers->aiProfiler.getNumTimesExecuted());
+		rvoLogObject.addLogData(_context.phaseProfilers->aiProfiler.getTotalTicksAccumulated());
+		rvoLogObject.addLogData(_context.phaseProfilers->aiProfiler.getMinTicks());
+		rvoLogObject.addLogData(_context.phaseProfilers->aiProfiler.getMaxTicks());
+		rvoLogObject.addLogData(_context.phaseProfilers->aiProfiler.getMinExecutionTimeMills());
+		rvoLogObject.addLogData(_context.phaseProfilers->aiProfiler.getMaxExecutionTimeMills());
+		rvoLogObject.addLogData(_context.phaseProfilers->aiProfiler.getAverageExecutionTimeMills());
+		rvoLogObject.addLogData(_context.phaseProfilers->aiProfiler.getTotalTime());
+		rvoLogObject.addLogData(_context.phaseProfilers->aiProfiler.getTickFrequency());
 
 		_rvoLogger->writeLogObject(rvoLogObject);
 		_data = _data + _rvoLogger->logObjectToString(rvoLogObject);
 		_logData.push_back(rvoLogObject.copy());
 
 		// cleanup profileing metrics for next simulation/scenario
-		gPhaseProfilers->aiProfiler.reset();
-		gPhaseProfilers->longTermPhaseProfiler.reset();
-		gPhaseProfilers->midTermPhaseProfiler.reset();
-		gPhaseProfilers->shortTermPhaseProfiler.reset();
-		gPhaseProfilers->perceptivePhaseProfiler.reset();
-		gPhaseProfilers->predictivePhaseProfiler.reset();
-		gPhaseProfilers->reactivePhaseProfiler.reset();
-		gPhaseProfilers->steeringPhaseProfiler.reset();
+		_context.phaseProfilers->aiProfiler.reset();
+		_context.phaseProfilers->longTermPhaseProfiler.reset();
+		_context.phaseProfilers->midTermPhaseProfiler.reset();
+		_context.phaseProfilers->shortTermPhaseProfiler.reset();
+		_context.phaseProfilers->perceptivePhaseProfiler.reset();
+		_context.phaseProfilers->predictivePhaseProfiler.reset();
+		_context.phaseProfilers->reactivePhaseProfiler.reset();
+		_context.phaseProfilers->steeringPhaseProfiler.reset();
 	}
 
 }
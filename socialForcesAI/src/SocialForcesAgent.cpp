@@ -7,6 +7,7 @@
 //
 
 
+#include <algorithm>
 #include "SocialForcesAgent.h"
 #include "SocialForcesAIModule.h"
 #include "SocialForces_Parameters.h"
@@ -35,20 +36,10 @@ using namespace SteerLib;
 // #define _DEBUG_ENTROPY 1
 
 
-SocialForcesAgent::SocialForcesAgent()
+SocialForcesAgent::SocialForcesAgent(SocialForcesAIModule * module)
 {
-	_SocialForcesParams.sf_acceleration = sf_acceleration;
-	_SocialForcesParams.sf_personal_space_threshold = sf_personal_space_threshold;
-	_SocialForcesParams.sf_agent_repulsion_importance = sf_agent_repulsion_importance;
-	_SocialForcesParams.sf_query_radius = sf_query_radius;
-	_SocialForcesParams.sf_body_force = sf_body_force;
-	_SocialForcesParams.sf_agent_body_force = sf_agent_body_force;
-	_SocialForcesParams.sf_sliding_friction_force = sf_sliding_friction_force;
-	_SocialForcesParams.sf_agent_b = sf_agent_b;
-	_SocialForcesParams.sf_agent_a = sf_agent_a;
-	_SocialForcesParams.sf_wall_b = sf_wall_b;
-	_SocialForcesParams.sf_wall_a = sf_wall_a;
-	_SocialForcesParams.sf_max_speed = sf_max_speed;
+	_context = module->getContext();
+	_SocialForcesParams = _context->parameters;
 
 	_enabled = false;
 }
@@ -74,13 +65,54 @@ void SocialForcesAgent::disable()
 
 	//  1. remove from database
 	AxisAlignedBox b = AxisAlignedBox(_position.x - _radius, _position.x + _radius, 0.0f, 0.0f, _position.z - _radius, _position.z + _radius);
-	gSpatialDatabase->removeObject(dynamic_cast<SpatialDatabaseItemPtr>(this), b);
+	_context->spatialDatabase->removeObject(dynamic_cast<SpatialDatabaseItemPtr>(this), b);
 
 	//  2. set enabled = false
 	_enabled = false;
 }
 
 
+// the parameters are not stored; they come from the module options and the agent's initial conditions, so that a restored simulation can continue with different parameters.
+void SocialForcesAgent::writeCheckpoint(SteerLib::CheckpointWriter & out)
+{
+	out.write(_enabled);
+	out.write(_position);
+	out.write(_velocity);
+	out.write(_forward);
+	out.write(_prefVelocity);
+	out.write(_newVelocity);
+	out.write(_newPosition);
+	out.write(_color);
+	out.write(_radius);
+	out.writeGoalQueue(_goalQueue);
+	out.write((unsigned long long)id_);
+	out.writeVector(_waypoints);
+	out.writeVector(_midTermPath);
+	out.write(_currentLocalTarget);
+}
+
+
+void SocialForcesAgent::readCheckpoint(SteerLib::CheckpointReader & in)
+{
+	unsigned long long id;
+	in.read(_enabled);
+	in.read(_position);
+	in.read(_velocity);
+	in.read(_forward);
+	in.read(_prefVelocity);
+	in.read(_newVelocity);
+	in.read(_newPosition);
+	in.read(_color);
+	in.read(_radius);
+	in.readGoalQueue(_goalQueue);
+	in.read(id);
+	id_ = (size_t)id;
+	in.readVector(_waypoints);
+	in.readVector(_midTermPath);
+	in.read(_currentLocalTarget);
+}
+
+
 void SocialForcesAgent::reset(const SteerLib::AgentInitialConditions & initialConditions, SteerLib::EngineInterface * engineInfo)
 {
 	// compute the "old" bounding box of the agent before it is reset.  its OK that it will be invalid if the agent was previously disabled
@@ -119,14 +151,14 @@ void SocialForcesAgent::reset(const SteerLib::AgentInitialConditions & initialCo
 	if (!_enabled) {
 		// if the agent was not enabled, then it does not already exist in the database, so add it.
 		// std::cout
-		gSpatialDatabase->addObject(dynamic_cast<SpatialDatabaseItemPtr>(this), newBounds);
+		_context->spatialDatabase->addObject(dynamic_cast<SpatialDatabaseItemPtr>(this), newBounds);
 	}
 	else {
 		// if the agent was enabled, then the agent already existed in the database, so update it instead of adding it.
 		// std::cout << "new position is " << _position << std::endl;
 		// std::cout << "new bounds are " << newBounds << std::endl;
 		// std::cout << "reset update " << this << std::endl;
-		gSpatialDatabase->updateObject(dynamic_cast<SpatialDatabaseItemPtr>(this), oldBounds, newBounds);
+		_context->spatialDatabase->updateObject(dynamic_cast<SpatialDatabaseItemPtr>(this), oldBounds, newBounds);
 		// engineInfo->getSpatialDatabase()->updateObject( this, oldBounds, newBounds);
 	}
 
@@ -152,7 +184,7 @@ void SocialForcesAgent::reset(const SteerLib::AgentInitialConditions & initialCo
 			{
 				// if the goal is random, we must randomly generate the goal.
 				// std::cout << "assigning random goal" << std::endl;
-				_goalQueue.back().targetLocation = gSpatialDatabase->randomPositionWithoutCollisions(1.0f, true);
+				_goalQueue.back().targetLocation = _context->spatialDatabase->randomPositionWithoutCollisions(1.0f, true, engineInfo->getRandomStream(this));
 			}
 		}
 		else {
@@ -200,7 +232,7 @@ void SocialForcesAgent::reset(const SteerLib::AgentInitialConditions & initialCo
 #endif
 
 	// std::cout << "Parameter spec: " << _SocialForcesParams << std::endl;
-	// gEngine->addAgent(this, rvoModule);
+	// _context->engine->addAgent(this, rvoModule);
 	assert(_forward.length() != 0.0f);
 	assert(_goalQueue.size() != 0);
 	assert(_radius != 0.0f);
@@ -239,30 +271,22 @@ std::pair<float, Util::Point> minimum_distance(Util::Point l1, Util::Point l2, U
 Util::Vector SocialForcesAgent::calcProximityForce(float dt)
 {
 	Util::Vector agent_repulsion_force = Util::Vector(0, 0, 0);
-	std::set<SteerLib::SpatialDatabaseItemPtr> _neighbors;
-	SteerLib::AgentInterface *tmp_agent;
 	SteerLib::ObstacleInterface *tmp_ob;
 	Util::Vector away = Util::Vector(0, 0, 0);
 	Util::Vector away_obs = Util::Vector(0, 0, 0);
 
-	gSpatialDatabase->getItemsInRange(_neighbors,
-		_position.x - (this->_radius + _SocialForcesParams.sf_query_radius),
-		_position.x + (this->_radius + _SocialForcesParams.sf_query_radius),
-		_position.z - (this->_radius + _SocialForcesParams.sf_query_radius),
-		_position.z + (this->_radius + _SocialForcesParams.sf_query_radius),
-		dynamic_cast<SteerLib::SpatialDatabaseItemPtr>(this));
-
+	getNeighborsInOrder(_neighbors);
 
-	for (std::set<SteerLib::SpatialDatabaseItemPtr>::iterator neighbor = _neighbors.begin(); neighbor != _neighbors.end(); neighbor++)
+	for (std::vector<SteerLib::SpatialDatabaseItemPtr>::iterator neighbor = _neighbors.begin(); neighbor != _neighbors.end(); neighbor++)
 	{
 		if ((*neighbor)->isAgent())
 		{
-			tmp_agent = dynamic_cast<SteerLib::AgentInterface *>(*neighbor);
-			Util::Vector away_tmp = normalize(position() - tmp_agent->position());
+			SteerLib::FrozenAgentState tmp_agent = getFrozenState(dynamic_cast<SteerLib::AgentInterface *>(*neighbor));
+			Util::Vector away_tmp = normalize(position() - tmp_agent.position);
 
 			float Ai = _SocialForcesParams.sf_agent_a;
-			float Rij = this->radius() + tmp_agent->radius();
-			float Dij = (this->position() - tmp_agent->position()).length();
+			float Rij = this->radius() + tmp_agent.radius;
+			float Dij = (this->position() - tmp_agent.position).length();
 			float Bi = _SocialForcesParams.sf_agent_b;
 
 			away = away + (away_tmp * (Ai * exp((Rij - Dij) / Bi)));
@@ -325,29 +349,27 @@ Util::Vector SocialForcesAgent::calcRepulsionForce(float dt)
 Util::Vector SocialForcesAgent::calcAgentRepulsionForce(float dt)
 {
 	Util::Vector agent_repulsion_force = Util::Vector(0, 0, 0);
-	std::set<SteerLib::SpatialDatabaseItemPtr> _neighbors;
 	SteerLib::AgentInterface *tmp_agent;
 
-	gSpatialDatabase->getItemsInRange(_neighbors,
-		_position.x - (this->_radius + _SocialForcesParams.sf_query_radius),
-		_position.x + (this->_radius + _SocialForcesParams.sf_query_radius),
-		_position.z - (this->_radius + _SocialForcesParams.sf_query_radius),
-		_position.z + (this->_radius + _SocialForcesParams.sf_query_radius),
-		dynamic_cast<SteerLib::SpatialDatabaseItemPtr>(this));
+	// only touching agents push, and their centers are no farther than this radius plus the largest radius of any agent.
+	const SteerLib::AgentStateSnapshot & snapshot = _context->engine->getAgentStateSnapshot();
+	float contactDistance = (snapshot.getNumAgents() != 0) ? (this->_radius + snapshot.getMaxRadius()) : (this->_radius + _SocialForcesParams.sf_query_radius);
+	getNearestNeighborsInOrder(_neighbors, SteerLib::NEIGHBOR_FILTER_AGENTS, contactDistance);
 
-
-	for (std::set<SteerLib::SpatialDatabaseItemPtr>::iterator neighbor = _neighbors.begin(); neighbor != _neighbors.end(); neighbor++) {
+	for (std::vector<SteerLib::SpatialDatabaseItemPtr>::iterator neighbor = _neighbors.begin(); neighbor != _neighbors.end(); neighbor++) {
 		if ((*neighbor)->isAgent()) {
 			tmp_agent = dynamic_cast<SteerLib::AgentInterface *>(*neighbor);
+			SteerLib::FrozenAgentState tmp_state = getFrozenState(tmp_agent);
+			float penetration = Util::computeCircleCirclePenetration2D(tmp_state.position, tmp_state.radius, this->position(), this->radius());
 
 			if (id() != tmp_agent->id() &&
-				(tmp_agent->computePenetration(this->position(), this->radius()) > 0.000001)
+				(penetration > 0.000001)
 				) {
 				agent_repulsion_force = agent_repulsion_force +
-					(tmp_agent->computePenetration(this->position(), this->radius()) *
+					(penetration *
 						_SocialForcesParams.sf_agent_body_force * dt
 						) *
-					normalize(position() - tmp_agent->position());
+					normalize(position() - tmp_state.position);
 			}
 		}
 		else {
@@ -362,18 +384,12 @@ Util::Vector SocialForcesAgent::calcAgentRepulsionForce(float dt)
 Util::Vector SocialForcesAgent::calcWallRepulsionForce(float dt)
 {
 	Util::Vector wall_repulsion_force = Util::Vector(0, 0, 0);
-	std::set<SteerLib::SpatialDatabaseItemPtr> _neighbors;
 	SteerLib::ObstacleInterface *tmp_ob = NULL;
 
-	gSpatialDatabase->getItemsInRange(_neighbors,
-		_position.x - (this->_radius + _SocialForcesParams.sf_query_radius),
-		_position.x + (this->_radius + _SocialForcesParams.sf_query_radius),
-		_position.z - (this->_radius + _SocialForcesParams.sf_query_radius),
-		_position.z + (this->_radius + _SocialForcesParams.sf_query_radius),
-		dynamic_cast<SteerLib::SpatialDatabaseItemPtr>(this));
-
+	// only obstacles the agent overlaps push it.
+	getNearestNeighborsInOrder(_neighbors, SteerLib::NEIGHBOR_FILTER_OBSTACLES, this->_radius);
 
-	for (std::set<SteerLib::SpatialDatabaseItemPtr>::iterator neighbor = _neighbors.begin(); neighbor != _neighbors.end(); neighbor++) {
+	for (std::vector<SteerLib::SpatialDatabaseItemPtr>::iterator neighbor = _neighbors.begin(); neighbor != _neighbors.end(); neighbor++) {
 		if (!(*neighbor)->isAgent()) {
 			tmp_ob = dynamic_cast<SteerLib::ObstacleInterface *>(*neighbor);
 
@@ -405,6 +421,100 @@ Util::Vector SocialForcesAgent::calcWallRepulsionForce(float dt)
 }
 
 
+bool SocialForcesAgent::OrderedNeighbor::operator<(const OrderedNeighbor & other) const
+{
+	if (kind != other.kind) return kind < other.kind;
+	if (kind != 2) return index < other.index;
+	if (bounds.xmin != other.bounds.xmin) return bounds.xmin < other.bounds.xmin;
+	if (bounds.zmin != other.bounds.zmin) return bounds.zmin < other.bounds.zmin;
+	if (bounds.xmax != other.bounds.xmax) return bounds.xmax < other.bounds.xmax;
+	if (bounds.zmax != other.bounds.zmax) return bounds.zmax < other.bounds.zmax;
+	// obstacles with the same bounds push the agent the same way, so their order does not change the result.
+	return item < other.item;
+}
+
+
+/**
+* The grid database returns neighbors in the order of its cell slots, which depends on the order
+* agents happened to move in; summing forces in that order makes results differ slightly between
+* identical runs.
+*/
+void SocialForcesAgent::getNeighborsInOrder(std::vector<SteerLib::SpatialDatabaseItemPtr> & neighbors)
+{
+	_context->spatialDatabase->getItemsInRange(neighbors,
+		_position.x - (this->_radius + _SocialForcesParams.sf_query_radius),
+		_position.x + (this->_radius + _SocialForcesParams.sf_query_radius),
+		_position.z - (this->_radius + _SocialForcesParams.sf_query_radius),
+		_position.z + (this->_radius + _SocialForcesParams.sf_query_radius),
+		dynamic_cast<SteerLib::SpatialDatabaseItemPtr>(this));
+
+	sortNeighbors(neighbors);
+}
+
+
+void SocialForcesAgent::getNearestNeighborsInOrder(std::vector<SteerLib::SpatialDatabaseItemPtr> & neighbors, SteerLib::NeighborFilterEnum filter, float maxDistance)
+{
+	_context->spatialDatabase->getKNearestNeighbors(_nearestNeighbors, _position, (unsigned int)-1, maxDistance,
+		dynamic_cast<SteerLib::SpatialDatabaseItemPtr>(this), filter);
+
+	neighbors.clear();
+	for (unsigned int i=0; i < _nearestNeighbors.size(); i++) {
+		neighbors.push_back(_nearestNeighbors[i].item);
+	}
+
+	// closest first is not a repeatable order when distances tie, or when other agents are moving.
+	sortNeighbors(neighbors);
+}
+
+
+void SocialForcesAgent::sortNeighbors(std::vector<SteerLib::SpatialDatabaseItemPtr> & neighbors)
+{
+	const SteerLib::AgentStateSnapshot & snapshot = _context->engine->getAgentStateSnapshot();
+
+	_orderedNeighbors.resize(neighbors.size());
+	for (unsigned int i=0; i < neighbors.size(); i++) {
+		OrderedNeighbor & ordered = _orderedNeighbors[i];
+		ordered.item = neighbors[i];
+		if (neighbors[i]->isAgent()) {
+			SteerLib::AgentInterface * agent = dynamic_cast<SteerLib::AgentInterface*>(neighbors[i]);
+			const SteerLib::FrozenAgentState * state = snapshot.getState(agent);
+			ordered.kind = (state != NULL) ? 0 : 1;
+			ordered.index = (state != NULL) ? state->index : _context->engine->getAgentHandle(agent).index;
+		}
+		else {
+			ordered.kind = 2;
+			ordered.index = 0;
+			ordered.bounds = dynamic_cast<SteerLib::ObstacleInterface*>(neighbors[i])->getBounds();
+		}
+	}
+
+	std::sort(_orderedNeighbors.begin(), _orderedNeighbors.end());
+	for (unsigned int i=0; i < neighbors.size(); i++) {
+		neighbors[i] = _orderedNeighbors[i].item;
+	}
+}
+
+
+SteerLib::FrozenAgentState SocialForcesAgent::getFrozenState(SteerLib::AgentInterface * agent)
+{
+	const SteerLib::FrozenAgentState * state = _context->engine->getAgentStateSnapshot().getState(agent);
+	if (state != NULL)
+	{
+		return *state;
+	}
+
+	// not captured (e.g. updateAI() called outside of the engine), so the live state is the best we have.
+	SteerLib::FrozenAgentState liveState;
+	liveState.position = agent->position();
+	liveState.forward = agent->forward();
+	liveState.velocity = agent->velocity();
+	liveState.radius = agent->radius();
+	liveState.enabled = agent->enabled();
+	liveState.index = 0;
+	return liveState;
+}
+
+
 std::pair<Util::Point, Util::Point> SocialForcesAgent::calcWallPointsFromNormal(SteerLib::ObstacleInterface* obs, Util::Vector normal)
 {
 	Util::AxisAlignedBox box = obs->getBounds();
@@ -575,23 +685,35 @@ bool SocialForcesAgent::hasLineOfSightTo(Util::Point target)
 	lineOfSightTestRight.initWithUnitInterval(_position + _radius*_rightSide, target - _position);
 	lineOfSightTestLeft.initWithUnitInterval(_position + _radius*(_rightSide), target - _position);
 
-	return (!gSpatialDatabase->trace(lineOfSightTestRight, dummyt, dummyObject, dynamic_cast<SpatialDatabaseItemPtr>(this), true))
-		&& (!gSpatialDatabase->trace(lineOfSightTestLeft, dummyt, dummyObject, dynamic_cast<SpatialDatabaseItemPtr>(this), true));
+	return (!_context->spatialDatabase->trace(lineOfSightTestRight, dummyt, dummyObject, dynamic_cast<SpatialDatabaseItemPtr>(this), true))
+		&& (!_context->spatialDatabase->trace(lineOfSightTestLeft, dummyt, dummyObject, dynamic_cast<SpatialDatabaseItemPtr>(this), true));
 
 }
 
 
 void SocialForcesAgent::updateAI(float timeStamp, float dt, unsigned int frameNumber)
+{
+	decideAI(timeStamp, dt, frameNumber);
+	if (enabled())
+	{
+		commitAI(timeStamp, dt, frameNumber);
+	}
+}
+
+
+/**
+* Computes the new velocity and position from the other agents' state at the start of the frame.
+* Only this agent's private planning state is changed here; everything others can see changes in commitAI().
+*/
+void SocialForcesAgent::decideAI(float timeStamp, float dt, unsigned int frameNumber)
 {
 	// std::cout << "_SocialForcesParams.rvo_max_speed " << _SocialForcesParams._SocialForcesParams.rvo_max_speed << std::endl;
-	Util::AutomaticFunctionProfiler profileThisFunction(&SocialForcesGlobals::gPhaseProfilers->aiProfiler);
+	Util::AutomaticFunctionProfiler profileThisFunction(&_context->getThreadPhaseProfilers().aiProfiler);
 	if (!enabled())
 	{
 		return;
 	}
 
-	Util::AxisAlignedBox oldBounds(_position.x - _radius, _position.x + _radius, 0.0f, 0.0f, _position.z - _radius, _position.z + _radius);
-
 	SteerLib::AgentGoalInfo goalInfo = _goalQueue.front();
 	Util::Vector goalDirection;
 	if (!_midTermPath.empty() && (!this->hasLineOfSightTo(goalInfo.targetLocation)))
@@ -646,13 +768,28 @@ void SocialForcesAgent::updateAI(float timeStamp, float dt, unsigned int frameNu
 	}
 
 	Util::Vector acceleration = (prefForce + repulsionForce + proximityForce) / AGENT_MASS;
-	_velocity = velocity() + acceleration * dt;
-	_velocity = clamp(velocity(), _SocialForcesParams.sf_max_speed);
-	_velocity.y = 0.0f;
+	_newVelocity = velocity() + acceleration * dt;
+	_newVelocity = clamp(_newVelocity, _SocialForcesParams.sf_max_speed);
+	_newVelocity.y = 0.0f;
 #ifdef _DEBUG_
-	std::cout << "agent" << id() << " speed is " << velocity().length() << std::endl;
+	std::cout << "agent" << id() << " speed is " << _newVelocity.length() << std::endl;
 #endif
-	_position = position() + (velocity() * dt);
+	_newPosition = position() + (_newVelocity * dt);
+}
+
+
+/**
+* Applies the velocity and position chosen by decideAI(), and handles reaching goals.
+*/
+void SocialForcesAgent::commitAI(float timeStamp, float dt, unsigned int frameNumber)
+{
+	Util::AxisAlignedBox oldBounds(_position.x - _radius, _position.x + _radius, 0.0f, 0.0f, _position.z - _radius, _position.z + _radius);
+
+	SteerLib::AgentGoalInfo goalInfo = _goalQueue.front();
+	Util::Vector goalDirection;
+
+	_velocity = _newVelocity;
+	_position = _newPosition;
 	// A grid database update should always be done right after the new position of the agent is calculated
 	/*
 	* Or when the agent is removed for example its true location will not reflect its location in the grid database.
@@ -661,7 +798,7 @@ void SocialForcesAgent::updateAI(float timeStamp, float dt, unsigned int frameNu
 	*/
 	// std::cout << "Updating agent" << this->id() << " at " << this->position() << std::endl;
 	Util::AxisAlignedBox newBounds(_position.x - _radius, _position.x + _radius, 0.0f, 0.0f, _position.z - _radius, _position.z + _radius);
-	gSpatialDatabase->updateObject(this, oldBounds, newBounds);
+	_context->spatialDatabase->updateObject(this, oldBounds, newBounds);
 
 	/*
 	if ( ( !_waypoints.empty() ) && (_waypoints.front() - position()).length() < radius()*WAYPOINT_THRESHOLD_MULTIPLIER)
@@ -773,7 +910,7 @@ bool SocialForcesAgent::runLongTermPlanning()
 	std::vector<Util::Point> agentPath;
 	Util::Point pos = position();
 
-	if (!gSpatialDatabase->findPath(pos, _goalQueue.front().targetLocation,
+	if (!_context->spatialDatabase->findPath(pos, _goalQueue.front().targetLocation,
 		agentPath, (unsigned int)50000))
 	{
 		return false;
@@ -803,13 +940,13 @@ bool SocialForcesAgent::runLongTermPlanning2()
 	// run the main a-star search here
 	std::vector<Util::Point> agentPath;
 	Util::Point pos = position();
-	if (gEngine->isAgentSelected(this))
+	if (_context->engine->isAgentSelected(this))
 	{
 		// std::cout << "agent" << this->id() << " is running planning again" << std::endl;
 	}
 
-	if (!gSpatialDatabase->findSmoothPath(pos, _goalQueue.front().targetLocation,
-		agentPath, (unsigned int)50000))
+	if (!_context->spatialDatabase->findSmoothPath(pos, _goalQueue.front().targetLocation,
+		agentPath, (unsigned int)50000, &_context->engine->getFrameArena()))
 	{
 		return false;
 	}
@@ -832,14 +969,14 @@ void SocialForcesAgent::draw()
 {
 #ifdef ENABLE_GUI
 	// if the agent is selected, do some annotations just for demonstration
-	if (gEngine->isAgentSelected(this))
+	if (_context->engine->isAgentSelected(this))
 	{
 		Util::Ray ray;
 		ray.initWithUnitInterval(_position, _forward);
 		float t = 0.0f;
 		SteerLib::SpatialDatabaseItem * objectFound;
 		Util::DrawLib::drawLine(ray.pos, ray.eval(1.0f));
-		if (gSpatialDatabase->trace(ray, t, objectFound, this, false))
+		if (_context->spatialDatabase->trace(ray, t, objectFound, this, false))
 		{
 			Util::DrawLib::drawAgentDisc(_position, _forward, _radius, Util::gBlue);
 		}
@@ -873,7 +1010,7 @@ void SocialForcesAgent::draw()
 
 #ifdef DRAW_COLLISIONS
 	std::set<SteerLib::SpatialDatabaseItemPtr> _neighbors;
-	gSpatialDatabase->getItemsInRange(_neighbors, _position.x - (this->_radius * 3), _position.x + (this->_radius * 3),
+	_context->spatialDatabase->getItemsInRange(_neighbors, _position.x - (this->_radius * 3), _position.x + (this->_radius * 3),
 		_position.z - (this->_radius * 3), _position.z + (this->_radius * 3), dynamic_cast<SteerLib::SpatialDatabaseItemPtr>(this));
 
 	for (std::set<SteerLib::SpatialDatabaseItemPtr>::iterator neighbor = _neighbors.begin(); neighbor != _neighbors.end(); neighbor++)
@@ -913,7 +1050,7 @@ void SocialForcesAgent::draw()
 
 	for (int i = 0; (_waypoints.size() > 1) && (i < (_waypoints.size() - 1)); i++)
 	{
-		if (gEngine->isAgentSelected(this))
+		if (_context->engine->isAgentSelected(this))
 		{
 			DrawLib::drawLine(_waypoints.at(i), _waypoints.at(i + 1), gYellow);
 		}
@@ -930,7 +1067,7 @@ void SocialForcesAgent::draw()
 
 	for (int i = 0; (_midTermPath.size() > 1) && (i < (_midTermPath.size() - 1)); i++)
 	{
-		if (gEngine->isAgentSelected(this))
+		if (_context->engine->isAgentSelected(this))
 		{
 			DrawLib::drawLine(_midTermPath.at(i), _midTermPath.at(i + 1), gMagenta);
 		}
@@ -945,7 +1082,7 @@ void SocialForcesAgent::draw()
 
 	/*
 	// draw normals and closest points on walls
-	std::set<SteerLib::ObstacleInterface * > tmp_obs = gEngine->getObstacles();
+	std::set<SteerLib::ObstacleInterface * > tmp_obs = _context->engine->getObstacles();
 
 	for (std::set<SteerLib::ObstacleInterface * >::iterator tmp_o = tmp_obs.begin();  tmp_o != tmp_obs.end();  tmp_o++)
 	{
@@ -1044,7 +1181,7 @@ void SocialForcesAgent::draw()
 //
 //	//  1. remove from database
 //	AxisAlignedBox b = AxisAlignedBox(_position.x - _radius, _position.x + _radius, 0.0f, 0.0f, _position.z - _radius, _position.z + _radius);
-//	gSpatialDatabase->removeObject(dynamic_cast<SpatialDatabaseItemPtr>(this), b);
+//	_context->spatialDatabase->removeObject(dynamic_cast<SpatialDatabaseItemPtr>(this), b);
 //
 //	//  2. set enabled = false
 //	_enabled = false;
@@ -1089,14 +1226,14 @@ void SocialForcesAgent::draw()
 //	if (!_enabled) {
 //		// if the agent was not enabled, then it does not already exist in the database, so add it.
 //		// std::cout
-//		gSpatialDatabase->addObject(dynamic_cast<SpatialDatabaseItemPtr>(this), newBounds);
+//		_context->spatialDatabase->addObject(dynamic_cast<SpatialDatabaseItemPtr>(this), newBounds);
 //	}
 //	else {
 //		// if the agent was enabled, then the agent already existed in the database, so update it instead of adding it.
 //		// std::cout << "new position is " << _position << std::endl;
 //		// std::cout << "new bounds are " << newBounds << std::endl;
 //		// std::cout << "reset update " << this << std::endl;
-//		gSpatialDatabase->updateObject(dynamic_cast<SpatialDatabaseItemPtr>(this), oldBounds, newBounds);
+//		_context->spatialDatabase->updateObject(dynamic_cast<SpatialDatabaseItemPtr>(this), oldBounds, newBounds);
 //		// engineInfo->getSpatialDatabase()->updateObject( this, oldBounds, newBounds);
 //	}
 //
@@ -1122,7 +1259,7 @@ void SocialForcesAgent::draw()
 //			{
 //				// if the goal is random, we must randomly generate the goal.
 //				// std::cout << "assigning random goal" << std::endl;
-//				_goalQueue.back().targetLocation = gSpatialDatabase->randomPositionWithoutCollisions(1.0f, true);
+//				_goalQueue.back().targetLocation = _context->spatialDatabase->randomPositionWithoutCollisions(1.0f, true);
 //			}
 //		}
 //		else {
@@ -1170,7 +1307,7 @@ void SocialForcesAgent::draw()
 //#endif
 //
 //	// std::cout << "Parameter spec: " << _SocialForcesParams << std::endl;
-//	// gEngine->addAgent(this, rvoModule);
+//	// _context->engine->addAgent(this, rvoModule);
 //	assert(_forward.length() != 0.0f);
 //	assert(_goalQueue.size() != 0);
 //	assert(_radius != 0.0f);
@@ -1214,7 +1351,7 @@ void SocialForcesAgent::draw()
 //	Util::Vector awayOb = Util::Vector(0, 0, 0);
 //
 //	std::set<SteerLib::SpatialDatabaseItemPtr> _neighbors;
-//	gSpatialDatabase->getItemsInRange(_neighbors,
+//	_context->spatialDatabase->getItemsInRange(_neighbors,
 //		_position.x - (this->_radius + _SocialForcesParams.sf_query_radius),
 //		_position.x + (this->_radius + _SocialForcesParams.sf_query_radius),
 //		_position.z - (this->_radius + _SocialForcesParams.sf_query_radius),
@@ -1273,7 +1410,7 @@ void SocialForcesAgent::draw()
 //
 //	Util::Vector agent_repulsion_force = Util::Vector(0, 0, 0);
 //	std::set<SteerLib::SpatialDatabaseItemPtr> _neighbors;
-//	gSpatialDatabase->getItemsInRange(_neighbors,
+//	_context->spatialDatabase->getItemsInRange(_neighbors,
 //		_position.x - (this->_radius + _SocialForcesParams.sf_query_radius),
 //		_position.x + (this->_radius + _SocialForcesParams.sf_query_radius),
 //		_position.z - (this->_radius + _SocialForcesParams.sf_query_radius),
@@ -1307,7 +1444,7 @@ void SocialForcesAgent::draw()
 //	Util::Vector wall_repulsion_force = Util::Vector(0, 0, 0);
 //
 //	std::set<SteerLib::SpatialDatabaseItemPtr> _neighbors;
-//	gSpatialDatabase->getItemsInRange(_neighbors,
+//	_context->spatialDatabase->getItemsInRange(_neighbors,
 //		_position.x - (this->_radius + _SocialForcesParams.sf_query_radius),
 //		_position.x + (this->_radius + _SocialForcesParams.sf_query_radius),
 //		_position.z - (this->_radius + _SocialForcesParams.sf_query_radius),
@@ -1538,8 +1675,8 @@ void SocialForcesAgent::draw()
 //	lineOfSightTestRight.initWithUnitInterval(_position + _radius*_rightSide, target - _position);
 //	lineOfSightTestLeft.initWithUnitInterval(_position + _radius*(_rightSide), target - _position);
 //
-//	return (!gSpatialDatabase->trace(lineOfSightTestRight, dummyt, dummyObject, dynamic_cast<SpatialDatabaseItemPtr>(this), true))
-//		&& (!gSpatialDatabase->trace(lineOfSightTestLeft, dummyt, dummyObject, dynamic_cast<SpatialDatabaseItemPtr>(this), true));
+//	return (!_context->spatialDatabase->trace(lineOfSightTestRight, dummyt, dummyObject, dynamic_cast<SpatialDatabaseItemPtr>(this), true))
+//		&& (!_context->spatialDatabase->trace(lineOfSightTestLeft, dummyt, dummyObject, dynamic_cast<SpatialDatabaseItemPtr>(this), true));
 //
 //}
 //
@@ -1547,7 +1684,7 @@ void SocialForcesAgent::draw()
 //void SocialForcesAgent::updateAI(float timeStamp, float dt, unsigned int frameNumber)
 //{
 //	// std::cout << "_SocialForcesParams.rvo_max_speed " << _SocialForcesParams._SocialForcesParams.rvo_max_speed << std::endl;
-//	Util::AutomaticFunctionProfiler profileThisFunction(&SocialForcesGlobals::gPhaseProfilers->aiProfiler);
+//	Util::AutomaticFunctionProfiler profileThisFunction(&_context->phaseProfilers->aiProfiler);
 //	if (!enabled())
 //	{
 //		return;
@@ -1624,7 +1761,7 @@ void SocialForcesAgent::draw()
 //	*/
 //	// std::cout << "Updating agent" << this->id() << " at " << this->position() << std::endl;
 //	Util::AxisAlignedBox newBounds(_position.x - _radius, _position.x + _radius, 0.0f, 0.0f, _position.z - _radius, _position.z + _radius);
-//	gSpatialDatabase->updateObject(this, oldBounds, newBounds);
+//	_context->spatialDatabase->updateObject(this, oldBounds, newBounds);
 //
 //	/*
 //	if ( ( !_waypoints.empty() ) && (_waypoints.front() - position()).length() < radius()*WAYPOINT_THRESHOLD_MULTIPLIER)
@@ -1736,7 +1873,7 @@ void SocialForcesAgent::draw()
 //	std::vector<Util::Point> agentPath;
 //	Util::Point pos = position();
 //
-//	if (!gSpatialDatabase->findPath(pos, _goalQueue.front().targetLocation,
+//	if (!_context->spatialDatabase->findPath(pos, _goalQueue.front().targetLocation,
 //		agentPath, (unsigned int)50000))
 //	{
 //		return false;
@@ -1766,12 +1903,12 @@ void SocialForcesAgent::draw()
 //	// run the main a-star search here
 //	std::vector<Util::Point> agentPath;
 //	Util::Point pos = position();
-//	if (gEngine->isAgentSelected(this))
+//	if (_context->engine->isAgentSelected(this))
 //	{
 //		// std::cout << "agent" << this->id() << " is running planning again" << std::endl;
 //	}
 //
-//	if (!gSpatialDatabase->findSmoothPath(pos, _goalQueue.front().targetLocation,
+//	if (!_context->spatialDatabase->findSmoothPath(pos, _goalQueue.front().targetLocation,
 //		agentPath, (unsigned int)50000))
 //	{
 //		return false;
@@ -1795,14 +1932,14 @@ void SocialForcesAgent::draw()
 //{
 //#ifdef ENABLE_GUI
 //	// if the agent is selected, do some annotations just for demonstration
-//	if (gEngine->isAgentSelected(this))
+//	if (_context->engine->isAgentSelected(this))
 //	{
 //		Util::Ray ray;
 //		ray.initWithUnitInterval(_position, _forward);
 //		float t = 0.0f;
 //		SteerLib::SpatialDatabaseItem * objectFound;
 //		Util::DrawLib::drawLine(ray.pos, ray.eval(1.0f));
-//		if (gSpatialDatabase->trace(ray, t, objectFound, this, false))
+//		if (_context->spatialDatabase->trace(ray, t, objectFound, this, false))
 //		{
 //			Util::DrawLib::drawAgentDisc(_position, _forward, _radius, Util::gBlue);
 //		}
@@ -1836,7 +1973,7 @@ void SocialForcesAgent::draw()
 //
 //#ifdef DRAW_COLLISIONS
 //	std::set<SteerLib::SpatialDatabaseItemPtr> _neighbors;
-//	gSpatialDatabase->getItemsInRange(_neighbors, _position.x - (this->_radius * 3), _position.x + (this->_radius * 3),
+//	_context->spatialDatabase->getItemsInRange(_neighbors, _position.x - (this->_radius * 3), _position.x + (this->_radius * 3),
 //		_position.z - (this->_radius * 3), _position.z + (this->_radius * 3), dynamic_cast<SteerLib::SpatialDatabaseItemPtr>(this));
 //
 //	for (std::set<SteerLib::SpatialDatabaseItemPtr>::iterator neighbor = _neighbors.begin(); neighbor != _neighbors.end(); neighbor++)
@@ -1876,7 +2013,7 @@ void SocialForcesAgent::draw()
 //
 //	for (int i = 0; (_waypoints.size() > 1) && (i < (_waypoints.size() - 1)); i++)
 //	{
-//		if (gEngine->isAgentSelected(this))
+//		if (_context->engine->isAgentSelected(this))
 //		{
 //			DrawLib::drawLine(_waypoints.at(i), _waypoints.at(i + 1), gYellow);
 //		}
@@ -1893,7 +2030,7 @@ void SocialForcesAgent::draw()
 //
 //	for (int i = 0; (_midTermPath.size() > 1) && (i < (_midTermPath.size() - 1)); i++)
 //	{
-//		if (gEngine->isAgentSelected(this))
+//		if (_context->engine->isAgentSelected(this))
 //		{
 //			DrawLib::drawLine(_midTermPath.at(i), _midTermPath.at(i + 1), gMagenta);
 //		}
@@ -1908,7 +2045,7 @@ void SocialForcesAgent::draw()
 //
 //	/*
 //	// draw normals and closest points on walls
-//	std::set<SteerLib::ObstacleInterface * > tmp_obs = gEngine->getObstacles();
+//	std::set<SteerLib::ObstacleInterface * > tmp_obs = _context->engine->getObstacles();
 //
 //	for (std::set<SteerLib::ObstacleInterface * >::iterator tmp_o = tmp_obs.begin();  tmp_o != tmp_obs.end();  tmp_o++)
 //	{
@@ -36,8 +36,15 @@
 
 #include "planning/BestFirstSearchPlanner.h"
 
+#include "simulation/AgentPool.h"
+#include "simulation/AgentRegistry.h"
+#include "simulation/AgentStateSnapshot.h"
 #include "simulation/Camera.h"
+#include "simulation/Checkpoint.h"
 #include "simulation/Clock.h"
+#include "simulation/MultiRateScheduler.h"
+#include "simulation/DeferredWorkQueue.h"
+#include "simulation/FrameTelemetry.h"
 #include "simulation/SimulationOptions.h"
 #include "simulation/SimulationEngine.h"
 #include "simulation/SteeringCommand.h"
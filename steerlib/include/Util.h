@@ -23,6 +23,7 @@
 #include "util/PerformanceProfiler.h"
 #include "util/StateMachine.h"
 #include "util/ThreadedTaskManager.h"
+#include "util/WorkStealingScheduler.h"
 #include "util/XMLParser.h"
 
 
@@ -23,6 +23,7 @@
 #include "recfileio/RecFileIO.h"
 #include "benchmarking/MetricsData.h"
 #include "interfaces/AgentInterface.h"
+#include "simulation/Checkpoint.h"
 
 #define ANGULAR_PRIORITY 1.0f
 
@@ -77,6 +78,14 @@ namespace SteerLib {
 	    unsigned int getNumThresholdedCollisions(float penetrationThreshold, float timeDurationThreshold); // implemented in .cpp
 		//@}
 	    
+		/// @name checkpoints
+		//@{
+		/// Writes the metrics, their history windows and the collisions into a checkpoint.
+		void writeCheckpoint(SteerLib::CheckpointWriter & out);
+		/// Restores the state written by writeCheckpoint(); the collector keeps the agent it was created for.
+		void readCheckpoint(SteerLib::CheckpointReader & in);
+		//@}
+
 	    /// dumps formatted console output with information of all current statistics.
 	    void printFormattedCurrentStatistics(std::ostream & out);
 		void printFormattedOverallStatistics(std::ostream & out);
@@ -48,6 +48,11 @@ namespace SteerLib {
 
 		void printCurrentMetrics(unsigned int agentIndex, std::ostream & out);
 
+		/// Writes the metrics of all agents into a checkpoint.
+		void writeCheckpoint(SteerLib::CheckpointWriter & out);
+		/// Restores the metrics written by writeCheckpoint(), for the same agents in the same order.
+		void readCheckpoint(SteerLib::CheckpointReader & in);
+
 	protected:
 	    void _resetEnvironmentMetrics();
 	    void _updateAgentMetrics(SteerLib::GridDatabase2D * gridDB, const std::vector<SteerLib::AgentInterface*> & updatedAgents, float currentTimeStamp, float timePassedSinceLastFrame);
@@ -16,6 +16,7 @@
 #include "util/Mutex.h"
 // #include "interfaces/AgentInterface.h"
 #include <sstream>
+#include <vector>
 
 #ifdef _WIN32
 // on win32, there is an unfortunate conflict between exporting symbols for a
@@ -32,6 +33,26 @@ namespace SteerLib {
 	class STEERLIB_API SpatialDatabaseItem;
 	typedef SpatialDatabaseItem* SpatialDatabaseItemPtr;
 
+	/**
+	 * @brief One object referenced by a GridCell, with a copy of the bounds it was added with.
+	 *
+	 * Queries filter objects by their bounds (distance, visual field, k-nearest neighbors) using this copy,
+	 * so that they only touch the objects that pass.  The copy is updated every time the object is updated
+	 * in the database.  Agents are added with the square around their circle, so centerX(), centerZ() and
+	 * radius() are the agent's position and radius as of its last update; whether an object is an agent
+	 * is known from the layer of the grid database it is in.
+	 */
+	struct GridCellEntry {
+		SpatialDatabaseItemPtr item;
+		float xmin, xmax, zmin, zmax;
+		/// The first grid cell the object overlaps; queries over a range of cells report the object only in the first cell of the range that it overlaps.
+		unsigned int xMinIndex, zMinIndex;
+
+		inline float centerX() const { return 0.5f * (xmin + xmax); }
+		inline float centerZ() const { return 0.5f * (zmin + zmax); }
+		inline float radius() const { return 0.5f * (xmax - xmin); }
+	};
+
 	/**
 	 * @brief A single grid cell of the GridDatabase2D spatial database.
 	 *
@@ -39,6 +60,11 @@ namespace SteerLib {
 	 * The cell contains a list of pointers of SpatialDatabaseItem objects that 
 	 * overlap the cell.
 	 *
+	 * The items are kept packed at the front of the list, so iterating over a cell only visits the items
+	 * it actually holds: getItem(i) for i from 0 to getNumItems()-1.  The first items are stored in a small
+	 * fixed array that the grid database allocates for all cells together; when a cell holds more items
+	 * than that (e.g. in a dense crowd), the rest go to an overflow list that the cell allocates on demand.
+	 *
 	 * Most users should not need to use this class at all, the GridDatabase2D is the main 
 	 * public interface for using the spatial database functionality.
 	 *
@@ -46,47 +72,39 @@ namespace SteerLib {
 	class STEERLIB_API GridCell {
 
 	public:
-		void init( unsigned int maxNumItems, SpatialDatabaseItemPtr * localBasePtr, float initialTraversalCost) {
+		GridCell() : _numItems(0), _inlineCapacity(0), _items(NULL), _overflowItems(NULL), _traversalCost(0.0f) { }
+		~GridCell() { delete _overflowItems; }
+
+		void init( unsigned int inlineCapacity, GridCellEntry * localBasePtr, float initialTraversalCost) {
 			_items = localBasePtr;
-			for (unsigned int j=0; j < maxNumItems; j++) {
-				_items[j] = NULL;
-			}
+			_inlineCapacity = inlineCapacity;
 			_numItems = 0; // initialize with no items in the grid cell
+			if (_overflowItems != NULL) {
+				_overflowItems->clear();
+			}
 			_traversalCost = initialTraversalCost;
 		}
 
+		/// Returns the number of items in this cell.
+		inline unsigned int getNumItems() const { return _numItems; }
+		/// Returns item i of this cell, where 0 <= i < getNumItems().
+		inline SpatialDatabaseItemPtr getItem(unsigned int i) const { return getEntry(i).item; }
+		/// Returns item i of this cell with its bounds, where 0 <= i < getNumItems().
+		inline const GridCellEntry & getEntry(unsigned int i) const { return (i < _inlineCapacity) ? _items[i] : (*_overflowItems)[i - _inlineCapacity]; }
+		/// Returns the number of items that did not fit in the fixed array.
+		inline unsigned int getNumOverflowItems() const { return (_numItems > _inlineCapacity) ? (_numItems - _inlineCapacity) : 0; }
+
 		/// Adds an object reference to this cell.
-		inline void add(SpatialDatabaseItemPtr entry, unsigned int maxItems, float traversalCostToAdd) {
+		inline void add(const GridCellEntry & entry, float traversalCostToAdd) {
 
 			_gridCellMutex.lock();
-
-			/** 
-			 * If an exception is thrown in this function, it means, there are too many 
-			 * agents in one grid cell.  If you are certain its not a bug, you can increase 
-			 * the value of numItemsPerCell in the GridDatabase2D constructor, or increase 
-			 * the resolution of the grid. (Note that such changes may affect performance, too.)
-			 */
-
-			if (_numItems >= maxItems)
-			{
-				_gridCellMutex.unlock();
-				std::cout << "The number of items in this cell is:" << _numItems << " The max number of items can be: " << maxItems << std::endl;
-				throw Util::GenericException("There are too many items in a single cell of the grid database.\nIn the next version, this will be handled robstly and not be an error.\nFor now, use a higher number for maxItemsPerGridCell (in the config file), or\nincrease the resolution of the grid (both of which may decrease performance).");
-			}
-			_numItems++;
-			unsigned int i=0;
-			while (_items[i] != NULL) {
-				i++;
-			}
-			_items[i] = entry;
-
+			_append(entry);
 			_traversalCost += traversalCostToAdd;
-
 			_gridCellMutex.unlock();
 		}
 
 		/// Removes an object reference from this cell.
-		inline void remove(SpatialDatabaseItemPtr entry, unsigned int maxItems, float traversalCostToSubtract) {
+		inline void remove(SpatialDatabaseItemPtr entry, float traversalCostToSubtract) {
 
 			_gridCellMutex.lock();
 
@@ -106,14 +124,10 @@ namespace SteerLib {
 				}
 				throw Util::GenericException(errormsg.str());
 			}
-			_numItems--;
-			unsigned int i=0;
-			while ((_items[i] != entry) && (i<maxItems)) i++;
-			if (i >= maxItems) {
+			if (!_remove(entry)) {
 				_gridCellMutex.unlock();
 				throw Util::GenericException("Tried to remove an object from a grid cell, but it did not exist there in the first place.");
 			}
-			_items[i] = NULL;
 
 			_traversalCost -= traversalCostToSubtract;
 
@@ -121,23 +135,94 @@ namespace SteerLib {
 
 		}
 
+		/// Replaces the bounds stored for an object this cell already holds, e.g. after it moved without leaving the cell; the object keeps its place in the cell.
+		inline void refresh(const GridCellEntry & entry) {
+			_gridCellMutex.lock();
+			if (!_refresh(entry)) {
+				_gridCellMutex.unlock();
+				throw Util::GenericException("Tried to refresh an object in a grid cell, but it did not exist there in the first place.");
+			}
+			_gridCellMutex.unlock();
+		}
+
 	private:
 
 		// The grid database is allowed to access the grid cell's private data directly.
 		friend class GridDatabase2D;
 		friend class GridDatabase2DPrivate;
 
+		/// Adds an item at the end of the list, without locking; used by add() and to restore checkpoints.
+		inline void _append(const GridCellEntry & entry) {
+			if (_numItems < _inlineCapacity) {
+				_items[_numItems] = entry;
+			}
+			else {
+				if (_overflowItems == NULL) {
+					_overflowItems = new std::vector<GridCellEntry>();
+				}
+				_overflowItems->push_back(entry);
+			}
+			_numItems++;
+		}
+
+		/// Removes an item without locking; returns false if the cell does not hold it.
+		inline bool _remove(SpatialDatabaseItemPtr item) {
+			unsigned int i=0;
+			while ((i < _numItems) && (getItem(i) != item)) i++;
+			if (i >= _numItems) {
+				return false;
+			}
+
+			// the last item takes the place of the removed one, so that the items stay packed.
+			if (i != _numItems-1) {
+				_setEntry(i, getEntry(_numItems-1));
+			}
+			_numItems--;
+			if (_numItems >= _inlineCapacity) {
+				_overflowItems->pop_back();
+			}
+			return true;
+		}
+
+		/// Overwrites the entry of entry.item without locking; returns false if the cell does not hold it.
+		inline bool _refresh(const GridCellEntry & entry) {
+			for (unsigned int i=0; i < _numItems; i++) {
+				if (getItem(i) == entry.item) {
+					_setEntry(i, entry);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		inline void _setEntry(unsigned int i, const GridCellEntry & entry) {
+			if (i < _inlineCapacity)
+				_items[i] = entry;
+			else
+				(*_overflowItems)[i - _inlineCapacity] = entry;
+		}
+
 		/// The number of items currently referenced in this cell.
 		unsigned int _numItems;
 
-		/// An array of pointers of fixed length; the length is determined during GridDatabase initialization.
-		SpatialDatabaseItemPtr * _items;
+		/// The length of _items; the length is determined during GridDatabase initialization.
+		unsigned int _inlineCapacity;
+
+		/// An array of fixed length, holding the first items of the cell.
+		GridCellEntry * _items;
+
+		/// The items that did not fit in _items, or NULL if the cell never needed more room.
+		std::vector<GridCellEntry> * _overflowItems;
 
 		/// Cost of traversing this grid cell
 		float _traversalCost;
 
 		/// This lock is used by the grid database directly; by itself the grid cell is not necessarily thread safe.
 		Util::Mutex _gridCellMutex;
+
+		// a cell owns its overflow list.
+		GridCell(const GridCell & );  // not implemented, not copyable
+		GridCell & operator= (const GridCell & );  // not implemented, not assignable
 	};
 
 
@@ -12,10 +12,14 @@
 #include <set>
 #include <stack>
 #include <vector>
+#include <functional>
 
 #include "Globals.h"
 #include "griddatabase/GridDatabase2DPrivate.h"
 #include "interfaces/SpatialDatabaseItem.h"
+#include "simulation/Checkpoint.h"
+#include "util/RandomStream.h"
+#include "util/FrameArena.h"
 
 // #define _DEBUG1
 
@@ -24,13 +28,38 @@ class MTRand;
 
 namespace SteerLib {
 
+	/// The layers of GridDatabase2D; queries take a combination of them, and only visit the cells of those layers.
+	enum GridLayerEnum {
+		/// obstacles, and every other object that is not an agent; it normally only changes while a simulation is being set up.
+		GRID_LAYER_STATIC = 1,
+		/// agents, which move every frame.
+		GRID_LAYER_DYNAMIC = 2,
+		GRID_LAYER_ALL = GRID_LAYER_STATIC | GRID_LAYER_DYNAMIC
+	};
+
+	/// Which objects GridDatabase2D::getKNearestNeighbors() considers.
+	enum NeighborFilterEnum {
+		NEIGHBOR_FILTER_ALL,
+		NEIGHBOR_FILTER_AGENTS,
+		NEIGHBOR_FILTER_OBSTACLES
+	};
+
+	/// One result of GridDatabase2D::getKNearestNeighbors().
+	struct NearestNeighbor {
+		SpatialDatabaseItemPtr item;
+		/// the squared distance from the query position to the agent's center, or to the closest point of the obstacle's bounds.
+		float distanceSquared;
+	};
+
 
 	/** 
 	 * @brief A 2-D spatial database, that can contain any objects that inherit the SpatialDatabaseItem interface.
 	 *
 	 * This class is an efficient 2-D spatial database that organizes objects in your environment (i.e., agents or obstacles).
-	 * In particular, this database organizes objects in a 2-D grid, where each cell in the grid contains a fixed
-	 * number of references to objects.
+	 * In particular, this database organizes objects in a 2-D grid, where each cell in the grid contains a list of
+	 * references to objects.  Every cell has two lists, in two separate layers: the static layer holds obstacles and
+	 * all other objects that are not agents, and the dynamic layer holds agents.  Queries take a combination of
+	 * GridLayerEnum values, so that e.g. a ray that ignores agents never visits them.
 	 *
 	 * The database supports four main types of queries:
 	 *  - <b>Updates and basic queries:</b> i.e. adding/removing objects from the database, and querying the basic properties of the database.
@@ -49,23 +78,29 @@ namespace SteerLib {
 	 * Perform queries on the database using the appropriate functionality described in the public interface.
 	 *
 	 * <h3> Notes </h3>
-	 *  - The database implementation is not (yet) thread-safe.
+	 *  - The database implementation is not (yet) thread-safe, except that queries may run concurrently with
+	 *    updates made between #beginDeferredUpdates() and #endDeferredUpdates().
+	 *  - An update that leaves an object in the same cells only refreshes the bounds the cells store for it.  Most
+	 *    moving agents stay in their cells from one frame to the next, so this is the common case.
 	 *  - The grid is located on the x-z plane.
 	 *  - During initialization you separately define (1) the spatial size of the grid, and (2) the 
 	 *    number of cells to create along the x and z directions.
-	 *  - You also define the max number of items to store in each cell.  Trying to storing more than 
-	 *    this number of items in a single grid cell will cause a Util::GenericException to be thrown.
+	 *  - You also define the number of items each cell stores without allocating more memory.  A cell
+	 *    that needs to hold more items allocates an overflow list.
 	 *
 	 * <h3> Performance considerations </h3>
 	 * Algorithmically, all types of queries are fairly efficient, by narrowing the computation cost down to 
 	 * only the cells that overlap your query.  Nearest neighbor queries tend to be the most costly type of 
 	 * query when the radius you are searching covers many grid cells.
 	 *
-	 * The performance of the grid database is sensitive to the value of numItemsPerCell (specified in the 
-	 * constructors).  If it is too large, all queries will perform proportionally slower, and the storage
-	 * cost of the database increases.  If it is too small, there is a risk of too many objects overlapping
-	 * one grid cell, causing an exception.  A similar but less sensitive performance issue to consider is
-	 * how many grid cells to use over the entire database.
+	 * The performance of the grid database is somewhat sensitive to the value of numItemsPerCell (specified in the 
+	 * constructors).  If it is too large, the storage cost of the database increases.  If it is too small, crowded
+	 * cells keep their items in overflow lists, which are slower to update and further away in memory.  A more
+	 * important performance issue to consider is how many grid cells to use over the entire database.
+	 *
+	 * Cells are stored in square tiles of 16x16 cells, and a layer only allocates a tile when an object is added to
+	 * one of its cells, so a large world that is mostly open ground costs memory only where obstacles and agents are.
+	 * #setCellNumbering() can number and store cells in Z-order instead of row by row.
 	 *
 	 * To balance these two points above, we suggest making the size of a grid cell approximately the same
 	 * size as your smallest common objects; this way you can reduce the value of numItemsPerCell (e.g., perhaps around 7).
@@ -75,10 +110,6 @@ namespace SteerLib {
 	 * @see
 	 *  - the SpatialDatabaseItem interface.
 	 *
-	 * @todo
-	 *  - add a "leftover" grid cell that can become arbitrarily large.  The idea being that the database always
-	 *    works with proper semantics, but may not perform well if too many things get leftover.
-	 *
 	 */
 	class STEERLIB_API GridDatabase2D : public GridDatabase2DPrivate {
 	public:
@@ -120,7 +151,26 @@ namespace SteerLib {
 		/// Returns 2-D <b>integer</b> index coordinates of a GridCell indexed by cellIndex.
 		inline void getGridCoordinatesFromIndex(unsigned int cellIndex, unsigned int &xIndex, unsigned int & zIndex);
 		/// Returns the index of the GridCell that is indexed by 2-D integer coordinates (x,z).
-		inline unsigned int getCellIndexFromGridCoords(unsigned int x, unsigned int z) { return (x * _zNumCells) + z; }
+		inline unsigned int getCellIndexFromGridCoords(unsigned int x, unsigned int z) { return (_cellNumbering == CELL_NUMBERING_MORTON) ? mortonEncode2D(x, z) : (x * _zNumCells) + z; }
+		/// Returns one more than the largest cell index, for arrays indexed by cell; with Morton numbering, this is more than the number of cells unless the grid is a square whose size is a power of two.
+		inline unsigned int getCellIndexLimit() { return getCellIndexFromGridCoords(_xNumCells-1, _zNumCells-1) + 1; }
+		/**
+		 * @brief Chooses how cells are numbered, and how they are ordered in memory; must be called before any object is added.
+		 *
+		 * With the default CELL_NUMBERING_ROW_MAJOR, cell (x,z) is number x * numCellsZ + z, so a square of cells lies in
+		 * as many separate strips of memory as it is wide.  With CELL_NUMBERING_MORTON, cells are numbered in Z-order
+		 * (see mortonEncode2D()), and the cells of each tile are stored in that order, so a small square of cells, and the
+		 * cells a ray or a path search steps through, are mostly next to each other.  The grid may then have at most
+		 * MORTON_MAX_NUM_CELLS cells along each axis.  Since the tiles already keep every 16x16 square together, Z-order only
+		 * reorders cells within a tile, and converting indices costs more; row by row is usually faster, so measure first.
+		 *
+		 * Cell indices are only meaningful to the numbering they were made with; code that steps between neighboring cells
+		 * must convert to grid coordinates and back, as the planners do, instead of adding to an index.  Checkpoints do not
+		 * depend on the numbering.
+		 */
+		void setCellNumbering(CellNumberingEnum numbering);
+		/// Returns the numbering set by setCellNumbering().
+		inline CellNumberingEnum getCellNumbering() { return _cellNumbering; }
 		//@}
 
 		/// @name Database update functions
@@ -133,28 +183,152 @@ namespace SteerLib {
 		void updateObject( SpatialDatabaseItemPtr item, const Util::AxisAlignedBox & oldBounds, const Util::AxisAlignedBox & newBounds );
 		//@}
 
+		/// @name Deferred updates
+		/// @brief While deferring, the update functions above only record changes (they may be called from several threads at once), and all queries keep seeing the database as it was when deferring began.
+		//@{
+		/// Starts buffering calls to addObject(), removeObject() and updateObject() instead of applying them.
+		void beginDeferredUpdates();
+		/// Applies the buffered change of one item, if there is one.  Lets the caller choose a deterministic order in which changes are applied.
+		void commitDeferredUpdate( SpatialDatabaseItemPtr item );
+		/// Applies the buffered changes of the given items in one pass, with the same result as calling commitDeferredUpdate() for each of them in order.
+		template < typename ItemPtrType >
+		void commitDeferredUpdates( const std::vector<ItemPtrType> & items ) {
+			_mergeDeferredUpdateBuffers();
+			for (unsigned int i=0; i < items.size(); i++) {
+				_collectDeferredUpdate(items[i]);
+			}
+			_applyDeferredCellChanges();
+		}
+		/// Applies all remaining buffered changes in the order they first arrived, and returns to applying updates immediately.
+		void endDeferredUpdates();
+		/// Returns true if updates are currently being buffered.
+		inline bool isDeferringUpdates() { return _deferringUpdates; }
+		//@}
+
+		/// @name Rebuilding the dynamic layer
+		//@{
+		/**
+		 * @brief Chooses how committed deferred updates of agents are applied.
+		 *
+		 * In a very dense crowd, removing and adding every agent that changed cells costs more than sorting all agents
+		 * into the cells again.  In DYNAMIC_LAYER_REBUILD mode, every commit of deferred updates that moves an agent
+		 * rebuilds the dynamic layer with a counting sort by cell: all entries of the layer are packed into one array,
+		 * cell after cell, and each cell points to its part of that array, so queries read the same GridCell interface.
+		 * The sort is stable, so the result does not depend on the number of threads.  If scheduler is not NULL, the
+		 * counting and scattering run on its threads.
+		 *
+		 * Updates made while not deferring still change the cells one by one; they use the cells' overflow lists
+		 * until the next rebuild packs them again.  The mode cannot change while updates are deferred.
+		 */
+		void setDynamicLayerMode(DynamicLayerModeEnum mode, Util::WorkStealingScheduler * scheduler = NULL);
+		/// Returns the mode set by setDynamicLayerMode().
+		inline DynamicLayerModeEnum getDynamicLayerMode() { return _dynamicLayerMode; }
+		//@}
+
+		/// @name Statistics
+		//@{
+		/// Starts or stops counting how many times an item is added to or removed from the grid cells; the engine counts them for SteerLib::FrameTelemetry.
+		inline void setCountingUpdates(bool counting) { _countingUpdates = counting; }
+		/// Returns the number of additions and removals counted since the last call, and starts counting from zero again.
+		inline unsigned int takeNumItemUpdates() { return _numItemUpdates.exchange(0); }
+		/// Returns the number of grid tiles that exist in the static and dynamic layers together; see GridLayer.
+		unsigned int getNumTilesAllocated();
+		/// Returns the number of bytes the grid cells and the items they hold use, including the tiles and the overflow lists of the cells.
+		size_t getNumBytesAllocated();
+		//@}
+
+		/// @name Checkpointing
+		//@{
+		/// Writes the contents of every grid cell, and the state of the random number generator; every item must have been registered with SteerLib::CheckpointWriter::addItem().
+		void writeCheckpoint(SteerLib::CheckpointWriter & out);
+		/// Replaces the contents of every grid cell with the contents written by writeCheckpoint(); the database must have the same dimensions.
+		void readCheckpoint(SteerLib::CheckpointReader & in);
+		//@}
+
 		/// @name Traversability queries
 		//@{
 		/// Returns true if there are any objects referenced in the GridCell.
-		inline bool hasAnyItems( unsigned int cellIndex ) { return (_cells[cellIndex]._numItems != 0); }
+		inline bool hasAnyItems( unsigned int cellIndex ) { unsigned int x, z; getGridCoordinatesFromIndex(cellIndex, x, z); return hasAnyItems(x, z); }
 		/// Returns true if there are any objects referenced in the GridCell.
-		inline bool hasAnyItems( unsigned int x, unsigned int z ) { return (_cells[getCellIndexFromGridCoords(x,z)]._numItems != 0); }
+		inline bool hasAnyItems( unsigned int x, unsigned int z ) { return (_getCell(_staticLayer, x, z)._numItems != 0) || (_getCell(_dynamicLayer, x, z)._numItems != 0); }
 		/// Returns the sum total of traversal costs of all objects referenced in the GridCell.
-		inline float getTraversalCost( unsigned int cellIndex ) { return _cells[cellIndex]._traversalCost; }
+		inline float getTraversalCost( unsigned int cellIndex ) { unsigned int x, z; getGridCoordinatesFromIndex(cellIndex, x, z); return getTraversalCost(x, z); }
 		/// Returns the sum total of traversal costs of all objects referenced in the GridCell.
-		inline float getTraversalCost( unsigned int x, unsigned int z ) { return _cells[getCellIndexFromGridCoords(x,z)]._traversalCost; }
+		inline float getTraversalCost( unsigned int x, unsigned int z ) { return _getCell(_staticLayer, x, z)._traversalCost + _getCell(_dynamicLayer, x, z)._traversalCost; }
 		//@}
 
 		/// @name Nearest neighbor queries
 		//@{
 		/// Returns an STL set of objects found in the specified spatial range.  Objects slightly outside the range may also be included.
-		void getItemsInRange(std::set<SpatialDatabaseItemPtr> & neighborList, float xmin, float xmax, float zmin, float zmax, SpatialDatabaseItemPtr exclude);
+		void getItemsInRange(std::set<SpatialDatabaseItemPtr> & neighborList, float xmin, float xmax, float zmin, float zmax, SpatialDatabaseItemPtr exclude, unsigned int layers = GRID_LAYER_ALL);
 		/// Returns an STL set of objects found in the specified range of GridCells.
-		void getItemsInRange(std::set<SpatialDatabaseItemPtr> & neighborList, unsigned int xMinIndex, unsigned int xMaxIndex, unsigned int zMinIndex, unsigned int zMaxIndex, SpatialDatabaseItemPtr exclude);
+		void getItemsInRange(std::set<SpatialDatabaseItemPtr> & neighborList, unsigned int xMinIndex, unsigned int xMaxIndex, unsigned int zMinIndex, unsigned int zMaxIndex, SpatialDatabaseItemPtr exclude, unsigned int layers = GRID_LAYER_ALL);
 		/// Returns an STL set of objects in the specified range, culling agent objects to a hemisphere centered around the facingDirection.
 		void getItemsInVisualField(std::set<SpatialDatabaseItemPtr> & neighborList, float xmin, float xmax, float zmin, float zmax, SpatialDatabaseItemPtr exclude, const Util::Point & position, const Util::Vector & facingDirection, float radiusSquared);
 		//@}
 
+		/// @name Nearest neighbor queries without a set
+		/// @brief Each object is reported once, even if it overlaps several grid cells, in the first cell of the range that it overlaps,
+		/// instead of being looked up in a set.  The vector versions replace the contents of the caller's vector, so a vector that is
+		/// reused between queries stops allocating memory once it is large enough; objects are in grid cell order.  A visitor must not
+		/// add or remove objects.
+		//@{
+		/// Fills neighborList with the objects found in the specified spatial range.  Objects slightly outside the range may also be included.
+		void getItemsInRange(std::vector<SpatialDatabaseItemPtr> & neighborList, float xmin, float xmax, float zmin, float zmax, SpatialDatabaseItemPtr exclude, unsigned int layers = GRID_LAYER_ALL);
+		/// Fills neighborList with the objects found in the specified range of GridCells.
+		void getItemsInRange(std::vector<SpatialDatabaseItemPtr> & neighborList, unsigned int xMinIndex, unsigned int xMaxIndex, unsigned int zMinIndex, unsigned int zMaxIndex, SpatialDatabaseItemPtr exclude, unsigned int layers = GRID_LAYER_ALL);
+		/// Fills neighborList with the objects in the specified range, culling agent objects to a hemisphere centered around the facingDirection.
+		void getItemsInVisualField(std::vector<SpatialDatabaseItemPtr> & neighborList, float xmin, float xmax, float zmin, float zmax, SpatialDatabaseItemPtr exclude, const Util::Point & position, const Util::Vector & facingDirection, float radiusSquared);
+		/// Calls visitor(item) for each object found in the specified spatial range, without collecting them first.
+		template < typename VisitorType >
+		void visitItemsInRange(float xmin, float xmax, float zmin, float zmax, SpatialDatabaseItemPtr exclude, VisitorType visitor, unsigned int layers = GRID_LAYER_ALL) {
+			unsigned int xMinIndex, xMaxIndex, zMinIndex, zMaxIndex;
+			if (getIndexRangeOfBounds(xmin, xmax, zmin, zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex)) {
+				visitItemsInRange(xMinIndex, xMaxIndex, zMinIndex, zMaxIndex, exclude, visitor, layers);
+			}
+		}
+		/// Calls visitor(item) for each object found in the specified range of GridCells, without collecting them first; all objects of the static layer come first.
+		template < typename VisitorType >
+		void visitItemsInRange(unsigned int xMinIndex, unsigned int xMaxIndex, unsigned int zMinIndex, unsigned int zMaxIndex, SpatialDatabaseItemPtr exclude, VisitorType visitor, unsigned int layers = GRID_LAYER_ALL) {
+			visitEntriesInRange(xMinIndex, xMaxIndex, zMinIndex, zMaxIndex, exclude, [&visitor](const GridCellEntry & entry) { visitor(entry.item); }, layers);
+		}
+		/// Calls visitor(entry) with each object found in the specified spatial range and the bounds it was last updated with, so that the caller can filter objects without touching them.
+		template < typename VisitorType >
+		void visitEntriesInRange(float xmin, float xmax, float zmin, float zmax, SpatialDatabaseItemPtr exclude, VisitorType visitor, unsigned int layers = GRID_LAYER_ALL) {
+			unsigned int xMinIndex, xMaxIndex, zMinIndex, zMaxIndex;
+			if (getIndexRangeOfBounds(xmin, xmax, zmin, zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex)) {
+				visitEntriesInRange(xMinIndex, xMaxIndex, zMinIndex, zMaxIndex, exclude, visitor, layers);
+			}
+		}
+		/// Calls visitor(entry) with each object found in the specified range of GridCells and the bounds it was last updated with.
+		template < typename VisitorType >
+		void visitEntriesInRange(unsigned int xMinIndex, unsigned int xMaxIndex, unsigned int zMinIndex, unsigned int zMaxIndex, SpatialDatabaseItemPtr exclude, VisitorType visitor, unsigned int layers = GRID_LAYER_ALL) {
+			if (layers & GRID_LAYER_STATIC) {
+				_visitLayerInRange(_staticLayer, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex, exclude, visitor);
+			}
+			if (layers & GRID_LAYER_DYNAMIC) {
+				_visitLayerInRange(_dynamicLayer, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex, exclude, visitor);
+			}
+		}
+		/// Converts a spatial range to the range of GridCells it overlaps, clamped to the grid; returns false if the range is entirely outside of the grid.
+		bool getIndexRangeOfBounds(float xmin, float xmax, float zmin, float zmax, unsigned int & xMinIndex, unsigned int & xMaxIndex, unsigned int & zMinIndex, unsigned int & zMaxIndex);
+		//@}
+
+		/// @name k-nearest neighbor queries
+		//@{
+		/**
+		 * @brief Fills neighbors with the (at most) k objects closest to position, no farther than maxDistance, closest first; returns how many were found.
+		 *
+		 * The search visits rings of grid cells around the cell of position, from the inside out, keeping the k closest
+		 * objects so far in a max-heap; it stops as soon as the next ring is farther away than maxDistance or than the
+		 * k-th closest object, so it usually only visits a few cells even when maxDistance is large.  Agents are measured
+		 * to their center, and all other objects to the closest point of their bounds, using the bounds stored in the grid
+		 * (see GridCellEntry), so objects that are too far away are never touched.  Like the other queries without a set,
+		 * the vector is reused.
+		 */
+		unsigned int getKNearestNeighbors(std::vector<NearestNeighbor> & neighbors, const Util::Point & position, unsigned int k, float maxDistance, SpatialDatabaseItemPtr exclude, NeighborFilterEnum filter);
+		//@}
+
 		/// @name Ray tracing queries
 		//@{
 		/// Returns "true" if the ray found an intersection in-between r.mint and r.maxt
@@ -175,8 +349,9 @@ namespace SteerLib {
 		bool findPath (Util::Point &startPosition, Util::Point &endPosition, std::vector<Util::Point> & path,
 				unsigned int _maxNodesToExpandForSearch);
 
+		/// Like findPath(), but drops the waypoints that can be seen from the one before them; the points being smoothed are kept in arena if one is given, e.g. SteerLib::EngineInterface::getFrameArena().
 		bool findSmoothPath (Util::Point &startPosition, Util::Point &endPosition, std::vector<Util::Point> & path,
-				unsigned int _maxNodesToExpandForSearch);
+				unsigned int _maxNodesToExpandForSearch, Util::FrameArena * arena = NULL);
 		//@}
 
 		/// @name Miscellaneous functions
@@ -188,14 +363,54 @@ namespace SteerLib {
 
 		/// Finds a random 2D point, within the specified region, that has no other objects within the requested radius, using an exising (already seeded) Mersenne Twister random number generator.
 		Util::Point randomPositionInRegionWithoutCollisions(const Util::AxisAlignedBox & region, float radius, bool excludeAgents, MTRand & randomNumberGenerator);
+		/// Finds a random 2D point that has no other objects within the requested radius, drawing from the given stream, e.g. an agent's own stream from SteerLib::EngineInterface::getRandomStream().
+		Util::Point randomPositionWithoutCollisions(float radius, bool excludeAgents, Util::RandomStream & randomStream);
+		/// Finds a random 2D point, within the specified region, that has no other objects within the requested radius, drawing from the given stream.
+		Util::Point randomPositionInRegionWithoutCollisions(const Util::AxisAlignedBox & region, float radius, bool excludeAgents, Util::RandomStream & randomStream);
 
 		/// Finds a random 2D point, within the specified region, using an exising (already seeded) Mersenne Twister random number generator.
 		Util::Point randomPositionInRegion(const Util::AxisAlignedBox & region, float radius,MTRand & randomNumberGenerator);
 
+		/// Restarts the database's own random number generator, used when no generator is given to the random position functions, from the given seed.
+		void seedRandomNumberGenerator(unsigned int seed);
+
 		/// Uses openGL and DrawLib to visualize the grid.
 		void draw();
 		//@}
 
+	protected:
+		/// Takes the buffered change of one item out of the buffer: a move within the same cells is applied at once, anything else is added to _deferredCellChanges.
+		void _collectDeferredUpdate(SpatialDatabaseItemPtr item);
+		/// Applies and clears _deferredCellChanges, one cell after the other, then rebuilds the dynamic layer if agent updates are pending.
+		void _applyDeferredCellChanges();
+		/// Sorts every entry of the dynamic layer, with _pendingRebuildUpdates applied, into _packedEntries, and points the dynamic cells there.
+		void _rebuildDynamicLayer();
+		/// Calls body(chunk, begin, end) for numChunks consecutive parts of [0, numItems), on the threads of _rebuildScheduler if there is one.
+		void _runInChunks(unsigned int numItems, unsigned int numChunks, const std::function<void (unsigned int chunk, unsigned int begin, unsigned int end)> & body);
+		/// An exclusive prefix sum over [0, numItems) in two passes of _runInChunks(): sumRange(begin, end) returns the total of each chunk,
+		/// then scanRange(begin, end, start) assigns the offsets of each chunk, given the total of all chunks before it.  Returns the total.
+		unsigned int _scanInChunks(unsigned int numItems, unsigned int numChunks, const std::function<unsigned int (unsigned int begin, unsigned int end)> & sumRange,
+			const std::function<void (unsigned int begin, unsigned int end, unsigned int start)> & scanRange);
+		/// Write and read the cells of one layer for writeCheckpoint() and readCheckpoint().
+		void _writeLayerCheckpoint(SteerLib::CheckpointWriter & out, const GridLayer & layer);
+		void _readLayerCheckpoint(SteerLib::CheckpointReader & in, GridLayer & layer);
+		/// Calls visitor(entry) for each object of one layer in the range of GridCells, in the first cell of the range that the object overlaps.
+		template < typename VisitorType >
+		void _visitLayerInRange(const GridLayer & layer, unsigned int xMinIndex, unsigned int xMaxIndex, unsigned int zMinIndex, unsigned int zMaxIndex, SpatialDatabaseItemPtr exclude, VisitorType & visitor) {
+			for (unsigned int i=xMinIndex; i<=xMaxIndex; i++) {
+				for (unsigned int j=zMinIndex; j<=zMaxIndex; j++) {
+					const GridCell & cell = _getCell(layer, i, j);
+					for (unsigned int k=0; k < cell._numItems; k++) {
+						const GridCellEntry & entry = cell.getEntry(k);
+						// an object overlaps a rectangle of cells, so the part of it in the range starts at exactly one cell.
+						if ((i != std::max(entry.xMinIndex, xMinIndex)) || (j != std::max(entry.zMinIndex, zMinIndex))) continue;
+						if (entry.item != exclude) {
+							visitor(entry);
+						}
+					}
+				}
+			}
+		}
 	};
 
 
@@ -226,6 +441,10 @@ namespace SteerLib {
 	}
 
 	inline void GridDatabase2D::getGridCoordinatesFromIndex(unsigned int cellIndex, unsigned int &xIndex, unsigned int & zIndex) {
+		if (_cellNumbering == CELL_NUMBERING_MORTON) {
+			mortonDecode2D(cellIndex, xIndex, zIndex);
+			return;
+		}
 		xIndex = cellIndex / _zNumCells; // integer division so that remainders also get truncated
 		zIndex = cellIndex - (xIndex * _zNumCells);
 	}
@@ -9,6 +9,12 @@
 /// @file GridDatabase2DPrivate.h
 /// @brief Defines private functionality for the SteerLib::GridDatabase2D spatial database.
 
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <atomic>
+#include <thread>
+
 #include "Globals.h"
 #include "util/Geometry.h"
 #include "util/GenericException.h"
@@ -25,11 +31,153 @@
 #pragma warning( disable : 4251 )
 #endif
 
+// forward declaration
+class MTRand;
+
+namespace Util {
+	class WorkStealingScheduler;
+}
+
 namespace SteerLib {
 
 	// forward declarations
 	class GridDatabasePlanningDomain;
 
+	/// How GridDatabase2D applies committed deferred updates of agents; see GridDatabase2D::setDynamicLayerMode().
+	enum DynamicLayerModeEnum {
+		/// each agent that moved is removed from the cells it left and added to the cells it entered.
+		DYNAMIC_LAYER_INCREMENTAL,
+		/// the whole dynamic layer is sorted again from scratch, into one packed array.
+		DYNAMIC_LAYER_REBUILD
+	};
+
+	/// How GridDatabase2D numbers its cells, and orders them in memory; see GridDatabase2D::setCellNumbering().
+	enum CellNumberingEnum {
+		/// cell (x,z) is number x * numCellsZ + z.
+		CELL_NUMBERING_ROW_MAJOR,
+		/// cell (x,z) is number mortonEncode2D(x,z), which interleaves the bits of x and z.
+		CELL_NUMBERING_MORTON
+	};
+
+	/// The largest number of cells along the x or z axis of a grid that uses CELL_NUMBERING_MORTON, so that every cell index fits into an int.
+	#define MORTON_MAX_NUM_CELLS (1u << 15)
+
+	/// Spreads the low 16 bits of v apart, so that bit i moves to bit 2i.
+	inline unsigned int mortonSpreadBits(unsigned int v) {
+		v &= 0x0000ffff;
+		v = (v | (v << 8)) & 0x00ff00ff;
+		v = (v | (v << 4)) & 0x0f0f0f0f;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	}
+
+	/// The inverse of mortonSpreadBits(): gathers the even bits of v into its low 16 bits.
+	inline unsigned int mortonCompactBits(unsigned int v) {
+		v &= 0x55555555;
+		v = (v | (v >> 1)) & 0x33333333;
+		v = (v | (v >> 2)) & 0x0f0f0f0f;
+		v = (v | (v >> 4)) & 0x00ff00ff;
+		v = (v | (v >> 8)) & 0x0000ffff;
+		return v;
+	}
+
+	/// Returns the Z-order (Morton) number of cell (x,z): the bits of x and z interleaved, z in the lowest bit, so that cells that are close in both directions get close numbers.
+	inline unsigned int mortonEncode2D(unsigned int x, unsigned int z) { return (mortonSpreadBits(x) << 1) | mortonSpreadBits(z); }
+	/// The inverse of mortonEncode2D().
+	inline void mortonDecode2D(unsigned int index, unsigned int & x, unsigned int & z) { x = mortonCompactBits(index >> 1); z = mortonCompactBits(index); }
+
+	/**
+	 * @brief The net effect of all database updates made to one item while updates are deferred.
+	 *
+	 * Any sequence of add/remove/update calls on the same item collapses into at most one removal
+	 * (using the bounds the item had before deferring started) followed by at most one addition.
+	 */
+	struct DeferredGridUpdate {
+		/// true if the item was in the database before the first deferred call.
+		bool wasInDatabase;
+		/// the bounds the item occupied before the first deferred call; only valid if wasInDatabase is true.
+		Util::AxisAlignedBox oldBounds;
+		/// true if the item should be in the database once the update is committed.
+		bool isInDatabase;
+		/// the bounds the item should occupy once the update is committed; only valid if isInDatabase is true.
+		Util::AxisAlignedBox newBounds;
+	};
+
+	/**
+	 * @brief The add/remove/update calls one thread made while updates are deferred, in the order it made them.
+	 *
+	 * Each thread appends to its own buffer without taking any lock; the thread that commits the updates
+	 * merges all buffers into one DeferredGridUpdate per item.
+	 */
+	struct DeferredUpdateBuffer {
+		/// The only thread that appends to this buffer.
+		std::thread::id ownerThread;
+		/// The calls, each already turned into the DeferredGridUpdate of that one call.
+		std::vector< std::pair<SpatialDatabaseItemPtr, DeferredGridUpdate> > calls;
+	};
+
+	/**
+	 * @brief One addition or removal of an item in one grid cell, collected while committing deferred updates.
+	 *
+	 * The changes of all committed items are sorted by cell before they are applied, so that each cell is
+	 * visited once; the sort is stable, so a cell ends up with its items in the same order as if the
+	 * updates had been applied one item at a time.
+	 */
+	struct DeferredCellChange {
+		unsigned int cellIndex;
+		/// true for the static layer, false for the dynamic layer.
+		bool isStatic;
+		/// true to add entry to the cell, false to remove entry.item from it.
+		bool isAddition;
+		float traversalCost;
+		GridCellEntry entry;
+	};
+
+
+	/// The number of grid cells along each side of a GridTile is 2 to the power of GRID_TILE_SHIFT.
+	#define GRID_TILE_SHIFT 4
+	#define GRID_TILE_SIZE (1u << GRID_TILE_SHIFT)
+	#define GRID_TILE_NUM_CELLS (GRID_TILE_SIZE * GRID_TILE_SIZE)
+
+	/**
+	 * @brief A square block of GRID_TILE_SIZE x GRID_TILE_SIZE grid cells of one layer, and the fixed arrays that hold their first items.
+	 *
+	 * Cell (x,z) of the grid is cell GridDatabase2DPrivate::_getTileCellIndex(x,z) of its tile, which follows the cell
+	 * numbering of the database.  Tiles at the far edges of the grid may have cells beyond the grid; those cells always
+	 * stay empty.
+	 */
+	struct GridTile {
+		GridTile() : entries(NULL) { }
+		~GridTile() { delete [] entries; }
+
+		GridCell cells[GRID_TILE_NUM_CELLS];
+		/// itemsPerCell entries for each cell of the tile, in the order of the cells; NULL if the layer keeps no items in fixed arrays.
+		GridCellEntry * entries;
+
+	private:
+		// the cells point into entries.
+		GridTile(const GridTile & );  // not implemented, not copyable
+		GridTile & operator= (const GridTile & );  // not implemented, not assignable
+	};
+
+	/**
+	 * @brief One layer of the GridDatabase2D: a grid of tiles, each allocated when an object is first added to one of its cells.
+	 *
+	 * Large maps are mostly open ground or solid rock, and agents gather in a small part of them, so most tiles of a
+	 * layer are never allocated.  A cell of a tile that does not exist is empty; reading it returns emptyCell, which has
+	 * the base traversal cost of the layer.  Tiles stay allocated once they exist, until the layer is cleared.
+	 */
+	struct GridLayer {
+		/// the tiles, x-major like the cells; NULL where no object was ever added.  Written under the database's tile mutex,
+		/// and read without it, so a tile is only published once its cells are initialized.
+		std::vector< std::atomic<GridTile*> > tiles;
+		/// the number of items each cell of a new tile holds in the tile's fixed array; more go to the cell's overflow list.
+		unsigned int itemsPerCell;
+		/// what every cell of a tile that does not exist looks like.
+		GridCell emptyCell;
+	};
+
 
 	/** 
 	 * @brief The protected data and member functions used by the GridDatabase2D class.
@@ -45,6 +193,13 @@ namespace SteerLib {
 		/// Helper function that allocates the database correctly during initialization
 		void _allocateDatabase();
 
+		/// Helper function that records a deferred add/remove/update; bounds pointers are NULL for the "not in the database" side of the change.
+		void _deferUpdate(SpatialDatabaseItemPtr item, const Util::AxisAlignedBox * oldBounds, const Util::AxisAlignedBox * newBounds);
+		/// Returns the buffer of the calling thread, creating it if this thread never deferred an update to this database before.
+		DeferredUpdateBuffer * _getDeferredUpdateBufferOfThisThread();
+		/// Moves the calls of all threads' buffers into _deferredUpdates; only the thread that owns the database may call this, while no other thread defers updates.
+		void _mergeDeferredUpdateBuffers();
+
 		/// Helper function that converts a spatial range to a 2-D integer index range.
 		inline bool _clampSpatialBoundsToIndexRange(float xmin, float xmax, float zmin, float zmax, unsigned int & xMinIndex, unsigned int & xMaxIndex, unsigned int & zMinIndex, unsigned int & zMaxIndex);
 
@@ -59,18 +214,125 @@ namespace SteerLib {
 		unsigned int _xNumCells;  // number of cells along the x or z axis
 		unsigned int _zNumCells;
 
-		unsigned int _maxItemsPerCell;
+		unsigned int _maxItemsPerCell;  // number of items each cell of the dynamic layer holds without allocating more memory
+		unsigned int _maxStaticItemsPerCell;  // the same for the static layer
 
 		bool _drawGrid; // should the grid be drawn?
 
-		/// The internal pointer to all SpatialDatabaseItem pointers, used so that all database data remains contiguous for better data locality; this is the pointer to de-allocate instead of each grid cell's pointer separately.
-		SpatialDatabaseItemPtr *  _basePtr;
+		/// @name The layers
+		/// @brief Every cell has one list of items in each layer.  Each layer is a grid of tiles, see GridLayer.
+		//@{
+		unsigned int _xNumTiles;  // number of tiles along the x or z axis
+		unsigned int _zNumTiles;
+		/// The dynamic layer, which holds the agents.
+		GridLayer _dynamicLayer;
+		/// The static layer, holding everything that is not an agent; kept apart so that moving agents do not write to the memory that holds obstacles.
+		GridLayer _staticLayer;
+		/// Guards the allocation of tiles, which can happen while objects are added from several threads.
+		Util::Mutex _tileMutex;
+
+		/// Returns the layer an item belongs to.
+		inline GridLayer & _getLayer(SpatialDatabaseItemPtr item);
+
+		/// How cells are numbered, and ordered within their tiles.
+		CellNumberingEnum _cellNumbering;
+		/// The position of cell (x,z) within its tile is _tileCellOffsetX[x % GRID_TILE_SIZE] | _tileCellOffsetZ[z % GRID_TILE_SIZE].
+		unsigned char _tileCellOffsetX[GRID_TILE_SIZE];
+		unsigned char _tileCellOffsetZ[GRID_TILE_SIZE];
+
+		/// Fills _tileCellOffsetX and _tileCellOffsetZ for _cellNumbering.
+		void _initTileCellOffsets();
+		/// Returns the position of cell (x,z) within its tile.
+		inline unsigned int _getTileCellIndex(unsigned int x, unsigned int z) const { return _tileCellOffsetX[x & (GRID_TILE_SIZE-1)] | _tileCellOffsetZ[z & (GRID_TILE_SIZE-1)]; }
 
-		/// A 2-D array of grid cells, but organized in a 1-D array.
-		GridCell* _cells;
+		/// Returns cell (x,z) of a layer for reading; the empty cell of the layer if its tile does not exist.
+		inline const GridCell & _getCell(const GridLayer & layer, unsigned int x, unsigned int z) const {
+			const GridTile * tile = layer.tiles[(x >> GRID_TILE_SHIFT) * _zNumTiles + (z >> GRID_TILE_SHIFT)].load(std::memory_order_acquire);
+			return (tile != NULL) ? tile->cells[_getTileCellIndex(x, z)] : layer.emptyCell;
+		}
+		/// Returns cell (x,z) of a layer for changing it, or NULL if its tile does not exist; unlike _getCellForWriting(), never allocates.
+		inline GridCell * _findCellForWriting(GridLayer & layer, unsigned int x, unsigned int z) {
+			GridTile * tile = layer.tiles[(x >> GRID_TILE_SHIFT) * _zNumTiles + (z >> GRID_TILE_SHIFT)].load(std::memory_order_acquire);
+			return (tile != NULL) ? &tile->cells[_getTileCellIndex(x, z)] : NULL;
+		}
+		/// Returns cell (x,z) of a layer for changing it, allocating its tile if needed.
+		inline GridCell & _getCellForWriting(GridLayer & layer, unsigned int x, unsigned int z) {
+			unsigned int tileIndex = (x >> GRID_TILE_SHIFT) * _zNumTiles + (z >> GRID_TILE_SHIFT);
+			GridTile * tile = layer.tiles[tileIndex].load(std::memory_order_acquire);
+			if (tile == NULL) {
+				tile = _allocateTile(layer, tileIndex);
+			}
+			return tile->cells[_getTileCellIndex(x, z)];
+		}
+		/// Returns the tile of a layer with the given index, allocating it if it does not exist yet.
+		GridTile * _allocateTile(GridLayer & layer, unsigned int tileIndex);
+		/// Deletes all tiles of a layer, leaving it empty.
+		void _clearLayer(GridLayer & layer);
+		//@}
 
 		/// The state space interface used by the planner to plan paths through the database.
 		GridDatabasePlanningDomain * _planningDomain;
+
+		/// The random number generator used when no generator is given to the random position functions; each database has its own, so that several engines do not share one sequence.
+		MTRand * _randomNumberGenerator;
+		/// Guards _randomNumberGenerator, which agents may use while they are updated in parallel.
+		Util::Mutex _randomNumberGeneratorMutex;
+
+		/// @name Deferred updates
+		/// @brief While deferring, add/remove/update calls are buffered here (possibly from several threads) and applied later by the thread that owns the database.
+		//@{
+		bool _deferringUpdates;
+		/// Changes every time deferring begins, and is never shared by two databases, so that a thread can tell whether the buffer it remembers is still the right one.
+		unsigned long long _deferredUpdateEpoch;
+		/// Guards _deferredUpdateBuffers; a thread only takes it the first time it defers an update after deferring began.
+		Util::Mutex _deferredUpdateBufferMutex;
+		/// One buffer for each thread that ever deferred an update to this database; kept between frames so that their memory is reused.
+		std::vector<DeferredUpdateBuffer*> _deferredUpdateBuffers;
+		/// The merged change of each item that was not committed yet.
+		std::unordered_map<SpatialDatabaseItemPtr, DeferredGridUpdate> _deferredUpdates;
+		/// Items in the order their first deferred update was merged, used for any updates that were not committed explicitly.
+		std::vector<SpatialDatabaseItemPtr> _deferredUpdateOrder;
+		/// The cell changes of the items being committed; kept between frames so that its memory is reused.
+		std::vector<DeferredCellChange> _deferredCellChanges;
+		//@}
+
+		/// @name Rebuilding the dynamic layer
+		/// @brief In DYNAMIC_LAYER_REBUILD mode, the tiles of the dynamic layer have no fixed arrays; instead their cells point into
+		/// _packedEntries.  The rebuild only sorts the cells of the tiles that exist: the cells of _rebuildTiles[t] are the slots
+		/// t*GRID_TILE_NUM_CELLS and on, and the entries of slot s are _packedEntries[_cellOffsets[s]] up to, but not including,
+		/// _packedEntries[_cellOffsets[s+1]].
+		//@{
+		DynamicLayerModeEnum _dynamicLayerMode;
+		/// Runs the rebuild on several threads, or NULL to rebuild on the calling thread.
+		Util::WorkStealingScheduler * _rebuildScheduler;
+		std::vector<GridCellEntry> _packedEntries;
+		std::vector<unsigned int> _cellOffsets;
+		/// Committed deferred updates of agents, in commit order, waiting to be applied by the next rebuild.
+		std::vector< std::pair<SpatialDatabaseItemPtr, DeferredGridUpdate> > _pendingRebuildUpdates;
+		/// Scratch space of the rebuild, kept between frames so that its memory is reused: every agent once, where the
+		/// agents of each cell start in that list, and the number of entries each chunk of agents puts in each cell.
+		std::vector<GridCellEntry> _rebuildItems;
+		std::vector<unsigned int> _rebuildItemOffsets;
+		std::vector<unsigned int> _rebuildCounts;
+		/// The start of every chunk of a prefix sum in _scanInChunks().
+		std::vector<unsigned int> _rebuildChunkStarts;
+		/// The tiles of the dynamic layer that exist, and the position of every tile in that list, or -1 if it does not exist.
+		std::vector<GridTile*> _rebuildTiles;
+		std::vector<unsigned int> _rebuildTileOrdinals;
+
+		/// Fills _rebuildTiles and _rebuildTileOrdinals.
+		void _collectRebuildTiles();
+		/// Returns the slot of cell (x,z), whose tile must be in _rebuildTiles.
+		inline unsigned int _getRebuildSlot(unsigned int x, unsigned int z) const {
+			return (_rebuildTileOrdinals[(x >> GRID_TILE_SHIFT) * _zNumTiles + (z >> GRID_TILE_SHIFT)] << (2*GRID_TILE_SHIFT)) | _getTileCellIndex(x, z);
+		}
+		//@}
+
+		/// @name Statistics
+		//@{
+		bool _countingUpdates;
+		std::atomic<unsigned int> _numItemUpdates;
+		//@}
 	};
 
 
@@ -13,6 +13,7 @@
 #include "Globals.h"
 #include "testcaseio/AgentInitialConditions.h"
 #include "griddatabase/GridDatabase2D.h"
+#include "simulation/Checkpoint.h"
 #include "util/Geometry.h"
 
 namespace SteerLib {
@@ -58,6 +59,28 @@ namespace SteerLib {
 		virtual void draw() = 0;
 		//@}
 
+		/// @name Optional two-phase update
+		/// @brief Agents that return true from usesTwoPhaseUpdate() are updated by calling decideAI() on all agents, and only then commitAI() on all agents, instead of updateAI().
+		//@{
+		/// Returns true if the engine should call decideAI() and commitAI() instead of updateAI(); must not change during the agent's lifetime.
+		virtual bool usesTwoPhaseUpdate() { return false; }
+		/// The "sense" step: decide what to do, reading other agents only through SteerLib::EngineInterface::getAgentStateSnapshot(); must not change anything other agents can observe, and may run concurrently with other agents.
+		virtual void decideAI(float timeStamp, float dt, unsigned int frameNumber) { }
+		/// The "act" step: apply the decision made by decideAI(), including spatial database updates; may run concurrently with other agents.
+		virtual void commitAI(float timeStamp, float dt, unsigned int frameNumber) { }
+		//@}
+
+		/// @name Optional checkpointing
+		/// @brief Agents that support checkpoints allow SteerLib::SimulationEngine::saveCheckpoint() to store them, and restoreCheckpoint() to bring them back.
+		//@{
+		/// Returns true if the agent implements writeCheckpoint() and readCheckpoint().
+		virtual bool supportsCheckpoints() { return false; }
+		/// Writes all of the agent's internal state that can change during the simulation; refer to other agents and obstacles with SteerLib::CheckpointWriter::writeItemReference().
+		virtual void writeCheckpoint(SteerLib::CheckpointWriter & out) { throw Util::GenericException("This agent does not support checkpoints."); }
+		/// Restores the state written by writeCheckpoint() into an agent that was created from the same initial conditions; must not update the spatial database, which the engine restores separately.
+		virtual void readCheckpoint(SteerLib::CheckpointReader & in) { throw Util::GenericException("This agent does not support checkpoints."); }
+		//@}
+
 		/// @name Accessors to query info about the agent
 		//@{
 		/// Returns true if the agent is active/enabled, false if it is inactive/disabled.
@@ -19,7 +19,13 @@
 #include "util/DynamicLibrary.h"
 #include "simulation/Clock.h"
 #include "simulation/Camera.h"
+#include "simulation/AgentRegistry.h"
+#include "simulation/AgentStateSnapshot.h"
+#include "simulation/MultiRateScheduler.h"
+#include "simulation/DeferredWorkQueue.h"
+#include "simulation/FrameTelemetry.h"
 #include "simulation/SimulationOptions.h"
+#include "util/FrameArena.h"
 
 namespace SteerLib {
 
@@ -47,6 +53,8 @@ namespace SteerLib {
 		bool isLoaded;
 		/// True if the module was initialized with a call to SteerLib::ModuleInterface::init(), false otherwise.
 		bool isInitialized;
+		/// The module's own random number stream, derived from the random seed and the module's name.
+		Util::RandomStream randomStream;
 	};
 
 
@@ -75,8 +83,33 @@ namespace SteerLib {
 		virtual SteerLib::GridDatabase2D * getSpatialDatabase() = 0;
 		/// Returns a reference to an STL vector containing a list of agents.
 		virtual const std::vector<SteerLib::AgentInterface*> & getAgents() = 0;
+		/// Returns a reference to an STL vector containing the agents owned by the given module, in no particular order.
+		virtual const std::vector<SteerLib::AgentInterface*> & getAgentsOfModule(SteerLib::ModuleInterface * owner) = 0;
+		/// Returns a handle to the agent that stays safe to use after the agent is destroyed, or a null handle if the engine does not know the agent.
+		virtual SteerLib::AgentHandle getAgentHandle(SteerLib::AgentInterface * agent) = 0;
+		/// Returns the agent the handle refers to, or NULL if that agent was destroyed or removed since.
+		virtual SteerLib::AgentInterface * getAgent(const SteerLib::AgentHandle & handle) = 0;
 		/// Returns a reference to an STL set of selected agents.
 		virtual const std::set<SteerLib::AgentInterface*> & getSelectedAgents() = 0;
+		/// Returns the frozen state of all agents at the start of the current frame; only captured while some agent uses the two-phase update.
+		virtual const SteerLib::AgentStateSnapshot & getAgentStateSnapshot() = 0;
+		/// Returns the scheduler that runs tasks of agents and modules every N frames, staggered across frames; its tasks are removed when the simulation is cleaned up.
+		virtual SteerLib::MultiRateScheduler & getMultiRateScheduler() = 0;
+		/// Returns the queue of work that can wait until the end of a real-time frame; it only defers work when the clock runs in a real-time mode.
+		virtual SteerLib::DeferredWorkQueue & getDeferredWorkQueue() = 0;
+		/// Returns the timings of the most recent frames; it is empty unless the telemetryFrames option is set, and may be read from any thread.
+		virtual const SteerLib::FrameTelemetry & getFrameTelemetry() = 0;
+		/// Returns the agent's own random number stream; the numbers only depend on the random seed, the order in which agents were created and how many numbers the agent drew before, not on which thread or in which order agents are updated.
+		/// This makes the draws repeatable, but the simulation as a whole is only repeatable if the agents' AI is as well; "steertool -test determinism" checks that for sfAI.
+		virtual Util::RandomStream & getRandomStream(SteerLib::AgentInterface * agent) = 0;
+		/// Returns the module's own random number stream, derived from the random seed and the module's name.
+		virtual Util::RandomStream & getModuleRandomStream(SteerLib::ModuleInterface * module) = 0;
+		/// Returns the calling thread's arena for temporary data; it is reset at the end of every frame, so nothing allocated from it may be kept longer.
+		virtual Util::FrameArena & getFrameArena() = 0;
+		/// Returns the number of threads that update agents, including the thread that runs the simulation.
+		virtual unsigned int getNumThreads() = 0;
+		/// Returns the index of the calling thread, between 0 and getNumThreads()-1; it is 0 for the thread that runs the simulation.
+		virtual unsigned int getIndexOfCurrentThread() = 0;
 		/// Returns a reference to an STL set containing a list of all obstacles.
 		virtual const std::set<SteerLib::ObstacleInterface*> & getObstacles() = 0;
 		/// Returns a pointer to the ModuleInterface of the module with the name moduleName.
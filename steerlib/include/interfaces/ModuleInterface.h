@@ -27,6 +27,16 @@ namespace SteerLib {
 	// forward declaration
 	class STEERLIB_API EngineInterface;
 
+	/// Declares whether a module's preprocessFrame() and postprocessFrame() may run at the same time as other modules'; see ModuleInterface::getFrameConcurrency().
+	enum ModuleFrameConcurrencyEnum {
+		/// The default; the frame functions run alone, one module after another in execution order.
+		MODULE_FRAME_EXCLUSIVE,
+		/// The frame functions only read agents, obstacles and other engine state, and only write the module's own data.
+		MODULE_FRAME_READ_ONLY,
+		/// The frame functions may change shared state, but synchronize every such change themselves.
+		MODULE_FRAME_THREAD_SAFE
+	};
+
 
 	/**
 	 * @brief The primary interface for a module used by the SimulationEngine.
@@ -125,6 +135,28 @@ namespace SteerLib {
 		virtual void processKeyboardInput(int key, int action ) { }
 		/// Uses OpenGL to draw any module-specific information to the screen; <b>WARNING:</b> this may be called multiple times per simulation step.
 		virtual void draw() { }
+		/// @brief Tells the engine whether preprocessFrame() and postprocessFrame() can run concurrently with other modules' frame functions.
+		///
+		/// When the engine runs with more than one thread, modules that return MODULE_FRAME_READ_ONLY may run at the same time as
+		/// other read-only modules, and modules that return MODULE_FRAME_THREAD_SAFE at the same time as other thread-safe modules.
+		/// Dependencies are still respected, and exclusive modules (the default) never overlap with any other module.
+		/// Concurrent frame functions may run on a worker thread, so they must not use OpenGL or GUI toolkits.
+		/// <b>Note:</b>This function must be valid at all times, even before init() is called or after finish() is called.
+		virtual ModuleFrameConcurrencyEnum getFrameConcurrency() { return MODULE_FRAME_EXCLUSIVE; }
+		//@}
+
+		/// @name Optional checkpointing
+		/// @brief Modules that keep state which changes during the simulation can store it in checkpoints.
+		///
+		/// The engine refuses to save or restore checkpoints while a module is loaded that does not support them, because such a
+		/// module would silently start over from the restored frame.
+		//@{
+		/// Returns true if the module stores all of its state that changes during the simulation with writeCheckpoint(), or has no such state.
+		virtual bool supportsCheckpoints() { return false; }
+		/// Writes the module's state into a checkpoint; called after the engine wrote the clock, agents, obstacles and spatial database.
+		virtual void writeCheckpoint(SteerLib::CheckpointWriter & out) { }
+		/// Restores the state written by writeCheckpoint(); called after the agents and spatial database were restored.
+		virtual void readCheckpoint(SteerLib::CheckpointReader & in) { }
 		//@}
 	};
 
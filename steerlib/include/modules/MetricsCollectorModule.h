@@ -22,6 +22,7 @@ namespace SteerLib {
 		std::string getConflicts() { return ""; }
 		std::string getData() { return ""; }
 		LogData * getLogData() { return new LogData(); }
+		ModuleFrameConcurrencyEnum getFrameConcurrency() { return MODULE_FRAME_READ_ONLY; }
 
 		void init( const SteerLib::OptionDictionary & options, SteerLib::EngineInterface * engineInfo ) {
 			_engine = engineInfo;
@@ -57,6 +58,10 @@ namespace SteerLib {
 
 		inline SteerLib::SimulationMetricsCollector * getSimulationMetrics() { return _simulationMetrics; }
 
+		bool supportsCheckpoints() { return true; }
+		void writeCheckpoint(SteerLib::CheckpointWriter & out) { _simulationMetrics->writeCheckpoint(out); }
+		void readCheckpoint(SteerLib::CheckpointReader & in) { _simulationMetrics->readCheckpoint(in); }
+
 	protected:
 		SteerLib::EngineInterface * _engine;
 		SteerLib::SimulationMetricsCollector * _simulationMetrics;
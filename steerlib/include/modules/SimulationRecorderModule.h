@@ -21,6 +21,7 @@ namespace SteerLib {
 		std::string getConflicts() { return ""; }
 		std::string getData() { return ""; }
 		LogData * getLogData() { return new LogData(); }
+		ModuleFrameConcurrencyEnum getFrameConcurrency() { return MODULE_FRAME_READ_ONLY; }
 
 		void init( const SteerLib::OptionDictionary & options, SteerLib::EngineInterface * engineInfo );
 
@@ -41,6 +42,10 @@ namespace SteerLib {
 		void postprocessFrame(float timeStamp, float dt, unsigned int frameNumber);
 		void postprocessSimulation();
 
+		bool supportsCheckpoints() { return true; }
+		void writeCheckpoint(SteerLib::CheckpointWriter & out);
+		void readCheckpoint(SteerLib::CheckpointReader & in);
+
 	protected:
 		SteerLib::EngineInterface * _engine;
 		SteerLib::RecFileWriter * _simulationWriter;
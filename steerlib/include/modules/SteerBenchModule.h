@@ -25,6 +25,8 @@ namespace SteerLib {
 		std::string getConflicts() { return ""; }
 		std::string getData() { return ""; }
 		LogData * getLogData() { return new LogData(); }
+		/// Not read-only: preprocessFrame() updates the state of _benchmarkTechnique, and techniques make no promises about running next to other modules.
+		ModuleFrameConcurrencyEnum getFrameConcurrency() { return MODULE_FRAME_EXCLUSIVE; }
 
 		void init( const SteerLib::OptionDictionary & options, SteerLib::EngineInterface * engineInfo ) {
 
@@ -52,6 +54,8 @@ namespace SteerLib {
 
 		void preprocessSimulation() {
 			_metricsCollectorModule = dynamic_cast<MetricsCollectorModule*>( _engine->getModule("metricsCollector"));
+			// the technique may still hold the scores of a previous simulation in the same engine.
+			_benchmarkTechnique->reset();
 		}
 
 		void preprocessFrame(float timeStamp, float dt, unsigned int frameNumber)
@@ -101,6 +105,11 @@ namespace SteerLib {
 		void postprocessSimulation() {
 		}
 
+		/// The techniques compute their scores from the metrics of the metricsCollector module, which stores the metrics in checkpoints itself.
+		bool supportsCheckpoints() { return true; }
+		/// Drops the score a technique may have computed from the metrics before they were restored.
+		void readCheckpoint(SteerLib::CheckpointReader & in) { _benchmarkTechnique->reset(); }
+
 		void setBenchmarkTechnique ( const std::string & techniqueName ) 
 		{
 			this->_techniqueName = techniqueName;
@@ -27,6 +27,11 @@ namespace SteerLib {
 		void initializeSimulation();
 		void postprocessFrame(float timeStamp, float dt, unsigned int frameNumber);
 		void cleanupSimulation();
+		/// The test case is loaded before a checkpoint is restored, and nothing about it changes during the simulation.
+		bool supportsCheckpoints() { return true; }
+
+		/// Sets the test case that the next initializeSimulation() loads, so that an engine can run another test case without loading its modules again.
+		inline void setTestCaseFilename(const std::string & testCaseFilename) { _testCaseFilename = testCaseFilename; }
 
 	protected:
 		SteerLib::EngineInterface * _engine;
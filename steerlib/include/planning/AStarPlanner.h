@@ -14,6 +14,7 @@
 #include <iostream>
 #include <map>
 #include "SteerLib.h"
+#include "util/FrameArena.h"
 
 namespace SteerLib
 {
@@ -129,10 +130,19 @@ namespace SteerLib
 		*/
 
 		bool computePath(std::vector<Util::Point>& agent_path, Util::Point start, Util::Point goal, SteerLib::GridDatabase2D * _gSpatialDatabase, bool append_to_path = false);
+
+		/*
+		@function setFrameArena sets the arena the search nodes and lists of computePath are allocated from, usually
+		the engine's SteerLib::EngineInterface::getFrameArena() of the calling thread. The memory is given back when
+		computePath returns. Without an arena, computePath uses an arena of its own for every query.
+		*/
+		void setFrameArena(Util::FrameArena * arena) { _frameArena = arena; }
 	private:
-		void _tryToAdd(unsigned int x, unsigned int z, const SearchNodePtr& from, float cost, Util::Point goal, std::vector<SearchNodePtr>& out);
-		std::vector<SearchNodePtr> _expand(const SearchNodePtr& node, Util::Point goal);
+		typedef Util::ArenaVector<SearchNodePtr> SearchNodeList;
+		void _tryToAdd(unsigned int x, unsigned int z, const SearchNodePtr& from, float cost, Util::Point goal, SearchNodeList& out);
+		void _expand(const SearchNodePtr& node, Util::Point goal, SearchNodeList& out);
 		SteerLib::GridDatabase2D * gSpatialDatabase;
+		Util::FrameArena * _frameArena;
 	};
 
 
@@ -12,6 +12,7 @@
 #include "Globals.h"
 #include "util/Geometry.h"
 #include "recfileio/RecFileIOPrivate.h"
+#include "simulation/Checkpoint.h"
 
 namespace SteerLib {
 
@@ -254,6 +255,14 @@ namespace SteerLib {
 		/// Adds a suggested camera view to the recording.
 		inline void addCameraView( const Util::Point & pos, const Util::Point & lookat ) { addCameraView( pos.x, pos.y, pos.z, lookat.x, lookat.y, lookat.z ); }
 		//@}
+
+		/// @name Checkpoints
+		//@{
+		/// Writes everything recorded so far into a checkpoint, including the frames already written to the file; must be called between frames.
+		void writeCheckpoint(SteerLib::CheckpointWriter & out);
+		/// Rewrites the file being recorded with the frames written by writeCheckpoint(), dropping any frames recorded since; must be called between frames of a recording with the same number of agents.
+		void readCheckpoint(SteerLib::CheckpointReader & in);
+		//@}
 	};
 
 
@@ -0,0 +1,93 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+#ifndef __STEERLIB_AGENT_POOL_H__
+#define __STEERLIB_AGENT_POOL_H__
+
+/// @file AgentPool.h
+/// @brief Declares SteerLib::AgentPool, which lets a module reuse the agents the engine destroyed instead of allocating new ones.
+
+#include <vector>
+
+#include "Globals.h"
+
+namespace SteerLib {
+
+	/**
+	 * @brief Keeps the agents a module was asked to destroy, so that its next createAgent() can return one of them.
+	 *
+	 * When the engine runs one simulation after another (see BatchEngineDriver), every simulation destroys all of its
+	 * agents in cleanupSimulation(), and the next one creates them again.  A module that owns an AgentPool can instead
+	 * release() the agent in ModuleInterface::destroyAgent(), and acquire() it again in ModuleInterface::createAgent(),
+	 * only allocating a new agent if the pool is empty:
+	 * \code
+	 * SteerLib::AgentInterface * MyAIModule::createAgent() {
+	 *     MyAgent * agent = _agentPool.acquire();
+	 *     return (agent != NULL) ? agent : new MyAgent(this);
+	 * }
+	 * void MyAIModule::destroyAgent( SteerLib::AgentInterface * agent ) { _agentPool.release(dynamic_cast<MyAgent*>(agent)); }
+	 * \endcode
+	 *
+	 * Released agents are disabled, so that they are no longer in the spatial database, and the engine calls reset()
+	 * on every agent it creates; an agent can only be pooled if its reset() initializes <b>all</b> of its state, not only
+	 * what the initial conditions describe.  The pool deletes its agents when it is destroyed or cleared, so a module
+	 * should clear() it in ModuleInterface::finish(), while the spatial database still exists.
+	 *
+	 * An AgentPool is not thread-safe; the engine creates and destroys agents from the main thread only.
+	 */
+	template < typename AgentType >
+	class AgentPool {
+	public:
+		AgentPool() : _numAgentsReused(0) { }
+		~AgentPool() { clear(); }
+
+		/// Returns an agent that was released before, or NULL if there is none; the agent must be reset() before it is used.
+		AgentType * acquire() {
+			if (_freeAgents.empty()) {
+				return NULL;
+			}
+			AgentType * agent = _freeAgents.back();
+			_freeAgents.pop_back();
+			_numAgentsReused++;
+			return agent;
+		}
+
+		/// Takes an agent that is no longer in the simulation, and disables it if it is still enabled.
+		void release(AgentType * agent) {
+			if (agent == NULL) {
+				return;
+			}
+			if (agent->enabled()) {
+				agent->disable();
+			}
+			_freeAgents.push_back(agent);
+		}
+
+		/// Deletes all agents in the pool.
+		void clear() {
+			for (unsigned int i=0; i < _freeAgents.size(); i++) {
+				delete _freeAgents[i];
+			}
+			_freeAgents.clear();
+		}
+
+		/// Returns the number of agents waiting to be reused.
+		inline unsigned int size() const { return (unsigned int)_freeAgents.size(); }
+		/// Returns how many times acquire() returned an agent instead of NULL.
+		inline unsigned int getNumAgentsReused() const { return _numAgentsReused; }
+
+	protected:
+		std::vector<AgentType*> _freeAgents;
+		unsigned int _numAgentsReused;
+
+	private:
+		// pooled agents are owned by exactly one pool.
+		AgentPool(const AgentPool & );  // not implemented, not copyable
+		AgentPool & operator= (const AgentPool & );  // not implemented, not assignable
+	};
+
+} // end namespace SteerLib
+
+#endif
@@ -0,0 +1,143 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+#ifndef __STEERLIB_AGENT_REGISTRY_H__
+#define __STEERLIB_AGENT_REGISTRY_H__
+
+/// @file AgentRegistry.h
+/// @brief Declares SteerLib::AgentRegistry, the engine's record of all agents and their owners, and SteerLib::AgentHandle.
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+#include "Globals.h"
+#include "util/RandomStream.h"
+
+#ifdef _WIN32
+// on win32, there is an unfortunate conflict between exporting symbols for a
+// dynamic/shared library and STL code.  A good document describing the problem
+// in detail is http://www.unknownroad.com/rtfm/VisualStudio/warningC4251.html
+// the "least evil" solution is just to simply ignore this warning.
+#pragma warning( push )
+#pragma warning( disable : 4251 )
+#endif
+
+namespace SteerLib {
+
+	// forward declarations
+	class STEERLIB_API AgentInterface;
+	class STEERLIB_API ModuleInterface;
+
+	/**
+	 * @brief Refers to an agent without pointing to it.
+	 *
+	 * A handle stays valid for as long as its agent is known to the engine.  After the agent is removed,
+	 * the handle is stale: looking it up returns NULL, even if another agent was added in the same slot since.
+	 * This makes handles safe to keep across frames, unlike pointers to agents that may have been destroyed.
+	 */
+	struct AgentHandle {
+		AgentHandle() : index(0xffffffffu), generation(0) { }
+		AgentHandle(unsigned int newIndex, unsigned int newGeneration) : index(newIndex), generation(newGeneration) { }
+		/// Returns true if the handle never referred to any agent.
+		inline bool isNull() const { return index == 0xffffffffu; }
+		inline bool operator==(const AgentHandle & other) const { return (index == other.index) && (generation == other.generation); }
+		inline bool operator!=(const AgentHandle & other) const { return !(*this == other); }
+		/// the slot of the agent in the AgentRegistry.
+		unsigned int index;
+		/// how many times the slot was used before; distinguishes the agent from earlier agents in the same slot.
+		unsigned int generation;
+	};
+
+	/**
+	 * @brief Keeps track of agents and the modules that own them, with constant-time insertion and removal.
+	 *
+	 * The registry is a slot map: every agent occupies a slot, and the slots of removed agents are reused.
+	 * Each slot counts how often it was reused, so that an AgentHandle to a removed agent can be recognized.
+	 *
+	 * Besides the slots, the registry keeps a dense list of all agents, which is what the engine iterates over
+	 * and what SteerLib::EngineInterface::getAgents() returns.  Removing an agent moves the last agent of the
+	 * dense list into its place, so the order of agents is not preserved, exactly as if the agent were
+	 * swapped with the last element of a std::vector and popped.  The registry also keeps a list of agents
+	 * for every owner, so that all agents of one module can be found without looking at the others.
+	 *
+	 * Finding the slot of an agent pointer uses a hash table; all other operations use only array indexing.
+	 */
+	class STEERLIB_API AgentRegistry {
+	public:
+		AgentRegistry() : _firstFreeSlot(NO_SLOT), _numAgentsAdded(0) { }
+
+		/// Records a new agent and its owner, and returns its handle; throws an exception if the agent is already known.
+		AgentHandle add(SteerLib::AgentInterface * agent, SteerLib::ModuleInterface * owner);
+		/// Forgets an agent and returns its owner; throws an exception if the agent is not known.
+		SteerLib::ModuleInterface * remove(SteerLib::AgentInterface * agent);
+		/// Forgets all agents, and invalidates all handles.
+		void clear();
+
+		/// @name Queries
+		//@{
+		/// Returns true if the agent is known.
+		inline bool contains(const SteerLib::AgentInterface * agent) const { return _slotOfAgent.find(agent) != _slotOfAgent.end(); }
+		/// Returns the number of agents.
+		inline unsigned int size() const { return (unsigned int)_agents.size(); }
+		/// Returns all agents, in a dense list.
+		inline const std::vector<SteerLib::AgentInterface*> & getAgents() const { return _agents; }
+		/// Returns the module that owns the agent, or NULL if the agent is not known.
+		SteerLib::ModuleInterface * getOwner(const SteerLib::AgentInterface * agent) const;
+		/// Returns the handle of the agent, or a null handle if the agent is not known.
+		AgentHandle getHandle(const SteerLib::AgentInterface * agent) const;
+		/// Returns the agent the handle refers to, or NULL if the handle is null or stale.
+		SteerLib::AgentInterface * getAgent(const AgentHandle & handle) const;
+		/// Returns the agents owned by a module, in no particular order; the list is empty if the module owns no agents.
+		const std::vector<SteerLib::AgentInterface*> & getAgentsOfOwner(SteerLib::ModuleInterface * owner) const;
+		/// Returns the position of the agent in getAgents(); the agent must be known.
+		inline unsigned int getDenseIndex(const SteerLib::AgentInterface * agent) const { return _slots[_slotOfAgent.find(agent)->second].denseIndex; }
+		/// Returns how many agents were added before this one since the registry was cleared; unlike the slot, this number is not reused until setNextSerialNumber() is called.
+		inline unsigned int getSerialNumber(const SteerLib::AgentInterface * agent) const { return _slots[_slotOfAgent.find(agent)->second].serialNumber; }
+		/// Returns the serial number the next agent will get.
+		inline unsigned int getNextSerialNumber() const { return _numAgentsAdded; }
+		//@}
+
+		/// Sets the serial number the next agent will get, e.g. to start over when a new simulation is loaded.
+		inline void setNextSerialNumber(unsigned int serialNumber) { _numAgentsAdded = serialNumber; }
+
+		/// Returns the agent's own random number stream, which the engine derives from the agent's serial number; the agent must be known.
+		inline Util::RandomStream & getRandomStream(const SteerLib::AgentInterface * agent) { return _slots[_slotOfAgent.find(agent)->second].randomStream; }
+
+	protected:
+		static const unsigned int NO_SLOT = 0xffffffffu;
+
+		struct Slot {
+			/// the agent in this slot, or NULL if the slot is free.
+			SteerLib::AgentInterface * agent;
+			SteerLib::ModuleInterface * owner;
+			unsigned int generation;
+			/// position of the agent in _agents.
+			unsigned int denseIndex;
+			/// position of the agent in the owner's list in _agentsOfOwner.
+			unsigned int ownerIndex;
+			/// the next free slot, if this slot is free.
+			unsigned int nextFreeSlot;
+			unsigned int serialNumber;
+			Util::RandomStream randomStream;
+		};
+
+		std::vector<Slot> _slots;
+		unsigned int _firstFreeSlot;
+		unsigned int _numAgentsAdded;
+		/// all agents, and the slot of each one at the same position.
+		std::vector<SteerLib::AgentInterface*> _agents;
+		std::vector<unsigned int> _slotOfDenseIndex;
+		std::unordered_map<const SteerLib::AgentInterface*, unsigned int> _slotOfAgent;
+		std::map<SteerLib::ModuleInterface*, std::vector<SteerLib::AgentInterface*> > _agentsOfOwner;
+	};
+
+} // end namespace SteerLib
+
+#ifdef _WIN32
+#pragma warning( pop )
+#endif
+
+#endif
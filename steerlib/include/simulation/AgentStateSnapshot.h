@@ -0,0 +1,96 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+#ifndef __STEERLIB_AGENT_STATE_SNAPSHOT_H__
+#define __STEERLIB_AGENT_STATE_SNAPSHOT_H__
+
+/// @file AgentStateSnapshot.h
+/// @brief Declares the SteerLib::AgentStateSnapshot class, a frozen per-frame copy of all agents' state.
+
+#include <vector>
+#include <utility>
+
+#include "Globals.h"
+#include "util/Geometry.h"
+
+#ifdef _WIN32
+// on win32, there is an unfortunate conflict between exporting symbols for a
+// dynamic/shared library and STL code.  A good document describing the problem
+// in detail is http://www.unknownroad.com/rtfm/VisualStudio/warningC4251.html
+// the "least evil" solution is just to simply ignore this warning.
+#pragma warning( push )
+#pragma warning( disable : 4251 )
+#endif
+
+namespace SteerLib {
+
+	// forward declaration
+	class STEERLIB_API AgentInterface;
+
+	/// The state of one agent, as it was when an AgentStateSnapshot was captured.
+	struct FrozenAgentState {
+		Util::Point position;
+		Util::Vector forward;
+		Util::Vector velocity;
+		float radius;
+		bool enabled;
+		/// Index of the agent in the engine's list of agents when the snapshot was captured; useful as a repeatable ordering of agents.
+		unsigned int index;
+	};
+
+	/**
+	 * @brief A double-buffered, read-only copy of the state of all agents.
+	 *
+	 * The engine captures a snapshot at the start of every frame in which some agent uses the two-phase
+	 * AgentInterface::decideAI() / AgentInterface::commitAI() contract.  During decideAI(), agents should read
+	 * other agents' state through this snapshot instead of the live accessors, so that the decision does not
+	 * depend on which agents were already updated, or on what other threads are doing.
+	 *
+	 * capture() fills the back buffer and then swaps, so that the previous frame remains available
+	 * through getPreviousState() and readers never observe a half-written snapshot.
+	 *
+	 * All const functions are safe to call from several threads at once, as long as capture() is not running.
+	 */
+	class STEERLIB_API AgentStateSnapshot {
+	public:
+		AgentStateSnapshot();
+		/// Copies the state of the given agents into the back buffer and makes it the current snapshot.
+		void capture(const std::vector<SteerLib::AgentInterface*> & agents);
+		/// Empties both buffers.
+		void clear();
+		/// Returns the frozen state of the agent in the current snapshot, or NULL if the agent was not captured.
+		const FrozenAgentState * getState(const SteerLib::AgentInterface * agent) const { return _findState(_buffers[_front], agent); }
+		/// Returns the frozen state of the agent in the snapshot before the current one, or NULL if the agent was not captured then.
+		const FrozenAgentState * getPreviousState(const SteerLib::AgentInterface * agent) const { return _findState(_buffers[1-_front], agent); }
+		/// Returns the number of agents in the current snapshot.
+		inline unsigned int getNumAgents() const { return (unsigned int)_buffers[_front].states.size(); }
+		/// Returns the frozen state of the i-th agent in the current snapshot.
+		inline const FrozenAgentState & getStateByIndex(unsigned int i) const { return _buffers[_front].states[i]; }
+		/// Returns the radius of the largest agent in the current snapshot, or 0 if it is empty; useful to bound searches for agents that touch.
+		inline float getMaxRadius() const { return _buffers[_front].maxRadius; }
+
+	protected:
+		/// One of the two buffers; agents are looked up by binary search over a list sorted by address.
+		struct Buffer {
+			std::vector<const SteerLib::AgentInterface*> agents;
+			std::vector<FrozenAgentState> states;
+			std::vector< std::pair<const SteerLib::AgentInterface*, unsigned int> > sortedIndex;
+			float maxRadius;
+		};
+
+		const FrozenAgentState * _findState(const Buffer & buffer, const SteerLib::AgentInterface * agent) const;
+
+		Buffer _buffers[2];
+		/// Index of the buffer that holds the current snapshot.
+		unsigned int _front;
+	};
+
+} // end namespace SteerLib
+
+#ifdef _WIN32
+#pragma warning( pop )
+#endif
+
+#endif
@@ -0,0 +1,190 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+#ifndef __STEERLIB_CHECKPOINT_H__
+#define __STEERLIB_CHECKPOINT_H__
+
+/// @file Checkpoint.h
+/// @brief Declares SteerLib::CheckpointWriter and SteerLib::CheckpointReader, which store simulation state in a compact binary checkpoint.
+
+#include <string>
+#include <vector>
+#include <map>
+#include <queue>
+#include <memory>
+#include <cstring>
+
+#include "Globals.h"
+#include "util/GenericException.h"
+#include "testcaseio/AgentInitialConditions.h"
+
+#ifdef _WIN32
+// on win32, there is an unfortunate conflict between exporting symbols for a
+// dynamic/shared library and STL code.  A good document describing the problem
+// in detail is http://www.unknownroad.com/rtfm/VisualStudio/warningC4251.html
+// the "least evil" solution is just to simply ignore this warning.
+#pragma warning( push )
+#pragma warning( disable : 4251 )
+#endif
+
+namespace SteerLib {
+
+	// forward declaration
+	class STEERLIB_API SpatialDatabaseItem;
+
+	/**
+	 * @brief Accumulates simulation state in memory, to be saved as a binary checkpoint.
+	 *
+	 * Values are appended in the host's native binary format, so a checkpoint is only meant to be restored
+	 * on the same kind of machine and with the same build that saved it.  write() and writeVector() are only
+	 * valid for plain data types without pointers, such as numbers, Util::Point and Util::Vector.
+	 *
+	 * Pointers to agents and obstacles cannot be stored directly; instead, writeItemReference() stores the
+	 * index the engine gave the item with addItem().  The SteerLib::CheckpointReader maps the index back to the
+	 * corresponding item of the restored simulation.
+	 *
+	 * Blocks (beginBlock() and endBlock()) are prefixed with their size, so that the reader can detect an agent
+	 * or module that does not read back exactly what it wrote.
+	 *
+	 * @see
+	 *  - SteerLib::SimulationEngine::saveCheckpoint()
+	 *  - SteerLib::AgentInterface::writeCheckpoint()
+	 */
+	class STEERLIB_API CheckpointWriter {
+	public:
+		CheckpointWriter() { }
+
+		/// @name Writing values
+		//@{
+		/// Appends a plain data value.
+		template <typename T> void write(const T & value) { _append(&value, sizeof(T)); }
+		/// Appends a vector of plain data values, preceded by its length.
+		template <typename T> void writeVector(const std::vector<T> & values) {
+			write((unsigned int)values.size());
+			if (!values.empty()) _append(&values[0], sizeof(T) * values.size());
+		}
+		/// Appends a string, preceded by its length.
+		void writeString(const std::string & value);
+		/// Appends one goal, including its behaviour.
+		void writeGoal(const SteerLib::AgentGoalInfo & goal);
+		/// Appends all goals of a queue, in order.
+		void writeGoalQueue(const std::queue<SteerLib::AgentGoalInfo> & goals);
+		/// Appends a reference to an item that was registered with addItem(); NULL is allowed.
+		void writeItemReference(const SteerLib::SpatialDatabaseItem * item);
+		//@}
+
+		/// @name Blocks
+		//@{
+		/// Starts a block; blocks may be nested.
+		void beginBlock();
+		/// Ends the innermost block, recording its size at its beginning.
+		void endBlock();
+		//@}
+
+		/// Gives the next index to an item, so that writeItemReference() can refer to it.
+		void addItem(const SteerLib::SpatialDatabaseItem * item);
+		/// Returns the number of bytes written so far.
+		inline size_t getSize() const { return _data.size(); }
+		/// Returns everything written so far, without the file header; see CheckpointReader::loadFromMemory().
+		inline const std::vector<char> & getData() const { return _data; }
+		/// Saves everything written so far to a file, with a header that identifies the format.
+		void saveToFile(const std::string & filename);
+
+	protected:
+		inline void _append(const void * bytes, size_t numBytes) {
+			size_t offset = _data.size();
+			_data.resize(offset + numBytes);
+			if (numBytes != 0) memcpy(&_data[offset], bytes, numBytes);
+		}
+
+		std::vector<char> _data;
+		/// offsets of the size fields of blocks that were started but not ended yet.
+		std::vector<size_t> _openBlocks;
+		std::map<const SteerLib::SpatialDatabaseItem*, unsigned int> _itemIndices;
+	};
+
+
+	/**
+	 * @brief Reads back simulation state that was stored by a SteerLib::CheckpointWriter.
+	 *
+	 * Every value must be read with the function corresponding to the one that wrote it, in the same order.
+	 * Reading past the end of the checkpoint, or reading a different amount of data than a block contains,
+	 * throws a Util::GenericException.
+	 *
+	 * Before item references can be read, the items of the restored simulation must be registered with addItem(),
+	 * in the same order the writer registered the items they replace.
+	 */
+	class STEERLIB_API CheckpointReader {
+	public:
+		CheckpointReader() : _data(new std::vector<char>()), _position(0) { }
+
+		/// @name Reading values
+		//@{
+		/// Reads a plain data value.
+		template <typename T> void read(T & value) { _extract(&value, sizeof(T)); }
+		/// Reads a vector of plain data values written by CheckpointWriter::writeVector().
+		template <typename T> void readVector(std::vector<T> & values) {
+			unsigned int size;
+			read(size);
+			_checkAvailable((size_t)size * sizeof(T));
+			values.resize(size);
+			if (size != 0) _extract(&values[0], sizeof(T) * size);
+		}
+		/// Reads a string written by CheckpointWriter::writeString().
+		void readString(std::string & value);
+		/// Reads a goal written by CheckpointWriter::writeGoal().
+		void readGoal(SteerLib::AgentGoalInfo & goal);
+		/// Replaces the contents of a queue with the goals written by CheckpointWriter::writeGoalQueue().
+		void readGoalQueue(std::queue<SteerLib::AgentGoalInfo> & goals);
+		/// Reads a reference written by CheckpointWriter::writeItemReference(), and returns the corresponding item.
+		SteerLib::SpatialDatabaseItem * readItemReference();
+		//@}
+
+		/// @name Blocks
+		//@{
+		/// Starts reading a block.
+		void beginBlock();
+		/// Finishes reading the innermost block; throws if it was not read exactly to its end.
+		void endBlock();
+		/// Skips over a whole block without reading it.
+		void skipBlock();
+		//@}
+
+		/// Registers the item that the next index refers to; see CheckpointWriter::addItem().
+		void addItem(SteerLib::SpatialDatabaseItem * item);
+		/// Returns true if everything in the checkpoint has been read.
+		inline bool isAtEnd() const { return _position == _data->size(); }
+		/// Loads a checkpoint file saved by CheckpointWriter::saveToFile(), and starts reading at its beginning.
+		void loadFromFile(const std::string & filename);
+		/// Starts reading data returned by CheckpointWriter::getData(); the data is shared, not copied, so several readers can restore the same checkpoint at once.
+		void loadFromMemory(const std::shared_ptr<const std::vector<char> > & data);
+
+	protected:
+		inline void _checkAvailable(size_t numBytes) {
+			if (numBytes > _data->size() - _position) {
+				throw Util::GenericException("The checkpoint ends unexpectedly; it may be truncated, or it may have been saved by a different version.");
+			}
+		}
+		inline void _extract(void * bytes, size_t numBytes) {
+			_checkAvailable(numBytes);
+			if (numBytes != 0) memcpy(bytes, &(*_data)[_position], numBytes);
+			_position += numBytes;
+		}
+
+		/// the checkpoint being read; never modified, so it may be shared with other readers.
+		std::shared_ptr<const std::vector<char> > _data;
+		size_t _position;
+		/// offsets where the blocks that are being read end.
+		std::vector<size_t> _openBlocks;
+		std::vector<SteerLib::SpatialDatabaseItem*> _items;
+	};
+
+} // namespace SteerLib
+
+#ifdef _WIN32
+#pragma warning( pop )
+#endif
+
+#endif
@@ -18,6 +18,7 @@
 #include "Globals.h"
 
 #include "util/HighResCounter.h"
+#include "simulation/Checkpoint.h"
 
 #ifndef _WIN32
 // win32 does not define "std::max", instead they define "max" as a macro.
@@ -198,9 +199,9 @@ namespace SteerLib {
 		/// Returns the mode of the simulation clock
 		inline ClockModeEnum getClockMode() { return _clockMode; }
 		/// Returns the total <em>simulation</em> time elapsed from frame 0 to the current frame.
-		inline float getCurrentSimulationTime() { return _counterTicksToSeconds(_totalSimulationTime); }
+		inline float getCurrentSimulationTime() { return (float)_totalSimulationTime; }
 		/// Returns the <em>simulation</em> time-step of the last frame
-		inline float getSimulationDt() { return _counterTicksToSeconds(_simulationDt); }
+		inline float getSimulationDt() { return _simulationDt; }
 		/// Returns the current <em>real</em> time, which is also the total real-time elapsed since the clock was reset.
 		inline float getCurrentRealTime() { return _counterTicksToSeconds(_totalRealTime); }
 		/// Returns the total <em>real</em> time elapsed in real-time since last frame.
@@ -209,6 +210,10 @@ namespace SteerLib {
 		inline float getRealFps() { return _measuredFps; }
 		/// Returns the current frame number; the first frame is frame 0 before advanceOneStep() is called.
 		inline unsigned int getCurrentFrameNumber() { return _simulationFrameNumber; }
+		/// Returns true if the clock waits for real time between frames, i.e. if the frames have a real-time budget.
+		inline bool hasFrameDeadline() { return (_clockMode == CLOCK_MODE_FIXED_REAL_TIME) || (_clockMode == CLOCK_MODE_VARIABLE_REAL_TIME); }
+		/// Returns the value of Util::getHighResCounterValue() at which the next frame is due, or 0 if the clock does not wait for real time.
+		unsigned long long getFrameDeadline();
 		//@}
 
 		/// @name Accessor "set" functions
@@ -220,10 +225,22 @@ namespace SteerLib {
 		void setClockMode(ClockModeEnum clockMode, float fixedFps, float minSimulationDt, float maxSimulationDt);
 		//@}
 
+		/// @name Checkpointing
+		//@{
+		/// Writes the simulation frame number and simulation time; real time is not stored, it keeps running from wherever it is when the checkpoint is restored.
+		void writeCheckpoint(SteerLib::CheckpointWriter & out);
+		/// Restores the simulation frame number and simulation time written by writeCheckpoint().
+		void readCheckpoint(SteerLib::CheckpointReader & in);
+		//@}
+
 	protected:
 		/// @name Protected helper functions
 		//@{
 		void _waitForFrameSync(const unsigned long long & minDesiredTicks);
+		/// Returns the real time a frame should take at least, in counter ticks; only meaningful if hasFrameDeadline() is true.
+		inline unsigned long long _getMinTicksPerFrame() { return (_clockMode == CLOCK_MODE_FIXED_REAL_TIME) ? _fixedTicksPerFrame : _minSimulationDt; }
+		/// Sets _simulationDt for the next step according to the clock mode.
+		void _computeSimulationDt();
 		void _updateFpsMeasurement();
 		inline float _counterTicksToSeconds(unsigned long long ticks) {
 			return (float)ticks * _inverseFrequency;
@@ -248,8 +265,9 @@ namespace SteerLib {
 		unsigned long long _baseTick;
 		unsigned long long _totalRealTime;
 		unsigned long long _realDt;
-		unsigned long long _totalSimulationTime;
-		unsigned long long _simulationDt;
+		/// simulation time is kept in seconds, so that it does not depend on the measured counter frequency.
+		double _totalSimulationTime;
+		float _simulationDt;
 
 		unsigned long long _fixedTicksPerFrame;
 		unsigned long long _minSimulationDt;
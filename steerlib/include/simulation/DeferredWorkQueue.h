@@ -0,0 +1,140 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+#ifndef __STEERLIB_DEFERRED_WORK_QUEUE_H__
+#define __STEERLIB_DEFERRED_WORK_QUEUE_H__
+
+/// @file DeferredWorkQueue.h
+/// @brief Declares SteerLib::DeferredWorkQueue, which runs work that can wait in the spare time at the end of real-time frames.
+
+#include <vector>
+#include <map>
+#include <mutex>
+#include <functional>
+
+#include "Globals.h"
+
+#ifdef _WIN32
+// on win32, there is an unfortunate conflict between exporting symbols for a
+// dynamic/shared library and STL code.  A good document describing the problem
+// in detail is http://www.unknownroad.com/rtfm/VisualStudio/warningC4251.html
+// the "least evil" solution is just to simply ignore this warning.
+#pragma warning( push )
+#pragma warning( disable : 4251 )
+#endif
+
+namespace SteerLib {
+
+	// forward declaration
+	class STEERLIB_API AgentInterface;
+
+	/**
+	 * @brief Runs deferrable work, most important first, until a frame's real-time budget is used up.
+	 *
+	 * When the clock runs in one of the real-time modes, every frame has a deadline.  Some work of an agent,
+	 * such as re-planning a path it is already following, does not have to happen on the frame it was
+	 * scheduled for.  Agents can hand such work to the engine's queue (see SteerLib::EngineInterface::getDeferredWorkQueue())
+	 * instead of doing it inside updateAI(); after all agents are updated, the engine runs queued work, highest
+	 * priority first, for as long as the frame's deadline has not passed, and the clock then sleeps for whatever
+	 * time remains.  On frames that are already late, the queued work simply waits.
+	 *
+	 * So that no agent waits forever, work that was queued maxDeferredFrames frames ago runs regardless of the
+	 * deadline.  The queue counts how often this happens for each agent, so starved agents can be reported.
+	 *
+	 * When the clock runs as fast as possible there is no deadline, and isDeferring() returns false; callers
+	 * should then do their work right away, so that the results do not depend on real time.
+	 *
+	 * defer() may be called from updateAI() on any of the engine's worker threads.  All other functions must be
+	 * called from the main thread while no agents are being updated.  Queued work may defer more work.
+	 */
+	class STEERLIB_API DeferredWorkQueue {
+	public:
+		/// The work to run later.
+		typedef std::function<void()> WorkFunction;
+
+		/// How often the work of an agent had to run because it waited too long.
+		struct StarvationInfo {
+			StarvationInfo() : numTimesStarved(0), maxFramesWaited(0) { }
+			unsigned int numTimesStarved;
+			unsigned int maxFramesWaited;
+		};
+
+		DeferredWorkQueue() : _deferring(false), _maxDeferredFrames(10), _nextSequenceNumber(0), _numItemsRun(0), _numItemsForced(0), _maxFramesWaited(0) { }
+
+		/// @name Queueing work
+		//@{
+		/// Returns true if work should be deferred; if false, callers should do the work right away instead.
+		inline bool isDeferring() const { return _deferring; }
+		/// Queues work of an agent, which was scheduled for the given frame; work with a higher priority runs first.  Thread-safe.
+		void defer(SteerLib::AgentInterface * agent, float priority, unsigned int frameNumber, const WorkFunction & work);
+		/// Drops all queued work of an agent; the engine calls this when the agent is destroyed or removed.
+		void cancel(const SteerLib::AgentInterface * agent);
+		/// Returns the number of queued work items.
+		inline unsigned int getNumPending() const { return (unsigned int)_items.size(); }
+		//@}
+
+		/// @name Running work
+		//@{
+		/// Runs all work that waited too long, then the rest in order of priority until Util::getHighResCounterValue() reaches deadline; returns the number of items that ran.
+		unsigned int runUntil(unsigned long long deadline, unsigned int currentFrameNumber);
+		/// Runs all queued work, e.g. before a checkpoint is written; returns the number of items that ran.
+		unsigned int runAll(unsigned int currentFrameNumber);
+		//@}
+
+		/// @name Settings and statistics
+		//@{
+		/// Sets whether work should be deferred at all; the engine enables this in the real-time clock modes.
+		inline void setDeferring(bool deferring) { _deferring = deferring; }
+		/// Sets how many frames work may wait before it runs regardless of the deadline.
+		inline void setMaxDeferredFrames(unsigned int maxDeferredFrames) { _maxDeferredFrames = maxDeferredFrames; }
+		inline unsigned int getMaxDeferredFrames() const { return _maxDeferredFrames; }
+		/// Returns the number of work items that ran so far, including those that were forced to run.
+		inline unsigned int getNumItemsRun() const { return _numItemsRun; }
+		/// Returns the number of work items that waited too long, and ran regardless of the deadline.
+		inline unsigned int getNumItemsForced() const { return _numItemsForced; }
+		/// Returns the most frames any work item waited.
+		inline unsigned int getMaxFramesWaited() const { return _maxFramesWaited; }
+		/// Returns, for every agent whose work waited too long at least once, how often that happened; the agents may have been destroyed since.
+		inline const std::map<const SteerLib::AgentInterface*, StarvationInfo> & getStarvedAgents() const { return _starvedAgents; }
+		/// Drops all queued work and all statistics.
+		void clear();
+		//@}
+
+	protected:
+		struct Item {
+			SteerLib::AgentInterface * agent;
+			float priority;
+			unsigned int frameDeferred;
+			/// the order in which items were queued; among items of the same priority, the oldest runs first.
+			unsigned long long sequenceNumber;
+			WorkFunction work;
+		};
+		/// Orders items for a max-heap, so the item that should run first is at the front.
+		static bool _runsLater(const Item & a, const Item & b);
+		/// Runs one item that was already taken out of the queue, and records how long it waited.
+		void _runItem(Item & item, unsigned int currentFrameNumber, bool forced);
+
+		bool _deferring;
+		unsigned int _maxDeferredFrames;
+		/// the queued items, as a heap ordered by _runsLater().
+		std::vector<Item> _items;
+		std::mutex _itemsMutex;
+		unsigned long long _nextSequenceNumber;
+
+		unsigned int _numItemsRun;
+		unsigned int _numItemsForced;
+		unsigned int _maxFramesWaited;
+		std::map<const SteerLib::AgentInterface*, StarvationInfo> _starvedAgents;
+		/// scratch space for runUntil().
+		std::vector<Item> _itemsToRun;
+	};
+
+} // end namespace SteerLib
+
+#ifdef _WIN32
+#pragma warning( pop )
+#endif
+
+#endif
@@ -0,0 +1,145 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+#ifndef __STEERLIB_FRAME_TELEMETRY_H__
+#define __STEERLIB_FRAME_TELEMETRY_H__
+
+/// @file FrameTelemetry.h
+/// @brief Declares SteerLib::FrameTelemetry, a ring buffer of per-frame timings of the engine's phases.
+
+#include <string>
+#include <vector>
+#include <atomic>
+
+#include "Globals.h"
+
+#ifdef _WIN32
+// on win32, there is an unfortunate conflict between exporting symbols for a
+// dynamic/shared library and STL code.  A good document describing the problem
+// in detail is http://www.unknownroad.com/rtfm/VisualStudio/warningC4251.html
+// the "least evil" solution is just to simply ignore this warning.
+#pragma warning( push )
+#pragma warning( disable : 4251 )
+#endif
+
+namespace SteerLib {
+
+	/**
+	 * @brief Keeps the timings of the most recent frames, to find out where the time of a frame goes.
+	 *
+	 * When enabled (see the engine option telemetryFrames), the engine records one row of values for every
+	 * frame: how long the whole frame took, how long each module's preprocessFrame() and postprocessFrame()
+	 * took, how long the multi-rate tasks and the agents took, how many agents were active, how many
+	 * items the spatial database added or removed, and how much temporary data came from the per-frame
+	 * arenas.  Times are in ticks of Util::getHighResCounterValue(); getCounterFrequency() converts them
+	 * to seconds.
+	 *
+	 * Rows are kept in a fixed-size ring buffer, so that a long run only keeps its most recent frames,
+	 * and recording never allocates memory.  Each row has NUM_FRAME_FIELDS fields, followed by two fields
+	 * per module (preprocess and postprocess ticks), in the order of getModuleNames().
+	 *
+	 * Only the engine records rows, from the main thread; module timings may also be recorded from the
+	 * engine's worker threads.  Other threads may read rows with copyRecentFrames() at any time without
+	 * locking: the reader checks, after copying, which rows were overwritten in the meantime and drops them.
+	 * start() and stop() must not be called while another thread reads.
+	 */
+	class STEERLIB_API FrameTelemetry {
+	public:
+		/// The fields at the beginning of every row.
+		enum FrameFieldEnum {
+			FIELD_FRAME_NUMBER,
+			/// when the frame started, in ticks since start() was called.
+			FIELD_FRAME_START_TICKS,
+			FIELD_FRAME_TICKS,
+			/// all modules' preprocessFrame() together.
+			FIELD_PREPROCESS_TICKS,
+			/// the tasks of the engine's SteerLib::MultiRateScheduler.
+			FIELD_SCHEDULED_TASK_TICKS,
+			/// updating all agents, including the two-phase snapshot and commit.
+			FIELD_AGENT_TICKS,
+			/// all modules' postprocessFrame() together.
+			FIELD_POSTPROCESS_TICKS,
+			FIELD_NUM_ACTIVE_AGENTS,
+			/// the number of times the spatial database added or removed an item; moving an item counts twice.
+			FIELD_NUM_GRID_UPDATES,
+			/// the number of allocations from the engine's per-thread arenas (see SteerLib::EngineInterface::getFrameArena()).
+			FIELD_NUM_ARENA_ALLOCATIONS,
+			/// the number of bytes those allocations took.
+			FIELD_ARENA_BYTES,
+			NUM_FRAME_FIELDS
+		};
+
+		FrameTelemetry() : _capacity(0), _numFields(0), _currentRow(0), _numFramesRecorded(0), _frameInProgress(false), _startTick(0) { }
+
+		/// @name Setup
+		//@{
+		/// Allocates room for the given number of frames of the given modules, and forgets all frames recorded before.
+		void start(unsigned int capacity, const std::vector<std::string> & moduleNames);
+		/// Frees the ring buffer; nothing is recorded until start() is called again.
+		void stop();
+		/// Returns true between start() and stop().
+		inline bool isEnabled() const { return _capacity != 0; }
+		//@}
+
+		/// @name Recording
+		//@{
+		/// Starts the row of a new frame, with all fields zero except the frame number and start time; the row is not visible to readers until endFrame().
+		void beginFrame(unsigned int frameNumber, unsigned long long startTick);
+		/// Sets one field of the current row.
+		inline void set(unsigned int field, unsigned long long value) { _values[_currentRow + field].store(value, std::memory_order_relaxed); }
+		/// Sets the preprocess or postprocess ticks of a module, by its position in getModuleNames().
+		inline void setModuleTicks(unsigned int moduleIndex, bool preprocess, unsigned long long ticks) {
+			set(NUM_FRAME_FIELDS + 2*moduleIndex + (preprocess ? 0 : 1), ticks);
+		}
+		/// Makes the current row visible to readers.
+		inline void endFrame() {
+			_numFramesRecorded.store(_numFramesRecorded.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+			_frameInProgress.store(false, std::memory_order_release);
+		}
+		//@}
+
+		/// @name Reading
+		//@{
+		inline unsigned int getCapacity() const { return _capacity; }
+		/// Returns the number of values in every row.
+		inline unsigned int getNumFields() const { return _numFields; }
+		inline const std::vector<std::string> & getModuleNames() const { return _moduleNames; }
+		/// Returns the number of frames recorded since start(), including those that were overwritten since.
+		inline unsigned long long getNumFramesRecorded() const { return _numFramesRecorded.load(std::memory_order_acquire); }
+		/// Returns the ticks per second of the recorded times.
+		unsigned long long getCounterFrequency() const;
+		/// Copies up to maxFrames of the most recent rows, oldest first, one after another; returns the number of rows copied.
+		unsigned int copyRecentFrames(std::vector<unsigned long long> & values, unsigned int maxFrames) const;
+		/// Returns the name of a field, as used in the header of the CSV file.
+		std::string getFieldName(unsigned int field) const;
+		/// Writes all rows still in the buffer as CSV, with times in milliseconds.
+		void writeCSV(const std::string & filename) const;
+		/// Writes all rows still in the buffer in a compact binary format, with times in ticks; see the implementation for the layout.
+		void writeBinary(const std::string & filename) const;
+		/// Writes CSV if the file name ends in ".csv", and the binary format otherwise.
+		void writeToFile(const std::string & filename) const;
+		//@}
+
+	protected:
+		unsigned int _capacity;
+		unsigned int _numFields;
+		std::vector<std::string> _moduleNames;
+		/// _capacity rows of _numFields values each.
+		std::vector< std::atomic<unsigned long long> > _values;
+		/// the position in _values of the row being recorded.
+		unsigned int _currentRow;
+		std::atomic<unsigned long long> _numFramesRecorded;
+		/// true between beginFrame() and endFrame(), while the oldest row is being overwritten.
+		std::atomic<bool> _frameInProgress;
+		unsigned long long _startTick;
+	};
+
+} // end namespace SteerLib
+
+#ifdef _WIN32
+#pragma warning( pop )
+#endif
+
+#endif
@@ -0,0 +1,134 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+#ifndef __STEERLIB_MULTI_RATE_SCHEDULER_H__
+#define __STEERLIB_MULTI_RATE_SCHEDULER_H__
+
+/// @file MultiRateScheduler.h
+/// @brief Declares SteerLib::MultiRateScheduler, which runs work every N frames and staggers it across frames.
+
+#include <vector>
+#include <map>
+#include <set>
+#include <functional>
+
+#include "Globals.h"
+
+#ifdef _WIN32
+// on win32, there is an unfortunate conflict between exporting symbols for a
+// dynamic/shared library and STL code.  A good document describing the problem
+// in detail is http://www.unknownroad.com/rtfm/VisualStudio/warningC4251.html
+// the "least evil" solution is just to simply ignore this warning.
+#pragma warning( push )
+#pragma warning( disable : 4251 )
+#endif
+
+namespace Util {
+	// forward declaration
+	class UTIL_API WorkStealingScheduler;
+}
+
+namespace SteerLib {
+
+	/**
+	 * @brief Runs tasks at different rates, and spreads tasks of the same rate evenly across frames.
+	 *
+	 * Expensive work such as planning usually does not need to run every frame.  A task registered with an
+	 * interval of N runs on every N-th frame, on frames where (frameNumber % N) equals the task's offset.  Unless
+	 * a specific offset is requested, the scheduler gives each task the offset that the fewest tasks with the same
+	 * interval use so far, so that e.g. 1000 agents planning every 20 frames plan 50 at a time, instead of all
+	 * 1000 on the same frame.
+	 *
+	 * The engine owns one scheduler (see SteerLib::EngineInterface::getMultiRateScheduler()) and calls runTasks()
+	 * every frame, after the modules' preprocessFrame() and before the agents are updated.  Tasks registered as
+	 * concurrent may run on the engine's worker threads at the same time as each other, so they should only
+	 * modify the state of their own agent; all other tasks run one at a time, in a repeatable order.
+	 *
+	 * Agents that run their phases inside AgentInterface::updateAI(), like the PPR agent, can use only the
+	 * staggering: chooseOffset() gives an offset, and getNextFrame() the next frame with that offset.
+	 *
+	 * Tasks must be added and removed from the main thread, i.e. not from updateAI() when the engine uses worker
+	 * threads.  A task may remove itself while it runs.  Tasks are not saved in checkpoints; after a checkpoint is
+	 * restored, every task whose frame has passed runs once and then continues on its own offset.
+	 */
+	class STEERLIB_API MultiRateScheduler {
+	public:
+		/// The work of a task; called with the current simulation time, the time step and the frame number.
+		typedef std::function<void(float timeStamp, float dt, unsigned int frameNumber)> TaskFunction;
+
+		MultiRateScheduler() : _currentFrame(0) { }
+
+		/// @name Tasks
+		//@{
+		/// Adds a task that runs every interval frames, starting at the next frame with the least used offset; returns an ID for removeTask().
+		unsigned int addTask(unsigned int interval, const TaskFunction & task, bool concurrent);
+		/// Adds a task that runs on the frames where (frameNumber % interval) == offset; returns an ID for removeTask().
+		unsigned int addTaskWithOffset(unsigned int interval, unsigned int offset, const TaskFunction & task, bool concurrent);
+		/// Removes a task, so that it does not run again.
+		void removeTask(unsigned int taskID);
+		/// Returns the number of tasks that were added and not removed.
+		inline unsigned int getNumTasks() const { return (unsigned int)(_tasks.size() - _freeTaskIDs.size()); }
+		/// Runs all tasks that are due at this frame; the engine calls this once per frame.  The worker threads may be NULL.
+		void runTasks(float timeStamp, float dt, unsigned int frameNumber, Util::WorkStealingScheduler * workerThreads);
+		/// Removes all tasks and forgets all offsets that were chosen.
+		void clear();
+		//@}
+
+		/// @name Staggering
+		//@{
+		/// Returns the offset (less than interval) used by the fewest tasks and agents with that interval, and counts one more user of it.
+		unsigned int chooseOffset(unsigned int interval);
+		/// Gives back an offset returned by chooseOffset(), once it is no longer used.
+		void releaseOffset(unsigned int interval, unsigned int offset);
+		/// Returns the first frame after frameNumber on which (frame % interval) == offset.
+		static inline unsigned int getNextFrame(unsigned int frameNumber, unsigned int interval, unsigned int offset) {
+			if (interval <= 1) return frameNumber + 1;
+			unsigned int framesToOffset = (offset + interval - (frameNumber % interval)) % interval;
+			return frameNumber + ((framesToOffset == 0) ? interval : framesToOffset);
+		}
+		//@}
+
+	protected:
+		struct Task {
+			TaskFunction function;
+			unsigned int interval;
+			unsigned int offset;
+			unsigned int nextFrame;
+			bool concurrent;
+			bool active;
+			/// incremented when the task is removed, so that a reused ID is not mistaken for the removed task.
+			unsigned int generation;
+			/// true if the offset was chosen with chooseOffset(), and must be released when the task is removed.
+			bool ownsOffset;
+		};
+
+		unsigned int _addTask(unsigned int interval, unsigned int offset, bool ownsOffset, const TaskFunction & task, bool concurrent);
+		/// Puts the task in _dueTasks at the first frame after frameNumber with its offset.
+		void _scheduleTask(unsigned int taskID, unsigned int frameNumber);
+
+		std::vector<Task> _tasks;
+		std::vector<unsigned int> _freeTaskIDs;
+		/// the IDs of the tasks that are due at each frame, in the order they will run.
+		std::map<unsigned int, std::vector<unsigned int> > _dueTasks;
+		/// for each interval, the number of users of each offset, and the same sorted by (users, offset) to find the least used one.
+		struct OffsetLoad {
+			std::vector<unsigned int> numUsers;
+			std::set< std::pair<unsigned int, unsigned int> > byNumUsers;
+		};
+		std::map<unsigned int, OffsetLoad> _offsetLoad;
+		/// the frame number the most recent runTasks() was called with.
+		unsigned int _currentFrame;
+		/// scratch space for runTasks(); pairs of task ID and generation.
+		std::vector< std::pair<unsigned int, unsigned int> > _tasksToRun;
+		std::vector< std::pair<unsigned int, unsigned int> > _concurrentTasksToRun;
+	};
+
+} // end namespace SteerLib
+
+#ifdef _WIN32
+#pragma warning( pop )
+#endif
+
+#endif
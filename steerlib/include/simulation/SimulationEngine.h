@@ -15,6 +15,7 @@
 
 #include "interfaces/EngineInterface.h"
 #include "util/StateMachine.h"
+#include "util/WorkStealingScheduler.h"
 
 #define KEY_PRESSED 1
 
@@ -157,6 +158,25 @@ namespace SteerLib {
 		bool update( bool advanceRealTimeOnly );
 		/// stops execution
 		void stop();
+		/// Seeds the spatial database's random number generator, and derives the random streams of all modules and agents from the seed again; the randomSeed option is used until this is called.
+		void setRandomSeed(unsigned int seed);
+		//@}
+
+		/// @name Checkpointing
+		/// @brief A checkpoint holds the clock, every agent's internal state, the obstacles, the spatial database, and the state of modules that store any.
+		///
+		/// A checkpoint can only be restored into an engine that loaded the same modules and the same test case, and called preprocessSimulation();
+		/// the agents and obstacles created from the test case are then brought to the state they had when the checkpoint was saved.
+		/// All agents and modules must support checkpoints (see SteerLib::AgentInterface::supportsCheckpoints() and SteerLib::ModuleInterface::supportsCheckpoints()).
+		//@{
+		/// Saves the complete state of the simulation to a binary checkpoint file; can be called between two updates.
+		void saveCheckpoint(const std::string & filename);
+		/// Restores the simulation from a checkpoint file saved by saveCheckpoint(); can be called between two updates.
+		void restoreCheckpoint(const std::string & filename);
+		/// Writes the complete state of the simulation into a checkpoint kept in memory.
+		void writeCheckpoint(SteerLib::CheckpointWriter & out);
+		/// Restores the simulation from a checkpoint kept in memory.
+		void readCheckpoint(SteerLib::CheckpointReader & in);
 		//@}
 	#ifdef ENABLE_GUI
 		/// Handles keyboard input by forwarding the keyboard event to all modules.
@@ -173,8 +193,20 @@ namespace SteerLib {
 		/// @brief Modules have access to these functions of the engine; these functions are documented in the SteerLib::EngineInterface documentation.
 		//@{
 		virtual SteerLib::GridDatabase2D * getSpatialDatabase() { return _spatialDatabase; }
-		virtual const std::vector<SteerLib::AgentInterface*> & getAgents() { return _agents; }
+		virtual const std::vector<SteerLib::AgentInterface*> & getAgents() { return _agentRegistry.getAgents(); }
+		virtual const std::vector<SteerLib::AgentInterface*> & getAgentsOfModule(SteerLib::ModuleInterface * owner) { return _agentRegistry.getAgentsOfOwner(owner); }
+		virtual SteerLib::AgentHandle getAgentHandle(SteerLib::AgentInterface * agent) { return _agentRegistry.getHandle(agent); }
+		virtual SteerLib::AgentInterface * getAgent(const SteerLib::AgentHandle & handle) { return _agentRegistry.getAgent(handle); }
 		virtual const std::set<SteerLib::AgentInterface*> & getSelectedAgents() { return _selectedAgents; }
+		virtual const SteerLib::AgentStateSnapshot & getAgentStateSnapshot() { return _agentStateSnapshot; }
+		virtual SteerLib::MultiRateScheduler & getMultiRateScheduler() { return _multiRateScheduler; }
+		virtual SteerLib::DeferredWorkQueue & getDeferredWorkQueue() { return _deferredWork; }
+		virtual const SteerLib::FrameTelemetry & getFrameTelemetry() { return _frameTelemetry; }
+		virtual Util::RandomStream & getRandomStream(SteerLib::AgentInterface * agent) { return _agentRegistry.getRandomStream(agent); }
+		virtual Util::RandomStream & getModuleRandomStream(SteerLib::ModuleInterface * module) { return getModuleMetaInfo(module)->randomStream; }
+		virtual Util::FrameArena & getFrameArena();
+		virtual unsigned int getNumThreads() { return (_taskScheduler != NULL) ? _taskScheduler->getNumThreads() : 1; }
+		virtual unsigned int getIndexOfCurrentThread() { return (_taskScheduler != NULL) ? _taskScheduler->getIndexOfCurrentThread() : 0; }
 		virtual const std::set<SteerLib::ObstacleInterface*> & getObstacles() { return _obstacles; }
 		virtual SteerLib::ModuleInterface * getModule(const std::string & moduleName);
 		virtual SteerLib::ModuleMetaInformation * getModuleMetaInfo(const std::string & moduleName);
@@ -230,6 +262,51 @@ namespace SteerLib {
 		void _reset();
 		/// Runs one step of the simulation
 		bool _simulateOneStep();
+		/// Updates all enabled agents (updateAI(), or decideAI() then commitAI()) using the worker threads, and returns the number of finished agents.
+		unsigned int _updateAgentsInParallel(float currentSimulationTime, float simulationDt, unsigned int currentFrameNumber);
+		/// Runs one phase of the agent update for all active agents on the worker threads, and waits for it to finish.
+		void _runAgentPhaseInParallel(unsigned int phase, float currentSimulationTime, float simulationDt, unsigned int currentFrameNumber);
+		/// Calls preprocessFrame() or postprocessFrame() of all modules, running independent non-exclusive modules concurrently when there are worker threads.
+		void _runModulesFramePhase(bool preprocess, float currentSimulationTime, float simulationDt, unsigned int currentFrameNumber);
+		/// Calls preprocessFrame() or postprocessFrame() of one module, recording how long it took if telemetry is enabled.
+		void _runModuleFrameFunction(unsigned int moduleIndex, bool preprocess, float currentSimulationTime, float simulationDt, unsigned int currentFrameNumber);
+		/// Splits _modulesInExecutionOrder into the stages used by _runModulesFramePhase().
+		void _buildModuleFrameStages();
+		/// Returns the current counter value if telemetry is enabled, and 0 otherwise.
+		inline unsigned long long _getTelemetryTick() { return _frameTelemetry.isEnabled() ? Util::getHighResCounterValue() : 0; }
+		/// If telemetry is enabled, records the ticks since phaseStartTick in a field of the current frame, and sets phaseStartTick to now.
+		inline void _recordTelemetryPhase(unsigned int field, unsigned long long & phaseStartTick) {
+			if (_frameTelemetry.isEnabled()) {
+				unsigned long long now = Util::getHighResCounterValue();
+				_frameTelemetry.set(field, now - phaseStartTick);
+				phaseStartTick = now;
+			}
+		}
+		/// Keeps _numTwoPhaseAgents up to date when an agent is added to or removed from _agentRegistry.
+		inline void _countTwoPhaseAgent(SteerLib::AgentInterface * agent, bool added) {
+			if (agent->usesTwoPhaseUpdate()) {
+				if (added) _numTwoPhaseAgents++; else _numTwoPhaseAgents--;
+			}
+		}
+		/// Checks the agents in _inactiveAgents again, and starts _activeAgents over with all agents if agents were added,
+		/// removed, or enabled again since it was last built.
+		void _rebuildActiveAgentsIfNeeded();
+		/// Accounts for an agent that was just dropped from _activeAgents because it is disabled.
+		inline void _deactivateAgent(SteerLib::AgentInterface * agent) {
+			_inactiveAgents.push_back(agent);
+			// for most AIs finished() is the same as enabled(); ShadowAI overrides this behavior
+			if (agent->finished()) _numFinishedAgents++;
+		}
+		/// Throws an exception unless a checkpoint can be saved or restored right now.
+		void _checkCanUseCheckpoints();
+		/// Derives the random stream of an agent from _randomStreams and the agent's serial number, so that it does not depend on the agent's slot or on threads.
+		void _deriveAgentRandomStream(SteerLib::AgentInterface * agent);
+		/// Derives _randomStreams from _randomSeed, and derives the streams of all modules and agents from it again.
+		void _deriveRandomStreams();
+		/// Resets the arenas of all threads, and returns how many allocations and bytes they handed out since the last reset.
+		void _resetFrameArenas(unsigned long long & numAllocations, unsigned long long & numBytes);
+		/// Returns the obstacles in the order they are stored in checkpoints, which does not depend on where they are in memory.
+		void _getObstaclesInCheckpointOrder(std::vector<SteerLib::ObstacleInterface*> & obstacles);
 		/// Just for debugging, dumps out the contents of the engine's organizational data structures
 		void _dumpModuleDataStructures();
 		/// Returns an instance of a built-in module of name moduleName, or returns NULL if moduleName is not a built-in module.
@@ -248,6 +325,30 @@ namespace SteerLib {
 		void _drawAgents();
 	#endif
 
+		/// The phases of one agent update; legacy agents only take part in the first.
+		enum AgentUpdatePhaseEnum {
+			AGENT_PHASE_UPDATE_OR_DECIDE,
+			AGENT_PHASE_COMMIT
+		};
+
+		/// One module in a concurrent stage of the module frame graph.
+		struct ModuleFrameNode {
+			SteerLib::ModuleInterface * module;
+			/// position of the module in _modulesInExecutionOrder.
+			unsigned int moduleIndex;
+			/// indices (in the same stage) of the modules that may only start after this one is done.
+			std::vector<unsigned int> successors;
+			unsigned int numPredecessors;
+		};
+
+		/// @brief A group of modules whose frame functions run together.
+		///
+		/// Exclusive modules get a stage of their own.  Consecutive non-exclusive modules share a stage, where
+		/// the edges between nodes order modules that depend on each other or that may not overlap.
+		struct ModuleFrameStage {
+			std::vector<ModuleFrameNode> nodes;
+		};
+
 		class EngineStateMachineCallback : public Util::StateMachineCallbackInterface
 		{
 		public:
@@ -271,13 +372,28 @@ namespace SteerLib {
 		std::vector<SteerLib::ModuleInterface*> _modulesInExecutionOrder;
 		/// maps the name of a conflicting module to the module that declared it a conflict.
 		std::multimap<std::string, std::string> _moduleConflicts;
+		/// the modules in execution order, grouped into stages that may run concurrently; rebuilt when modules are loaded or unloaded.
+		std::vector<ModuleFrameStage> _moduleFrameStages;
+		bool _moduleFrameStagesNeedRebuild;
 		//@}
 
 		/// @name Data structures to keep track of agents
 		//@{
-		std::vector<SteerLib::AgentInterface*> _agents;
+		/// all agents, their owners, and their handles.
+		SteerLib::AgentRegistry _agentRegistry;
 		std::set<SteerLib::AgentInterface*> _selectedAgents;
-		std::map<SteerLib::AgentInterface*, SteerLib::ModuleInterface*> _agentOwners;
+		/// number of agents in _agentRegistry that use the two-phase decideAI()/commitAI() update.
+		unsigned int _numTwoPhaseAgents;
+		/// the agents that were enabled when they were last updated, in the same order as in _agentRegistry.
+		std::vector<SteerLib::AgentInterface*> _activeAgents;
+		/// the agents dropped from _activeAgents since it was last built; they are checked once per frame, without being updated.
+		std::vector<SteerLib::AgentInterface*> _inactiveAgents;
+		/// true if _activeAgents must be rebuilt before it is used again.
+		bool _activeAgentsNeedRebuild;
+		/// number of agents in _inactiveAgents whose finished() is true in the current frame; compared to the number of agents to see if all agents are done.
+		unsigned int _numFinishedAgents;
+		/// frozen agent state read during decideAI().
+		SteerLib::AgentStateSnapshot _agentStateSnapshot;
 		//@}
 
 		/// @name Other objects managed by the engine
@@ -288,6 +404,20 @@ namespace SteerLib {
 		SteerLib::GridDatabase2D * _spatialDatabase;
 		std::set<SteerLib::ObstacleInterface*> _obstacles;
 		SteerLib::EngineControllerInterface * _engineController;
+		/// Worker threads used to update agents; NULL when running with a single thread.
+		Util::WorkStealingScheduler * _taskScheduler;
+		/// Runs the tasks agents and modules registered to run every N frames.
+		SteerLib::MultiRateScheduler _multiRateScheduler;
+		/// Work of agents that runs in the spare time at the end of real-time frames.
+		SteerLib::DeferredWorkQueue _deferredWork;
+		/// Timings of the most recent frames; only recorded if the telemetryFrames option is not 0.
+		SteerLib::FrameTelemetry _frameTelemetry;
+		/// One arena of temporary data per thread, indexed like the threads of _taskScheduler; all are reset at the end of every frame.
+		std::vector<Util::FrameArena*> _frameArenas;
+		/// The seed of all random streams; see setRandomSeed().
+		unsigned int _randomSeed;
+		/// The stream all other random streams are split from; it is never drawn from itself.
+		Util::RandomStream _randomStreams;
 		//@}
 
 
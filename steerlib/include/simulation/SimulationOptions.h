@@ -261,6 +261,13 @@ namespace SteerLib {
 			float minVariableDt;
 			float maxVariableDt;
 			std::string clockMode;
+			unsigned int maxDeferredFrames;
+			unsigned int telemetryFrames;
+			std::string telemetryFilename;
+			std::string checkpointFilename;
+			unsigned int checkpointFrame;
+			std::string restoreCheckpointFilename;
+			unsigned int randomSeed;
 		};
 
 		struct GridDatabaseOptions {
@@ -270,6 +277,8 @@ namespace SteerLib {
 			unsigned int numGridCellsX;
 			unsigned int numGridCellsZ;
 			bool drawGrid;
+			bool rebuildAgentLayer;
+			bool mortonCellOrder;
 		};
 
 		struct GUIOptions {
@@ -306,6 +315,14 @@ namespace SteerLib {
 		struct QtEngineDriverOptions {
 		};
 
+		struct BatchEngineDriverOptions {
+			std::string manifestFilename;
+			std::string resultsFilename;
+			unsigned int numThreads;
+			unsigned int forkFrame;
+			bool reuseEngines;
+		};
+
 		/// @name Options data
 		/// @brief The actual options are stored in these public data structures.
 		///
@@ -327,6 +344,7 @@ namespace SteerLib {
 		CommandLineEngineDriverOptions   commandLineEngineDriverOptions;
 		GLFWEngineDriverOptions   glfwEngineDriverOptions;
 		QtEngineDriverOptions   qtEngineDriverOptions;
+		BatchEngineDriverOptions   batchEngineDriverOptions;
 		SteerLib::ModuleOptionsDatabase   moduleOptionsDatabase;
 		//@}
 
@@ -0,0 +1,187 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+#ifndef __UTIL_FRAME_ARENA_H__
+#define __UTIL_FRAME_ARENA_H__
+
+/// @file FrameArena.h
+/// @brief Declares Util::FrameArena, a bump allocator for temporary data that is freed all at once, and Util::ArenaAllocator, an STL allocator that uses it.
+
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <deque>
+#include <set>
+
+#include "Globals.h"
+
+#ifdef _WIN32
+// on win32, there is an unfortunate conflict between exporting symbols for a
+// dynamic/shared library and STL code.  A good document describing the problem
+// in detail is http://www.unknownroad.com/rtfm/VisualStudio/warningC4251.html
+// the "least evil" solution is just to simply ignore this warning.
+#pragma warning( push )
+#pragma warning( disable : 4251 )
+#endif
+
+namespace Util {
+
+	/**
+	 * @brief Hands out memory by moving a pointer forward in large blocks; all of it is freed at once by reset().
+	 *
+	 * Path planners and agents build many short-lived containers every frame (open lists, expanded nodes, paths
+	 * being smoothed).  Allocating those from an arena costs a pointer increment instead of a call to the heap, and
+	 * freeing them costs nothing: deallocation is ignored, and reset() makes all memory available again.
+	 *
+	 * The engine keeps one arena per thread, and resets all of them at the end of every frame, so memory taken from
+	 * SteerLib::EngineInterface::getFrameArena() is valid until the frame ends.  Nothing allocated from it may be used
+	 * in a later frame; containers that live longer should use the normal allocator.
+	 *
+	 * Blocks are kept by reset(), so after the first few frames an arena normally does not allocate from the heap
+	 * at all.  If a frame needed more than one block, reset() replaces them with a single block that is large enough.
+	 *
+	 * An arena is not thread-safe; each thread must use its own.
+	 */
+	class UTIL_API FrameArena {
+	public:
+		/// A position in the arena; see getMarker().
+		struct Marker {
+			unsigned int block;
+			size_t offset;
+		};
+
+		/// The arena allocates nothing until the first call to allocate(); blocks are at least blockSize bytes.
+		FrameArena(size_t blockSize = 64 * 1024);
+		~FrameArena();
+
+		/// Returns memory for numBytes bytes, aligned to alignment, which must be a power of two; valid until reset().
+		void * allocate(size_t numBytes, size_t alignment);
+		/// Makes all memory available again; everything allocated before must no longer be used.
+		void reset();
+		/// Frees the blocks, too.
+		void release();
+
+		/// Returns the current position, so that everything allocated after it can be freed early with rewind().
+		inline Marker getMarker() const { Marker marker; marker.block = _currentBlock; marker.offset = _currentOffset; return marker; }
+		/// Makes the memory allocated since getMarker() returned the marker available again; it must no longer be used.
+		inline void rewind(const Marker & marker) { _currentBlock = marker.block; _currentOffset = marker.offset; }
+
+		/// @name Statistics
+		//@{
+		/// Returns the number of calls to allocate() since the last reset().
+		inline unsigned int getNumAllocations() const { return _numAllocations; }
+		/// Returns the number of bytes handed out since the last reset(), including alignment padding.
+		inline size_t getNumBytesAllocated() const { return _numBytesAllocated; }
+		/// Returns the total size of the blocks the arena holds.
+		inline size_t getCapacity() const { return _capacity; }
+		//@}
+
+	protected:
+		struct Block {
+			char * memory;
+			size_t size;
+		};
+
+		/// Moves on to a block with room for numBytes bytes at the given alignment, allocating one if needed.
+		void _nextBlock(size_t numBytes, size_t alignment);
+
+		size_t _blockSize;
+		std::vector<Block> _blocks;
+		/// the block allocations come from, and the number of bytes already used in it.
+		unsigned int _currentBlock;
+		size_t _currentOffset;
+		size_t _capacity;
+		unsigned int _numAllocations;
+		size_t _numBytesAllocated;
+
+	private:
+		// the memory handed out belongs to exactly one arena.
+		FrameArena(const FrameArena & );  // not implemented, not copyable
+		FrameArena & operator= (const FrameArena & );  // not implemented, not assignable
+	};
+
+
+	/**
+	 * @brief Rewinds an arena to where it was when the scope was created, when the scope is destroyed.
+	 *
+	 * A function that uses a lot of temporary memory, such as a path search that may run for many agents in one
+	 * frame, can free it as soon as it returns instead of at the end of the frame.  The scope must be created before
+	 * the containers that use the arena, so that it is destroyed after them.
+	 */
+	class FrameArenaScope {
+	public:
+		FrameArenaScope(FrameArena & arena) : _arena(arena), _marker(arena.getMarker()) { }
+		~FrameArenaScope() { _arena.rewind(_marker); }
+	protected:
+		FrameArena & _arena;
+		FrameArena::Marker _marker;
+	private:
+		FrameArenaScope(const FrameArenaScope & );  // not implemented, not copyable
+		FrameArenaScope & operator= (const FrameArenaScope & );  // not implemented, not assignable
+	};
+
+
+	/**
+	 * @brief An STL allocator that takes memory from a Util::FrameArena, so that STL containers can be used for per-frame temporaries.
+	 *
+	 * Deallocation does nothing; the memory is reclaimed when the arena is reset.  A container using this allocator
+	 * must therefore be destroyed before its arena is reset, and may not be kept from one frame to the next.
+	 *
+	 * An allocator created without an arena uses operator new and delete, so a function that takes an optional arena
+	 * can build the same container type either way.
+	 */
+	template < typename T >
+	class ArenaAllocator {
+	public:
+		typedef T value_type;
+		typedef T * pointer;
+		typedef const T * const_pointer;
+		typedef T & reference;
+		typedef const T & const_reference;
+		typedef size_t size_type;
+		typedef ptrdiff_t difference_type;
+		template < typename U > struct rebind { typedef ArenaAllocator<U> other; };
+
+		ArenaAllocator() : _arena(NULL) { }
+		ArenaAllocator(FrameArena * arena) : _arena(arena) { }
+		template < typename U > ArenaAllocator(const ArenaAllocator<U> & other) : _arena(other.getArena()) { }
+
+		inline T * allocate(size_t n) {
+			if (_arena == NULL) {
+				return static_cast<T*>(::operator new(n * sizeof(T)));
+			}
+			return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T)));
+		}
+		inline void deallocate(T * p, size_t n) {
+			if (_arena == NULL) {
+				::operator delete(p);
+			}
+		}
+
+		inline FrameArena * getArena() const { return _arena; }
+
+	protected:
+		FrameArena * _arena;
+	};
+
+	template < typename T, typename U >
+	inline bool operator==(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) { return a.getArena() == b.getArena(); }
+	template < typename T, typename U >
+	inline bool operator!=(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) { return a.getArena() != b.getArena(); }
+
+	/// @name Containers whose memory comes from a Util::FrameArena
+	//@{
+	template < typename T > using ArenaVector = std::vector< T, ArenaAllocator<T> >;
+	template < typename T > using ArenaDeque = std::deque< T, ArenaAllocator<T> >;
+	template < typename T, typename Compare = std::less<T> > using ArenaSet = std::set< T, Compare, ArenaAllocator<T> >;
+	//@}
+
+} // end namespace Util
+
+#ifdef _WIN32
+#pragma warning( pop )
+#endif
+
+#endif
@@ -81,6 +81,7 @@ namespace Util {
 
 	// dummy no-op functionality if multithreading is disabled.
 	class Mutex {
+	public:
 		Mutex() { }
 		~Mutex() { }
 		inline void lock() throw() { }
@@ -59,6 +59,9 @@ namespace Util {
 		float getMaxExecutionTimeMills();
 		float getAverageExecutionTimeMills();
 
+		/// Adds the calls recorded by another profiler to these statistics, e.g. to combine profilers that were used by different threads.
+		void addStatistics(const PerformanceProfiler & other);
+
 		/// Outputs a human-readable form of these statistics.
 		void displayStatistics(std::ostream & out);
 		/// Checks if the timer is started or not
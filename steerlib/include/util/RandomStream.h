@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+#ifndef __UTIL_RANDOM_STREAM_H__
+#define __UTIL_RANDOM_STREAM_H__
+
+/// @file RandomStream.h
+/// @brief Declares Util::RandomStream, a small counter-based random number generator that can be split into independent streams.
+
+#include <string>
+
+#include "Globals.h"
+
+namespace Util {
+
+	/**
+	 * @brief A counter-based random number generator, which can be split into independent streams.
+	 *
+	 * The n-th number of a stream is a hash of the stream's key and n (this is the SplitMix64 generator),
+	 * so a stream is only 16 bytes, and can be given to every agent.  split() derives the key of a new
+	 * stream from the key of this one and an index or name, so that a tree of streams can be derived from
+	 * a single seed, e.g. one per agent from (run seed, agent number).  Numbers drawn from one stream never
+	 * depend on how many numbers other streams drew, or in which order.
+	 *
+	 * The functions that return random numbers mirror those of MTRand, so either generator can be used.
+	 * A stream is plain data; it can be copied, or stored in a checkpoint with SteerLib::CheckpointWriter::write().
+	 */
+	class RandomStream {
+	public:
+		/// Creates the stream of seed 0.
+		RandomStream() : _key(_mix(0)), _counter(0) { }
+		/// Creates the stream of the given seed.
+		explicit RandomStream(unsigned long long seed) : _key(_mix(seed)), _counter(0) { }
+
+		/// @name Deriving streams
+		//@{
+		/// Returns a new stream that is independent of this one and of streams split with other indices; does not change this stream.
+		inline RandomStream split(unsigned long long index) const {
+			RandomStream child;
+			child._key = _mix(_key ^ _mix(index + GOLDEN_GAMMA));
+			return child;
+		}
+		/// Like split(), with an index computed from a name; useful for e.g. modules, which do not have a number that stays the same between runs.
+		inline RandomStream split(const std::string & name) const {
+			// 64-bit FNV-1a
+			unsigned long long hash = 14695981039346656037ULL;
+			for (unsigned int i=0; i < name.size(); i++) {
+				hash = (hash ^ (unsigned char)name[i]) * 1099511628211ULL;
+			}
+			return split(hash);
+		}
+		//@}
+
+		/// @name Random numbers
+		//@{
+		/// Returns the next 64 random bits.
+		inline unsigned long long next64() {
+			_counter++;
+			return _mix(_key + _counter * GOLDEN_GAMMA);
+		}
+		/// Returns a random integer in [0, 2^32-1].
+		inline unsigned int randInt() { return (unsigned int)(next64() >> 32); }
+		/// Returns a random integer in [0, n].
+		inline unsigned int randInt(unsigned int n) {
+			// the multiply-shift maps 32 random bits to [0, n] with a negligible bias.
+			return (unsigned int)(((unsigned long long)randInt() * ((unsigned long long)n + 1)) >> 32);
+		}
+		/// Returns a random real number in [0, 1].
+		inline double rand() { return (double)(next64() >> 11) * (1.0 / 9007199254740991.0); }
+		/// Returns a random real number in [0, n].
+		inline double rand(double n) { return rand() * n; }
+		//@}
+
+		/// Returns how many numbers of 64 bits were drawn since the stream was created.
+		inline unsigned long long getCounter() const { return _counter; }
+
+	protected:
+		static const unsigned long long GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;
+
+		/// The finalizer of SplitMix64; a bijection that spreads every input bit over all output bits.
+		static inline unsigned long long _mix(unsigned long long z) {
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			return z ^ (z >> 31);
+		}
+
+		unsigned long long _key;
+		unsigned long long _counter;
+	};
+
+} // end namespace Util
+
+#endif
@@ -0,0 +1,200 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+#ifndef __UTIL_WORK_STEALING_SCHEDULER_H__
+#define __UTIL_WORK_STEALING_SCHEDULER_H__
+
+/// @file WorkStealingScheduler.h
+/// @brief Declares Util::WorkStealingScheduler, a thread pool with per-thread task deques, and Util::TaskGroup for fork-join.
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+#include "Globals.h"
+#include "util/Mutex.h"
+#include "util/ThreadedTaskManager.h"
+
+
+#ifdef _WIN32
+// on win32, there is an unfortunate conflict between exporting symbols for a
+// dynamic/shared library and STL code.  A good document describing the problem
+// in detail is http://www.unknownroad.com/rtfm/VisualStudio/warningC4251.html
+// the "least evil" solution is just to simply ignore this warning.
+#pragma warning( push )
+#pragma warning( disable : 4251 )
+#endif
+
+
+namespace Util {
+
+	class UTIL_API WorkStealingScheduler;
+
+	/// A callable task; the argument is the index of the thread running it, between 0 and WorkStealingScheduler::getNumThreads()-1.
+	typedef std::function<void (unsigned int threadIndex)> TaskFunction;
+	/// The body of a WorkStealingScheduler::parallelFor(), called for each sub-range [begin, end) of the index range.
+	typedef std::function<void (unsigned int threadIndex, unsigned int begin, unsigned int end)> RangeFunction;
+
+	/**
+	 * @brief A set of tasks that can be waited on together (fork-join).
+	 *
+	 * Tasks are forked with run(), and wait() joins them.  While waiting, the calling thread runs queued tasks itself
+	 * instead of sleeping, so a task may safely create and wait on its own TaskGroup.
+	 *
+	 * If a task throws, the first exception is kept and re-thrown by wait(); the remaining tasks still run.
+	 * The destructor waits for any tasks that are still pending.
+	 */
+	class UTIL_API TaskGroup {
+	public:
+		TaskGroup(WorkStealingScheduler & scheduler);
+		~TaskGroup();
+		/// Queues a task on the deque of the calling thread, where idle threads can steal it.
+		void run(const TaskFunction & task);
+		/// Waits until all tasks of this group are complete, helping to run queued tasks meanwhile.
+		void wait();
+	protected:
+		friend class WorkStealingScheduler;
+		WorkStealingScheduler & _scheduler;
+		/// Number of tasks of this group that were queued but have not finished yet.
+		std::atomic<unsigned int> _numPendingTasks;
+		/// Guards _exception.
+		Util::Mutex _exceptionMutex;
+		std::exception_ptr _exception;
+	};
+
+	/**
+	 * @brief A work-stealing thread pool, with fork-join task groups and a parallel-for over index ranges.
+	 *
+	 * Every thread owns a deque of tasks.  A thread pushes and pops tasks at the back of its own deque, and
+	 * when its deque is empty it steals from the front of another thread's deque.  Each deque has its own small lock,
+	 * so unlike Util::ThreadedTaskManager there is no single lock that every task must go through.
+	 *
+	 * A scheduler created with <code>numThreads</code> starts <code>numThreads-1</code> worker threads; the remaining
+	 * thread is the one that waits (TaskGroup::wait(), parallelFor() or waitForAllTasksToComplete()), which runs tasks
+	 * as thread index 0 instead of sleeping.  Only one thread that is not a worker should use a scheduler at a time.
+	 *
+	 * parallelFor() splits an index range in halves until the pieces are no larger than the grain size; the halves are
+	 * queued as they are split, so idle threads steal large pieces first.
+	 *
+	 * addTask(), wakeUpAllSleepingWorkerThreads() and waitForAllTasksToComplete() behave like the functions of
+	 * Util::ThreadedTaskManager, so that code using the old task manager can switch with little change.  Tasks added
+	 * from outside the pool are collected without locking, and queued MAX_UNPUBLISHED_TASKS at a time, or sooner when
+	 * threads are woken up or the thread starts waiting; a thread that steals such tasks takes up to MAX_STOLEN_TASKS
+	 * of them at once.  Both keep a stream of small tasks from passing through a lock one task at a time.
+	 *
+	 * Of course, <b>you will need to make your tasks thread-safe!</b>
+	 *
+	 * @see
+	 *  - Util::TaskGroup, to fork tasks and wait for them
+	 */
+	class UTIL_API WorkStealingScheduler {
+	public:
+		/// During initialization, specify the total number of threads that will run tasks, including the thread that waits.
+		WorkStealingScheduler(unsigned int numThreads);
+		/// The destructor waits for queued tasks to complete, and then properly terminates the worker threads.
+		~WorkStealingScheduler();
+
+		/// Returns the number of threads that run tasks, including the waiting thread; thread indices are always less than this.
+		inline unsigned int getNumThreads() { return _numThreads; }
+		/// Returns the index of the calling thread if it is one of this scheduler's workers, or 0 otherwise, e.g. to pick per-thread data outside of a task.
+		inline unsigned int getIndexOfCurrentThread() { return _getIndexOfCurrentThread(); }
+
+		/// Calls body(threadIndex, begin, end) on sub-ranges that together cover [begin, end), and returns when all are done; a grainSize of 0 chooses one automatically.
+		void parallelFor(unsigned int begin, unsigned int end, unsigned int grainSize, const RangeFunction & body);
+
+		/// @name Util::ThreadedTaskManager compatible interface
+		//@{
+		/// Adds a task that will be executed by one of the threads; if adding many tasks at the same time, it is only necessary to broadcast on the last task.
+		void addTask(const Task & newTask, bool broadcastToSleepingWorkerThreads);
+		/// Wakes up all sleeping worker threads.
+		void wakeUpAllSleepingWorkerThreads() throw();
+		/// Waits until all tasks added with addTask() are complete; the calling thread helps run them.
+		void waitForAllTasksToComplete();
+		//@}
+
+	protected:
+		friend class TaskGroup;
+
+		/// One queued task; either a callable, a task from addTask(), or a piece of a parallelFor() that is split further when it runs.
+		struct QueuedTask {
+			TaskFunction function;
+			Task addedTask;
+			const RangeFunction * rangeBody;
+			unsigned int begin;
+			unsigned int end;
+			unsigned int grainSize;
+			TaskGroup * group;
+		};
+
+		/// The deque owned by one thread; padded so that the deques of different threads do not share a cache line.
+		struct TaskDeque {
+			Util::Mutex lock;
+			std::deque<QueuedTask> tasks;
+			/// The size of tasks, readable without the lock, so that stealing threads can skip empty deques.
+			std::atomic<unsigned int> numTasks;
+			/// Tasks the owner just stole and is about to move into its own deque; reserved for MAX_STOLEN_TASKS tasks.
+			std::vector<QueuedTask> stolenTasks;
+			char padding[64];
+		};
+
+		/// The number of tasks added from outside the pool that are collected before they are queued.
+		static const unsigned int MAX_UNPUBLISHED_TASKS = 64;
+		/// The most tasks added with addTask() that one steal takes from another deque.
+		static const unsigned int MAX_STOLEN_TASKS = 32;
+
+		/// The main function executed by every worker thread; runs or steals tasks until the scheduler is destroyed.
+		void _runWorkerThread(unsigned int threadIndex);
+		/// Returns the index of the calling thread if it is one of this scheduler's workers, or 0 otherwise.
+		unsigned int _getIndexOfCurrentThread();
+		/// Pushes a task on the back of the given thread's deque, and wakes up a sleeping thread if there is one.
+		void _pushTask(unsigned int threadIndex, const QueuedTask & task, bool wakeUpSleepingThreads);
+		/// Queues the tasks collected by addTask() outside the pool on deque 0, and wakes up sleeping threads if asked to.
+		void _publishTasks(bool wakeUpSleepingThreads);
+		/// Pops a task from the back of the thread's own deque, or else steals one from the front of another deque.
+		bool _popOrStealTask(unsigned int threadIndex, QueuedTask & task);
+		/// Runs one task and marks it complete in its group; exceptions are stored in the group.
+		void _runTask(unsigned int threadIndex, QueuedTask & task);
+		/// Splits the range of a parallelFor() down to the grain size, queuing the upper halves, and runs the last piece.
+		void _runRange(unsigned int threadIndex, const RangeFunction & body, unsigned int begin, unsigned int end, unsigned int grainSize, TaskGroup * group);
+		/// Runs queued tasks until the group has no pending tasks, sleeping only when there is nothing to run or steal.
+		void _waitForGroup(TaskGroup & group);
+		/// Wakes up threads sleeping in _runWorkerThread() or _waitForGroup(), if there are any.
+		void _wakeUpSleepingThreads();
+		/// Wakes up one sleeping thread, if there is one, to run a single new task.
+		void _wakeUpOneSleepingThread();
+
+		/// The number of threads that run tasks, including the waiting thread.
+		unsigned int _numThreads;
+		/// One deque per thread; deque 0 belongs to the waiting thread.
+		TaskDeque * _deques;
+		/// The worker threads, for thread indices 1 to _numThreads-1.
+		std::vector<std::thread> _threads;
+		/// Number of tasks currently sitting in any deque; used to decide whether it is worth sleeping.
+		std::atomic<unsigned int> _numQueuedTasks;
+		/// Number of threads that are sleeping or about to sleep on _wakeUpCondition.
+		std::atomic<unsigned int> _numSleepingThreads;
+		/// Flag to indicate if worker threads should shut down the next time they are awoken.
+		std::atomic<bool> _shuttingDown;
+		std::mutex _sleepMutex;
+		std::condition_variable _wakeUpCondition;
+		/// The group that holds tasks added with addTask().
+		TaskGroup * _addedTasks;
+		/// Tasks added with addTask() by the thread outside the pool that are not queued yet; only that thread uses it.
+		std::vector<QueuedTask> _unpublishedTasks;
+	};
+
+} // namespace Util
+
+
+#ifdef _WIN32
+#pragma warning( pop )
+#endif
+
+#endif
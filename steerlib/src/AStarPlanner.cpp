@@ -26,7 +26,7 @@
 
 namespace SteerLib
 {
-	AStarPlanner::AStarPlanner() {}
+	AStarPlanner::AStarPlanner() : gSpatialDatabase(NULL), _frameArena(NULL) {}
 
 	AStarPlanner::~AStarPlanner() {}
 
@@ -38,11 +38,12 @@ namespace SteerLib
 		gSpatialDatabase->getGridCoordinatesFromIndex(current_id, x, z);
 		int x_range_min, x_range_max, z_range_min, z_range_max;
 
-		x_range_min = MAX(x - OBSTACLE_CLEARANCE, 0);
-		x_range_max = MIN(x + OBSTACLE_CLEARANCE, gSpatialDatabase->getNumCellsX());
+		// only cells inside the grid have an index; with Morton numbering, coordinates past the edge do not wrap to another row.
+		x_range_min = MAX((int)x - OBSTACLE_CLEARANCE, 0);
+		x_range_max = MIN((int)x + OBSTACLE_CLEARANCE, (int)gSpatialDatabase->getNumCellsX() - 1);
 
-		z_range_min = MAX(z - OBSTACLE_CLEARANCE, 0);
-		z_range_max = MIN(z + OBSTACLE_CLEARANCE, gSpatialDatabase->getNumCellsZ());
+		z_range_min = MAX((int)z - OBSTACLE_CLEARANCE, 0);
+		z_range_max = MIN((int)z + OBSTACLE_CLEARANCE, (int)gSpatialDatabase->getNumCellsZ() - 1);
 
 
 		for (int i = x_range_min; i <= x_range_max; i += GRID_STEP)
@@ -89,19 +90,27 @@ namespace SteerLib
 	{
 		gSpatialDatabase = _gSpatialDatabase;
 
+		// All nodes and lists of the search live in the arena, and are given back in one go when the scope ends;
+		// the scope is declared first, so it ends after all of them are destroyed.
+		Util::FrameArena ownArena;
+		Util::FrameArena & arena = (_frameArena != NULL) ? *_frameArena : ownArena;
+		Util::FrameArenaScope arenaScope(arena);
+		Util::ArenaAllocator<SearchNodePtr> allocator(&arena);
+
 		int startIndex = gSpatialDatabase->getCellIndexFromLocation(start);
-		SearchNodePtr startNode(new SearchNode(startIndex, 0, 0));
+		SearchNodePtr startNode = std::allocate_shared<SearchNode>(Util::ArenaAllocator<SearchNode>(&arena), startIndex, 0.0f, 0.0f);
 
 		int goalIndex = gSpatialDatabase->getCellIndexFromLocation(goal);
 
-		std::vector<SearchNodePtr> openSet;
-		std::vector<SearchNodePtr> closedSet;
+		SearchNodeList openSet(allocator);
+		SearchNodeList closedSet(allocator);
+		SearchNodeList expandedList(allocator);
 		SearchNodePtr goalNode(nullptr);
 		openSet.push_back(startNode);
 
 		while (!openSet.empty()) {
 			// Get the node with the minimum f, breaking ties on g. 
-			std::vector<SearchNodePtr>::iterator minIter = std::min_element(openSet.begin(), openSet.end());
+			SearchNodeList::iterator minIter = std::min_element(openSet.begin(), openSet.end());
 			SearchNodePtr minNode = *minIter;
 			openSet.erase(minIter);
 
@@ -112,10 +121,10 @@ namespace SteerLib
 			}
 
 			// Expand this node.
-			std::vector<SearchNodePtr> expandedList = _expand(minNode, goal);
+			_expand(minNode, goal, expandedList);
 			for (SearchNodePtr& expandedNode : expandedList) {
 				// If this cell is already in the open set, check if this is a cheaper path.
-				std::vector<SearchNodePtr>::iterator iter = std::find(openSet.begin(), openSet.end(), expandedNode);
+				SearchNodeList::iterator iter = std::find(openSet.begin(), openSet.end(), expandedNode);
 				if (iter != openSet.end()) {
 					if (expandedNode->g() < (*iter)->g()) {
 						(*iter)->g(expandedNode->g());
@@ -150,21 +159,23 @@ namespace SteerLib
 	}
 
 	// Helper method which attempts to add a SearchNode to the output vector if it is traversable.
-	void AStarPlanner::_tryToAdd(unsigned int x, unsigned int z, const SearchNodePtr& from, float cost, Util::Point goal, std::vector<SearchNodePtr>& out) {
+	void AStarPlanner::_tryToAdd(unsigned int x, unsigned int z, const SearchNodePtr& from, float cost, Util::Point goal, SearchNodeList& out) {
+		// neighbors of cells on the edge may be past it; x and z are unsigned, so that includes -1.
+		if ((x >= gSpatialDatabase->getNumCellsX()) || (z >= gSpatialDatabase->getNumCellsZ())) return;
 		int index = gSpatialDatabase->getCellIndexFromGridCoords(x, z);
 		if (!canBeTraversed(index)) return;
 		Util::Point p;
 		gSpatialDatabase->getLocationFromIndex(index, p);
 		float h = distanceBetween(p, goal);
 		//float h = distanceSquaredBetween(p, goal);
-		out.push_back(SearchNodePtr(new SearchNode(index, from->g() + cost, h)));
+		// the node comes from the same arena as the list.
+		out.push_back(std::allocate_shared<SearchNode>(Util::ArenaAllocator<SearchNode>(out.get_allocator()), index, from->g() + cost, h));
 	}
 
-	// Returns a list of neighboring traversable cells.
-	std::vector<SearchNodePtr> AStarPlanner::_expand(const SearchNodePtr& node, const Util::Point goal) {
+	// Fills out with the neighboring traversable cells.
+	void AStarPlanner::_expand(const SearchNodePtr& node, const Util::Point goal, SearchNodeList& out) {
 		unsigned int x, z;
-		int index;
-		std::vector<SearchNodePtr> out;
+		out.clear();
 		gSpatialDatabase->getGridCoordinatesFromIndex(node->index(), x, z);
 
 		// Try to add the four cardinal directions.
@@ -181,7 +192,5 @@ namespace SteerLib
 		_tryToAdd(x - 1, z + 1, node, 1, goal, out);
 		_tryToAdd(x + 1, z - 1, node, 1, goal, out);
 		_tryToAdd(x + 1, z + 1, node, 1, goal, out);
-
-		return std::move(out);
 	}
 }
\ No newline at end of file
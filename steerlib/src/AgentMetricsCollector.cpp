@@ -216,8 +216,8 @@ void AgentMetricsCollector::_updateCollisionStats(GridDatabase2D * gridDB, Agent
 	// when analyzing a recording, the spatial database will be populated with AgentMetricsCollector objects instead of agents.
 	//
 
-	std::set<SpatialDatabaseItemPtr> neighbors;
-	std::set<SpatialDatabaseItemPtr>::iterator neighbor;
+	std::vector<SpatialDatabaseItemPtr> neighbors;
+	std::vector<SpatialDatabaseItemPtr>::iterator neighbor;
 	gridDB->getItemsInRange(neighbors, _currentPosition.x - _radius, _currentPosition.x + _radius, _currentPosition.z - _radius, _currentPosition.z + _radius, updatedAgent);
 
 
@@ -558,3 +558,72 @@ void AgentMetricsCollector::printFormattedOverallStatistics(std::ostream & out)
 
 
 
+
+
+void AgentMetricsCollector::writeCheckpoint(CheckpointWriter & out)
+{
+	out.write(_numFramesMeasured);
+	out.write(_currentPosition);
+	out.write(_previousPosition);
+	out.write(_currentDirection);
+	out.write(_previousDirection);
+	out.write(_enabled);
+	out.write(_radius);
+	out.write(_metrics);
+
+	out.write(_positionWindow);
+	out.write(_turnWindow);
+	out.write(_distanceWindow);
+	out.write(_changeInSpeedWindow);
+	out.write(_velocityWindow);
+	out.write(_accelerationWindow);
+	out.write(_instantaneousAccelerationWindow);
+
+	// a collision in progress is keyed by the item it is with, whose address is different in the restored simulation.
+	out.write((unsigned int)_currentCollidingObjects.size());
+	std::map<uintptr_t, SteerLib::CollisionInfo>::const_iterator collisionIter;
+	for (collisionIter = _currentCollidingObjects.begin(); collisionIter != _currentCollidingObjects.end(); ++collisionIter) {
+		out.writeItemReference(reinterpret_cast<const SpatialDatabaseItem*>(collisionIter->first));
+		out.write(collisionIter->second);
+	}
+
+	// past collisions are only counted, and their items may no longer exist, so their keys are not kept.
+	std::vector<CollisionInfo> pastCollisions(_pastCollisions);
+	for (unsigned int i=0; i < pastCollisions.size(); i++) {
+		pastCollisions[i].collisionKey = 0;
+	}
+	out.writeVector(pastCollisions);
+}
+
+void AgentMetricsCollector::readCheckpoint(CheckpointReader & in)
+{
+	in.read(_numFramesMeasured);
+	in.read(_currentPosition);
+	in.read(_previousPosition);
+	in.read(_currentDirection);
+	in.read(_previousDirection);
+	in.read(_enabled);
+	in.read(_radius);
+	in.read(_metrics);
+
+	in.read(_positionWindow);
+	in.read(_turnWindow);
+	in.read(_distanceWindow);
+	in.read(_changeInSpeedWindow);
+	in.read(_velocityWindow);
+	in.read(_accelerationWindow);
+	in.read(_instantaneousAccelerationWindow);
+
+	unsigned int numCurrentCollisions;
+	in.read(numCurrentCollisions);
+	_currentCollidingObjects.clear();
+	for (unsigned int i=0; i < numCurrentCollisions; i++) {
+		uintptr_t collisionKey = (uintptr_t)in.readItemReference();
+		CollisionInfo collision;
+		in.read(collision);
+		collision.collisionKey = collisionKey;
+		_currentCollidingObjects[collisionKey] = collision;
+	}
+
+	in.readVector(_pastCollisions);
+}
@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+/// @file AgentRegistry.cpp
+/// @brief Implements the SteerLib::AgentRegistry class.
+
+#include "simulation/AgentRegistry.h"
+#include "util/GenericException.h"
+
+using namespace SteerLib;
+using namespace Util;
+
+
+AgentHandle AgentRegistry::add(AgentInterface * agent, ModuleInterface * owner)
+{
+	if (contains(agent)) {
+		throw GenericException("Cannot add agent, agent already exists.\n");
+	}
+
+	unsigned int slotIndex;
+	if (_firstFreeSlot != NO_SLOT) {
+		slotIndex = _firstFreeSlot;
+		_firstFreeSlot = _slots[slotIndex].nextFreeSlot;
+	}
+	else {
+		slotIndex = (unsigned int)_slots.size();
+		_slots.push_back(Slot());
+		_slots[slotIndex].generation = 0;
+	}
+
+	std::vector<AgentInterface*> & ownerAgents = _agentsOfOwner[owner];
+
+	Slot & slot = _slots[slotIndex];
+	slot.agent = agent;
+	slot.owner = owner;
+	slot.denseIndex = (unsigned int)_agents.size();
+	slot.ownerIndex = (unsigned int)ownerAgents.size();
+	slot.nextFreeSlot = NO_SLOT;
+	slot.serialNumber = _numAgentsAdded++;
+	slot.randomStream = RandomStream();
+
+	_agents.push_back(agent);
+	_slotOfDenseIndex.push_back(slotIndex);
+	ownerAgents.push_back(agent);
+	_slotOfAgent[agent] = slotIndex;
+
+	return AgentHandle(slotIndex, slot.generation);
+}
+
+
+ModuleInterface * AgentRegistry::remove(AgentInterface * agent)
+{
+	std::unordered_map<const AgentInterface*, unsigned int>::iterator slotIter = _slotOfAgent.find(agent);
+	if (slotIter == _slotOfAgent.end()) {
+		throw GenericException("The engine did not have a record of the agent.  Are you sure you used SimulationEngine::createAgent() or SimulationEngine::addAgent()?");
+	}
+
+	unsigned int slotIndex = slotIter->second;
+	_slotOfAgent.erase(slotIter);
+	Slot & slot = _slots[slotIndex];
+	ModuleInterface * owner = slot.owner;
+
+	// swap-n-pop from the dense list, so the last agent takes this agent's place.
+	unsigned int lastSlotIndex = _slotOfDenseIndex.back();
+	_agents[slot.denseIndex] = _agents.back();
+	_slotOfDenseIndex[slot.denseIndex] = lastSlotIndex;
+	_slots[lastSlotIndex].denseIndex = slot.denseIndex;
+	_agents.pop_back();
+	_slotOfDenseIndex.pop_back();
+
+	// the same for the owner's list.
+	std::vector<AgentInterface*> & ownerAgents = _agentsOfOwner[owner];
+	AgentInterface * lastOwnerAgent = ownerAgents.back();
+	if (lastOwnerAgent != agent) {
+		ownerAgents[slot.ownerIndex] = lastOwnerAgent;
+		_slots[_slotOfAgent[lastOwnerAgent]].ownerIndex = slot.ownerIndex;
+	}
+	ownerAgents.pop_back();
+	if (ownerAgents.empty()) {
+		_agentsOfOwner.erase(owner);
+	}
+
+	// free the slot; the new generation makes existing handles to it stale.
+	slot.agent = NULL;
+	slot.owner = NULL;
+	slot.generation++;
+	slot.nextFreeSlot = _firstFreeSlot;
+	_firstFreeSlot = slotIndex;
+
+	return owner;
+}
+
+
+void AgentRegistry::clear()
+{
+	// the slots are kept, so that handles from before stay stale instead of referring to new agents.
+	_firstFreeSlot = NO_SLOT;
+	for (unsigned int i=(unsigned int)_slots.size(); i > 0; i--) {
+		Slot & slot = _slots[i-1];
+		if (slot.agent != NULL) {
+			slot.agent = NULL;
+			slot.owner = NULL;
+			slot.generation++;
+		}
+		slot.nextFreeSlot = _firstFreeSlot;
+		_firstFreeSlot = i-1;
+	}
+
+	_numAgentsAdded = 0;
+	_agents.clear();
+	_slotOfDenseIndex.clear();
+	_slotOfAgent.clear();
+	_agentsOfOwner.clear();
+}
+
+
+ModuleInterface * AgentRegistry::getOwner(const AgentInterface * agent) const
+{
+	std::unordered_map<const AgentInterface*, unsigned int>::const_iterator slotIter = _slotOfAgent.find(agent);
+	return (slotIter == _slotOfAgent.end()) ? NULL : _slots[slotIter->second].owner;
+}
+
+
+AgentHandle AgentRegistry::getHandle(const AgentInterface * agent) const
+{
+	std::unordered_map<const AgentInterface*, unsigned int>::const_iterator slotIter = _slotOfAgent.find(agent);
+	if (slotIter == _slotOfAgent.end()) {
+		return AgentHandle();
+	}
+	return AgentHandle(slotIter->second, _slots[slotIter->second].generation);
+}
+
+
+AgentInterface * AgentRegistry::getAgent(const AgentHandle & handle) const
+{
+	if ((handle.index >= _slots.size()) || (_slots[handle.index].generation != handle.generation)) {
+		return NULL;
+	}
+	return _slots[handle.index].agent;
+}
+
+
+const std::vector<AgentInterface*> & AgentRegistry::getAgentsOfOwner(ModuleInterface * owner) const
+{
+	static const std::vector<AgentInterface*> noAgents;
+	std::map<ModuleInterface*, std::vector<AgentInterface*> >::const_iterator ownerIter = _agentsOfOwner.find(owner);
+	return (ownerIter == _agentsOfOwner.end()) ? noAgents : ownerIter->second;
+}
@@ -0,0 +1,80 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+/// @file AgentStateSnapshot.cpp
+/// @brief Implements the SteerLib::AgentStateSnapshot class.
+
+#include <algorithm>
+
+#include "simulation/AgentStateSnapshot.h"
+#include "interfaces/AgentInterface.h"
+
+using namespace SteerLib;
+
+
+AgentStateSnapshot::AgentStateSnapshot()
+{
+	_front = 0;
+	_buffers[0].maxRadius = 0.0f;
+	_buffers[1].maxRadius = 0.0f;
+}
+
+
+void AgentStateSnapshot::clear()
+{
+	for (unsigned int b=0; b < 2; b++) {
+		_buffers[b].agents.clear();
+		_buffers[b].states.clear();
+		_buffers[b].sortedIndex.clear();
+		_buffers[b].maxRadius = 0.0f;
+	}
+	_front = 0;
+}
+
+
+void AgentStateSnapshot::capture(const std::vector<SteerLib::AgentInterface*> & agents)
+{
+	Buffer & back = _buffers[1-_front];
+	unsigned int numAgents = agents.size();
+
+	// the lookup index only needs to be rebuilt if the list of agents changed since this buffer was last used.
+	bool sameAgents = (back.agents.size() == numAgents) && std::equal(agents.begin(), agents.end(), back.agents.begin());
+
+	back.states.resize(numAgents);
+	back.maxRadius = 0.0f;
+	for (unsigned int i=0; i < numAgents; i++) {
+		FrozenAgentState & state = back.states[i];
+		AgentInterface * agent = agents[i];
+		state.enabled = agent->enabled();
+		state.position = agent->position();
+		state.forward = agent->forward();
+		state.velocity = agent->velocity();
+		state.radius = agent->radius();
+		state.index = i;
+		if (state.radius > back.maxRadius) back.maxRadius = state.radius;
+	}
+
+	if (!sameAgents) {
+		back.agents.assign(agents.begin(), agents.end());
+		back.sortedIndex.resize(numAgents);
+		for (unsigned int i=0; i < numAgents; i++) {
+			back.sortedIndex[i] = std::make_pair(back.agents[i], i);
+		}
+		std::sort(back.sortedIndex.begin(), back.sortedIndex.end());
+	}
+
+	_front = 1-_front;
+}
+
+
+const FrozenAgentState * AgentStateSnapshot::_findState(const Buffer & buffer, const SteerLib::AgentInterface * agent) const
+{
+	std::vector< std::pair<const AgentInterface*, unsigned int> >::const_iterator iter;
+	iter = std::lower_bound(buffer.sortedIndex.begin(), buffer.sortedIndex.end(), std::make_pair(agent, 0u));
+	if ((iter == buffer.sortedIndex.end()) || (iter->first != agent)) {
+		return NULL;
+	}
+	return &(buffer.states[iter->second]);
+}
@@ -0,0 +1,279 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+/// @file Checkpoint.cpp
+/// @brief Implements SteerLib::CheckpointWriter and SteerLib::CheckpointReader.
+
+#include <fstream>
+#include "simulation/Checkpoint.h"
+#include "util/Misc.h"
+
+using namespace SteerLib;
+using namespace Util;
+
+// identifies a checkpoint file; the version must change whenever the layout of the engine's checkpoint changes.
+#define CHECKPOINT_MAGIC "STEERCKP"
+#define CHECKPOINT_MAGIC_LENGTH 8
+#define CHECKPOINT_VERSION 4
+// written in native byte order, so that a checkpoint from a machine with a different byte order is recognized.
+#define CHECKPOINT_BYTE_ORDER_MARK 0x01020304u
+// written instead of an item index for NULL references.
+#define CHECKPOINT_NULL_ITEM 0xffffffffu
+
+
+//========================================
+
+void CheckpointWriter::writeString(const std::string & value)
+{
+	write((unsigned int)value.size());
+	_append(value.data(), value.size());
+}
+
+void CheckpointWriter::writeGoal(const AgentGoalInfo & goal)
+{
+	write((unsigned int)goal.goalType);
+	write(goal.targetIsRandom);
+	write(goal.timeDuration);
+	write(goal.desiredSpeed);
+	write(goal.targetTime);
+	write(goal.targetTangent);
+	write(goal.targetLocation);
+	writeString(goal.targetName);
+	write(goal.targetDirection);
+	writeString(goal.flowType);
+	write(goal.targetRegion);
+
+	writeString(goal.targetBehaviour.getSteeringAlg());
+	std::vector<BehaviourParameter> parameters = goal.targetBehaviour.getParameters();
+	write((unsigned int)parameters.size());
+	for (unsigned int i=0; i < parameters.size(); i++) {
+		writeString(parameters[i].key);
+		writeString(parameters[i].value);
+	}
+}
+
+void CheckpointWriter::writeGoalQueue(const std::queue<AgentGoalInfo> & goals)
+{
+	// std::queue cannot be iterated, so the goals are written from a copy.
+	std::queue<AgentGoalInfo> remainingGoals(goals);
+	write((unsigned int)remainingGoals.size());
+	while (!remainingGoals.empty()) {
+		writeGoal(remainingGoals.front());
+		remainingGoals.pop();
+	}
+}
+
+void CheckpointWriter::writeItemReference(const SpatialDatabaseItem * item)
+{
+	if (item == NULL) {
+		write(CHECKPOINT_NULL_ITEM);
+		return;
+	}
+
+	std::map<const SpatialDatabaseItem*, unsigned int>::const_iterator iter = _itemIndices.find(item);
+	if (iter == _itemIndices.end()) {
+		throw GenericException("Cannot checkpoint a reference to an item that is neither an agent nor an obstacle of the engine.");
+	}
+	write(iter->second);
+}
+
+void CheckpointWriter::beginBlock()
+{
+	_openBlocks.push_back(_data.size());
+	write((unsigned long long)0);
+}
+
+void CheckpointWriter::endBlock()
+{
+	if (_openBlocks.empty()) {
+		throw GenericException("CheckpointWriter::endBlock() called without a matching beginBlock().");
+	}
+
+	size_t sizeOffset = _openBlocks.back();
+	_openBlocks.pop_back();
+	unsigned long long blockSize = _data.size() - sizeOffset - sizeof(unsigned long long);
+	memcpy(&_data[sizeOffset], &blockSize, sizeof(blockSize));
+}
+
+void CheckpointWriter::addItem(const SpatialDatabaseItem * item)
+{
+	unsigned int index = (unsigned int)_itemIndices.size();
+	if (!_itemIndices.insert(std::make_pair(item, index)).second) {
+		throw GenericException("CheckpointWriter::addItem() - the same item was added twice.");
+	}
+}
+
+void CheckpointWriter::saveToFile(const std::string & filename)
+{
+	if (!_openBlocks.empty()) {
+		throw GenericException("Cannot save checkpoint \"" + filename + "\", a block was started but not ended.");
+	}
+
+	std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary);
+	if (!out.is_open()) {
+		throw GenericException("Could not open checkpoint file \"" + filename + "\" for writing.");
+	}
+
+	unsigned int version = CHECKPOINT_VERSION;
+	unsigned int byteOrderMark = CHECKPOINT_BYTE_ORDER_MARK;
+	unsigned long long dataSize = _data.size();
+	out.write(CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LENGTH);
+	out.write((const char*)&version, sizeof(version));
+	out.write((const char*)&byteOrderMark, sizeof(byteOrderMark));
+	out.write((const char*)&dataSize, sizeof(dataSize));
+	if (!_data.empty()) {
+		out.write(&_data[0], _data.size());
+	}
+
+	out.close();
+	if (out.fail()) {
+		throw GenericException("Could not write checkpoint file \"" + filename + "\".");
+	}
+}
+
+
+//========================================
+
+void CheckpointReader::readString(std::string & value)
+{
+	unsigned int size;
+	read(size);
+	_checkAvailable(size);
+	value.assign(_data->begin() + _position, _data->begin() + _position + size);
+	_position += size;
+}
+
+void CheckpointReader::readGoal(AgentGoalInfo & goal)
+{
+	unsigned int goalType;
+	read(goalType);
+	goal.goalType = (AgentGoalTypeEnum)goalType;
+	read(goal.targetIsRandom);
+	read(goal.timeDuration);
+	read(goal.desiredSpeed);
+	read(goal.targetTime);
+	read(goal.targetTangent);
+	read(goal.targetLocation);
+	readString(goal.targetName);
+	read(goal.targetDirection);
+	readString(goal.flowType);
+	read(goal.targetRegion);
+
+	std::string steeringAlg;
+	unsigned int numParameters;
+	readString(steeringAlg);
+	read(numParameters);
+	goal.targetBehaviour = Behaviour();
+	goal.targetBehaviour.setSteeringAlg(steeringAlg);
+	for (unsigned int i=0; i < numParameters; i++) {
+		BehaviourParameter parameter;
+		readString(parameter.key);
+		readString(parameter.value);
+		goal.targetBehaviour.addParameter(parameter);
+	}
+}
+
+void CheckpointReader::readGoalQueue(std::queue<AgentGoalInfo> & goals)
+{
+	unsigned int numGoals;
+	read(numGoals);
+	goals = std::queue<AgentGoalInfo>();
+	for (unsigned int i=0; i < numGoals; i++) {
+		AgentGoalInfo goal;
+		readGoal(goal);
+		goals.push(goal);
+	}
+}
+
+SpatialDatabaseItem * CheckpointReader::readItemReference()
+{
+	unsigned int index;
+	read(index);
+	if (index == CHECKPOINT_NULL_ITEM) {
+		return NULL;
+	}
+	if (index >= _items.size()) {
+		throw GenericException("The checkpoint refers to item " + toString(index) + ", but only " + toString(_items.size()) + " items exist.");
+	}
+	return _items[index];
+}
+
+void CheckpointReader::beginBlock()
+{
+	unsigned long long blockSize;
+	read(blockSize);
+	_checkAvailable((size_t)blockSize);
+	_openBlocks.push_back(_position + (size_t)blockSize);
+}
+
+void CheckpointReader::endBlock()
+{
+	if (_openBlocks.empty()) {
+		throw GenericException("CheckpointReader::endBlock() called without a matching beginBlock().");
+	}
+
+	size_t blockEnd = _openBlocks.back();
+	_openBlocks.pop_back();
+	if (_position != blockEnd) {
+		throw GenericException("A block of the checkpoint was not read back the same way it was written (" + toString(blockEnd - _position) + " bytes left over).");
+	}
+}
+
+void CheckpointReader::skipBlock()
+{
+	unsigned long long blockSize;
+	read(blockSize);
+	_checkAvailable((size_t)blockSize);
+	_position += (size_t)blockSize;
+}
+
+void CheckpointReader::addItem(SpatialDatabaseItem * item)
+{
+	_items.push_back(item);
+}
+
+void CheckpointReader::loadFromFile(const std::string & filename)
+{
+	std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+	if (!in.is_open()) {
+		throw GenericException("Could not open checkpoint file \"" + filename + "\".");
+	}
+
+	char magic[CHECKPOINT_MAGIC_LENGTH];
+	unsigned int version = 0;
+	unsigned int byteOrderMark = 0;
+	unsigned long long dataSize = 0;
+	in.read(magic, CHECKPOINT_MAGIC_LENGTH);
+	in.read((char*)&version, sizeof(version));
+	in.read((char*)&byteOrderMark, sizeof(byteOrderMark));
+	in.read((char*)&dataSize, sizeof(dataSize));
+
+	if (in.fail() || (memcmp(magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LENGTH) != 0)) {
+		throw GenericException("\"" + filename + "\" is not a checkpoint file.");
+	}
+	if (byteOrderMark != CHECKPOINT_BYTE_ORDER_MARK) {
+		throw GenericException("Checkpoint \"" + filename + "\" was saved on a machine with a different byte order.");
+	}
+	if (version != CHECKPOINT_VERSION) {
+		throw GenericException("Checkpoint \"" + filename + "\" has version " + toString(version) + ", but this version of SteerLib reads version " + toString(CHECKPOINT_VERSION) + ".");
+	}
+
+	std::shared_ptr<std::vector<char> > data(new std::vector<char>((size_t)dataSize));
+	if (dataSize != 0) {
+		in.read(&(*data)[0], (std::streamsize)dataSize);
+	}
+	if (in.fail()) {
+		throw GenericException("Checkpoint \"" + filename + "\" is truncated.");
+	}
+
+	loadFromMemory(data);
+}
+
+void CheckpointReader::loadFromMemory(const std::shared_ptr<const std::vector<char> > & data)
+{
+	_data = data;
+	_position = 0;
+	_openBlocks.clear();
+}
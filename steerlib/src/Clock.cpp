@@ -11,6 +11,9 @@
 ///   - fix coding style
 ///   - options are accessible now, is there anything to change because of this?
 
+#include <thread>
+#include <chrono>
+
 #include "util/GenericException.h"
 #include "util/HighResCounter.h"
 #include "util/Misc.h"
@@ -19,6 +22,8 @@
 using namespace SteerLib;
 using namespace Util;
 
+/// how long before the end of a frame _waitForFrameSync() stops sleeping and busy-waits instead.
+#define FRAME_SYNC_SPIN_MILLISECONDS 1
 
 
 Clock::Clock()
@@ -55,12 +60,9 @@ void Clock::reset()
 void Clock::advanceSimulationAndUpdateRealTime()
 {
 
-	// 1. if fixed-real-time mode, then try to wait until real-time matches the clock
-	if (_clockMode == CLOCK_MODE_FIXED_REAL_TIME) {
-		_waitForFrameSync(_fixedTicksPerFrame);
-	}
-	else if (_clockMode == CLOCK_MODE_VARIABLE_REAL_TIME) {
-		_waitForFrameSync(_minSimulationDt);  // will not wait if elapsed time was already more than this.
+	// 1. in the real-time modes, wait until real-time matches the clock; does not wait if the elapsed time was already more than a frame.
+	if (hasFrameDeadline()) {
+		_waitForFrameSync(_getMinTicksPerFrame());
 	}
 
 	// 2. update real-time ( NOTE: _realDt includes any extra delay due to _waitForFrameSync(). )
@@ -68,14 +70,7 @@ void Clock::advanceSimulationAndUpdateRealTime()
 	_totalRealTime += _realDt;
 
 	// 2. compute the next simulation dt
-	if ((_clockMode == CLOCK_MODE_FIXED_AS_FAST_AS_POSSIBLE) || (_clockMode == CLOCK_MODE_FIXED_REAL_TIME)) {
-		_simulationDt = _fixedTicksPerFrame;
-	}
-	else if (_clockMode == CLOCK_MODE_VARIABLE_REAL_TIME) {
-		// _simulationDt will match _realDt, but it will be "clamped" to remain between _mainSimulationDt and _maxSimulationDt.
-		_simulationDt = (_realDt < _maxSimulationDt) ? _realDt : _maxSimulationDt;
-		_simulationDt = (_simulationDt > _minSimulationDt) ? _simulationDt : _minSimulationDt;
-	}
+	_computeSimulationDt();
 
 	// 3. update total simulation time based on the new simulation dt
 	_totalSimulationTime += _simulationDt;
@@ -101,15 +96,7 @@ void Clock::backupSimulationAndUpdateRealTime()
 	_totalRealTime -= _realDt;
 
 	// 2. compute the next simulation dt
-	if ((_clockMode == CLOCK_MODE_FIXED_AS_FAST_AS_POSSIBLE) ||
-			(_clockMode == CLOCK_MODE_FIXED_REAL_TIME)) {
-		_simulationDt = _fixedTicksPerFrame;
-	}
-	else if (_clockMode == CLOCK_MODE_VARIABLE_REAL_TIME) {
-		// _simulationDt will match _realDt, but it will be "clamped" to remain between _mainSimulationDt and _maxSimulationDt.
-		_simulationDt = (_realDt < _maxSimulationDt) ? _realDt : _maxSimulationDt;
-		_simulationDt = (_simulationDt > _minSimulationDt) ? _simulationDt : _minSimulationDt;
-	}
+	_computeSimulationDt();
 
 	// 3. update total simulation time based on the new simulation dt
 	_totalSimulationTime -= _simulationDt;
@@ -124,6 +111,32 @@ void Clock::backupSimulationAndUpdateRealTime()
 
 }
 
+unsigned long long Clock::getFrameDeadline()
+{
+	if (!hasFrameDeadline()) {
+		return 0;
+	}
+	if (_baseTick == 0) {
+		// the clock did not start yet.
+		_getTickCount();
+	}
+	return _baseTick + _totalRealTime + _getMinTicksPerFrame();
+}
+
+void Clock::writeCheckpoint(CheckpointWriter & out)
+{
+	out.write(_simulationFrameNumber);
+	out.write(_totalSimulationTime);
+	out.write(_simulationDt);
+}
+
+void Clock::readCheckpoint(CheckpointReader & in)
+{
+	in.read(_simulationFrameNumber);
+	in.read(_totalSimulationTime);
+	in.read(_simulationDt);
+}
+
 void Clock::setClockMode(ClockModeEnum clockMode, float fixedFps, float minSimulationDt, float maxSimulationDt)
 {
 	_clockMode = clockMode;
@@ -139,6 +152,21 @@ void Clock::setClockMode(ClockModeEnum clockMode, float fixedFps, float minSimul
 }
 
 
+void Clock::_computeSimulationDt()
+{
+	if ((_clockMode == CLOCK_MODE_FIXED_AS_FAST_AS_POSSIBLE) || (_clockMode == CLOCK_MODE_FIXED_REAL_TIME)) {
+		// not derived from the counter frequency, which is measured again by every process and differs slightly
+		// each time; a fixed step must be exactly the same in every run for simulations to be repeatable.
+		_simulationDt = 1.0f / _fixedSimulationFrameRate;
+	}
+	else if (_clockMode == CLOCK_MODE_VARIABLE_REAL_TIME) {
+		// _simulationDt will match _realDt, but it will be "clamped" to remain between _mainSimulationDt and _maxSimulationDt.
+		unsigned long long simulationTicks = (_realDt < _maxSimulationDt) ? _realDt : _maxSimulationDt;
+		simulationTicks = (simulationTicks > _minSimulationDt) ? simulationTicks : _minSimulationDt;
+		_simulationDt = _counterTicksToSeconds(simulationTicks);
+	}
+}
+
 void Clock::_updateFpsMeasurement()
 {
 	if(_realDt > 0.f)
@@ -148,21 +176,21 @@ void Clock::_updateFpsMeasurement()
 
 void Clock::_waitForFrameSync(const unsigned long long & minDesiredTicks)
 {
-
-	// tempDt is the time since last update.
-	// we only insert a delay if that time was shorter than the desired fixed ticks per frame.
-	//
-	unsigned long long tempDt = _getTickCount() - _totalRealTime;
-	if (tempDt < minDesiredTicks) {
-		// figure out when to wake up
-		unsigned long long targetTime = _totalRealTime + minDesiredTicks - tempDt;
-
-		// TODO: set up a better non-busy wait, as long as it uses accurate timing.
-		// busy-wait
-		while(_getTickCount() < targetTime) {
-			// do nothing
+	// we only insert a delay if the time since the last update was shorter than the desired ticks per frame.
+	unsigned long long targetTime = _totalRealTime + minDesiredTicks;
+
+	// sleeping is not precise; the thread may wake up late by about a millisecond.  So the thread sleeps until
+	// shortly before the target time, and busy-waits only for the rest.
+	const unsigned long long frequency = getHighResCounterFrequency();
+	const unsigned long long spinTicks = frequency / 1000 * FRAME_SYNC_SPIN_MILLISECONDS;
+
+	unsigned long long now = _getTickCount();
+	while (now < targetTime) {
+		unsigned long long remainingTicks = targetTime - now;
+		if (remainingTicks > spinTicks) {
+			unsigned long long sleepMicroseconds = (remainingTicks - spinTicks) * 1000000 / frequency;
+			std::this_thread::sleep_for(std::chrono::microseconds(sleepMicroseconds));
 		}
+		now = _getTickCount();
 	}
 }
-
-
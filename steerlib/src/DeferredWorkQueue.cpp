@@ -0,0 +1,137 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+/// @file DeferredWorkQueue.cpp
+/// @brief Implements the SteerLib::DeferredWorkQueue class.
+
+#include <algorithm>
+
+#include "simulation/DeferredWorkQueue.h"
+#include "util/HighResCounter.h"
+
+using namespace SteerLib;
+using namespace Util;
+
+
+bool DeferredWorkQueue::_runsLater(const Item & a, const Item & b)
+{
+	if (a.priority != b.priority) return a.priority < b.priority;
+	return a.sequenceNumber > b.sequenceNumber;
+}
+
+
+void DeferredWorkQueue::defer(AgentInterface * agent, float priority, unsigned int frameNumber, const WorkFunction & work)
+{
+	Item item;
+	item.agent = agent;
+	item.priority = priority;
+	item.frameDeferred = frameNumber;
+	item.work = work;
+
+	std::lock_guard<std::mutex> lock(_itemsMutex);
+	item.sequenceNumber = _nextSequenceNumber++;
+	_items.push_back(item);
+	std::push_heap(_items.begin(), _items.end(), _runsLater);
+}
+
+
+void DeferredWorkQueue::cancel(const AgentInterface * agent)
+{
+	unsigned int numItemsBefore = (unsigned int)_items.size();
+	for (unsigned int i=0; i < _items.size(); ) {
+		if (_items[i].agent == agent) {
+			_items[i] = _items.back();
+			_items.pop_back();
+		}
+		else {
+			i++;
+		}
+	}
+	if (_items.size() != numItemsBefore) {
+		std::make_heap(_items.begin(), _items.end(), _runsLater);
+	}
+}
+
+
+void DeferredWorkQueue::_runItem(Item & item, unsigned int currentFrameNumber, bool forced)
+{
+	unsigned int framesWaited = (currentFrameNumber > item.frameDeferred) ? (currentFrameNumber - item.frameDeferred) : 0;
+	_maxFramesWaited = std::max(_maxFramesWaited, framesWaited);
+	_numItemsRun++;
+	if (forced) {
+		_numItemsForced++;
+		StarvationInfo & starvation = _starvedAgents[item.agent];
+		starvation.numTimesStarved++;
+		starvation.maxFramesWaited = std::max(starvation.maxFramesWaited, framesWaited);
+	}
+
+	// the work may queue more work, which would modify _items.
+	WorkFunction work;
+	work.swap(item.work);
+	work();
+}
+
+
+unsigned int DeferredWorkQueue::runUntil(unsigned long long deadline, unsigned int currentFrameNumber)
+{
+	unsigned int numItemsRunBefore = _numItemsRun;
+
+	// first, everything that waited too long, regardless of the deadline; in order of priority, like the rest.
+	_itemsToRun.clear();
+	for (unsigned int i=0; i < _items.size(); ) {
+		if (currentFrameNumber >= _items[i].frameDeferred + _maxDeferredFrames) {
+			_itemsToRun.push_back(_items[i]);
+			_items[i] = _items.back();
+			_items.pop_back();
+		}
+		else {
+			i++;
+		}
+	}
+	if (!_itemsToRun.empty()) {
+		std::make_heap(_items.begin(), _items.end(), _runsLater);
+		std::sort(_itemsToRun.begin(), _itemsToRun.end(), _runsLater);
+		// sorted so that the item to run first is at the back.
+		while (!_itemsToRun.empty()) {
+			Item item = _itemsToRun.back();
+			_itemsToRun.pop_back();
+			_runItem(item, currentFrameNumber, true);
+		}
+	}
+
+	// then the rest, for as long as the frame has time left.
+	while (!_items.empty() && (getHighResCounterValue() < deadline)) {
+		std::pop_heap(_items.begin(), _items.end(), _runsLater);
+		Item item = _items.back();
+		_items.pop_back();
+		_runItem(item, currentFrameNumber, false);
+	}
+
+	return _numItemsRun - numItemsRunBefore;
+}
+
+
+unsigned int DeferredWorkQueue::runAll(unsigned int currentFrameNumber)
+{
+	unsigned int numItemsRunBefore = _numItemsRun;
+	while (!_items.empty()) {
+		std::pop_heap(_items.begin(), _items.end(), _runsLater);
+		Item item = _items.back();
+		_items.pop_back();
+		_runItem(item, currentFrameNumber, false);
+	}
+	return _numItemsRun - numItemsRunBefore;
+}
+
+
+void DeferredWorkQueue::clear()
+{
+	_items.clear();
+	_nextSequenceNumber = 0;
+	_numItemsRun = 0;
+	_numItemsForced = 0;
+	_maxFramesWaited = 0;
+	_starvedAgents.clear();
+}
@@ -0,0 +1,110 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+/// @file FrameArena.cpp
+/// @brief Implements the Util::FrameArena class.
+
+#include <algorithm>
+#include <cstdint>
+
+#include "util/FrameArena.h"
+
+using namespace Util;
+
+
+FrameArena::FrameArena(size_t blockSize)
+{
+	_blockSize = blockSize;
+	_currentBlock = 0;
+	_currentOffset = 0;
+	_capacity = 0;
+	_numAllocations = 0;
+	_numBytesAllocated = 0;
+}
+
+
+FrameArena::~FrameArena()
+{
+	release();
+}
+
+
+/// Returns the first offset at or after offset, in a block starting at memory, whose address is aligned to alignment.
+static inline size_t alignedOffset(const char * memory, size_t offset, size_t alignment)
+{
+	// blocks are only aligned for fundamental types, so larger alignments must be applied to the address, not the offset.
+	uintptr_t address = (uintptr_t)(memory + offset);
+	return offset + (size_t)(((address + alignment - 1) & ~(uintptr_t)(alignment - 1)) - address);
+}
+
+
+void * FrameArena::allocate(size_t numBytes, size_t alignment)
+{
+	_numAllocations++;
+
+	size_t offset = 0;
+	if (_currentBlock < _blocks.size()) {
+		offset = alignedOffset(_blocks[_currentBlock].memory, _currentOffset, alignment);
+	}
+	if ((_currentBlock >= _blocks.size()) || (offset + numBytes > _blocks[_currentBlock].size)) {
+		_nextBlock(numBytes, alignment);
+		offset = alignedOffset(_blocks[_currentBlock].memory, 0, alignment);
+	}
+
+	_numBytesAllocated += (offset + numBytes) - _currentOffset;
+	_currentOffset = offset + numBytes;
+	return _blocks[_currentBlock].memory + offset;
+}
+
+
+void FrameArena::_nextBlock(size_t numBytes, size_t alignment)
+{
+	if (!_blocks.empty()) {
+		_currentBlock++;
+	}
+	while ((_currentBlock < _blocks.size()) && (alignedOffset(_blocks[_currentBlock].memory, 0, alignment) + numBytes > _blocks[_currentBlock].size)) {
+		_currentBlock++;
+	}
+	if (_currentBlock == _blocks.size()) {
+		// with alignment extra bytes, the allocation fits wherever the block starts.
+		Block block;
+		block.size = std::max(_blockSize, numBytes + alignment);
+		block.memory = static_cast<char*>(::operator new(block.size));
+		_blocks.push_back(block);
+		_capacity += block.size;
+	}
+	_currentOffset = 0;
+}
+
+
+void FrameArena::reset()
+{
+	// one block that fits everything is cheaper to walk next frame than several small ones.
+	if (_blocks.size() > 1) {
+		size_t capacity = _capacity;
+		release();
+		Block block;
+		block.size = capacity;
+		block.memory = static_cast<char*>(::operator new(block.size));
+		_blocks.push_back(block);
+		_capacity = block.size;
+	}
+	_currentBlock = 0;
+	_currentOffset = 0;
+	_numAllocations = 0;
+	_numBytesAllocated = 0;
+}
+
+
+void FrameArena::release()
+{
+	for (unsigned int i=0; i < _blocks.size(); i++) {
+		::operator delete(_blocks[i].memory);
+	}
+	_blocks.clear();
+	_capacity = 0;
+	_currentBlock = 0;
+	_currentOffset = 0;
+}
@@ -0,0 +1,196 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+/// @file FrameTelemetry.cpp
+/// @brief Implements the SteerLib::FrameTelemetry class.
+
+#include <fstream>
+#include <algorithm>
+
+#include "simulation/FrameTelemetry.h"
+#include "util/HighResCounter.h"
+#include "util/GenericException.h"
+#include "util/Misc.h"
+
+using namespace SteerLib;
+using namespace Util;
+
+#define TELEMETRY_FILE_MAGIC "STEERLIB-TELEMETRY"
+#define TELEMETRY_FILE_VERSION 2
+
+
+void FrameTelemetry::start(unsigned int capacity, const std::vector<std::string> & moduleNames)
+{
+	_moduleNames = moduleNames;
+	_numFields = NUM_FRAME_FIELDS + 2 * (unsigned int)moduleNames.size();
+	_capacity = capacity;
+	std::vector< std::atomic<unsigned long long> > values((size_t)capacity * _numFields);
+	_values.swap(values);
+	_currentRow = 0;
+	_numFramesRecorded.store(0);
+	_frameInProgress.store(false);
+	_startTick = getHighResCounterValue();
+}
+
+
+void FrameTelemetry::stop()
+{
+	std::vector< std::atomic<unsigned long long> > noValues;
+	_values.swap(noValues);
+	_capacity = 0;
+	_numFields = 0;
+	_moduleNames.clear();
+	_numFramesRecorded.store(0);
+	_frameInProgress.store(false);
+}
+
+
+void FrameTelemetry::beginFrame(unsigned int frameNumber, unsigned long long startTick)
+{
+	_frameInProgress.store(true);
+	std::atomic_thread_fence(std::memory_order_release);
+	_currentRow = (unsigned int)(_numFramesRecorded.load(std::memory_order_relaxed) % _capacity) * _numFields;
+	for (unsigned int i=0; i < _numFields; i++) {
+		_values[_currentRow + i].store(0, std::memory_order_relaxed);
+	}
+	set(FIELD_FRAME_NUMBER, frameNumber);
+	set(FIELD_FRAME_START_TICKS, startTick - _startTick);
+}
+
+
+unsigned long long FrameTelemetry::getCounterFrequency() const
+{
+	return getHighResCounterFrequency();
+}
+
+
+unsigned int FrameTelemetry::copyRecentFrames(std::vector<unsigned long long> & values, unsigned int maxFrames) const
+{
+	values.clear();
+	if (_capacity == 0) {
+		return 0;
+	}
+
+	unsigned long long numFramesBefore = _numFramesRecorded.load(std::memory_order_acquire);
+	unsigned long long numFrames = std::min(numFramesBefore, (unsigned long long)std::min(maxFrames, _capacity));
+	unsigned long long firstFrame = numFramesBefore - numFrames;
+
+	values.resize((size_t)numFrames * _numFields);
+	for (unsigned long long frame = firstFrame; frame < numFramesBefore; frame++) {
+		unsigned int row = (unsigned int)(frame % _capacity) * _numFields;
+		unsigned long long * destination = &values[(size_t)(frame - firstFrame) * _numFields];
+		for (unsigned int i=0; i < _numFields; i++) {
+			destination[i] = _values[row + i].load(std::memory_order_relaxed);
+		}
+	}
+
+	// while copying, the engine may have overwritten the oldest rows.  If it is recording a frame right now,
+	// that is frame numFramesAfter, which replaces frame (numFramesAfter - capacity).
+	std::atomic_thread_fence(std::memory_order_acquire);
+	unsigned long long numFramesAfter = _numFramesRecorded.load(std::memory_order_relaxed);
+	if (_frameInProgress.load()) {
+		numFramesAfter++;
+	}
+	unsigned long long firstValidFrame = (numFramesAfter > _capacity) ? (numFramesAfter - _capacity) : 0;
+	if (firstValidFrame > firstFrame) {
+		unsigned long long numOverwritten = std::min(firstValidFrame, numFramesBefore) - firstFrame;
+		values.erase(values.begin(), values.begin() + (size_t)numOverwritten * _numFields);
+		numFrames -= numOverwritten;
+	}
+
+	return (unsigned int)numFrames;
+}
+
+
+std::string FrameTelemetry::getFieldName(unsigned int field) const
+{
+	static const char * frameFieldNames[NUM_FRAME_FIELDS] = {
+		"frame", "start", "frame_total", "preprocess_total", "scheduled_tasks", "agents", "postprocess_total", "active_agents", "grid_updates",
+		"arena_allocations", "arena_bytes"
+	};
+
+	if (field < NUM_FRAME_FIELDS) {
+		return frameFieldNames[field];
+	}
+	unsigned int moduleIndex = (field - NUM_FRAME_FIELDS) / 2;
+	if (moduleIndex >= _moduleNames.size()) {
+		throw GenericException("FrameTelemetry::getFieldName() - there is no field " + toString(field) + ".");
+	}
+	return _moduleNames[moduleIndex] + (((field - NUM_FRAME_FIELDS) % 2 == 0) ? "_preprocess" : "_postprocess");
+}
+
+
+void FrameTelemetry::writeCSV(const std::string & filename) const
+{
+	std::ofstream out(filename.c_str());
+	if (!out.is_open()) {
+		throw GenericException("Could not open \"" + filename + "\" to write frame telemetry.");
+	}
+
+	for (unsigned int i=0; i < _numFields; i++) {
+		out << ((i == 0) ? "" : ",") << getFieldName(i);
+	}
+	out << "\n";
+
+	std::vector<unsigned long long> values;
+	unsigned int numFrames = copyRecentFrames(values, _capacity);
+	double millisecondsPerTick = 1000.0 / (double)getCounterFrequency();
+	for (unsigned int frame=0; frame < numFrames; frame++) {
+		const unsigned long long * row = &values[(size_t)frame * _numFields];
+		for (unsigned int i=0; i < _numFields; i++) {
+			bool isCount = (i == FIELD_FRAME_NUMBER) || (i == FIELD_NUM_ACTIVE_AGENTS) || (i == FIELD_NUM_GRID_UPDATES)
+				|| (i == FIELD_NUM_ARENA_ALLOCATIONS) || (i == FIELD_ARENA_BYTES);
+			if (i != 0) out << ",";
+			if (isCount)
+				out << row[i];
+			else
+				out << (double)row[i] * millisecondsPerTick;
+		}
+		out << "\n";
+	}
+}
+
+
+void FrameTelemetry::writeBinary(const std::string & filename) const
+{
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	if (!out.is_open()) {
+		throw GenericException("Could not open \"" + filename + "\" to write frame telemetry.");
+	}
+
+	// the layout, all numbers in the host's native format:
+	//   magic string, version (uint32), counter frequency (uint64), number of modules (uint32),
+	//   for each module its name length (uint32) and characters, fields per row (uint32),
+	//   number of rows (uint32), then the rows, oldest first, as uint64 values.
+	std::vector<unsigned long long> values;
+	unsigned int numFrames = copyRecentFrames(values, _capacity);
+	unsigned int version = TELEMETRY_FILE_VERSION;
+	unsigned long long frequency = getCounterFrequency();
+	unsigned int numModules = (unsigned int)_moduleNames.size();
+
+	out.write(TELEMETRY_FILE_MAGIC, sizeof(TELEMETRY_FILE_MAGIC) - 1);
+	out.write((const char*)&version, sizeof(version));
+	out.write((const char*)&frequency, sizeof(frequency));
+	out.write((const char*)&numModules, sizeof(numModules));
+	for (unsigned int i=0; i < numModules; i++) {
+		unsigned int nameLength = (unsigned int)_moduleNames[i].size();
+		out.write((const char*)&nameLength, sizeof(nameLength));
+		out.write(_moduleNames[i].data(), nameLength);
+	}
+	out.write((const char*)&_numFields, sizeof(_numFields));
+	out.write((const char*)&numFrames, sizeof(numFrames));
+	if (!values.empty()) {
+		out.write((const char*)&values[0], values.size() * sizeof(unsigned long long));
+	}
+}
+
+
+void FrameTelemetry::writeToFile(const std::string & filename) const
+{
+	if ((filename.size() >= 4) && (toLower(filename.substr(filename.size() - 4)) == ".csv"))
+		writeCSV(filename);
+	else
+		writeBinary(filename);
+}
@@ -15,6 +15,7 @@
 #include "util/DrawLib.h"
 #include "util/Color.h"
 #include "util/Misc.h"
+#include "util/WorkStealingScheduler.h"
 #include "mersenne/MersenneTwister.h"
 
 #include "interfaces/AgentInterface.h"
@@ -25,6 +26,34 @@ using namespace std;
 using namespace SteerLib;
 using namespace Util;
 
+namespace {
+	/// Returns what the grid cells store about an object with the given bounds, whose first cell is (xMinIndex, zMinIndex).
+	inline GridCellEntry makeGridCellEntry(SpatialDatabaseItemPtr item, const AxisAlignedBox & bounds, unsigned int xMinIndex, unsigned int zMinIndex)
+	{
+		GridCellEntry entry;
+		entry.item = item;
+		entry.xmin = bounds.xmin;
+		entry.xmax = bounds.xmax;
+		entry.zmin = bounds.zmin;
+		entry.zmax = bounds.zmax;
+		entry.xMinIndex = xMinIndex;
+		entry.zMinIndex = zMinIndex;
+		return entry;
+	}
+
+	inline bool isEarlierCellChange(const DeferredCellChange & a, const DeferredCellChange & b)
+	{
+		return (a.cellIndex < b.cellIndex) || ((a.cellIndex == b.cellIndex) && (a.isStatic < b.isStatic));
+	}
+
+	/// The source of GridDatabase2DPrivate::_deferredUpdateEpoch values, shared by all databases so that no two get the same one.
+	std::atomic<unsigned long long> nextDeferredUpdateEpoch(1);
+
+	/// The buffer the current thread last deferred updates into, and the epoch of the database it belongs to.
+	thread_local unsigned long long cachedDeferredUpdateEpoch = 0;
+	thread_local DeferredUpdateBuffer * cachedDeferredUpdateBuffer = NULL;
+}
+
 
 //
 // constructor for grid database - takes the bounds and desired number of cells
@@ -46,9 +75,16 @@ GridDatabase2D::GridDatabase2D(float xmin, float xmax, float zmin, float zmax, u
 	_zCellSize = _zGridSize / ((float)numZCells);
 	_maxItemsPerCell = maxItemsPerCell;
 	_drawGrid = drawGrid;
+	_deferringUpdates = false;
+	_deferredUpdateEpoch = 0;
+	_countingUpdates = false;
+	_numItemUpdates = 0;
+	_dynamicLayerMode = DYNAMIC_LAYER_INCREMENTAL;
+	_rebuildScheduler = NULL;
 
 	_allocateDatabase();
 	_planningDomain = new GridDatabasePlanningDomain(this);
+	_randomNumberGenerator = new MTRand(2);
 }
 
 
@@ -69,9 +105,16 @@ GridDatabase2D::GridDatabase2D(const Point & origin2D, float xExtent, float zExt
 	_zCellSize = _zGridSize / ((float)numZCells);
 	_maxItemsPerCell = maxItemsPerCell;
 	_drawGrid = drawGrid;
+	_deferringUpdates = false;
+	_deferredUpdateEpoch = 0;
+	_countingUpdates = false;
+	_numItemUpdates = 0;
+	_dynamicLayerMode = DYNAMIC_LAYER_INCREMENTAL;
+	_rebuildScheduler = NULL;
 
 	_allocateDatabase();
 	_planningDomain = new GridDatabasePlanningDomain(this);
+	_randomNumberGenerator = new MTRand(2);
 }
 
 
@@ -80,9 +123,13 @@ GridDatabase2D::GridDatabase2D(const Point & origin2D, float xExtent, float zExt
 //
 GridDatabase2D::~GridDatabase2D()
 {
-	delete [] _basePtr;
-	delete [] _cells;
+	_clearLayer(_dynamicLayer);
+	_clearLayer(_staticLayer);
 	delete _planningDomain;
+	delete _randomNumberGenerator;
+	for (unsigned int i=0; i < _deferredUpdateBuffers.size(); i++) {
+		delete _deferredUpdateBuffers[i];
+	}
 }
 
 
@@ -91,25 +138,135 @@ GridDatabase2D::~GridDatabase2D()
 //
 void GridDatabase2DPrivate::_allocateDatabase()
 {
-	if (_maxItemsPerCell > 15) {
-		cerr << "WARNING: GridDatabase2D is linearly dependent on _maxItemsPerCell." << endl;
-		cerr << "         right now _maxItemsPerCell is " << _maxItemsPerCell << "," << endl;
-		cerr << "         performance may degrade." << endl;
+	// _maxItemsPerCell is only the number of items each cell stores without allocating more memory;
+	// queries visit the items a cell holds, not all of its slots.
+	// obstacles seldom share a cell with more than a few others.
+	_maxStaticItemsPerCell = std::min(_maxItemsPerCell, 4u);
+
+	// no tile exists until an object is added to one of its cells.
+	_xNumTiles = (_xNumCells + GRID_TILE_SIZE - 1) >> GRID_TILE_SHIFT;
+	_zNumTiles = (_zNumCells + GRID_TILE_SIZE - 1) >> GRID_TILE_SHIFT;
+	unsigned int numTotalTiles = _xNumTiles*_zNumTiles;
+
+	std::vector< std::atomic<GridTile*> > staticTiles(numTotalTiles);
+	std::vector< std::atomic<GridTile*> > dynamicTiles(numTotalTiles);
+	_staticLayer.tiles.swap(staticTiles);
+	_dynamicLayer.tiles.swap(dynamicTiles);
+	for (unsigned int t=0; t < numTotalTiles; t++) {
+		_staticLayer.tiles[t].store(NULL);
+		_dynamicLayer.tiles[t].store(NULL);
 	}
 
-	unsigned int numTotalCells = _xNumCells*_zNumCells;
-	unsigned int numTotalItems = numTotalCells * _maxItemsPerCell;
+	// TODO: is it OK to make the traversal cost 0.0f ?? it would be more general.  need to double-check assumptions 
+	// of astar lib...  is traversal cost a fixed cost to add, or is it a multiplicative factor?
+	// the base cost is counted once, in the static layer.
+	_staticLayer.itemsPerCell = _maxStaticItemsPerCell;
+	_staticLayer.emptyCell.init( 0, NULL, 1.0f );
+	_dynamicLayer.itemsPerCell = _maxItemsPerCell;
+	_dynamicLayer.emptyCell.init( 0, NULL, 0.0f );
 
-	_basePtr = new SpatialDatabaseItemPtr[numTotalItems];
-	_cells = new GridCell[numTotalCells];
+	_cellNumbering = CELL_NUMBERING_ROW_MAJOR;
+	_initTileCellOffsets();
+}
 
-	for (unsigned int i=0; i < numTotalCells; i++) {
-		// TODO: is it OK to make the traversal cost 0.0f ?? it would be more general.  need to double-check assumptions 
-		// of astar lib...  is traversal cost a fixed cost to add, or is it a multiplicative factor?
-		_cells[i].init( _maxItemsPerCell, _basePtr + (i*_maxItemsPerCell), 1.0f );
+
+void GridDatabase2DPrivate::_initTileCellOffsets()
+{
+	for (unsigned int i=0; i < GRID_TILE_SIZE; i++) {
+		if (_cellNumbering == CELL_NUMBERING_MORTON) {
+			_tileCellOffsetX[i] = (unsigned char)mortonEncode2D(i, 0);
+			_tileCellOffsetZ[i] = (unsigned char)mortonEncode2D(0, i);
+		}
+		else {
+			_tileCellOffsetX[i] = (unsigned char)(i << GRID_TILE_SHIFT);
+			_tileCellOffsetZ[i] = (unsigned char)i;
+		}
+	}
+}
+
+
+void GridDatabase2D::setCellNumbering(CellNumberingEnum numbering)
+{
+	if (getNumTilesAllocated() != 0) {
+		throw GenericException("GridDatabase2D::setCellNumbering() can only change the cell numbering before any object is added.");
+	}
+	if ((numbering == CELL_NUMBERING_MORTON) && ((_xNumCells > MORTON_MAX_NUM_CELLS) || (_zNumCells > MORTON_MAX_NUM_CELLS))) {
+		throw GenericException("GridDatabase2D::setCellNumbering() - a grid of " + toString(_xNumCells) + "x" + toString(_zNumCells) + " cells is too large for Morton numbering; at most " + toString(MORTON_MAX_NUM_CELLS) + " cells along each axis are supported.");
+	}
+	_cellNumbering = numbering;
+	_initTileCellOffsets();
+}
+
+
+//
+// _getLayer() - agents are in the dynamic layer, everything else in the static layer.
+//
+inline GridLayer & GridDatabase2DPrivate::_getLayer(SpatialDatabaseItemPtr item)
+{
+	return item->isAgent() ? _dynamicLayer : _staticLayer;
+}
+
+
+//
+// _allocateTile() - several threads may add objects to cells of the same missing tile, so the tile is created
+//                   under _tileMutex, and published only after its cells are initialized.
+//
+GridTile * GridDatabase2DPrivate::_allocateTile(GridLayer & layer, unsigned int tileIndex)
+{
+	_tileMutex.lock();
+	GridTile * tile = layer.tiles[tileIndex].load(std::memory_order_acquire);
+	if (tile == NULL) {
+		tile = new GridTile();
+		if (layer.itemsPerCell != 0) {
+			tile->entries = new GridCellEntry[GRID_TILE_NUM_CELLS * layer.itemsPerCell];
+		}
+		for (unsigned int k=0; k < GRID_TILE_NUM_CELLS; k++) {
+			tile->cells[k].init( layer.itemsPerCell, tile->entries + (k*layer.itemsPerCell), layer.emptyCell._traversalCost );
+		}
+		layer.tiles[tileIndex].store(tile, std::memory_order_release);
+	}
+	_tileMutex.unlock();
+	return tile;
+}
+
+
+void GridDatabase2DPrivate::_clearLayer(GridLayer & layer)
+{
+	for (unsigned int t=0; t < layer.tiles.size(); t++) {
+		delete layer.tiles[t].exchange(NULL);
 	}
 }
 
+
+unsigned int GridDatabase2D::getNumTilesAllocated()
+{
+	unsigned int numTiles = 0;
+	for (unsigned int t=0; t < _staticLayer.tiles.size(); t++) {
+		if (_staticLayer.tiles[t].load() != NULL) numTiles++;
+		if (_dynamicLayer.tiles[t].load() != NULL) numTiles++;
+	}
+	return numTiles;
+}
+
+
+size_t GridDatabase2D::getNumBytesAllocated()
+{
+	size_t numBytes = 2 * _staticLayer.tiles.size() * sizeof(GridTile*) + _packedEntries.capacity() * sizeof(GridCellEntry);
+	const GridLayer * layers[2] = { &_staticLayer, &_dynamicLayer };
+	for (unsigned int l=0; l < 2; l++) {
+		for (unsigned int t=0; t < layers[l]->tiles.size(); t++) {
+			const GridTile * tile = layers[l]->tiles[t].load();
+			if (tile == NULL) continue;
+			numBytes += sizeof(GridTile);
+			if (tile->entries != NULL) numBytes += GRID_TILE_NUM_CELLS * layers[l]->itemsPerCell * sizeof(GridCellEntry);
+			for (unsigned int k=0; k < GRID_TILE_NUM_CELLS; k++) {
+				if (tile->cells[k]._overflowItems != NULL) numBytes += tile->cells[k]._overflowItems->capacity() * sizeof(GridCellEntry);
+			}
+		}
+	}
+	return numBytes;
+}
+
 // Rounds the given float to the nearest integer if it is in the specified error range.
 float _roundClose(float f)
 {
@@ -175,6 +332,11 @@ inline bool GridDatabase2DPrivate::_clampSpatialBoundsToIndexRange(float xmin, f
 //
 void GridDatabase2D::addObject( SpatialDatabaseItemPtr item, const AxisAlignedBox & newBounds )
 {
+	if (_deferringUpdates) {
+		_deferUpdate(item, NULL, &newBounds);
+		return;
+	}
+
 	// convert the spatial bounds of the object into index bounds
 	unsigned int xMinIndex, xMaxIndex, zMinIndex, zMaxIndex;
 	if (_clampSpatialBoundsToIndexRange(newBounds.xmin, newBounds.xmax, newBounds.zmin, newBounds.zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex) == false) {
@@ -182,19 +344,19 @@ void GridDatabase2D::addObject( SpatialDatabaseItemPtr item, const AxisAlignedBo
 		return;
 	}
 
-	unsigned int cellIndex;
+	if (_countingUpdates) {
+		_numItemUpdates.fetch_add(1, std::memory_order_relaxed);
+	}
 
-	// iterate over all cells that overlap the bounding box of the object
-	// Note that we use a shortcut to avoid wasting computation;  instead of using getCellIndexFromGridCoords(i,j) in the inner-loop,
-	// we take advantage of the fact that the grid cells are contiguous in memory, and increment cellIndex directly,
-	// recomputing it only when i changes.
+	// iterate over all cells that overlap the bounding box of the object, creating the tiles they are in if needed.
 	// std::cout << "Adding object to cell again, maxItems is: " << _maxItemsPerCell << std::endl;
+	GridCellEntry entry = makeGridCellEntry(item, newBounds, xMinIndex, zMinIndex);
+	float traversalCost = item->getTraversalCost();
+
+	GridLayer & layer = _getLayer(item);
 	for (unsigned int i=xMinIndex; i<=xMaxIndex; i++) {
-		cellIndex = getCellIndexFromGridCoords(i,zMinIndex);
 		for (unsigned int j=zMinIndex; j<=zMaxIndex; j++) {
-			_cells[cellIndex].add(item,_maxItemsPerCell, item->getTraversalCost());
-			// std::cout << "CellIndex is: " << cellIndex << std::endl;
-			cellIndex++;
+			_getCellForWriting(layer, i, j).add(entry, traversalCost);
 		}
 	}
 }
@@ -205,6 +367,11 @@ void GridDatabase2D::addObject( SpatialDatabaseItemPtr item, const AxisAlignedBo
 //
 void GridDatabase2D::removeObject( SpatialDatabaseItemPtr item, const AxisAlignedBox &oldBounds )
 {
+	if (_deferringUpdates) {
+		_deferUpdate(item, &oldBounds, NULL);
+		return;
+	}
+
 	// convert the spatial bounds of the object into index bounds
 	unsigned int xMinIndex, xMaxIndex, zMinIndex, zMaxIndex;
 	if (_clampSpatialBoundsToIndexRange(oldBounds.xmin, oldBounds.xmax, oldBounds.zmin, oldBounds.zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex) == false) {
@@ -212,20 +379,23 @@ void GridDatabase2D::removeObject( SpatialDatabaseItemPtr item, const AxisAligne
 		return;
 	}
 
-	unsigned int cellIndex;
+	if (_countingUpdates) {
+		_numItemUpdates.fetch_add(1, std::memory_order_relaxed);
+	}
 
-	// iterate over all cells that overlap the bounding box of the object
-	// Note that we use a shortcut to avoid wasting computation;  instead of using getCellIndexFromGridCoords(i,j) in the inner-loop,
-	// we take advantage of the fact that the grid cells are contiguous in memory, and increment cellIndex directly,
-	// recomputing it only when i changes.
+	// iterate over all cells that overlap the bounding box of the object; an object that was added there
+	// created their tiles, so a missing tile means the item is not there, and is never allocated just to find that out.
 #ifdef _DEBUG
 	// std::cout << "about to remove(item, _maxItemsPerCell, item->getTraversalCost());\n";
 #endif
+	GridLayer & layer = _getLayer(item);
 	for (unsigned int i=xMinIndex; i<=xMaxIndex; i++) {
-		cellIndex = getCellIndexFromGridCoords(i,zMinIndex);
 		for (unsigned int j=zMinIndex; j<=zMaxIndex; j++) {
-			_cells[cellIndex].remove(item, _maxItemsPerCell, item->getTraversalCost());
-			cellIndex++;
+			GridCell * cell = _findCellForWriting(layer, i, j);
+			if (cell == NULL) {
+				throw GenericException("Tried to remove an object from a grid cell, but it did not exist there in the first place.");
+			}
+			cell->remove(item, item->getTraversalCost());
 		}
 	}
 }
@@ -234,10 +404,8 @@ void GridDatabase2D::removeObject( SpatialDatabaseItemPtr item, const AxisAligne
 //
 // updateObject() - updates the grid cells that have a reference to the item.
 //
-// for now this function calls removeObject() and addObject(). but later it may be
-// appropriate to optimize this even further by updating only the grid cells that
-// will be changed by the update.
-//
+// if the item still overlaps the same cells, only the bounds those cells store are refreshed;
+// otherwise this function calls removeObject() and addObject().
 //
 void GridDatabase2D::updateObject( SpatialDatabaseItemPtr item, const AxisAlignedBox & oldBounds, const AxisAlignedBox & newBounds )
 {
@@ -245,6 +413,30 @@ void GridDatabase2D::updateObject( SpatialDatabaseItemPtr item, const AxisAligne
 #ifdef _DEBUG_!
 	std::cout << "about to updateObject()\n";
 #endif
+	if (_deferringUpdates) {
+		_deferUpdate(item, &oldBounds, &newBounds);
+		return;
+	}
+
+	unsigned int oldXMinIndex, oldXMaxIndex, oldZMinIndex, oldZMaxIndex;
+	unsigned int xMinIndex, xMaxIndex, zMinIndex, zMaxIndex;
+	if (_clampSpatialBoundsToIndexRange(oldBounds.xmin, oldBounds.xmax, oldBounds.zmin, oldBounds.zmax, oldXMinIndex, oldXMaxIndex, oldZMinIndex, oldZMaxIndex)
+		&& _clampSpatialBoundsToIndexRange(newBounds.xmin, newBounds.xmax, newBounds.zmin, newBounds.zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex)
+		&& (oldXMinIndex == xMinIndex) && (oldXMaxIndex == xMaxIndex) && (oldZMinIndex == zMinIndex) && (oldZMaxIndex == zMaxIndex)) {
+		// updates outside of deferral never run concurrently, so the cells need not be locked.
+		GridCellEntry entry = makeGridCellEntry(item, newBounds, xMinIndex, zMinIndex);
+		GridLayer & layer = _getLayer(item);
+		for (unsigned int i=xMinIndex; i<=xMaxIndex; i++) {
+			for (unsigned int j=zMinIndex; j<=zMaxIndex; j++) {
+				GridCell * cell = _findCellForWriting(layer, i, j);
+				if ((cell == NULL) || !cell->_refresh(entry)) {
+					throw GenericException("Tried to refresh an object in a grid cell, but it did not exist there in the first place.");
+				}
+			}
+		}
+		return;
+	}
+
 	removeObject(item, oldBounds);
 	// assert(item != NULL);
 	addObject(item, newBounds);
@@ -252,22 +444,694 @@ void GridDatabase2D::updateObject( SpatialDatabaseItemPtr item, const AxisAligne
 
 
 //
-// getItemsInRange() - the protected version uses the integer index ranges.
+// _deferUpdate() - appends one add/remove/update call to the buffer of the calling thread.
+//                  no lock is taken, except the first time a thread defers an update after
+//                  deferring began.  An item should only be updated by one thread at a time.
 //
-void GridDatabase2D::getItemsInRange(set<SpatialDatabaseItemPtr> & neighborList, unsigned int xMinIndex, unsigned int xMaxIndex, unsigned int zMinIndex, unsigned int zMaxIndex, SpatialDatabaseItemPtr exclude)
+void GridDatabase2DPrivate::_deferUpdate( SpatialDatabaseItemPtr item, const AxisAlignedBox * oldBounds, const AxisAlignedBox * newBounds )
 {
-	int cellIndex;
+	if (cachedDeferredUpdateEpoch != _deferredUpdateEpoch) {
+		cachedDeferredUpdateBuffer = _getDeferredUpdateBufferOfThisThread();
+		cachedDeferredUpdateEpoch = _deferredUpdateEpoch;
+	}
+	std::vector< std::pair<SpatialDatabaseItemPtr, DeferredGridUpdate> > & calls = cachedDeferredUpdateBuffer->calls;
+
+	// consecutive calls on the same item, such as an update right after an addition, are merged right away.
+	if (calls.empty() || (calls.back().first != item)) {
+		DeferredGridUpdate update;
+		update.wasInDatabase = (oldBounds != NULL);
+		if (oldBounds != NULL) update.oldBounds = *oldBounds;
+		calls.push_back(std::make_pair(item, update));
+	}
 
-	// iterate over all grid cells in the range,
-	for (unsigned int i=xMinIndex; i<=xMaxIndex; i++) {
-		cellIndex = (i * _zNumCells) + zMinIndex;
-		for (unsigned int j=zMinIndex; j<=zMaxIndex; j++) {
-			for (unsigned int k=0; k < _maxItemsPerCell; k++) {
-				if ((_cells[cellIndex]._items[k]!=NULL) && (_cells[cellIndex]._items[k]!=exclude)) {
-					neighborList.insert(_cells[cellIndex]._items[k]);
+	DeferredGridUpdate & update = calls.back().second;
+	update.isInDatabase = (newBounds != NULL);
+	if (newBounds != NULL) update.newBounds = *newBounds;
+}
+
+
+DeferredUpdateBuffer * GridDatabase2DPrivate::_getDeferredUpdateBufferOfThisThread()
+{
+	std::thread::id thisThread = std::this_thread::get_id();
+	DeferredUpdateBuffer * buffer = NULL;
+
+	_deferredUpdateBufferMutex.lock();
+	for (unsigned int i=0; i < _deferredUpdateBuffers.size(); i++) {
+		if (_deferredUpdateBuffers[i]->ownerThread == thisThread) {
+			buffer = _deferredUpdateBuffers[i];
+			break;
+		}
+	}
+	if (buffer == NULL) {
+		buffer = new DeferredUpdateBuffer();
+		buffer->ownerThread = thisThread;
+		_deferredUpdateBuffers.push_back(buffer);
+	}
+	_deferredUpdateBufferMutex.unlock();
+
+	return buffer;
+}
+
+
+//
+// _mergeDeferredUpdateBuffers() - folds the calls of every thread into one change per item:
+//                                 the first call decides where the item was before deferring
+//                                 started; the latest call decides where it will be once the
+//                                 change is committed.
+//
+void GridDatabase2DPrivate::_mergeDeferredUpdateBuffers()
+{
+	for (unsigned int b=0; b < _deferredUpdateBuffers.size(); b++) {
+		std::vector< std::pair<SpatialDatabaseItemPtr, DeferredGridUpdate> > & calls = _deferredUpdateBuffers[b]->calls;
+		for (unsigned int i=0; i < calls.size(); i++) {
+			std::pair<std::unordered_map<SpatialDatabaseItemPtr, DeferredGridUpdate>::iterator, bool> inserted = _deferredUpdates.insert(calls[i]);
+			if (inserted.second) {
+				_deferredUpdateOrder.push_back(calls[i].first);
+			}
+			else {
+				inserted.first->second.isInDatabase = calls[i].second.isInDatabase;
+				inserted.first->second.newBounds = calls[i].second.newBounds;
+			}
+		}
+		calls.clear();
+	}
+}
+
+
+void GridDatabase2D::beginDeferredUpdates()
+{
+	if (_deferringUpdates) {
+		throw GenericException("GridDatabase2D::beginDeferredUpdates() called while already deferring updates.");
+	}
+	_deferringUpdates = true;
+	_deferredUpdateEpoch = nextDeferredUpdateEpoch.fetch_add(1);
+}
+
+
+//
+// commitDeferredUpdate() - applies the buffered change of one item.  Only the owning thread
+//                          should call this, and no queries should run concurrently with it.
+//
+void GridDatabase2D::commitDeferredUpdate( SpatialDatabaseItemPtr item )
+{
+	_mergeDeferredUpdateBuffers();
+	std::unordered_map<SpatialDatabaseItemPtr, DeferredGridUpdate>::iterator iter = _deferredUpdates.find(item);
+	if (iter == _deferredUpdates.end()) {
+		return;
+	}
+
+	_collectDeferredUpdate(item);
+	_applyDeferredCellChanges();
+}
+
+
+//
+// _collectDeferredUpdate() - turns the buffered change of one item into changes of single cells.
+//
+void GridDatabase2D::_collectDeferredUpdate( SpatialDatabaseItemPtr item )
+{
+	std::unordered_map<SpatialDatabaseItemPtr, DeferredGridUpdate>::iterator iter = _deferredUpdates.find(item);
+	if (iter == _deferredUpdates.end()) {
+		return;
+	}
+
+	DeferredGridUpdate update = iter->second;
+	_deferredUpdates.erase(iter);
+
+	if ((_dynamicLayerMode == DYNAMIC_LAYER_REBUILD) && item->isAgent()) {
+		_pendingRebuildUpdates.push_back(std::make_pair(item, update));
+		return;
+	}
+
+	unsigned int oldXMinIndex, oldXMaxIndex, oldZMinIndex, oldZMaxIndex;
+	unsigned int xMinIndex, xMaxIndex, zMinIndex, zMaxIndex;
+	bool wasInGrid = update.wasInDatabase && _clampSpatialBoundsToIndexRange(update.oldBounds.xmin, update.oldBounds.xmax, update.oldBounds.zmin, update.oldBounds.zmax, oldXMinIndex, oldXMaxIndex, oldZMinIndex, oldZMaxIndex);
+	bool isInGrid = update.isInDatabase && _clampSpatialBoundsToIndexRange(update.newBounds.xmin, update.newBounds.xmax, update.newBounds.zmin, update.newBounds.zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex);
+
+	GridLayer & layer = _getLayer(item);
+	if (wasInGrid && isInGrid && (oldXMinIndex == xMinIndex) && (oldXMaxIndex == xMaxIndex) && (oldZMinIndex == zMinIndex) && (oldZMaxIndex == zMaxIndex)) {
+		// the item stays in the same cells and keeps its place in them, so its bounds can be refreshed right away.
+		GridCellEntry entry = makeGridCellEntry(item, update.newBounds, xMinIndex, zMinIndex);
+		for (unsigned int i=xMinIndex; i<=xMaxIndex; i++) {
+			for (unsigned int j=zMinIndex; j<=zMaxIndex; j++) {
+				GridCell * cell = _findCellForWriting(layer, i, j);
+				if ((cell == NULL) || !cell->_refresh(entry)) {
+					throw GenericException("Tried to refresh an object in a grid cell, but it did not exist there in the first place.");
+				}
+			}
+		}
+		return;
+	}
+
+	DeferredCellChange change;
+	change.isStatic = (&layer == &_staticLayer);
+	change.traversalCost = item->getTraversalCost();
+
+	if (wasInGrid) {
+		if (_countingUpdates) {
+			_numItemUpdates.fetch_add(1, std::memory_order_relaxed);
+		}
+		change.isAddition = false;
+		change.entry = makeGridCellEntry(item, update.oldBounds, oldXMinIndex, oldZMinIndex);
+		for (unsigned int i=oldXMinIndex; i<=oldXMaxIndex; i++) {
+			for (unsigned int j=oldZMinIndex; j<=oldZMaxIndex; j++) {
+				change.cellIndex = getCellIndexFromGridCoords(i,j);
+				_deferredCellChanges.push_back(change);
+			}
+		}
+	}
+
+	if (isInGrid) {
+		if (_countingUpdates) {
+			_numItemUpdates.fetch_add(1, std::memory_order_relaxed);
+		}
+		change.isAddition = true;
+		change.entry = makeGridCellEntry(item, update.newBounds, xMinIndex, zMinIndex);
+		for (unsigned int i=xMinIndex; i<=xMaxIndex; i++) {
+			for (unsigned int j=zMinIndex; j<=zMaxIndex; j++) {
+				change.cellIndex = getCellIndexFromGridCoords(i,j);
+				_deferredCellChanges.push_back(change);
+			}
+		}
+	}
+}
+
+
+//
+// _applyDeferredCellChanges() - applies the collected changes in the order of the cells, so that
+//                               each cell is changed once, by one thread, without taking its lock.
+//
+void GridDatabase2D::_applyDeferredCellChanges()
+{
+	std::stable_sort(_deferredCellChanges.begin(), _deferredCellChanges.end(), isEarlierCellChange);
+
+	for (unsigned int i=0; i < _deferredCellChanges.size(); i++) {
+		const DeferredCellChange & change = _deferredCellChanges[i];
+		unsigned int x, z;
+		getGridCoordinatesFromIndex(change.cellIndex, x, z);
+		GridLayer & layer = change.isStatic ? _staticLayer : _dynamicLayer;
+		if (change.isAddition) {
+			GridCell & cell = _getCellForWriting(layer, x, z);
+			cell._append(change.entry);
+			cell._traversalCost += change.traversalCost;
+		}
+		else {
+			GridCell * cell = _findCellForWriting(layer, x, z);
+			if ((cell == NULL) || !cell->_remove(change.entry.item)) {
+				_deferredCellChanges.clear();
+				throw GenericException("Tried to remove an object from a grid cell, but it did not exist there in the first place.");
+			}
+			cell->_traversalCost -= change.traversalCost;
+		}
+	}
+	_deferredCellChanges.clear();
+
+	if (!_pendingRebuildUpdates.empty()) {
+		_rebuildDynamicLayer();
+	}
+}
+
+
+void GridDatabase2D::setDynamicLayerMode(DynamicLayerModeEnum mode, WorkStealingScheduler * scheduler)
+{
+	if (_deferringUpdates) {
+		throw GenericException("GridDatabase2D::setDynamicLayerMode() cannot change the mode while updates are deferred.");
+	}
+
+	_rebuildScheduler = scheduler;
+	if (mode == _dynamicLayerMode) {
+		return;
+	}
+	_dynamicLayerMode = mode;
+
+	if (mode == DYNAMIC_LAYER_REBUILD) {
+		_dynamicLayer.itemsPerCell = 0;
+		_rebuildDynamicLayer();
+		for (unsigned int t=0; t < _dynamicLayer.tiles.size(); t++) {
+			GridTile * tile = _dynamicLayer.tiles[t].load();
+			if (tile == NULL) continue;
+			delete [] tile->entries;
+			tile->entries = NULL;
+		}
+	}
+	else {
+		// move every cell back to its part of a fixed array of its tile, keeping the order of its items.
+		_dynamicLayer.itemsPerCell = _maxItemsPerCell;
+		std::vector<GridCellEntry> cellEntries;
+		for (unsigned int t=0; t < _dynamicLayer.tiles.size(); t++) {
+			GridTile * tile = _dynamicLayer.tiles[t].load();
+			if (tile == NULL) continue;
+			tile->entries = new GridCellEntry[GRID_TILE_NUM_CELLS * _maxItemsPerCell];
+			for (unsigned int k=0; k < GRID_TILE_NUM_CELLS; k++) {
+				GridCell & cell = tile->cells[k];
+				cellEntries.clear();
+				for (unsigned int n=0; n < cell._numItems; n++) {
+					cellEntries.push_back(cell.getEntry(n));
+				}
+				cell.init(_maxItemsPerCell, tile->entries + (k*_maxItemsPerCell), cell._traversalCost);
+				for (unsigned int n=0; n < cellEntries.size(); n++) {
+					cell._append(cellEntries[n]);
+				}
+			}
+		}
+		std::vector<GridCellEntry> noEntries;
+		_packedEntries.swap(noEntries);
+		_cellOffsets.clear();
+	}
+}
+
+
+void GridDatabase2D::_runInChunks(unsigned int numItems, unsigned int numChunks, const std::function<void (unsigned int chunk, unsigned int begin, unsigned int end)> & body)
+{
+	if ((_rebuildScheduler == NULL) || (numChunks == 1)) {
+		for (unsigned int chunk=0; chunk < numChunks; chunk++) {
+			body(chunk, (unsigned int)(((unsigned long long)numItems * chunk) / numChunks), (unsigned int)(((unsigned long long)numItems * (chunk+1)) / numChunks));
+		}
+		return;
+	}
+
+	_rebuildScheduler->parallelFor(0, numChunks, 1, [&](unsigned int threadIndex, unsigned int begin, unsigned int end) {
+		for (unsigned int chunk=begin; chunk < end; chunk++) {
+			body(chunk, (unsigned int)(((unsigned long long)numItems * chunk) / numChunks), (unsigned int)(((unsigned long long)numItems * (chunk+1)) / numChunks));
+		}
+	});
+}
+
+
+unsigned int GridDatabase2D::_scanInChunks(unsigned int numItems, unsigned int numChunks, const std::function<unsigned int (unsigned int begin, unsigned int end)> & sumRange,
+	const std::function<void (unsigned int begin, unsigned int end, unsigned int start)> & scanRange)
+{
+	_rebuildChunkStarts.resize(numChunks + 1);
+	_runInChunks(numItems, numChunks, [&](unsigned int chunk, unsigned int begin, unsigned int end) {
+		_rebuildChunkStarts[chunk] = sumRange(begin, end);
+	});
+
+	// only numChunks values, so this part is serial.
+	unsigned int total = 0;
+	for (unsigned int chunk=0; chunk < numChunks; chunk++) {
+		unsigned int chunkTotal = _rebuildChunkStarts[chunk];
+		_rebuildChunkStarts[chunk] = total;
+		total += chunkTotal;
+	}
+	_rebuildChunkStarts[numChunks] = total;
+
+	_runInChunks(numItems, numChunks, [&](unsigned int chunk, unsigned int begin, unsigned int end) {
+		scanRange(begin, end, _rebuildChunkStarts[chunk]);
+	});
+	return total;
+}
+
+
+void GridDatabase2DPrivate::_collectRebuildTiles()
+{
+	_rebuildTiles.clear();
+	_rebuildTileOrdinals.resize(_dynamicLayer.tiles.size());
+	for (unsigned int t=0; t < _dynamicLayer.tiles.size(); t++) {
+		GridTile * tile = _dynamicLayer.tiles[t].load(std::memory_order_relaxed);
+		_rebuildTileOrdinals[t] = (tile != NULL) ? (unsigned int)_rebuildTiles.size() : (unsigned int)-1;
+		if (tile != NULL) _rebuildTiles.push_back(tile);
+	}
+}
+
+
+//
+// _rebuildDynamicLayer() - a stable counting sort of all agents by cell.  The agents are split into one chunk per
+//                          thread; each chunk counts how many entries it puts in each cell, the counts are summed
+//                          into the start of every (cell, chunk) pair in cell-major order, and each chunk then
+//                          writes its entries in order.  Every step is split across the threads, but the work of
+//                          each one grows with the number of cells in the tiles that exist, not only with the
+//                          number of agents; the counts and their sums even take (number of threads) x (number
+//                          of cells).  Large empty parts of the world, without tiles, cost nothing.
+//
+void GridDatabase2D::_rebuildDynamicLayer()
+{
+	unsigned int numChunks = (_rebuildScheduler != NULL) ? _rebuildScheduler->getNumThreads() : 1;
+
+	// (1) collect every agent once, from the first cell it overlaps, in the order of the slots.
+	_collectRebuildTiles();
+	unsigned int numSlots = (unsigned int)_rebuildTiles.size() * GRID_TILE_NUM_CELLS;
+	_rebuildItemOffsets.resize(numSlots + 1);
+	_runInChunks(numSlots, numChunks, [this](unsigned int chunk, unsigned int begin, unsigned int end) {
+		for (unsigned int s=begin; s < end; s++) {
+			const GridCell & cell = _rebuildTiles[s / GRID_TILE_NUM_CELLS]->cells[s % GRID_TILE_NUM_CELLS];
+			unsigned int numFirstEntries = 0;
+			for (unsigned int k=0; k < cell._numItems; k++) {
+				const GridCellEntry & entry = cell.getEntry(k);
+				if (_getRebuildSlot(entry.xMinIndex, entry.zMinIndex) == s) numFirstEntries++;
+			}
+			_rebuildItemOffsets[s] = numFirstEntries;
+		}
+	});
+	unsigned int numItems = _scanInChunks(numSlots, numChunks, [this](unsigned int begin, unsigned int end) {
+		unsigned int total = 0;
+		for (unsigned int s=begin; s < end; s++) total += _rebuildItemOffsets[s];
+		return total;
+	}, [this](unsigned int begin, unsigned int end, unsigned int start) {
+		for (unsigned int s=begin; s < end; s++) {
+			unsigned int numFirstEntries = _rebuildItemOffsets[s];
+			_rebuildItemOffsets[s] = start;
+			start += numFirstEntries;
+		}
+	});
+	_rebuildItemOffsets[numSlots] = numItems;
+
+	_rebuildItems.resize(numItems);
+	_runInChunks(numSlots, numChunks, [this](unsigned int chunk, unsigned int begin, unsigned int end) {
+		for (unsigned int s=begin; s < end; s++) {
+			const GridCell & cell = _rebuildTiles[s / GRID_TILE_NUM_CELLS]->cells[s % GRID_TILE_NUM_CELLS];
+			unsigned int n = _rebuildItemOffsets[s];
+			for (unsigned int k=0; k < cell._numItems; k++) {
+				const GridCellEntry & entry = cell.getEntry(k);
+				if (_getRebuildSlot(entry.xMinIndex, entry.zMinIndex) == s) _rebuildItems[n++] = entry;
+			}
+		}
+	});
+
+	// (2) apply the pending updates: an agent that was in the grid is found among the few agents that start in the same
+	//     cell and replaced, or cleared if it left the grid; agents that were not in the grid are added at the end.
+	unsigned int numUpdates = (unsigned int)_pendingRebuildUpdates.size();
+	std::atomic<unsigned int> numMissingItems(0);
+	_runInChunks(numUpdates, numChunks, [&](unsigned int chunk, unsigned int begin, unsigned int end) {
+		for (unsigned int u=begin; u < end; u++) {
+			SpatialDatabaseItemPtr item = _pendingRebuildUpdates[u].first;
+			const DeferredGridUpdate & update = _pendingRebuildUpdates[u].second;
+			unsigned int xMinIndex, xMaxIndex, zMinIndex, zMaxIndex;
+			if (!update.wasInDatabase || !_clampSpatialBoundsToIndexRange(update.oldBounds.xmin, update.oldBounds.xmax, update.oldBounds.zmin, update.oldBounds.zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex)) {
+				continue;
+			}
+			if (_rebuildTileOrdinals[(xMinIndex >> GRID_TILE_SHIFT) * _zNumTiles + (zMinIndex >> GRID_TILE_SHIFT)] == (unsigned int)-1) {
+				numMissingItems.fetch_add(1);
+				continue;
+			}
+			unsigned int s = _getRebuildSlot(xMinIndex, zMinIndex);
+			unsigned int n = _rebuildItemOffsets[s];
+			while ((n < _rebuildItemOffsets[s+1]) && (_rebuildItems[n].item != item)) n++;
+			if (n == _rebuildItemOffsets[s+1]) {
+				numMissingItems.fetch_add(1);
+				continue;
+			}
+			if (update.isInDatabase && _clampSpatialBoundsToIndexRange(update.newBounds.xmin, update.newBounds.xmax, update.newBounds.zmin, update.newBounds.zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex)) {
+				_rebuildItems[n] = makeGridCellEntry(item, update.newBounds, xMinIndex, zMinIndex);
+			}
+			else {
+				_rebuildItems[n].item = NULL;
+			}
+		}
+	});
+	for (unsigned int u=0; u < numUpdates; u++) {
+		const DeferredGridUpdate & update = _pendingRebuildUpdates[u].second;
+		unsigned int xMinIndex, xMaxIndex, zMinIndex, zMaxIndex;
+		bool wasInGrid = update.wasInDatabase && _clampSpatialBoundsToIndexRange(update.oldBounds.xmin, update.oldBounds.xmax, update.oldBounds.zmin, update.oldBounds.zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex);
+		if (!wasInGrid && update.isInDatabase && _clampSpatialBoundsToIndexRange(update.newBounds.xmin, update.newBounds.xmax, update.newBounds.zmin, update.newBounds.zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex)) {
+			_rebuildItems.push_back(makeGridCellEntry(_pendingRebuildUpdates[u].first, update.newBounds, xMinIndex, zMinIndex));
+		}
+	}
+	if (_countingUpdates) {
+		_numItemUpdates.fetch_add(numUpdates, std::memory_order_relaxed);
+	}
+	_pendingRebuildUpdates.clear();
+	numItems = (unsigned int)_rebuildItems.size();
+
+	// agents that moved into tiles that do not exist yet need them before the slots are counted.
+	unsigned int numTilesBefore = (unsigned int)_rebuildTiles.size();
+	for (unsigned int n=0; n < numItems; n++) {
+		const GridCellEntry & entry = _rebuildItems[n];
+		unsigned int xMinIndex, xMaxIndex, zMinIndex, zMaxIndex;
+		if ((entry.item == NULL) || !_clampSpatialBoundsToIndexRange(entry.xmin, entry.xmax, entry.zmin, entry.zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex)) continue;
+		for (unsigned int ti=(xMinIndex >> GRID_TILE_SHIFT); ti<=(xMaxIndex >> GRID_TILE_SHIFT); ti++) {
+			for (unsigned int tj=(zMinIndex >> GRID_TILE_SHIFT); tj<=(zMaxIndex >> GRID_TILE_SHIFT); tj++) {
+				unsigned int tileIndex = ti * _zNumTiles + tj;
+				if (_rebuildTileOrdinals[tileIndex] == (unsigned int)-1) {
+					_rebuildTileOrdinals[tileIndex] = (unsigned int)_rebuildTiles.size();
+					_rebuildTiles.push_back(_allocateTile(_dynamicLayer, tileIndex));
+				}
+			}
+		}
+	}
+	if (_rebuildTiles.size() != numTilesBefore) {
+		_collectRebuildTiles();
+		numSlots = (unsigned int)_rebuildTiles.size() * GRID_TILE_NUM_CELLS;
+	}
+
+	// (3) each chunk of agents counts the entries it puts in every slot.
+	_rebuildCounts.resize((size_t)numChunks * numSlots);
+	_runInChunks(numItems, numChunks, [this, numSlots](unsigned int chunk, unsigned int begin, unsigned int end) {
+		unsigned int * counts = &_rebuildCounts[(size_t)chunk * numSlots];
+		std::fill(counts, counts + numSlots, 0u);
+		for (unsigned int n=begin; n < end; n++) {
+			const GridCellEntry & entry = _rebuildItems[n];
+			unsigned int xMinIndex, xMaxIndex, zMinIndex, zMaxIndex;
+			if ((entry.item == NULL) || !_clampSpatialBoundsToIndexRange(entry.xmin, entry.xmax, entry.zmin, entry.zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex)) continue;
+			for (unsigned int i=xMinIndex; i<=xMaxIndex; i++) {
+				for (unsigned int j=zMinIndex; j<=zMaxIndex; j++) {
+					counts[_getRebuildSlot(i,j)]++;
+				}
+			}
+		}
+	});
+
+	// (4) the start of each (slot, chunk) pair; the entries of a cell come from the chunks in order, so the sort is stable.
+	_cellOffsets.resize(numSlots + 1);
+	unsigned int numEntries = _scanInChunks(numSlots, numChunks, [this, numSlots, numChunks](unsigned int begin, unsigned int end) {
+		unsigned int total = 0;
+		for (unsigned int chunk=0; chunk < numChunks; chunk++) {
+			const unsigned int * counts = &_rebuildCounts[(size_t)chunk * numSlots];
+			for (unsigned int s=begin; s < end; s++) total += counts[s];
+		}
+		return total;
+	}, [this, numSlots, numChunks](unsigned int begin, unsigned int end, unsigned int start) {
+		for (unsigned int s=begin; s < end; s++) {
+			_cellOffsets[s] = start;
+			for (unsigned int chunk=0; chunk < numChunks; chunk++) {
+				unsigned int count = _rebuildCounts[(size_t)chunk * numSlots + s];
+				_rebuildCounts[(size_t)chunk * numSlots + s] = start;
+				start += count;
+			}
+		}
+	});
+	_cellOffsets[numSlots] = numEntries;
+
+	// (5) each chunk writes its entries; the cells no longer point into the packed array until step (6).
+	_packedEntries.resize(numEntries);
+	_runInChunks(numItems, numChunks, [this, numSlots](unsigned int chunk, unsigned int begin, unsigned int end) {
+		unsigned int * next = &_rebuildCounts[(size_t)chunk * numSlots];
+		for (unsigned int n=begin; n < end; n++) {
+			const GridCellEntry & entry = _rebuildItems[n];
+			unsigned int xMinIndex, xMaxIndex, zMinIndex, zMaxIndex;
+			if ((entry.item == NULL) || !_clampSpatialBoundsToIndexRange(entry.xmin, entry.xmax, entry.zmin, entry.zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex)) continue;
+			for (unsigned int i=xMinIndex; i<=xMaxIndex; i++) {
+				for (unsigned int j=zMinIndex; j<=zMaxIndex; j++) {
+					_packedEntries[next[_getRebuildSlot(i,j)]++] = entry;
+				}
+			}
+		}
+	});
+
+	// (6) point every dynamic cell to its part of the packed array.
+	_runInChunks(numSlots, numChunks, [this](unsigned int chunk, unsigned int begin, unsigned int end) {
+		for (unsigned int s=begin; s < end; s++) {
+			unsigned int numCellEntries = _cellOffsets[s+1] - _cellOffsets[s];
+			GridCellEntry * cellEntries = _packedEntries.data() + _cellOffsets[s];
+			float traversalCost = 0.0f;
+			for (unsigned int k=0; k < numCellEntries; k++) {
+				traversalCost += cellEntries[k].item->getTraversalCost();
+			}
+			GridCell & cell = _rebuildTiles[s / GRID_TILE_NUM_CELLS]->cells[s % GRID_TILE_NUM_CELLS];
+			cell.init(numCellEntries, cellEntries, traversalCost);
+			cell._numItems = numCellEntries;
+		}
+	});
+
+	if (numMissingItems.load() != 0) {
+		throw GenericException("Tried to move " + toString(numMissingItems.load()) + " agents in the grid database, but they were not in the grid cells of their old bounds.");
+	}
+}
+
+
+void GridDatabase2D::endDeferredUpdates()
+{
+	if (!_deferringUpdates) {
+		throw GenericException("GridDatabase2D::endDeferredUpdates() called without a matching beginDeferredUpdates().");
+	}
+
+	_deferringUpdates = false;
+
+	// anything not committed explicitly is applied in arrival order.
+	commitDeferredUpdates(_deferredUpdateOrder);
+	_deferredUpdateOrder.clear();
+	_deferredUpdates.clear();
+}
+
+
+//
+// seedRandomNumberGenerator()
+//
+void GridDatabase2D::seedRandomNumberGenerator(unsigned int seed)
+{
+	_randomNumberGeneratorMutex.lock();
+	_randomNumberGenerator->seed((MTRand::uint32)seed);
+	_randomNumberGeneratorMutex.unlock();
+}
+
+
+//
+// writeCheckpoint() - items are stored in the order of their cells, so that queries visit them in the same order after a restore.
+//
+void GridDatabase2D::writeCheckpoint(CheckpointWriter & out)
+{
+	if (_deferringUpdates) {
+		throw GenericException("Cannot checkpoint the grid database while updates are deferred.");
+	}
+
+	out.write(_xNumCells);
+	out.write(_zNumCells);
+	out.write(_maxItemsPerCell);
+
+	MTRand::uint32 randomState[MTRand::SAVE];
+	_randomNumberGeneratorMutex.lock();
+	_randomNumberGenerator->save(randomState);
+	_randomNumberGeneratorMutex.unlock();
+	out.write(randomState);
+
+	_writeLayerCheckpoint(out, _staticLayer);
+	_writeLayerCheckpoint(out, _dynamicLayer);
+}
+
+
+//
+// _writeLayerCheckpoint() - the checkpoint does not depend on which tiles exist, or on the cell numbering; cells of missing
+//                          tiles are written as empty cells, and every cell is identified by its row-major position.
+//
+void GridDatabase2D::_writeLayerCheckpoint(CheckpointWriter & out, const GridLayer & layer)
+{
+	unsigned int numTotalCells = _xNumCells*_zNumCells;
+	std::vector<float> traversalCosts(numTotalCells);
+	unsigned int numOccupiedCells = 0;
+	for (unsigned int i=0; i < numTotalCells; i++) {
+		const GridCell & cell = _getCell(layer, i / _zNumCells, i % _zNumCells);
+		traversalCosts[i] = cell._traversalCost;
+		if (cell._numItems != 0) numOccupiedCells++;
+	}
+	out.writeVector(traversalCosts);
+
+	out.write(numOccupiedCells);
+	for (unsigned int i=0; i < numTotalCells; i++) {
+		const GridCell & cell = _getCell(layer, i / _zNumCells, i % _zNumCells);
+		if (cell._numItems == 0) continue;
+		out.write(i);
+		out.write(cell._numItems);
+		for (unsigned int k=0; k < cell._numItems; k++) {
+			const GridCellEntry & entry = cell.getEntry(k);
+			out.writeItemReference(entry.item);
+			out.write(entry.xmin);
+			out.write(entry.xmax);
+			out.write(entry.zmin);
+			out.write(entry.zmax);
+			out.write(entry.xMinIndex);
+			out.write(entry.zMinIndex);
+		}
+	}
+}
+
+
+//
+// readCheckpoint()
+//
+void GridDatabase2D::readCheckpoint(CheckpointReader & in)
+{
+	if (_deferringUpdates) {
+		throw GenericException("Cannot restore the grid database from a checkpoint while updates are deferred.");
+	}
+
+	unsigned int xNumCells, zNumCells, maxItemsPerCell;
+	in.read(xNumCells);
+	in.read(zNumCells);
+	in.read(maxItemsPerCell);
+	// cells hold any number of items, so maxItemsPerCell does not have to match.
+	if ((xNumCells != _xNumCells) || (zNumCells != _zNumCells)) {
+		throw GenericException("The checkpoint was saved with a grid database of " + toString(xNumCells) + "x" + toString(zNumCells) + " cells, which does not match the current grid database.");
+	}
+
+	MTRand::uint32 randomState[MTRand::SAVE];
+	in.read(randomState);
+	_randomNumberGeneratorMutex.lock();
+	_randomNumberGenerator->load(randomState);
+	_randomNumberGeneratorMutex.unlock();
+
+	_readLayerCheckpoint(in, _staticLayer);
+	// while the dynamic layer is rebuilt, its tiles have no fixed arrays, so the cells are read into their overflow lists, and packed again afterwards.
+	_readLayerCheckpoint(in, _dynamicLayer);
+	if (_dynamicLayerMode == DYNAMIC_LAYER_REBUILD) {
+		_rebuildDynamicLayer();
+	}
+}
+
+
+//
+// _readLayerCheckpoint() - only the tiles of cells that are not empty are created again.
+//
+void GridDatabase2D::_readLayerCheckpoint(CheckpointReader & in, GridLayer & layer)
+{
+	unsigned int numTotalCells = _xNumCells*_zNumCells;
+	std::vector<float> traversalCosts;
+	in.readVector(traversalCosts);
+	if (traversalCosts.size() != numTotalCells) {
+		throw GenericException("The checkpoint has the wrong number of grid cells.");
+	}
+
+	_clearLayer(layer);
+	for (unsigned int i=0; i < numTotalCells; i++) {
+		if (traversalCosts[i] != layer.emptyCell._traversalCost) {
+			_getCellForWriting(layer, i / _zNumCells, i % _zNumCells)._traversalCost = traversalCosts[i];
+		}
+	}
+
+	unsigned int numOccupiedCells;
+	in.read(numOccupiedCells);
+	for (unsigned int c=0; c < numOccupiedCells; c++) {
+		unsigned int cellIndex, numItems;
+		in.read(cellIndex);
+		in.read(numItems);
+		if ((cellIndex >= numTotalCells) || (_getCell(layer, cellIndex / _zNumCells, cellIndex % _zNumCells)._numItems != 0)) {
+			throw GenericException("The checkpoint has an invalid grid cell.");
+		}
+		GridCell & cell = _getCellForWriting(layer, cellIndex / _zNumCells, cellIndex % _zNumCells);
+
+		for (unsigned int n=0; n < numItems; n++) {
+			GridCellEntry entry;
+			entry.item = in.readItemReference();
+			in.read(entry.xmin);
+			in.read(entry.xmax);
+			in.read(entry.zmin);
+			in.read(entry.zmax);
+			in.read(entry.xMinIndex);
+			in.read(entry.zMinIndex);
+			cell._append(entry);
+		}
+	}
+}
+
+
+//
+// getItemsInRange() - the protected version uses the integer index ranges.
+//
+void GridDatabase2D::getItemsInRange(set<SpatialDatabaseItemPtr> & neighborList, unsigned int xMinIndex, unsigned int xMaxIndex, unsigned int zMinIndex, unsigned int zMaxIndex, SpatialDatabaseItemPtr exclude, unsigned int layers)
+{
+	for (unsigned int layer = GRID_LAYER_STATIC; layer <= GRID_LAYER_DYNAMIC; layer <<= 1) {
+		if ((layers & layer) == 0) continue;
+		const GridLayer & gridLayer = (layer == GRID_LAYER_STATIC) ? _staticLayer : _dynamicLayer;
+
+		// iterate over all grid cells in the range,
+		for (unsigned int i=xMinIndex; i<=xMaxIndex; i++) {
+			for (unsigned int j=zMinIndex; j<=zMaxIndex; j++) {
+				const GridCell & cell = _getCell(gridLayer, i, j);
+				for (unsigned int k=0; k < cell._numItems; k++) {
+					SpatialDatabaseItemPtr item = cell.getItem(k);
+					if (item != exclude) {
+						neighborList.insert(item);
+					}
 				}
 			}
-			cellIndex++;
 		}
 	}
 }
@@ -276,11 +1140,11 @@ void GridDatabase2D::getItemsInRange(set<SpatialDatabaseItemPtr> & neighborList,
 //
 // getItemsInRange() - simply converts the spatial bounds into index range, and then calls the private getItemsInRange().
 //
-void GridDatabase2D::getItemsInRange(set<SpatialDatabaseItemPtr> & neighborList, float xmin, float xmax, float zmin, float zmax, SpatialDatabaseItemPtr exclude)
+void GridDatabase2D::getItemsInRange(set<SpatialDatabaseItemPtr> & neighborList, float xmin, float xmax, float zmin, float zmax, SpatialDatabaseItemPtr exclude, unsigned int layers)
 {
 	unsigned int xMinIndex=0, xMaxIndex=0, zMinIndex=0, zMaxIndex=0;
 	_clampSpatialBoundsToIndexRange(xmin, xmax, zmin, zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex);
-	getItemsInRange(neighborList,xMinIndex,xMaxIndex,zMinIndex,zMaxIndex,exclude);
+	getItemsInRange(neighborList,xMinIndex,xMaxIndex,zMinIndex,zMaxIndex,exclude,layers);
 }
 
 //
@@ -291,64 +1155,192 @@ void GridDatabase2D::getItemsInVisualField(set<SpatialDatabaseItemPtr> & neighbo
 	unsigned int xMinIndex=0, xMaxIndex=0, zMinIndex=0, zMaxIndex=0;
 	_clampSpatialBoundsToIndexRange(xmin, xmax, zmin, zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex);
 
-	int cellIndex;
-	// iterate over all grid cells in the range,
-	for (unsigned int i=xMinIndex; i<=xMaxIndex; i++) {
-		cellIndex = getCellIndexFromGridCoords(i,zMinIndex);
-		for (unsigned int j=zMinIndex; j<=zMaxIndex; j++) {
-			for (unsigned int k=0; k < _maxItemsPerCell; k++) {
-				SpatialDatabaseItemPtr possiblyVisibleObject = _cells[cellIndex]._items[k];
+	// for non-Agent items, i.e. "objects" --> obstacles and such: we assume the 
+	// agent will know where such items are, even if its not directly 
+	// in its visual field.  so, always add the whole static layer without needing to check
+	// line-of-sight or distance.
+	getItemsInRange(neighborList, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex, exclude, GRID_LAYER_STATIC);
+
+	// the dynamic layer only holds agents; each is visited once, with the bounds it was last updated with,
+	// so the distance and cone tests do not need to touch the agent at all.
+	Vector forward = normalize(facingDirection);
+	visitEntriesInRange(xMinIndex, xMaxIndex, zMinIndex, zMaxIndex, exclude, [&](const GridCellEntry & entry) {
+		SpatialDatabaseItemPtr possiblyVisibleObject = entry.item;
+
+		// if it is already in the set, we don't need to consider this object any further.
+		if (neighborList.find(possiblyVisibleObject) != neighborList.end())
+			return;
+
+		// (1) if the agent is outside of the radius of the visual field, then forget it
+		Point hisPosition(entry.centerX(), position.y, entry.centerZ());
+		Vector directionToOtherAgent = hisPosition - position;
+		float distSquared = directionToOtherAgent.lengthSquared();
+		if (distSquared > radiusSquared) 
+			return;
+
+		// (2) check whether the object is actually in the cone based on our facing direction
+		// TODO: we shouldn't need to normalize here, because we just want to check sign, right?
+		float cosTheta = dot(directionToOtherAgent/sqrtf(distSquared),forward);
+		if (cosTheta < 0.0f) 
+			return;
+
+		// (3) finally, we can do the most expensive final check - checking line-of-sight.
+		// previous database did not do this here, because ray tracing routines were not possible to call in the grid DB.
+		// now with the virtualized interface of database items, we can.
+		if (!hasLineOfSight(position, hisPosition, possiblyVisibleObject, exclude))
+			return;
+				
+		// if we really got this far, that means this object really is visible, so add it to the neighborList.
+		neighborList.insert(possiblyVisibleObject);
+	}, GRID_LAYER_DYNAMIC);
+}
 
 
-				// ignore this object if it is actually not an object (NULL), or if we are supposed to exclude it
-				if ((possiblyVisibleObject==NULL) || (possiblyVisibleObject==exclude))
-					continue;
+bool GridDatabase2D::getIndexRangeOfBounds(float xmin, float xmax, float zmin, float zmax, unsigned int & xMinIndex, unsigned int & xMaxIndex, unsigned int & zMinIndex, unsigned int & zMaxIndex)
+{
+	return _clampSpatialBoundsToIndexRange(xmin, xmax, zmin, zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex);
+}
 
-				if (possiblyVisibleObject->isAgent()) {
-					// three more conditions...
-
-					// do a search to make sure it doesnt exist in the set already, if it does exist 
-					// then we don't need to consider this object any further.
-					if (neighborList.find(possiblyVisibleObject) != neighborList.end()) continue;
-
-					// (1) if the agent is outside of the radius of the visual field, then forget it
-					Point hisPosition = (dynamic_cast<AgentInterface*>(possiblyVisibleObject))->position();
-					Vector directionToOtherAgent = hisPosition - position;
-					float distSquared = directionToOtherAgent.lengthSquared();
-					if (distSquared > radiusSquared) 
-						continue;
-
-					// (2) check whether the object is actually in the cone based on our facing direction
-					// TODO: we shouldn't need to normalize here, because we just want to check sign, right?
-					//float cosTheta = dot(directionToOtherAgent/sqrtf(distSquared),normalize(facingDirection));
-					float cosTheta = dot(directionToOtherAgent/sqrtf(distSquared),normalize(facingDirection));
-					if (cosTheta < 0.0f) 
-						continue;
-
-					// (3) finally, we can do the most expensive final check - checking line-of-sight.
-					// previous database did not do this here, because ray tracing routines were not possible to call in the grid DB.
-					// now with the virtualized interface of database items, we can.
-					if (!hasLineOfSight(position, hisPosition, possiblyVisibleObject, exclude))
-						continue;
-					
-					// if we really got this far, that means this object really is visible, so add it to the neighborList.
-					neighborList.insert(possiblyVisibleObject);
-				}
-				else {
-					// for non-Agent items, i.e. "objects" --> obstacles and such: we assume the 
-					// agent will know where such items are, even if its not directly 
-					// in its visual field.  so, always add it without needing to check
-					// line-of-sight or distance.
-					neighborList.insert(possiblyVisibleObject);
-				}
 
+void GridDatabase2D::getItemsInRange(std::vector<SpatialDatabaseItemPtr> & neighborList, unsigned int xMinIndex, unsigned int xMaxIndex, unsigned int zMinIndex, unsigned int zMaxIndex, SpatialDatabaseItemPtr exclude, unsigned int layers)
+{
+	neighborList.clear();
+	visitItemsInRange(xMinIndex, xMaxIndex, zMinIndex, zMaxIndex, exclude, [&neighborList](SpatialDatabaseItemPtr item) { neighborList.push_back(item); }, layers);
+}
+
+
+void GridDatabase2D::getItemsInRange(std::vector<SpatialDatabaseItemPtr> & neighborList, float xmin, float xmax, float zmin, float zmax, SpatialDatabaseItemPtr exclude, unsigned int layers)
+{
+	neighborList.clear();
+	visitItemsInRange(xmin, xmax, zmin, zmax, exclude, [&neighborList](SpatialDatabaseItemPtr item) { neighborList.push_back(item); }, layers);
+}
+
+
+void GridDatabase2D::getItemsInVisualField(std::vector<SpatialDatabaseItemPtr> & neighborList, float xmin, float xmax, float zmin, float zmax, SpatialDatabaseItemPtr exclude, const Point & position, const Vector & facingDirection, float radiusSquared)
+{
+	neighborList.clear();
+	Vector forward = normalize(facingDirection);
+
+	// the same tests as the set version: the whole static layer, and the agents that pass the tests.
+	visitItemsInRange(xmin, xmax, zmin, zmax, exclude, [&neighborList](SpatialDatabaseItemPtr item) { neighborList.push_back(item); }, GRID_LAYER_STATIC);
+	visitEntriesInRange(xmin, xmax, zmin, zmax, exclude, [&](const GridCellEntry & entry) {
+		Point hisPosition(entry.centerX(), position.y, entry.centerZ());
+		Vector directionToOtherAgent = hisPosition - position;
+		float distSquared = directionToOtherAgent.lengthSquared();
+		if (distSquared > radiusSquared)
+			return;
+		if (dot(directionToOtherAgent/sqrtf(distSquared), forward) < 0.0f)
+			return;
+		if (!hasLineOfSight(position, hisPosition, entry.item, exclude))
+			return;
+		neighborList.push_back(entry.item);
+	}, GRID_LAYER_DYNAMIC);
+}
+
+namespace {
+	/// Orders nearest neighbors by distance; as the comparison of a heap, it keeps the farthest one at the front.
+	inline bool isCloserNeighbor(const NearestNeighbor & a, const NearestNeighbor & b) { return a.distanceSquared < b.distanceSquared; }
+}
+
+
+unsigned int GridDatabase2D::getKNearestNeighbors(std::vector<NearestNeighbor> & neighbors, const Point & position, unsigned int k, float maxDistance, SpatialDatabaseItemPtr exclude, NeighborFilterEnum filter)
+{
+	neighbors.clear();
+	if (k == 0) {
+		return 0;
+	}
+
+	float maxDistanceSquared = maxDistance * maxDistance;
+	unsigned int layers = (filter == NEIGHBOR_FILTER_AGENTS) ? GRID_LAYER_DYNAMIC : ((filter == NEIGHBOR_FILTER_OBSTACLES) ? GRID_LAYER_STATIC : GRID_LAYER_ALL);
+
+	// the cell of the position, clamped to the grid.
+	int centerX = (int)floor((position.x - _xOrigin) / _xCellSize);
+	int centerZ = (int)floor((position.z - _zOrigin) / _zCellSize);
+	centerX = std::max(0, std::min(centerX, (int)_xNumCells - 1));
+	centerZ = std::max(0, std::min(centerZ, (int)_zNumCells - 1));
+
+	for (int ring = 0; ; ring++) {
+		int xMin = centerX - ring, xMax = centerX + ring;
+		int zMin = centerZ - ring, zMax = centerZ + ring;
+		if ((xMin < 0) && (zMin < 0) && (xMax >= (int)_xNumCells) && (zMax >= (int)_zNumCells)) {
+			// the previous rings covered the whole grid.
+			break;
+		}
+
+		if (ring > 0) {
+			// nothing in this ring or beyond is closer than the edge of the square covered by the previous rings.
+			float distanceToEdge = std::min(
+				std::min(position.x - (_xOrigin + (xMin + 1) * _xCellSize), (_xOrigin + xMax * _xCellSize) - position.x),
+				std::min(position.z - (_zOrigin + (zMin + 1) * _zCellSize), (_zOrigin + zMax * _zCellSize) - position.z));
+			float lowerBoundSquared = (distanceToEdge > 0.0f) ? distanceToEdge * distanceToEdge : 0.0f;
+			if (lowerBoundSquared > maxDistanceSquared) {
+				break;
+			}
+			if ((neighbors.size() == k) && (lowerBoundSquared >= neighbors.front().distanceSquared)) {
+				break;
 			}
-			cellIndex++;
 		}
 
+		// the cells of the ring: the top and bottom rows, then the two columns in between.
+		for (int x = xMin; x <= xMax; x++) {
+			for (int z = zMin; z <= zMax; z += ((x == xMin) || (x == xMax) || (zMax == zMin)) ? 1 : (zMax - zMin)) {
+				if ((x < 0) || (z < 0) || (x >= (int)_xNumCells) || (z >= (int)_zNumCells)) {
+					continue;
+				}
+
+				for (unsigned int layer = GRID_LAYER_STATIC; layer <= GRID_LAYER_DYNAMIC; layer <<= 1) {
+					if ((layers & layer) == 0) continue;
+					bool isAgent = (layer == GRID_LAYER_DYNAMIC);
+					const GridCell & cell = _getCell(isAgent ? _dynamicLayer : _staticLayer, x, z);
+
+					for (unsigned int i=0; i < cell._numItems; i++) {
+						const GridCellEntry & entry = cell.getEntry(i);
+
+						float distanceSquared;
+						if (isAgent) {
+							float dx = entry.centerX() - position.x;
+							float dz = entry.centerZ() - position.z;
+							distanceSquared = dx * dx + dz * dz;
+						}
+						else {
+							float dx = std::max(std::max(entry.xmin - position.x, position.x - entry.xmax), 0.0f);
+							float dz = std::max(std::max(entry.zmin - position.z, position.z - entry.zmax), 0.0f);
+							distanceSquared = dx * dx + dz * dz;
+						}
+						if (distanceSquared > maxDistanceSquared) continue;
+						if ((neighbors.size() == k) && (distanceSquared >= neighbors.front().distanceSquared)) continue;
+						if (entry.item == exclude) continue;
+
+						// an object in several cells is seen again at the same distance; it is only in the heap if it was close enough.
+						bool alreadyFound = false;
+						for (unsigned int n=0; (n < neighbors.size()) && !alreadyFound; n++) {
+							alreadyFound = (neighbors[n].item == entry.item);
+						}
+						if (alreadyFound) continue;
+
+						NearestNeighbor neighbor;
+						neighbor.item = entry.item;
+						neighbor.distanceSquared = distanceSquared;
+						if (neighbors.size() < k) {
+							neighbors.push_back(neighbor);
+							std::push_heap(neighbors.begin(), neighbors.end(), isCloserNeighbor);
+						}
+						else {
+							std::pop_heap(neighbors.begin(), neighbors.end(), isCloserNeighbor);
+							neighbors.back() = neighbor;
+							std::push_heap(neighbors.begin(), neighbors.end(), isCloserNeighbor);
+						}
+					}
+				}
+			}
+		}
 	}
+
+	std::sort_heap(neighbors.begin(), neighbors.end(), isCloserNeighbor);
+	return (unsigned int)neighbors.size();
 }
 
+
 void GridDatabase2D::draw()
 {
 #ifdef ENABLE_GUI
@@ -388,8 +1380,6 @@ void GridDatabase2D::draw()
 	{
 		for (unsigned int j=0; j < _zNumCells; j++)
 		{
-			int cellIndex = getCellIndexFromGridCoords(i, j);
-
 			Point p = Point(_xOrigin + i * _xCellSize, gridQuadHeight, _zOrigin + j * _zCellSize);
 			Point a = p + Point(0, 0, 0);
 			Point b = p + Point(0, 0, _zCellSize);
@@ -401,16 +1391,8 @@ void GridDatabase2D::draw()
 			Color color(0.4,0.4,0.4);
 
 
-			for (unsigned int item=0; item < _cells[cellIndex]._numItems; item++)
-			{
-				if ((_cells[cellIndex]._items[item] != NULL))
-				{
-					if (_cells[cellIndex]._items[item]->isAgent())
-						color = color + Color(0,0,0.9f / _maxItemsPerCell);
-					else
-						color = color + Color(0.8f / _maxItemsPerCell,0,0);
-				}
-			}
+			color = color + Color(0,0,0.9f / _maxItemsPerCell) * (float)_getCell(_dynamicLayer, i, j)._numItems;
+			color = color + Color(0.8f / _maxItemsPerCell,0,0) * (float)_getCell(_staticLayer, i, j)._numItems;
 			DrawLib::glColor(color);
 			DrawLib::drawQuad(a, b, c, d);
 		}
@@ -489,30 +1471,33 @@ bool GridDatabase2D::trace(const Ray & r, float & t, SpatialDatabaseItemPtr &hit
 		hitObject = NULL;
 		float mostRecent_maxt = min(maxt,min(txfar,tzfar)); // this way no intersection will be valid unless it was within this grid cell
 
-		for (unsigned int i=0; i<_maxItemsPerCell; i++)
+		// agents are only in the dynamic layer, so excluding them means not looking at that layer at all.
+		for (unsigned int layer = GRID_LAYER_STATIC; layer <= (excludeAgents ? GRID_LAYER_STATIC : GRID_LAYER_DYNAMIC); layer <<= 1)
 		{
-
-			if ((_cells[currentBin]._items[i] != NULL) && (_cells[currentBin]._items[i] != exclude)) // && (_cells[currentBin]._numItems > i))
-			{ // Getting trace errors for outside of mapped region.
-				// Access not within mapped region at address 0xFFFFFFE00991E050
-
-				if ((excludeAgents) && _cells[currentBin]._items[i]->isAgent())
-					continue;
-
-				float temp_t;
-				bool intersected;
-				intersected = false;
-				Ray tempRay;
-				tempRay.initWithUnitInterval(r.pos, r.dir);
-				tempRay.maxt = mostRecent_maxt;
-				tempRay.mint = mint;
-				intersected = _cells[currentBin]._items[i]->intersects(tempRay,temp_t);
-				if ((intersected) && (temp_t < mostRecent_maxt)) {
-					// found a valid intersection, set all the values appropriately
-					validIntersectionFound = true;
-					mostRecent_maxt = temp_t;
-					t = temp_t;
-					hitObject = _cells[currentBin]._items[i];
+			const GridCell & cell = _getCell((layer == GRID_LAYER_STATIC) ? _staticLayer : _dynamicLayer, x, z);
+			for (unsigned int i=0; i<cell._numItems; i++)
+			{
+				SpatialDatabaseItemPtr item = cell.getItem(i);
+
+				if (item != exclude)
+				{ // Getting trace errors for outside of mapped region.
+					// Access not within mapped region at address 0xFFFFFFE00991E050
+
+					float temp_t;
+					bool intersected;
+					intersected = false;
+					Ray tempRay;
+					tempRay.initWithUnitInterval(r.pos, r.dir);
+					tempRay.maxt = mostRecent_maxt;
+					tempRay.mint = mint;
+					intersected = item->intersects(tempRay,temp_t);
+					if ((intersected) && (temp_t < mostRecent_maxt)) {
+						// found a valid intersection, set all the values appropriately
+						validIntersectionFound = true;
+						mostRecent_maxt = temp_t;
+						t = temp_t;
+						hitObject = item;
+					}
 				}
 			}
 		}
@@ -527,7 +1512,7 @@ bool GridDatabase2D::trace(const Ray & r, float & t, SpatialDatabaseItemPtr &hit
 				x--;
 			else
 				x++;
-			if ((x < 0) || (x > _xNumCells)) {
+			if (x >= _xNumCells) {
 				return false; // no intersection found yet, and now we're out of bounds.
 			}
 		}
@@ -537,7 +1522,7 @@ bool GridDatabase2D::trace(const Ray & r, float & t, SpatialDatabaseItemPtr &hit
 				z--;
 			else
 				z++;
-			if ((z < 0) || (z > _zNumCells)) {
+			if (z >= _zNumCells) {
 				return false; // no intersection found yet, and now we're out of bounds.
 			}
 		}
@@ -624,22 +1609,25 @@ bool GridDatabase2D::hasLineOfSight(const Ray & r, SpatialDatabaseItemPtr exclud
 		validIntersectionFound = false;
 		float mostRecent_maxt = min(maxt,min(txfar,tzfar)); // this way no intersection will be valid unless it was within this grid cell
 
-		for (unsigned int i=0; i<_maxItemsPerCell; i++) {
-			if ((_cells[currentBin]._items[i] != NULL) && (_cells[currentBin]._items[i] != exclude1) 
-				&& (_cells[currentBin]._items[i] != exclude2) && (_cells[currentBin]._items[i]->blocksLineOfSight())) {
-
-				float temp_t;
-				bool intersected;
-				intersected = false;
-				Ray tempRay;
-				tempRay.initWithUnitInterval(r.pos, r.dir);
-				tempRay.maxt = mostRecent_maxt;
-				tempRay.mint = mint;
-				intersected = _cells[currentBin]._items[i]->intersects(tempRay,temp_t);
-				if ((intersected) && (temp_t < mostRecent_maxt)) {
-					// found a valid intersection, set all the values appropriately
-					validIntersectionFound = true;
-					mostRecent_maxt = temp_t;
+		for (unsigned int layer = GRID_LAYER_STATIC; layer <= GRID_LAYER_DYNAMIC; layer <<= 1) {
+			const GridCell & cell = _getCell((layer == GRID_LAYER_STATIC) ? _staticLayer : _dynamicLayer, x, z);
+			for (unsigned int i=0; i<cell._numItems; i++) {
+				SpatialDatabaseItemPtr item = cell.getItem(i);
+				if ((item != exclude1) && (item != exclude2) && (item->blocksLineOfSight())) {
+
+					float temp_t;
+					bool intersected;
+					intersected = false;
+					Ray tempRay;
+					tempRay.initWithUnitInterval(r.pos, r.dir);
+					tempRay.maxt = mostRecent_maxt;
+					tempRay.mint = mint;
+					intersected = item->intersects(tempRay,temp_t);
+					if ((intersected) && (temp_t < mostRecent_maxt)) {
+						// found a valid intersection, set all the values appropriately
+						validIntersectionFound = true;
+						mostRecent_maxt = temp_t;
+					}
 				}
 			}
 		}
@@ -655,7 +1643,7 @@ bool GridDatabase2D::hasLineOfSight(const Ray & r, SpatialDatabaseItemPtr exclud
 				x--;
 			else
 				x++;
-			if ((x < 0) || (x > _xNumCells)) {
+			if (x >= _xNumCells) {
 				return true; // no intersection found yet, and now we're out of bounds.
 			}
 		}
@@ -665,7 +1653,7 @@ bool GridDatabase2D::hasLineOfSight(const Ray & r, SpatialDatabaseItemPtr exclud
 				z--;
 			else
 				z++;
-			if ((z < 0) || (z > _zNumCells)) {
+			if (z >= _zNumCells) {
 				return true; // no intersection found yet, and now we're out of bounds.
 			}
 		}
@@ -705,62 +1693,84 @@ Point GridDatabase2D::randomPositionWithoutCollisions(float radius, bool exclude
 
 Point GridDatabase2D::randomPositionInRegionWithoutCollisions(const AxisAlignedBox & region, float radius, bool excludeAgents)
 {
-	static MTRand _randomNumberGenerator(2);
-	return randomPositionInRegionWithoutCollisions(region, radius, excludeAgents, _randomNumberGenerator);
+	Point position;
+	_randomNumberGeneratorMutex.lock();
+	try {
+		position = randomPositionInRegionWithoutCollisions(region, radius, excludeAgents, *_randomNumberGenerator);
+	}
+	catch (...) {
+		_randomNumberGeneratorMutex.unlock();
+		throw;
+	}
+	_randomNumberGeneratorMutex.unlock();
+	return position;
 }
 
-Point GridDatabase2D::randomPositionInRegionWithoutCollisions(const AxisAlignedBox & region, float radius, bool excludeAgents,  MTRand & randomNumberGenerator)
-{
-	Point ret(0.0f, 0.0f, 0.0f);
-	bool notFoundYet;
-	unsigned int numTries = 0;
-	float xspan = region.xmax - region.xmin - 2*radius;
-	float zspan = region.zmax - region.zmin - 2*radius;
-
-	do {
-
-		ret.x = region.xmin + radius + ((float)randomNumberGenerator.rand(xspan));
-		ret.y = 0.0f;
-		ret.z = region.zmin + radius + ((float)randomNumberGenerator.rand(zspan));
-
-		// assume this new point has no collisions, until we find out below
-		notFoundYet = false;
-
-		// check if ret collides with anything
-		set<SpatialDatabaseItemPtr> neighbors;
-		neighbors.clear();
-		float _new_radius = radius; //  + 0.2f; // Glen testing effects for footstepAI
-		getItemsInRange(neighbors, ret.x - _new_radius, ret.x + _new_radius, ret.z - _new_radius, ret.z + _new_radius, NULL);
-
-		set<SpatialDatabaseItemPtr>::iterator neighbor;
-		/*
-		 * increment must be after loop body or (*neighbor)->isAgent()) will be called on an
-		 * element that is beyond the set.
-		 */
-		for (neighbor = neighbors.begin(); neighbor != neighbors.end(); neighbor++)
-		{
-			if ((excludeAgents) && ((*neighbor)->isAgent()))
-			{
-				continue;
-			}
-			notFoundYet = (*neighbor)->overlaps(ret, radius);
-			if (notFoundYet)
+namespace {
+	/// The implementation of GridDatabase2D::randomPositionInRegionWithoutCollisions() for either kind of random number generator.
+	template <typename RandomNumberGenerator>
+	Point findRandomPositionInRegionWithoutCollisions(GridDatabase2D & database, const AxisAlignedBox & region, float radius, bool excludeAgents, RandomNumberGenerator & randomNumberGenerator)
+	{
+		Point ret(0.0f, 0.0f, 0.0f);
+		bool notFoundYet;
+		unsigned int numTries = 0;
+		float xspan = region.xmax - region.xmin - 2*radius;
+		float zspan = region.zmax - region.zmin - 2*radius;
+
+		do {
+
+			ret.x = region.xmin + radius + ((float)randomNumberGenerator.rand(xspan));
+			ret.y = 0.0f;
+			ret.z = region.zmin + radius + ((float)randomNumberGenerator.rand(zspan));
+
+			// assume this new point has no collisions, until we find out below
+			notFoundYet = false;
+
+			// check if ret collides with anything
+			set<SpatialDatabaseItemPtr> neighbors;
+			neighbors.clear();
+			float _new_radius = radius; //  + 0.2f; // Glen testing effects for footstepAI
+			database.getItemsInRange(neighbors, ret.x - _new_radius, ret.x + _new_radius, ret.z - _new_radius, ret.z + _new_radius, NULL,
+				excludeAgents ? GRID_LAYER_STATIC : GRID_LAYER_ALL);
+
+			set<SpatialDatabaseItemPtr>::iterator neighbor;
+			for (neighbor = neighbors.begin(); neighbor != neighbors.end(); neighbor++)
 			{
-				break;
+				notFoundYet = (*neighbor)->overlaps(ret, radius);
+				if (notFoundYet)
+				{
+					break;
+				}
 			}
-		}
-		numTries++;
-		if (numTries > 1000)
-		{
-			cerr << "ERROR: trying too hard to find a random position in region.  The region is probably already too dense." << endl;
-			if (numTries > 10000)
+			numTries++;
+			if (numTries > 1000)
 			{
-				throw GenericException("Gave up trying to find a random position in region.");
+				cerr << "ERROR: trying too hard to find a random position in region.  The region is probably already too dense." << endl;
+				if (numTries > 10000)
+				{
+					throw GenericException("Gave up trying to find a random position in region.");
+				}
 			}
-		}
-	} while (notFoundYet);
+		} while (notFoundYet);
 
-	return ret;
+		return ret;
+	}
+}
+
+Point GridDatabase2D::randomPositionInRegionWithoutCollisions(const AxisAlignedBox & region, float radius, bool excludeAgents,  MTRand & randomNumberGenerator)
+{
+	return findRandomPositionInRegionWithoutCollisions(*this, region, radius, excludeAgents, randomNumberGenerator);
+}
+
+Point GridDatabase2D::randomPositionWithoutCollisions(float radius, bool excludeAgents, RandomStream & randomStream)
+{
+	AxisAlignedBox aab(_xOrigin, _xOrigin + _xGridSize, 0.0f, 0.0f, _zOrigin, _zOrigin + _zGridSize);
+	return randomPositionInRegionWithoutCollisions(aab, radius, excludeAgents, randomStream);
+}
+
+Point GridDatabase2D::randomPositionInRegionWithoutCollisions(const AxisAlignedBox & region, float radius, bool excludeAgents, RandomStream & randomStream)
+{
+	return findRandomPositionInRegionWithoutCollisions(*this, region, radius, excludeAgents, randomStream);
 }
 
 Util::Point GridDatabase2D::randomPositionInRegion(const Util::AxisAlignedBox & region, float radius,MTRand & randomNumberGenerator)
@@ -843,7 +1853,7 @@ bool GridDatabase2D::findPath (Util::Point &startPosition, Util::Point &endPosit
  * Note: This algorithm ignores agents when tracing
  */
 bool GridDatabase2D::findSmoothPath (Util::Point &startPosition, Util::Point &endPosition, std::vector<Util::Point> & path,
-		unsigned int _maxNodesToExpandForSearch)
+		unsigned int _maxNodesToExpandForSearch, Util::FrameArena * arena)
 {
 	// clearing path
 	path.clear ();
@@ -851,7 +1861,8 @@ bool GridDatabase2D::findSmoothPath (Util::Point &startPosition, Util::Point &en
 	int startIndex = getCellIndexFromLocation(startPosition);
 	int goalIndex = getCellIndexFromLocation(endPosition);
 	std::stack<unsigned int> agentPath;
-	std::deque<Util::Point> plannedPath;
+	Util::ArenaAllocator<Util::Point> plannedPathAllocator(arena);
+	Util::ArenaDeque<Util::Point> plannedPath(plannedPathAllocator);
 	Util::Point temp_p;
 
 	bool pathComplete = planPath(startIndex,goalIndex,agentPath,_maxNodesToExpandForSearch);
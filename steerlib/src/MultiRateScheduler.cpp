@@ -0,0 +1,204 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+/// @file MultiRateScheduler.cpp
+/// @brief Implements the SteerLib::MultiRateScheduler class.
+
+#include <algorithm>
+
+#include "simulation/MultiRateScheduler.h"
+#include "util/WorkStealingScheduler.h"
+#include "util/GenericException.h"
+#include "util/Misc.h"
+
+using namespace SteerLib;
+using namespace Util;
+
+
+unsigned int MultiRateScheduler::addTask(unsigned int interval, const TaskFunction & task, bool concurrent)
+{
+	if (interval == 0) {
+		throw GenericException("MultiRateScheduler::addTask() - the interval of a task must be at least one frame.");
+	}
+	return _addTask(interval, chooseOffset(interval), true, task, concurrent);
+}
+
+
+unsigned int MultiRateScheduler::addTaskWithOffset(unsigned int interval, unsigned int offset, const TaskFunction & task, bool concurrent)
+{
+	if ((interval == 0) || (offset >= interval)) {
+		throw GenericException("MultiRateScheduler::addTaskWithOffset() - invalid interval " + toString(interval) + " and offset " + toString(offset) + ".");
+	}
+	return _addTask(interval, offset, false, task, concurrent);
+}
+
+
+unsigned int MultiRateScheduler::_addTask(unsigned int interval, unsigned int offset, bool ownsOffset, const TaskFunction & task, bool concurrent)
+{
+	unsigned int taskID;
+	if (!_freeTaskIDs.empty()) {
+		taskID = _freeTaskIDs.back();
+		_freeTaskIDs.pop_back();
+	}
+	else {
+		taskID = (unsigned int)_tasks.size();
+		_tasks.push_back(Task());
+		_tasks[taskID].generation = 0;
+	}
+
+	Task & newTask = _tasks[taskID];
+	newTask.function = task;
+	newTask.interval = interval;
+	newTask.offset = offset;
+	newTask.concurrent = concurrent;
+	newTask.active = true;
+	newTask.ownsOffset = ownsOffset;
+
+	// the first frame the task may run is the one after the last frame that already ran.
+	_scheduleTask(taskID, _currentFrame);
+	return taskID;
+}
+
+
+void MultiRateScheduler::removeTask(unsigned int taskID)
+{
+	if ((taskID >= _tasks.size()) || (!_tasks[taskID].active)) {
+		throw GenericException("MultiRateScheduler::removeTask() - task " + toString(taskID) + " does not exist.");
+	}
+
+	Task & task = _tasks[taskID];
+	std::map<unsigned int, std::vector<unsigned int> >::iterator dueIter = _dueTasks.find(task.nextFrame);
+	if (dueIter != _dueTasks.end()) {
+		std::vector<unsigned int> & dueTaskIDs = dueIter->second;
+		dueTaskIDs.erase(std::find(dueTaskIDs.begin(), dueTaskIDs.end(), taskID));
+		if (dueTaskIDs.empty()) {
+			_dueTasks.erase(dueIter);
+		}
+	}
+
+	if (task.ownsOffset) {
+		releaseOffset(task.interval, task.offset);
+	}
+
+	task.function = TaskFunction();
+	task.active = false;
+	task.generation++;
+	_freeTaskIDs.push_back(taskID);
+}
+
+
+void MultiRateScheduler::_scheduleTask(unsigned int taskID, unsigned int frameNumber)
+{
+	Task & task = _tasks[taskID];
+	task.nextFrame = getNextFrame(frameNumber, task.interval, task.offset);
+	_dueTasks[task.nextFrame].push_back(taskID);
+}
+
+
+void MultiRateScheduler::runTasks(float timeStamp, float dt, unsigned int frameNumber, WorkStealingScheduler * workerThreads)
+{
+	_currentFrame = frameNumber;
+
+	// collect everything that is due; after a checkpoint was restored, this may include tasks from frames that were skipped.
+	_tasksToRun.clear();
+	_concurrentTasksToRun.clear();
+	while (!_dueTasks.empty() && (_dueTasks.begin()->first <= frameNumber)) {
+		std::vector<unsigned int> dueTaskIDs;
+		dueTaskIDs.swap(_dueTasks.begin()->second);
+		_dueTasks.erase(_dueTasks.begin());
+
+		for (unsigned int i=0; i < dueTaskIDs.size(); i++) {
+			unsigned int taskID = dueTaskIDs[i];
+			if (_tasks[taskID].concurrent)
+				_concurrentTasksToRun.push_back(std::make_pair(taskID, _tasks[taskID].generation));
+			else
+				_tasksToRun.push_back(std::make_pair(taskID, _tasks[taskID].generation));
+			// scheduling the next run right away lets the task remove itself while it runs.
+			_scheduleTask(taskID, frameNumber);
+		}
+	}
+
+	// a task that was removed by another task in the meantime has a different generation.
+	for (unsigned int i=0; i < _tasksToRun.size(); i++) {
+		Task & task = _tasks[_tasksToRun[i].first];
+		if (task.active && (task.generation == _tasksToRun[i].second)) {
+			TaskFunction function = task.function;
+			function(timeStamp, dt, frameNumber);
+		}
+	}
+
+	if ((workerThreads == NULL) || (_concurrentTasksToRun.size() < 2)) {
+		for (unsigned int i=0; i < _concurrentTasksToRun.size(); i++) {
+			Task & task = _tasks[_concurrentTasksToRun[i].first];
+			if (task.active && (task.generation == _concurrentTasksToRun[i].second)) {
+				TaskFunction function = task.function;
+				function(timeStamp, dt, frameNumber);
+			}
+		}
+	}
+	else {
+		// concurrent tasks may not add or remove tasks, so the list of tasks does not change while they run.
+		workerThreads->parallelFor(0, (unsigned int)_concurrentTasksToRun.size(), 0, [&](unsigned int threadIndex, unsigned int begin, unsigned int end) {
+			for (unsigned int i = begin; i < end; i++) {
+				const Task & task = _tasks[_concurrentTasksToRun[i].first];
+				if (task.active && (task.generation == _concurrentTasksToRun[i].second)) {
+					task.function(timeStamp, dt, frameNumber);
+				}
+			}
+		});
+	}
+}
+
+
+void MultiRateScheduler::clear()
+{
+	_tasks.clear();
+	_freeTaskIDs.clear();
+	_dueTasks.clear();
+	_offsetLoad.clear();
+	_currentFrame = 0;
+}
+
+
+unsigned int MultiRateScheduler::chooseOffset(unsigned int interval)
+{
+	if (interval <= 1) {
+		return 0;
+	}
+
+	OffsetLoad & load = _offsetLoad[interval];
+	if (load.numUsers.empty()) {
+		load.numUsers.assign(interval, 0);
+		for (unsigned int offset=0; offset < interval; offset++) {
+			load.byNumUsers.insert(std::make_pair(0u, offset));
+		}
+	}
+
+	// ties go to the smallest offset, so offsets are handed out in order while all are equally used.
+	unsigned int offset = load.byNumUsers.begin()->second;
+	load.byNumUsers.erase(load.byNumUsers.begin());
+	load.numUsers[offset]++;
+	load.byNumUsers.insert(std::make_pair(load.numUsers[offset], offset));
+	return offset;
+}
+
+
+void MultiRateScheduler::releaseOffset(unsigned int interval, unsigned int offset)
+{
+	if (interval <= 1) {
+		return;
+	}
+
+	// offsets chosen before clear() are silently ignored.
+	std::map<unsigned int, OffsetLoad>::iterator loadIter = _offsetLoad.find(interval);
+	if ((loadIter == _offsetLoad.end()) || (offset >= interval) || (loadIter->second.numUsers[offset] == 0)) {
+		return;
+	}
+
+	OffsetLoad & load = loadIter->second;
+	load.byNumUsers.erase(std::make_pair(load.numUsers[offset], offset));
+	load.numUsers[offset]--;
+	load.byNumUsers.insert(std::make_pair(load.numUsers[offset], offset));
+}
@@ -115,6 +115,21 @@ void PerformanceProfiler::displayStatistics(std::ostream & out)
 	out << "    Total time of all calls: " << getTotalTime() << " seconds" << std::endl;
 }
 
+void PerformanceProfiler::addStatistics(const PerformanceProfiler & other)
+{
+	if (other._numTimesCalled == 0)
+		return;
+
+	if ( other._maxTicks > _maxTicks )
+		_maxTicks = other._maxTicks;
+
+	if ( other._minTicks < _minTicks || _numTimesCalled == 0)
+		_minTicks = other._minTicks;
+
+	_numTimesCalled += other._numTimesCalled;
+	_totalTicksAccumulated += other._totalTicksAccumulated;
+}
+
 void PerformanceProfiler::_updateStatistics()
 {
 	unsigned long long ticksForOneStep = _endTick - _startTick;
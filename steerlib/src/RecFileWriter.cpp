@@ -342,3 +342,67 @@ void RecFileWriter::addCameraView( float origx, float origy, float origz, float
 
 }
 
+
+
+//
+// writeCheckpoint(): stores the header, the lists, and the frame table, along with a copy of everything written to the file so far.
+//
+void RecFileWriter::writeCheckpoint(SteerLib::CheckpointWriter & out)
+{
+	if (!_opened) {
+		throw GenericException("RecFileWriter::writeCheckpoint(): no recording is in progress.");
+	}
+
+	if ( _writingFrame ) {
+		throw GenericException("RecFileWriter::writeCheckpoint(): cannot write a checkpoint while a frame is being written.");
+	}
+
+	_playbackFile.flush();
+	std::vector<char> fileContents((size_t)_playbackFile.tellp());
+	ifstream fileSoFar(_filename.c_str(), ios::binary);
+	if (!fileSoFar.read(fileContents.data(), fileContents.size())) {
+		throw GenericException("RecFileWriter::writeCheckpoint(): could not read back the partially written file \"" + _filename + "\".");
+	}
+
+	out.write(*_header);
+	out.writeVector(fileContents);
+	out.writeVector(_obstacleList);
+	out.writeVector(_cameraList);
+	out.writeVector(_frameTable);
+}
+
+
+//
+// readCheckpoint(): rewrites the file from the contents stored by writeCheckpoint(), and continues the recording from there.
+//
+void RecFileWriter::readCheckpoint(SteerLib::CheckpointReader & in)
+{
+	if (!_opened) {
+		throw GenericException("RecFileWriter::readCheckpoint(): no recording is in progress.");
+	}
+
+	if ( _writingFrame ) {
+		throw GenericException("RecFileWriter::readCheckpoint(): cannot read a checkpoint while a frame is being written.");
+	}
+
+	RecFileHeader header;
+	in.read(header);
+	if (header.numAgents != _header->numAgents) {
+		throw GenericException("RecFileWriter::readCheckpoint(): the checkpoint recorded " + toString(header.numAgents) + " agents, but this recording has " + toString(_header->numAgents) + ".");
+	}
+
+	std::vector<char> fileContents;
+	in.readVector(fileContents);
+
+	_playbackFile.close();
+	_playbackFile.open(_filename.c_str(), ios::binary | ios::trunc);
+	if (!_playbackFile.is_open()) {
+		throw GenericException("RecFileWriter::readCheckpoint(): could not open file \"" + _filename + "\".");
+	}
+	_playbackFile.write(fileContents.data(), fileContents.size());
+
+	*_header = header;
+	in.readVector(_obstacleList);
+	in.readVector(_cameraList);
+	in.readVector(_frameTable);
+}
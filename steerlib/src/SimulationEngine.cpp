@@ -11,6 +11,9 @@
 
 #include <iomanip>
 #include <algorithm>
+#include <set>
+#include <atomic>
+#include <functional>
 #include <string>
 
 #include "simulation/SimulationOptions.h"
@@ -34,6 +37,10 @@ using namespace Util;
 
 // #define _DEBUG 1
 
+// the random streams of agents and of modules are split from different branches of the engine's stream.
+#define RANDOM_STREAMS_OF_AGENTS 1
+#define RANDOM_STREAMS_OF_MODULES 2
+
 
 SimulationEngine::SimulationEngine()
 {
@@ -46,15 +53,27 @@ void SimulationEngine::_reset()
 	_moduleMetaInfoByReference.clear();
 	_modulesInExecutionOrder.clear();
 	_moduleConflicts.clear();
-	_agents.clear();
+	_moduleFrameStages.clear();
+	_moduleFrameStagesNeedRebuild = true;
+	_agentRegistry.clear();
 	_selectedAgents.clear();
-	_agentOwners.clear();
+	_numTwoPhaseAgents = 0;
+	_activeAgents.clear();
+	_inactiveAgents.clear();
+	_activeAgentsNeedRebuild = true;
+	_numFinishedAgents = 0;
+	_multiRateScheduler.clear();
+	_deferredWork.clear();
+	_frameTelemetry.stop();
+	_agentStateSnapshot.clear();
 	_commands.clear();
 	_obstacles.clear();
 	//_clock reset ???;
 	//_camera reset ???;
 	_spatialDatabase = NULL;
 	_engineController = NULL;
+	_taskScheduler = NULL;
+	_frameArenas.clear();
 	_numFramesSimulated = 0;
 	_simulationLoaded = false;
 	_simulationRunning = false;
@@ -95,6 +114,9 @@ void SimulationEngine::init(SimulationOptions * options, SteerLib::EngineControl
 		clockMode = Clock::CLOCK_MODE_VARIABLE_REAL_TIME;
 	}
 	_clock.setClockMode(clockMode, _options->engineOptions.fixedFPS, _options->engineOptions.minVariableDt, _options->engineOptions.maxVariableDt);
+	// only frames with a real-time deadline have spare time to run deferred work in.
+	_deferredWork.setDeferring(_clock.hasFrameDeadline());
+	_deferredWork.setMaxDeferredFrames(_options->engineOptions.maxDeferredFrames);
 
 	_camera.reset();
 	_camera.setView(_options->guiOptions.cameraPosition, _options->guiOptions.cameraLookAt, _options->guiOptions.cameraUp, _options->guiOptions.cameraFovy);
@@ -105,11 +127,30 @@ void SimulationEngine::init(SimulationOptions * options, SteerLib::EngineControl
 	float zmax = (_options->gridDatabaseOptions.gridSizeZ / 2.0f);
 
 
-	if (_options->engineOptions.numThreads != 1) {
-		throw GenericException("multi-threading not supported yet");
+	if (_options->engineOptions.numThreads == 0) {
+		throw GenericException("The engine needs at least one thread, but numThreads is 0.");
+	}
+	else if (_options->engineOptions.numThreads > 1) {
+		// the calling thread also runs agent updates, so numThreads counts it.
+		_taskScheduler = new WorkStealingScheduler(_options->engineOptions.numThreads);
+	}
+	for (unsigned int i=0; i < _options->engineOptions.numThreads; i++) {
+		_frameArenas.push_back(new FrameArena());
 	}
 
 	_spatialDatabase = new GridDatabase2D(xmin, xmax, zmin, zmax, _options->gridDatabaseOptions.numGridCellsX, _options->gridDatabaseOptions.numGridCellsZ, _options->gridDatabaseOptions.maxItemsPerGridCell, _options->gridDatabaseOptions.drawGrid);
+	if (_options->engineOptions.randomSeed != 0) {
+		_spatialDatabase->seedRandomNumberGenerator(_options->engineOptions.randomSeed);
+	}
+	if (_options->gridDatabaseOptions.rebuildAgentLayer) {
+		_spatialDatabase->setDynamicLayerMode(DYNAMIC_LAYER_REBUILD, _taskScheduler);
+	}
+	if (_options->gridDatabaseOptions.mortonCellOrder) {
+		_spatialDatabase->setCellNumbering(CELL_NUMBERING_MORTON);
+	}
+	// unlike the spatial database's generator, the random streams are also seeded when the seed is 0.
+	_randomSeed = _options->engineOptions.randomSeed;
+	_randomStreams = RandomStream(_randomSeed);
 
 
 
@@ -164,15 +205,17 @@ void SimulationEngine::finish()
 	}
 
 	// if modules did not clean up agents (they should), we can compensate user-friendly here.
-	if (_agents.size() != 0) {
-		std::vector<SteerLib::AgentInterface*>::iterator agentIterator;
-		for (agentIterator = _agents.begin(); agentIterator != _agents.end(); ++agentIterator) {
-			_agentOwners[(*agentIterator)]->destroyAgent(*agentIterator);
+	if (_agentRegistry.size() != 0) {
+		const std::vector<SteerLib::AgentInterface*> & agents = _agentRegistry.getAgents();
+		for (unsigned int i=0; i < agents.size(); i++) {
+			_agentRegistry.getOwner(agents[i])->destroyAgent(agents[i]);
 		}
-		_agents.clear();
-		_agentOwners.clear();
+		_agentRegistry.clear();
+		_numTwoPhaseAgents = 0;
+		_activeAgentsNeedRebuild = true;
 	}
 	_selectedAgents.clear();
+	_agentStateSnapshot.clear();
 
 	// unload modules in reverse execution order.
 	// note that at each iteration, unloadModule removes one or more modules from _modulesInExecutionOrder.
@@ -186,6 +229,14 @@ void SimulationEngine::finish()
 	assert(_moduleConflicts.size() == 0);
 
 	if (_spatialDatabase != NULL) delete _spatialDatabase;
+	if (_taskScheduler != NULL) {
+		delete _taskScheduler;
+		_taskScheduler = NULL;
+	}
+	for (unsigned int i=0; i < _frameArenas.size(); i++) {
+		delete _frameArenas[i];
+	}
+	_frameArenas.clear();
 	_commands.clear();
 	//_clock cleanup??
 	//_camera cleanup??
@@ -207,6 +258,17 @@ void SimulationEngine::initializeSimulation()
 	_engineState.transitionToState(ENGINE_STATE_LOADING_SIMULATION);
 
 	_clock.reset();
+	_numFramesSimulated = 0;
+
+	// every simulation starts with the same random numbers, so that a simulation gives the same results
+	// in an engine that already ran other simulations as in a new one.
+	if (_agentRegistry.size() == 0) {
+		_agentRegistry.setNextSerialNumber(0);
+	}
+	if (_randomSeed != 0) {
+		_spatialDatabase->seedRandomNumberGenerator(_randomSeed);
+	}
+	_deriveRandomStreams();
 
 	// iterate over all modules asking them to initialize.
 	std::vector<SteerLib::ModuleInterface*>::iterator iter;
@@ -230,6 +292,11 @@ void SimulationEngine::cleanupSimulation()
 	}
 
 	_clock.reset();
+	// frame numbers start over with the next simulation, and so do the tasks.
+	_multiRateScheduler.clear();
+	_deferredWork.clear();
+	_frameTelemetry.stop();
+	_spatialDatabase->setCountingUpdates(false);
 
 	_engineState.transitionToState(ENGINE_STATE_READY);
 }
@@ -246,7 +313,22 @@ void SimulationEngine::preprocessSimulation()
 		(*iter)->preprocessSimulation();
 	}
 
+	if (_options->engineOptions.telemetryFrames != 0) {
+		std::vector<std::string> moduleNames;
+		for ( iter = _modulesInExecutionOrder.begin(); iter != _modulesInExecutionOrder.end();  ++iter ) {
+			moduleNames.push_back(_moduleMetaInfoByReference[*iter]->moduleName);
+		}
+		_frameTelemetry.start(_options->engineOptions.telemetryFrames, moduleNames);
+		_spatialDatabase->setCountingUpdates(true);
+		// whatever the modules added while setting up is not part of the first frame.
+		_spatialDatabase->takeNumItemUpdates();
+	}
+
 	_engineState.transitionToState(ENGINE_STATE_SIMULATION_READY_FOR_UPDATE);
+
+	if (_options->engineOptions.restoreCheckpointFilename != "") {
+		restoreCheckpoint(_options->engineOptions.restoreCheckpointFilename);
+	}
 }
 
 
@@ -254,9 +336,21 @@ void SimulationEngine::preprocessSimulation()
 
 void SimulationEngine::postprocessSimulation()
 {
+	if ((_options->engineOptions.checkpointFilename != "") && (_options->engineOptions.checkpointFrame == 0)) {
+		saveCheckpoint(_options->engineOptions.checkpointFilename);
+	}
+
 	_engineState.transitionToState(ENGINE_STATE_POSTPROCESSING_SIMULATION);
 
 	std::cout << "Simulated " << _numFramesSimulated << " frames." << std::endl;
+	if (_frameTelemetry.isEnabled() && (_options->engineOptions.telemetryFilename != "")) {
+		_frameTelemetry.writeToFile(_options->engineOptions.telemetryFilename);
+		std::cout << "Wrote telemetry of the last " << std::min(_frameTelemetry.getNumFramesRecorded(), (unsigned long long)_frameTelemetry.getCapacity()) << " frames to " << _options->engineOptions.telemetryFilename << "." << std::endl;
+	}
+	if (_deferredWork.isDeferring()) {
+		std::cout << "Deferred work: " << _deferredWork.getNumItemsRun() << " items ran, " << _deferredWork.getNumItemsForced() << " of them late";
+		std::cout << " (" << _deferredWork.getStarvedAgents().size() << " agents starved), longest wait " << _deferredWork.getMaxFramesWaited() << " frames, " << _deferredWork.getNumPending() << " still queued." << std::endl;
+	}
 
 	std::vector<SteerLib::ModuleInterface*>::iterator iter;
 	for ( iter = _modulesInExecutionOrder.begin(); iter != _modulesInExecutionOrder.end();  ++iter ) {
@@ -267,6 +361,217 @@ void SimulationEngine::postprocessSimulation()
 }
 
 
+//========================================
+
+namespace {
+	/// Orders obstacles by their bounds, so that checkpoints list them in the same order in every run.
+	bool obstacleCheckpointOrder(SteerLib::ObstacleInterface * a, SteerLib::ObstacleInterface * b)
+	{
+		Util::AxisAlignedBox aBox = a->getBounds();
+		Util::AxisAlignedBox bBox = b->getBounds();
+		if (aBox.xmin != bBox.xmin) return aBox.xmin < bBox.xmin;
+		if (aBox.zmin != bBox.zmin) return aBox.zmin < bBox.zmin;
+		if (aBox.xmax != bBox.xmax) return aBox.xmax < bBox.xmax;
+		if (aBox.zmax != bBox.zmax) return aBox.zmax < bBox.zmax;
+		if (aBox.ymin != bBox.ymin) return aBox.ymin < bBox.ymin;
+		return aBox.ymax < bBox.ymax;
+	}
+}
+
+void SimulationEngine::saveCheckpoint(const std::string & filename)
+{
+	CheckpointWriter out;
+	writeCheckpoint(out);
+	out.saveToFile(filename);
+	std::cout << "Saved checkpoint of frame " << _clock.getCurrentFrameNumber() << " to " << filename << " (" << out.getSize() << " bytes)." << std::endl;
+}
+
+void SimulationEngine::restoreCheckpoint(const std::string & filename)
+{
+	CheckpointReader in;
+	in.loadFromFile(filename);
+	readCheckpoint(in);
+	std::cout << "Restored checkpoint " << filename << " at frame " << _clock.getCurrentFrameNumber() << "." << std::endl;
+}
+
+void SimulationEngine::writeCheckpoint(CheckpointWriter & out)
+{
+	const std::vector<SteerLib::AgentInterface*> & agents = _agentRegistry.getAgents();
+	_checkCanUseCheckpoints();
+
+	// deferred work is not saved, so it is finished first; otherwise it would be lost when the checkpoint is restored.
+	_deferredWork.runAll(_clock.getCurrentFrameNumber());
+
+	std::vector<SteerLib::ObstacleInterface*> obstacles;
+	_getObstaclesInCheckpointOrder(obstacles);
+
+	// items are numbered agents first, then obstacles, so that references can be stored as indices.
+	for (unsigned int i=0; i < agents.size(); i++) {
+		out.addItem(agents[i]);
+	}
+	for (unsigned int i=0; i < obstacles.size(); i++) {
+		out.addItem(obstacles[i]);
+	}
+
+	_clock.writeCheckpoint(out);
+	out.write(_numFramesSimulated);
+	out.write(_randomSeed);
+	out.write(_agentRegistry.getNextSerialNumber());
+
+	out.write((unsigned int)agents.size());
+	for (unsigned int i=0; i < agents.size(); i++) {
+		out.writeString(_moduleMetaInfoByReference[_agentRegistry.getOwner(agents[i])]->moduleName);
+		out.write(_agentRegistry.getRandomStream(agents[i]));
+		out.beginBlock();
+		agents[i]->writeCheckpoint(out);
+		out.endBlock();
+	}
+
+	// obstacles do not change during a simulation, so their bounds are only used to check that the restored simulation has the same obstacles.
+	out.write((unsigned int)obstacles.size());
+	for (unsigned int i=0; i < obstacles.size(); i++) {
+		out.write(obstacles[i]->getBounds());
+	}
+
+	_spatialDatabase->writeCheckpoint(out);
+
+	out.write((unsigned int)_modulesInExecutionOrder.size());
+	for (unsigned int i=0; i < _modulesInExecutionOrder.size(); i++) {
+		out.writeString(_moduleMetaInfoByReference[_modulesInExecutionOrder[i]]->moduleName);
+		out.write(_moduleMetaInfoByReference[_modulesInExecutionOrder[i]]->randomStream);
+		out.beginBlock();
+		_modulesInExecutionOrder[i]->writeCheckpoint(out);
+		out.endBlock();
+	}
+}
+
+void SimulationEngine::readCheckpoint(CheckpointReader & in)
+{
+	const std::vector<SteerLib::AgentInterface*> & agents = _agentRegistry.getAgents();
+	_checkCanUseCheckpoints();
+
+	// agents may still wait for their deferred work; it runs now, and the restored state then replaces its results.
+	_deferredWork.runAll(_clock.getCurrentFrameNumber());
+
+	std::vector<SteerLib::ObstacleInterface*> obstacles;
+	_getObstaclesInCheckpointOrder(obstacles);
+
+	for (unsigned int i=0; i < agents.size(); i++) {
+		in.addItem(agents[i]);
+	}
+	for (unsigned int i=0; i < obstacles.size(); i++) {
+		in.addItem(obstacles[i]);
+	}
+
+	_clock.readCheckpoint(in);
+	in.read(_numFramesSimulated);
+	in.read(_randomSeed);
+	_randomStreams = RandomStream(_randomSeed);
+	unsigned int nextSerialNumber;
+	in.read(nextSerialNumber);
+	_agentRegistry.setNextSerialNumber(nextSerialNumber);
+
+	unsigned int numAgents;
+	in.read(numAgents);
+	if (numAgents != agents.size()) {
+		throw GenericException("The checkpoint has " + toString(numAgents) + " agents, but the current simulation has " + toString(agents.size()) + "; a checkpoint can only be restored into the same test case.");
+	}
+	for (unsigned int i=0; i < agents.size(); i++) {
+		std::string ownerName;
+		in.readString(ownerName);
+		const std::string & currentOwnerName = _moduleMetaInfoByReference[_agentRegistry.getOwner(agents[i])]->moduleName;
+		if (ownerName != currentOwnerName) {
+			throw GenericException("Agent " + toString(i) + " of the checkpoint belongs to module \"" + ownerName + "\", but in the current simulation it belongs to \"" + currentOwnerName + "\".");
+		}
+		in.read(_agentRegistry.getRandomStream(agents[i]));
+		in.beginBlock();
+		agents[i]->readCheckpoint(in);
+		in.endBlock();
+	}
+
+	unsigned int numObstacles;
+	in.read(numObstacles);
+	if (numObstacles != obstacles.size()) {
+		throw GenericException("The checkpoint has " + toString(numObstacles) + " obstacles, but the current simulation has " + toString(obstacles.size()) + "; a checkpoint can only be restored into the same test case.");
+	}
+	for (unsigned int i=0; i < obstacles.size(); i++) {
+		Util::AxisAlignedBox bounds;
+		in.read(bounds);
+		Util::AxisAlignedBox currentBounds = obstacles[i]->getBounds();
+		if ((bounds.xmin != currentBounds.xmin) || (bounds.xmax != currentBounds.xmax) || (bounds.ymin != currentBounds.ymin) ||
+			(bounds.ymax != currentBounds.ymax) || (bounds.zmin != currentBounds.zmin) || (bounds.zmax != currentBounds.zmax)) {
+			throw GenericException("The obstacles of the checkpoint do not match the current simulation; a checkpoint can only be restored into the same test case.");
+		}
+	}
+
+	_spatialDatabase->readCheckpoint(in);
+
+	// modules are matched by name; modules that are no longer loaded are skipped.
+	std::set<std::string> restoredModuleNames;
+	unsigned int numModules;
+	in.read(numModules);
+	for (unsigned int i=0; i < numModules; i++) {
+		std::string moduleName;
+		in.readString(moduleName);
+		RandomStream moduleRandomStream;
+		in.read(moduleRandomStream);
+		std::map<std::string, SteerLib::ModuleMetaInformation*>::iterator moduleIter = _moduleMetaInfoByName.find(moduleName);
+		if (moduleIter == _moduleMetaInfoByName.end()) {
+			in.skipBlock();
+			continue;
+		}
+		moduleIter->second->randomStream = moduleRandomStream;
+		in.beginBlock();
+		moduleIter->second->module->readCheckpoint(in);
+		in.endBlock();
+		restoredModuleNames.insert(moduleName);
+	}
+
+	// a module that is not in the checkpoint would keep the state it has at the beginning of the simulation, e.g. benchmark metrics of no frames.
+	for (unsigned int i=0; i < _modulesInExecutionOrder.size(); i++) {
+		const std::string & moduleName = _moduleMetaInfoByReference[_modulesInExecutionOrder[i]]->moduleName;
+		if (restoredModuleNames.find(moduleName) == restoredModuleNames.end()) {
+			throw GenericException("Module \"" + moduleName + "\" is loaded, but the checkpoint does not contain its state; a checkpoint can only be restored into an engine with the same modules.");
+		}
+	}
+
+	if (!in.isAtEnd()) {
+		throw GenericException("The checkpoint has unexpected data at its end.");
+	}
+
+	// agents that were disabled may be enabled again, and the other way around.
+	_activeAgentsNeedRebuild = true;
+}
+
+void SimulationEngine::_checkCanUseCheckpoints()
+{
+	unsigned int state = _engineState.getCurrentState();
+	if ((state != ENGINE_STATE_SIMULATION_READY_FOR_UPDATE) && (state != ENGINE_STATE_SIMULATION_NO_MORE_UPDATES_ALLOWED)) {
+		throw GenericException("Checkpoints can only be saved or restored between two updates of a simulation.");
+	}
+
+	const std::vector<SteerLib::AgentInterface*> & agents = _agentRegistry.getAgents();
+
+	for (unsigned int i=0; i < agents.size(); i++) {
+		if (!agents[i]->supportsCheckpoints()) {
+			throw GenericException("The agents of module \"" + _moduleMetaInfoByReference[_agentRegistry.getOwner(agents[i])]->moduleName + "\" do not support checkpoints.");
+		}
+	}
+
+	for (unsigned int i=0; i < _modulesInExecutionOrder.size(); i++) {
+		if (!_modulesInExecutionOrder[i]->supportsCheckpoints()) {
+			throw GenericException("Module \"" + _moduleMetaInfoByReference[_modulesInExecutionOrder[i]]->moduleName + "\" does not support checkpoints.");
+		}
+	}
+}
+
+void SimulationEngine::_getObstaclesInCheckpointOrder(std::vector<SteerLib::ObstacleInterface*> & obstacles)
+{
+	obstacles.assign(_obstacles.begin(), _obstacles.end());
+	std::stable_sort(obstacles.begin(), obstacles.end(), obstacleCheckpointOrder);
+}
+
+
 //========================================
 
 bool SimulationEngine::update( bool advanceRealTimeOnly )
@@ -278,6 +583,11 @@ bool SimulationEngine::update( bool advanceRealTimeOnly )
 	}
 
 	if (!advanceRealTimeOnly) {
+		// spend the rest of the previous frame's real-time budget on deferred work, then wait for the frame to end.
+		if (_deferredWork.isDeferring()) {
+			_deferredWork.runUntil(_clock.getFrameDeadline(), _clock.getCurrentFrameNumber());
+		}
+
 		// update real-time aspects of the simulation
 		_clock.advanceSimulationAndUpdateRealTime();
 		_camera.update(_clock.getCurrentRealTime(), _clock.getRealDt());
@@ -310,38 +620,105 @@ bool SimulationEngine::_simulateOneStep()
 	float currentSimulationTime = _clock.getCurrentSimulationTime();
 	float simulatonDt = _clock.getSimulationDt();
 	unsigned int currentFrameNumber = _clock.getCurrentFrameNumber();
+	// modules may add or remove agents while the frame runs, so this always refers to the current list.
+	const std::vector<SteerLib::AgentInterface*> & agents = _agentRegistry.getAgents();
+
+	unsigned long long frameStartTick = _getTelemetryTick();
+	if (_frameTelemetry.isEnabled()) {
+		_frameTelemetry.beginFrame(currentFrameNumber, frameStartTick);
+	}
 
 	//Call animate for camera
 	if (_options->guiOptions.animateCamera)
 		_camera.animate(currentSimulationTime, simulatonDt, currentFrameNumber);
 
 	// call preprocess for all modules
-	std::vector<SteerLib::ModuleInterface*>::iterator moduleIterator;
-	for ( moduleIterator = _modulesInExecutionOrder.begin(); moduleIterator != _modulesInExecutionOrder.end();  ++moduleIterator ) {
-		(*moduleIterator)->preprocessFrame(currentSimulationTime, simulatonDt, currentFrameNumber);
-	}
+	unsigned long long phaseStartTick = _getTelemetryTick();
+	_runModulesFramePhase(true, currentSimulationTime, simulatonDt, currentFrameNumber);
+	_recordTelemetryPhase(FrameTelemetry::FIELD_PREPROCESS_TICKS, phaseStartTick);
+
+	// run the tasks that agents and modules scheduled for this frame
+	_multiRateScheduler.runTasks(currentSimulationTime, simulatonDt, currentFrameNumber, _taskScheduler);
+	_recordTelemetryPhase(FrameTelemetry::FIELD_SCHEDULED_TASK_TICKS, phaseStartTick);
 
 	// call updateAI for all agents
-	std::vector<SteerLib::AgentInterface*>::iterator agentIterator;
-	for ( agentIterator = _agents.begin(); agentIterator != _agents.end(); ++agentIterator )
-	{
-		if ((*agentIterator)->enabled()){
-			(*agentIterator)->updateAI(currentSimulationTime, simulatonDt, currentFrameNumber);
+	if (_taskScheduler != NULL) {
+		numDisabledAgents = _updateAgentsInParallel(currentSimulationTime, simulatonDt, currentFrameNumber);
+	}
+	else {
+		// when the agent layer is rebuilt every frame, agents see it as it was at the start of the frame, as they do with several threads.
+		bool deferGridUpdates = (_spatialDatabase->getDynamicLayerMode() == DYNAMIC_LAYER_REBUILD);
+		if (deferGridUpdates) {
+			_spatialDatabase->beginDeferredUpdates();
 		}
-		else {
-			if((*agentIterator)->finished()) {	//for most AIs, this will in turn call enabled() and duplicate original behavior; ShadowAI overrides this behavior
-				numDisabledAgents++;
+
+		// two-phase agents decide against the state all agents had at the start of the frame.
+		if (_numTwoPhaseAgents != 0) {
+			_agentStateSnapshot.capture(agents);
+		}
+
+		// only the active agents are visited; the ones found disabled are dropped from the active list
+		// on the way, keeping the others in order.
+		_rebuildActiveAgentsIfNeeded();
+		unsigned int numActiveAgents = 0;
+		for (unsigned int i=0; i < _activeAgents.size(); i++)
+		{
+			SteerLib::AgentInterface * agent = _activeAgents[i];
+			if (agent->enabled()){
+				_activeAgents[numActiveAgents++] = agent;
+				if (agent->usesTwoPhaseUpdate())
+					agent->decideAI(currentSimulationTime, simulatonDt, currentFrameNumber);
+				else
+					agent->updateAI(currentSimulationTime, simulatonDt, currentFrameNumber);
+			}
+			else {
+				_deactivateAgent(agent);
 			}
 		}
+		_activeAgents.resize(numActiveAgents);
+		numDisabledAgents = _numFinishedAgents;
+
+		// then all decisions are applied as one batch.
+		if (_numTwoPhaseAgents != 0) {
+			std::vector<SteerLib::AgentInterface*>::const_iterator agentIterator;
+			for ( agentIterator = _activeAgents.begin(); agentIterator != _activeAgents.end(); ++agentIterator ) {
+				if ((*agentIterator)->enabled() && (*agentIterator)->usesTwoPhaseUpdate()) {
+					(*agentIterator)->commitAI(currentSimulationTime, simulatonDt, currentFrameNumber);
+				}
+			}
+		}
+
+		if (deferGridUpdates) {
+			_spatialDatabase->commitDeferredUpdates(_activeAgents);
+			_spatialDatabase->endDeferredUpdates();
+		}
 	}
 
+	_recordTelemetryPhase(FrameTelemetry::FIELD_AGENT_TICKS, phaseStartTick);
+
 	// call postprocess for all modules
-	for ( moduleIterator = _modulesInExecutionOrder.begin(); moduleIterator != _modulesInExecutionOrder.end();  ++moduleIterator ) {
-		(*moduleIterator)->postprocessFrame(currentSimulationTime, simulatonDt, currentFrameNumber);
+	_runModulesFramePhase(false, currentSimulationTime, simulatonDt, currentFrameNumber);
+	_recordTelemetryPhase(FrameTelemetry::FIELD_POSTPROCESS_TICKS, phaseStartTick);
+
+	// temporary data of this frame is no longer used by anyone.
+	unsigned long long numArenaAllocations, numArenaBytes;
+	_resetFrameArenas(numArenaAllocations, numArenaBytes);
+
+	if (_frameTelemetry.isEnabled()) {
+		_frameTelemetry.set(FrameTelemetry::FIELD_FRAME_TICKS, phaseStartTick - frameStartTick);
+		_frameTelemetry.set(FrameTelemetry::FIELD_NUM_ACTIVE_AGENTS, _activeAgents.size());
+		_frameTelemetry.set(FrameTelemetry::FIELD_NUM_GRID_UPDATES, _spatialDatabase->takeNumItemUpdates());
+		_frameTelemetry.set(FrameTelemetry::FIELD_NUM_ARENA_ALLOCATIONS, numArenaAllocations);
+		_frameTelemetry.set(FrameTelemetry::FIELD_ARENA_BYTES, numArenaBytes);
+		_frameTelemetry.endFrame();
 	}
 
 	_numFramesSimulated++;
 
+	if ((_options->engineOptions.checkpointFilename != "") && (_options->engineOptions.checkpointFrame == _clock.getCurrentFrameNumber())) {
+		saveCheckpoint(_options->engineOptions.checkpointFilename);
+	}
+
 
 	// indicate that we're done (return false) if we've already played the desired number of frames.
 	if ((_options->engineOptions.numFramesToSimulate != 0) && (_numFramesSimulated >= _options->engineOptions.numFramesToSimulate))
@@ -349,7 +726,7 @@ bool SimulationEngine::_simulateOneStep()
 
 	// indicate that we're done (return false) if all agents were disabled in this frame.
 	// Disabling exit when all agents have finished simulating. 
-	if (numDisabledAgents == _agents.size())
+	if (numDisabledAgents == _agentRegistry.size())
 		return false;
 
 	// Force stop by some other module
@@ -360,6 +737,203 @@ bool SimulationEngine::_simulateOneStep()
 }
 
 
+//========================================
+
+void SimulationEngine::_runModulesFramePhase(bool preprocess, float currentSimulationTime, float simulationDt, unsigned int currentFrameNumber)
+{
+	if (_taskScheduler == NULL) {
+		for (unsigned int i=0; i < _modulesInExecutionOrder.size(); i++) {
+			_runModuleFrameFunction(i, preprocess, currentSimulationTime, simulationDt, currentFrameNumber);
+		}
+		return;
+	}
+
+	if (_moduleFrameStagesNeedRebuild) {
+		_buildModuleFrameStages();
+	}
+
+	for (unsigned int s=0; s < _moduleFrameStages.size(); s++) {
+		std::vector<ModuleFrameNode> & nodes = _moduleFrameStages[s].nodes;
+
+		// exclusive modules, and stages with nothing to overlap, stay on the calling thread.
+		if (nodes.size() == 1) {
+			_runModuleFrameFunction(nodes[0].moduleIndex, preprocess, currentSimulationTime, simulationDt, currentFrameNumber);
+			continue;
+		}
+
+		// each module is forked as soon as the last module it waits for is done.
+		std::vector< std::atomic<unsigned int> > numPredecessorsLeft(nodes.size());
+		for (unsigned int i=0; i < nodes.size(); i++) {
+			numPredecessorsLeft[i] = nodes[i].numPredecessors;
+		}
+
+		Util::TaskGroup group(*_taskScheduler);
+		std::function<void (unsigned int)> runNode = [&](unsigned int nodeIndex) {
+			_runModuleFrameFunction(nodes[nodeIndex].moduleIndex, preprocess, currentSimulationTime, simulationDt, currentFrameNumber);
+
+			for (unsigned int j=0; j < nodes[nodeIndex].successors.size(); j++) {
+				unsigned int successor = nodes[nodeIndex].successors[j];
+				if (--numPredecessorsLeft[successor] == 0) {
+					group.run([&runNode, successor](unsigned int threadIndex) { runNode(successor); });
+				}
+			}
+		};
+
+		for (unsigned int i=0; i < nodes.size(); i++) {
+			if (nodes[i].numPredecessors == 0) {
+				group.run([&runNode, i](unsigned int threadIndex) { runNode(i); });
+			}
+		}
+		group.wait();
+	}
+}
+
+void SimulationEngine::_runModuleFrameFunction(unsigned int moduleIndex, bool preprocess, float currentSimulationTime, float simulationDt, unsigned int currentFrameNumber)
+{
+	SteerLib::ModuleInterface * module = _modulesInExecutionOrder[moduleIndex];
+	unsigned long long startTick = _getTelemetryTick();
+
+	if (preprocess)
+		module->preprocessFrame(currentSimulationTime, simulationDt, currentFrameNumber);
+	else
+		module->postprocessFrame(currentSimulationTime, simulationDt, currentFrameNumber);
+
+	// modules loaded after the telemetry started have no fields of their own.
+	if (_frameTelemetry.isEnabled() && (moduleIndex < _frameTelemetry.getModuleNames().size())) {
+		_frameTelemetry.setModuleTicks(moduleIndex, preprocess, Util::getHighResCounterValue() - startTick);
+	}
+}
+
+void SimulationEngine::_buildModuleFrameStages()
+{
+	_moduleFrameStages.clear();
+
+	for (unsigned int i=0; i < _modulesInExecutionOrder.size(); i++) {
+		SteerLib::ModuleInterface * module = _modulesInExecutionOrder[i];
+		ModuleFrameConcurrencyEnum concurrency = module->getFrameConcurrency();
+
+		// an exclusive module ends the current stage and gets its own; so does the first module.
+		bool startNewStage = (concurrency == MODULE_FRAME_EXCLUSIVE) || _moduleFrameStages.empty()
+			|| (_moduleFrameStages.back().nodes[0].module->getFrameConcurrency() == MODULE_FRAME_EXCLUSIVE);
+		if (startNewStage) {
+			_moduleFrameStages.push_back(ModuleFrameStage());
+		}
+
+		std::vector<ModuleFrameNode> & nodes = _moduleFrameStages.back().nodes;
+		ModuleFrameNode newNode;
+		newNode.module = module;
+		newNode.moduleIndex = i;
+		newNode.numPredecessors = 0;
+
+		// the new module comes after every earlier module of the stage that it depends on, or that it may not overlap with.
+		// earlier modules were loaded first, so edges only point forward and the stage cannot have cycles.
+		ModuleMetaInformation * metaInfo = _moduleMetaInfoByReference[module];
+		for (unsigned int j=0; j < nodes.size(); j++) {
+			ModuleMetaInformation * earlierMetaInfo = _moduleMetaInfoByReference[nodes[j].module];
+			bool dependsOnEarlier = (metaInfo->dependencies.find(earlierMetaInfo) != metaInfo->dependencies.end());
+			bool mayOverlap = (nodes[j].module->getFrameConcurrency() == concurrency);
+			if (dependsOnEarlier || !mayOverlap) {
+				nodes[j].successors.push_back((unsigned int)nodes.size());
+				newNode.numPredecessors++;
+			}
+		}
+
+		nodes.push_back(newNode);
+	}
+
+	_moduleFrameStagesNeedRebuild = false;
+}
+
+unsigned int SimulationEngine::_updateAgentsInParallel(float currentSimulationTime, float simulationDt, unsigned int currentFrameNumber)
+{
+	// Agents update the spatial database from inside updateAI() and commitAI().  While the workers run, those
+	// updates are only recorded, so every agent queries the same database contents from the previous frame.
+	// Afterwards the updates are applied in agent order, which keeps the database identical to what it would be
+	// regardless of how the work was split among threads.
+	_spatialDatabase->beginDeferredUpdates();
+
+	const std::vector<SteerLib::AgentInterface*> & agents = _agentRegistry.getAgents();
+	if (_numTwoPhaseAgents != 0) {
+		_agentStateSnapshot.capture(agents);
+	}
+
+	// the active list is compacted before the workers start, so that they only see agents that are enabled.
+	_rebuildActiveAgentsIfNeeded();
+	unsigned int numActiveAgents = 0;
+	for (unsigned int i=0; i < _activeAgents.size(); i++) {
+		if (_activeAgents[i]->enabled()) {
+			_activeAgents[numActiveAgents++] = _activeAgents[i];
+		}
+		else {
+			_deactivateAgent(_activeAgents[i]);
+		}
+	}
+	_activeAgents.resize(numActiveAgents);
+
+	_runAgentPhaseInParallel(AGENT_PHASE_UPDATE_OR_DECIDE, currentSimulationTime, simulationDt, currentFrameNumber);
+
+	if (_numTwoPhaseAgents != 0) {
+		_runAgentPhaseInParallel(AGENT_PHASE_COMMIT, currentSimulationTime, simulationDt, currentFrameNumber);
+	}
+
+	// agents that were inactive during the whole frame did not record any updates.
+	_spatialDatabase->commitDeferredUpdates(_activeAgents);
+	_spatialDatabase->endDeferredUpdates();
+
+	return _numFinishedAgents;
+}
+
+void SimulationEngine::_runAgentPhaseInParallel(unsigned int phase, float currentSimulationTime, float simulationDt, unsigned int currentFrameNumber)
+{
+	const std::vector<SteerLib::AgentInterface*> & agents = _activeAgents;
+
+	_taskScheduler->parallelFor(0, (unsigned int)agents.size(), 0, [&](unsigned int threadIndex, unsigned int begin, unsigned int end) {
+		if (phase == AGENT_PHASE_COMMIT) {
+			for (unsigned int i = begin; i < end; i++) {
+				if (agents[i]->enabled() && agents[i]->usesTwoPhaseUpdate()) {
+					agents[i]->commitAI(currentSimulationTime, simulationDt, currentFrameNumber);
+				}
+			}
+			return;
+		}
+
+		// all active agents were enabled when the phase started.
+		for (unsigned int i = begin; i < end; i++) {
+			if (agents[i]->usesTwoPhaseUpdate())
+				agents[i]->decideAI(currentSimulationTime, simulationDt, currentFrameNumber);
+			else
+				agents[i]->updateAI(currentSimulationTime, simulationDt, currentFrameNumber);
+		}
+	});
+}
+
+void SimulationEngine::_rebuildActiveAgentsIfNeeded()
+{
+	// finished() of a disabled agent may still change (e.g. ShadowAI), and a module may enable it again,
+	// so the inactive agents are checked every frame, like all agents were before they were skipped.
+	_numFinishedAgents = 0;
+	for (unsigned int i=0; (i < _inactiveAgents.size()) && !_activeAgentsNeedRebuild; i++) {
+		if (_inactiveAgents[i]->enabled()) {
+			_activeAgentsNeedRebuild = true;
+		}
+		else if (_inactiveAgents[i]->finished()) {
+			_numFinishedAgents++;
+		}
+	}
+
+	if (!_activeAgentsNeedRebuild) {
+		return;
+	}
+
+	// every agent starts out active; the ones that are disabled are dropped the first time they are visited.
+	const std::vector<SteerLib::AgentInterface*> & agents = _agentRegistry.getAgents();
+	_activeAgents.assign(agents.begin(), agents.end());
+	_inactiveAgents.clear();
+	_numFinishedAgents = 0;
+	_activeAgentsNeedRebuild = false;
+}
+
+
 //========================================
 
 #ifdef ENABLE_GUI
@@ -500,8 +1074,9 @@ void SimulationEngine::_drawObstacles()
 #ifdef ENABLE_GUI
 void SimulationEngine::_drawAgents()
 {
-	std::vector<SteerLib::AgentInterface*>::iterator agentIterator;
-	for ( agentIterator = _agents.begin(); agentIterator != _agents.end(); ++agentIterator ) {
+	const std::vector<SteerLib::AgentInterface*> & agents = _agentRegistry.getAgents();
+	std::vector<SteerLib::AgentInterface*>::const_iterator agentIterator;
+	for ( agentIterator = agents.begin(); agentIterator != agents.end(); ++agentIterator ) {
 		if ((*agentIterator)->enabled()){
 			(*agentIterator)->draw();
 		}
@@ -759,6 +1334,8 @@ SteerLib::ModuleMetaInformation * SimulationEngine::_loadModule(const std::strin
 	// if all went well up to this point, the module and its dependencies is loaded, so add it to the end of the list of modules
 	// (i.e. it executes after all its dependencies) and return!
 	_modulesInExecutionOrder.push_back(newModule);
+	_moduleFrameStagesNeedRebuild = true;
+	newMetaInfo->randomStream = _randomStreams.split(RANDOM_STREAMS_OF_MODULES).split(newMetaInfo->moduleName);
 	std::cout << "loaded module " << newMetaInfo->moduleName << "\n";
 
 	return newMetaInfo;
@@ -811,6 +1388,7 @@ bool SimulationEngine::_unloadModule( SteerLib::ModuleInterface * moduleToDestro
 	std::vector<SteerLib::ModuleInterface*>::iterator moduleExecIter = _modulesInExecutionOrder.begin();
 	while ((*moduleExecIter) != moduleToDestroy) { ++moduleExecIter; }
 	_modulesInExecutionOrder.erase(moduleExecIter);
+	_moduleFrameStagesNeedRebuild = true;
 	std::set<std::string>::iterator conflictsIter;
 	for (conflictsIter = moduleMetaInfoToDestroy->conflicts.begin(); conflictsIter != moduleMetaInfoToDestroy->conflicts.end(); ++conflictsIter) {
 		_moduleConflicts.erase(*conflictsIter);
@@ -939,9 +1517,18 @@ SteerLib::AgentInterface * SimulationEngine::createAgent(const SteerLib::AgentIn
 	SteerLib::AgentInterface * newAgent = owner->createAgent();
 
 	if (newAgent != NULL) {
-		newAgent->reset(initialConditions,this);
-		_agents.push_back(newAgent);
-		_agentOwners[newAgent] = owner;
+		// the agent is registered before reset(), so that reset() can already draw from the agent's random stream.
+		_agentRegistry.add(newAgent, owner);
+		_deriveAgentRandomStream(newAgent);
+		try {
+			newAgent->reset(initialConditions,this);
+		}
+		catch (...) {
+			_agentRegistry.remove(newAgent);
+			throw;
+		}
+		_countTwoPhaseAgent(newAgent, true);
+		_activeAgentsNeedRebuild = true;
 	}
 
 	return newAgent;
@@ -951,41 +1538,21 @@ SteerLib::AgentInterface * SimulationEngine::createAgent(const SteerLib::AgentIn
 
 void SimulationEngine::destroyAgent(SteerLib::AgentInterface * agentToDestroy)
 {
-	/// @todo
-	///   - this removal method is not entirely robust, and makes un-wise assumptions
-	///     fix it after changing _agents data type from std::vector to std::set
 	if (agentToDestroy != NULL)
 	{
-
 		// find the module that owns this agent; this also implicitly makes sure agent actually was known to the engine.
-		SteerLib::ModuleInterface * module =  NULL;
-		std::map<SteerLib::AgentInterface*, SteerLib::ModuleInterface*>::iterator moduleIter;
-		moduleIter = _agentOwners.find(agentToDestroy);
-		if (moduleIter == _agentOwners.end())
+		SteerLib::ModuleInterface * module = _agentRegistry.getOwner(agentToDestroy);
+		if (module == NULL)
 		{
 			throw GenericException("Cannot destroy agent because the engine did not have a record of the agent.  Are you sure you used SimulationEngine::createAgent() or SimulationEngine::addAgent()?");
 		}
-		else {
-			module = (*moduleIter).second;
-		}
-
-		// remove the agent from the list of _agents
-		// this is unnecessarily costly because we use std::vector, and we must iterate through the entire list to find it
-		// but for now it seems like an acceptable trade-off because this is not in a performace-critical place, and 
-		// the ability to index into _agents is important in some other places.
-		std::vector<SteerLib::AgentInterface*>::iterator agentIter;
-		agentIter = std::find( _agents.begin(), _agents.end(), agentToDestroy);
-		// if this assertion happens, we have a bug, since we expected that the agent will be in both _agentOwners and _agents.
-		assert(agentIter != _agents.end());
-
-		// the swap-n-pop method avoids a linear-time cost for removing something in the array
-		// but does not preserve the order of agents.
-		swap((*agentIter), _agents.back());
-		_agents.pop_back();
 
-
-		// remove the agent from the list of owners
-		_agentOwners.erase(agentToDestroy);
+		// the registry removes the agent in constant time, moving the last agent into its place;
+		// this does not preserve the order of agents.
+		_agentRegistry.remove(agentToDestroy);
+		_countTwoPhaseAgent(agentToDestroy, false);
+		_activeAgentsNeedRebuild = true;
+		_deferredWork.cancel(agentToDestroy);
 
 		// destroy the agent
 		module->destroyAgent(agentToDestroy);
@@ -996,21 +1563,22 @@ void SimulationEngine::destroyAgent(SteerLib::AgentInterface * agentToDestroy)
 
 void SimulationEngine::destroyAllAgentsFromModule(SteerLib::ModuleInterface * owner)
 {
-	/// @todo: there may be a better way to implement this?
-	// 0x9d97330
+	// the agents are destroyed from the end of the list of all agents towards the front, so that
+	// the remaining agents end up in the same order as if the whole list had been searched backwards.
+	std::vector< std::pair<unsigned int, SteerLib::AgentInterface*> > agentsToDestroy;
+	const std::vector<SteerLib::AgentInterface*> & ownerAgents = _agentRegistry.getAgentsOfOwner(owner);
+	for (unsigned int i=0; i < ownerAgents.size(); i++) {
+		agentsToDestroy.push_back(std::make_pair(_agentRegistry.getDenseIndex(ownerAgents[i]), ownerAgents[i]));
+	}
+	std::sort(agentsToDestroy.begin(), agentsToDestroy.end());
+
 #ifdef _DEBUG
 	std::cout << "about to destroyAllAgents and ModuleInterface is " << owner << "\n";
-	std::cout << "agents.size() = " << _agents.size() << "\n";
+	std::cout << "agents.size() = " << _agentRegistry.size() << ", destroying " << agentsToDestroy.size() << "\n";
 #endif
-	for (int i = _agents.size()-1; i >= 0; i--)
+	for (unsigned int i=(unsigned int)agentsToDestroy.size(); i > 0; i--)
 	{
-		if (_agentOwners[_agents[i]] == owner)
-		{
-#ifdef _DEBUG
-	std::cout << "Destroying agent\n";
-#endif
-			destroyAgent(_agents[i]);
-		}
+		destroyAgent(agentsToDestroy[i-1].second);
 	}
 }
 
@@ -1018,32 +1586,72 @@ void SimulationEngine::destroyAllAgentsFromModule(SteerLib::ModuleInterface * ow
 
 void SimulationEngine::addAgent(SteerLib::AgentInterface * newAgent, SteerLib::ModuleInterface * owner)
 {
-	// make sure the agent does not already exist in the engine's data structures.
-	if (_agentOwners.find(newAgent) != _agentOwners.end()) {
-		throw GenericException("Cannot add agent, agent already exists.\n");
+	// throws if the agent already exists in the engine's data structures.
+	_agentRegistry.add(newAgent, owner);
+	_deriveAgentRandomStream(newAgent);
+	_countTwoPhaseAgent(newAgent, true);
+	_activeAgentsNeedRebuild = true;
+}
+
+//========================================
+
+void SimulationEngine::setRandomSeed(unsigned int seed)
+{
+	_spatialDatabase->seedRandomNumberGenerator(seed);
+	_randomSeed = seed;
+	_deriveRandomStreams();
+}
+
+void SimulationEngine::_deriveRandomStreams()
+{
+	_randomStreams = RandomStream(_randomSeed);
+	std::map<SteerLib::ModuleInterface*, SteerLib::ModuleMetaInformation*>::iterator moduleIter;
+	for (moduleIter = _moduleMetaInfoByReference.begin(); moduleIter != _moduleMetaInfoByReference.end(); ++moduleIter) {
+		moduleIter->second->randomStream = _randomStreams.split(RANDOM_STREAMS_OF_MODULES).split(moduleIter->second->moduleName);
+	}
+	const std::vector<SteerLib::AgentInterface*> & agents = _agentRegistry.getAgents();
+	for (unsigned int i=0; i < agents.size(); i++) {
+		_deriveAgentRandomStream(agents[i]);
 	}
+}
 
-	_agents.push_back(newAgent);
-	_agentOwners[newAgent] = owner;
+Util::FrameArena & SimulationEngine::getFrameArena()
+{
+	if (_frameArenas.empty()) {
+		throw GenericException("SimulationEngine::getFrameArena() - the engine is not initialized.");
+	}
+	return *_frameArenas[getIndexOfCurrentThread()];
+}
+
+void SimulationEngine::_resetFrameArenas(unsigned long long & numAllocations, unsigned long long & numBytes)
+{
+	numAllocations = 0;
+	numBytes = 0;
+	for (unsigned int i=0; i < _frameArenas.size(); i++) {
+		numAllocations += _frameArenas[i]->getNumAllocations();
+		numBytes += _frameArenas[i]->getNumBytesAllocated();
+		_frameArenas[i]->reset();
+	}
+}
+
+void SimulationEngine::_deriveAgentRandomStream(SteerLib::AgentInterface * agent)
+{
+	_agentRegistry.getRandomStream(agent) = _randomStreams.split(RANDOM_STREAMS_OF_AGENTS).split(_agentRegistry.getSerialNumber(agent));
 }
 
 //========================================
 
 void SimulationEngine::removeAgent(SteerLib::AgentInterface * agentToRemove)
 {
-	std::vector<SteerLib::AgentInterface*>::iterator agentIter;
-	agentIter = std::find( _agents.begin(), _agents.end(), agentToRemove);
-	if (agentIter == _agents.end()) {
+	if (!_agentRegistry.contains(agentToRemove)) {
 		throw GenericException("Cannot remove agent because the engine did not have a record of the agent.  Are you sure you used SimulationEngine::createAgent() or SimulationEngine::addAgent()?");
 	}
 
-	// the swap-n-pop method avoids a linear-time cost for removing something in the array
-	// but does not preserve the order of agents.
-	swap((*agentIter), _agents.back());
-	_agents.pop_back();
-
-	// remove the agent from the list of owners
-	_agentOwners.erase(agentToRemove);
+	// like destroyAgent(), this does not preserve the order of agents.
+	_agentRegistry.remove(agentToRemove);
+	_countTwoPhaseAgent(agentToRemove, false);
+	_activeAgentsNeedRebuild = true;
+	_deferredWork.cancel(agentToRemove);
 }
 
 /*
@@ -84,3 +84,23 @@ void SimulationMetricsCollector::printCurrentMetrics(unsigned int agentIndex, st
 	_agentCollectors[agentIndex]->printFormattedOverallStatistics(out);
 	_agentCollectors[agentIndex]->printFormattedCurrentStatistics(out);
 }
+
+void SimulationMetricsCollector::writeCheckpoint(CheckpointWriter & out)
+{
+	out.write((unsigned int)_agentCollectors.size());
+	for (unsigned int i=0; i < _agentCollectors.size(); i++) {
+		_agentCollectors[i]->writeCheckpoint(out);
+	}
+}
+
+void SimulationMetricsCollector::readCheckpoint(CheckpointReader & in)
+{
+	unsigned int numAgents;
+	in.read(numAgents);
+	if (numAgents != _agentCollectors.size()) {
+		throw GenericException("The checkpoint has metrics of " + toString(numAgents) + " agents, but the current simulation measures " + toString(_agentCollectors.size()) + ".");
+	}
+	for (unsigned int i=0; i < _agentCollectors.size(); i++) {
+		_agentCollectors[i]->readCheckpoint(in);
+	}
+}
@@ -148,6 +148,13 @@ using namespace Util;
 #define DEFAULT_MIN_VARIABLE_DT 0.001f
 #define DEFAULT_MAX_VARIABLE_DT 0.2f
 #define DEFAULT_CLOCK_MODE "fixed-fast"
+#define DEFAULT_MAX_DEFERRED_FRAMES 10
+#define DEFAULT_TELEMETRY_FRAMES 0
+#define DEFAULT_TELEMETRY_FILENAME ""
+#define DEFAULT_CHECKPOINT_FILENAME ""
+#define DEFAULT_CHECKPOINT_FRAME 0
+#define DEFAULT_RESTORE_CHECKPOINT_FILENAME ""
+#define DEFAULT_RANDOM_SEED 0
 
 //====================================
 // GRID DATABASE DEFAULTS
@@ -158,6 +165,8 @@ using namespace Util;
 #define DEFAULT_NUM_GRID_CELLS_X 200
 #define DEFAULT_NUM_GRID_CELLS_Z 200
 #define DEFAULT_DRAW_GRID true
+#define DEFAULT_REBUILD_AGENT_LAYER false
+#define DEFAULT_MORTON_CELL_ORDER false
 
 //====================================
 // GLFW ENGINE DRIVER DEFAULTS
@@ -171,6 +180,15 @@ using namespace Util;
 #define DEFAULT_FULLSCREEN false
 #define DEFAULT_STEREO_MODE "off"
 
+//====================================
+// BATCH ENGINE DRIVER DEFAULTS
+//====================================
+#define DEFAULT_BATCH_MANIFEST_FILENAME ""
+#define DEFAULT_BATCH_RESULTS_FILENAME "batch-results.csv"
+#define DEFAULT_BATCH_NUM_THREADS 1
+#define DEFAULT_BATCH_FORK_FRAME 0
+#define DEFAULT_BATCH_REUSE_ENGINES true
+
 //====================================
 // BUILT-IN MODULES DEFAULTS
 //====================================
@@ -233,6 +251,13 @@ SimulationOptions::SimulationOptions()
 	engineOptions.minVariableDt = DEFAULT_MIN_VARIABLE_DT;
 	engineOptions.maxVariableDt = DEFAULT_MAX_VARIABLE_DT;
 	engineOptions.clockMode = DEFAULT_CLOCK_MODE;
+	engineOptions.maxDeferredFrames = DEFAULT_MAX_DEFERRED_FRAMES;
+	engineOptions.telemetryFrames = DEFAULT_TELEMETRY_FRAMES;
+	engineOptions.telemetryFilename = DEFAULT_TELEMETRY_FILENAME;
+	engineOptions.checkpointFilename = DEFAULT_CHECKPOINT_FILENAME;
+	engineOptions.checkpointFrame = DEFAULT_CHECKPOINT_FRAME;
+	engineOptions.restoreCheckpointFilename = DEFAULT_RESTORE_CHECKPOINT_FILENAME;
+	engineOptions.randomSeed = DEFAULT_RANDOM_SEED;
 
 	// grid database options
 	gridDatabaseOptions.maxItemsPerGridCell = DEFAULT_MAX_ITEMS_PER_GRID_CELL;
@@ -241,6 +266,8 @@ SimulationOptions::SimulationOptions()
 	gridDatabaseOptions.numGridCellsX = DEFAULT_NUM_GRID_CELLS_X;
 	gridDatabaseOptions.numGridCellsZ = DEFAULT_NUM_GRID_CELLS_Z;
 	gridDatabaseOptions.drawGrid = DEFAULT_DRAW_GRID;
+	gridDatabaseOptions.rebuildAgentLayer = DEFAULT_REBUILD_AGENT_LAYER;
+	gridDatabaseOptions.mortonCellOrder = DEFAULT_MORTON_CELL_ORDER;
 
 	// GUI options
 	guiOptions.useAntialiasing = DEFAULT_ANTIALIASING;
@@ -268,6 +295,13 @@ SimulationOptions::SimulationOptions()
 	glfwEngineDriverOptions.fullscreen = DEFAULT_FULLSCREEN;
 	glfwEngineDriverOptions.stereoMode = DEFAULT_STEREO_MODE;
 
+	// batch engine driver options
+	batchEngineDriverOptions.manifestFilename = DEFAULT_BATCH_MANIFEST_FILENAME;
+	batchEngineDriverOptions.resultsFilename = DEFAULT_BATCH_RESULTS_FILENAME;
+	batchEngineDriverOptions.numThreads = DEFAULT_BATCH_NUM_THREADS;
+	batchEngineDriverOptions.forkFrame = DEFAULT_BATCH_FORK_FRAME;
+	batchEngineDriverOptions.reuseEngines = DEFAULT_BATCH_REUSE_ENGINES;
+
 	//
 	// module options
 	// for each module, initialize its module options, and insert that into the module options database.
@@ -407,6 +441,7 @@ void SimulationOptions::_setupXMLStructure( Util::XMLParser & xmlOpts )
 	engineDriversTag->createChildTag("commandLine", "Options for the command-line engine driver (currently there are no options for the command-line)");
 	XMLTag * glfwEngineDriverTag = engineDriversTag->createChildTag("glfw", "Options for the GLFW engine driver");
 	engineDriversTag->createChildTag("qt", "Options for the Qt engine driver (config for qt not implemented yet!)");
+	XMLTag * batchEngineDriverTag = engineDriversTag->createChildTag("batch", "Options for the batch engine driver, which runs many jobs in one process");
 
 	// GUI options
 	guiTag->createChildTag("useAntialiasing", "Set to \"true\" to remove jaggies, for smoother-looking visuals, but lower performance", XML_DATA_TYPE_BOOLEAN, &guiOptions.useAntialiasing);
@@ -440,14 +475,23 @@ void SimulationOptions::_setupXMLStructure( Util::XMLParser & xmlOpts )
 	engineTag->createChildTag("minVariableDt", "The minimum time-step allowed when the clock is in \"variable-real-time\" mode.  If the proposed time-step is smaller, this value will be used instead, effectively limiting the max frame rate.", XML_DATA_TYPE_FLOAT, &engineOptions.minVariableDt);
 	engineTag->createChildTag("maxVariableDt", "The maximum time-step allowed when the clock is in \"variable-real-time\" mode.  If the proposed time-step is larger, this value will be used instead, at the expense of breaking synchronization between simulation time and real-time.", XML_DATA_TYPE_FLOAT, &engineOptions.maxVariableDt);
 	engineTag->createChildTag("clockMode", "can be either \"fixed-fast\" (fixed simulation frame rate, running as fast as possible), \"fixed-real-time\" (fixed simulation frame rate, running in real-time), or \"variable-real-time\" (variable simulation frame rate in real-time).", XML_DATA_TYPE_STRING, &engineOptions.clockMode);
+	engineTag->createChildTag("maxDeferredFrames", "In the real-time clock modes, agents may defer work such as re-planning to the spare time at the end of a frame.  Work that waited this many frames runs even if the frame is already late.", XML_DATA_TYPE_UNSIGNED_INT, &engineOptions.maxDeferredFrames);
+	engineTag->createChildTag("telemetryFrames", "If not 0, the engine records how long each phase of a frame takes, keeping this many of the most recent frames.", XML_DATA_TYPE_UNSIGNED_INT, &engineOptions.telemetryFrames);
+	engineTag->createChildTag("telemetryFile", "The file the frame telemetry is written to at the end of the simulation; CSV if the name ends in \".csv\", and a binary format otherwise.", XML_DATA_TYPE_STRING, &engineOptions.telemetryFilename);
+	engineTag->createChildTag("checkpointFile", "If a filename is specified, the complete state of the simulation is saved to this binary checkpoint file after frame checkpointFrame.", XML_DATA_TYPE_STRING, &engineOptions.checkpointFilename);
+	engineTag->createChildTag("checkpointFrame", "The frame after which the checkpoint is saved - 0 means after the last frame of the simulation.", XML_DATA_TYPE_UNSIGNED_INT, &engineOptions.checkpointFrame);
+	engineTag->createChildTag("restoreCheckpointFile", "If a filename is specified, the simulation continues from this checkpoint instead of from the start of the test case.  The same modules and test case must be used as when the checkpoint was saved.", XML_DATA_TYPE_STRING, &engineOptions.restoreCheckpointFilename);
+	engineTag->createChildTag("randomSeed", "Seeds the random number generator of the spatial database, which agents use for random targets - 0 means use the default seed.", XML_DATA_TYPE_UNSIGNED_INT, &engineOptions.randomSeed);
 
 	// grid database options
-	gridDatabaseTag->createChildTag("maxItemsPerGridCell", "Max number of items a grid cell can contain", XML_DATA_TYPE_UNSIGNED_INT, &gridDatabaseOptions.maxItemsPerGridCell);
+	gridDatabaseTag->createChildTag("maxItemsPerGridCell", "Number of items a grid cell can contain without allocating more memory", XML_DATA_TYPE_UNSIGNED_INT, &gridDatabaseOptions.maxItemsPerGridCell);
 	gridDatabaseTag->createChildTag("sizeX", "Total size of the grid along the X axis", XML_DATA_TYPE_FLOAT, &gridDatabaseOptions.gridSizeX);
 	gridDatabaseTag->createChildTag("sizeZ", "Total size of the grid along the Z axis", XML_DATA_TYPE_FLOAT, &gridDatabaseOptions.gridSizeZ);
 	gridDatabaseTag->createChildTag("numCellsX", "Number of cells in the grid along the X axis", XML_DATA_TYPE_UNSIGNED_INT, &gridDatabaseOptions.numGridCellsX);
 	gridDatabaseTag->createChildTag("numCellsZ", "Number of cells in the grid along the Z axis", XML_DATA_TYPE_UNSIGNED_INT, &gridDatabaseOptions.numGridCellsZ);
 	gridDatabaseTag->createChildTag("draw", "Draws the grid if \"true\".", XML_DATA_TYPE_BOOLEAN, &gridDatabaseOptions.drawGrid);
+	gridDatabaseTag->createChildTag("rebuildAgentLayer", "If \"true\", the grid cells of agents are sorted again from scratch every frame instead of updated agent by agent, which is faster for very dense crowds.  Agents then always see each other where they were at the start of the frame, even with one thread.", XML_DATA_TYPE_BOOLEAN, &gridDatabaseOptions.rebuildAgentLayer);
+	gridDatabaseTag->createChildTag("mortonCellOrder", "If \"true\", grid cells are numbered and stored in Z-order (Morton order) instead of row by row, which keeps nearby cells closer in memory on large grids.", XML_DATA_TYPE_BOOLEAN, &gridDatabaseOptions.mortonCellOrder);
 
 	// GLFW engine driver options
 	glfwEngineDriverTag->createChildTag("startWithClockPaused", "Starts the clock paused if \"true\".", XML_DATA_TYPE_BOOLEAN, &glfwEngineDriverOptions.pausedOnStart);
@@ -458,6 +502,13 @@ void SimulationOptions::_setupXMLStructure( Util::XMLParser & xmlOpts )
 	glfwEngineDriverTag->createChildTag("windowTitle", "Title of the openGL window", XML_DATA_TYPE_STRING, &glfwEngineDriverOptions.windowTitle);
 	glfwEngineDriverTag->createChildTag("fullscreen", "Uses fullscreen (rather than windowed) mode if \"true\".", XML_DATA_TYPE_BOOLEAN, &glfwEngineDriverOptions.fullscreen);
 	glfwEngineDriverTag->createChildTag("stereoMode", "The stereoscopic mode. Can be one of \"off\", \"side-by-side\", \"top-and-bottom\", or \"quadbuffer\".", XML_DATA_TYPE_STRING, &glfwEngineDriverOptions.stereoMode);
+
+	// batch engine driver options
+	batchEngineDriverTag->createChildTag("manifest", "The file listing the jobs to run; each line is a test case, an AI module, and optionally more steersim command-line options for that job.", XML_DATA_TYPE_STRING, &batchEngineDriverOptions.manifestFilename);
+	batchEngineDriverTag->createChildTag("results", "The file that results of all jobs are written to; the format is JSON if the name ends in \".json\", and CSV otherwise.", XML_DATA_TYPE_STRING, &batchEngineDriverOptions.resultsFilename);
+	batchEngineDriverTag->createChildTag("numThreads", "The number of jobs to run at the same time; each job has its own engine, which may use its own threads as well.", XML_DATA_TYPE_UNSIGNED_INT, &batchEngineDriverOptions.numThreads);
+	batchEngineDriverTag->createChildTag("forkFrame", "If not 0, all jobs must use the same test case and AI module; the first forkFrame frames are simulated only once, and every job continues from an in-memory checkpoint of that frame with its own options.", XML_DATA_TYPE_UNSIGNED_INT, &batchEngineDriverOptions.forkFrame);
+	batchEngineDriverTag->createChildTag("reuseEngines", "If \"true\", a job that uses the same AI module and options as the previous job on its thread runs in that job's engine, keeping its modules, spatial database and pooled agents, instead of building a new engine.", XML_DATA_TYPE_BOOLEAN, &batchEngineDriverOptions.reuseEngines);
 }
 
 
@@ -138,3 +138,21 @@ void SimulationRecorderModule::postprocessSimulation() {
 	delete _simulationWriter;
 }
 
+
+void SimulationRecorderModule::writeCheckpoint(SteerLib::CheckpointWriter & out) {
+
+	out.write(_initialized);
+	if (_initialized) _simulationWriter->writeCheckpoint(out);
+
+}
+
+void SimulationRecorderModule::readCheckpoint(SteerLib::CheckpointReader & in) {
+
+	bool wasRecording;
+	in.read(wasRecording);
+	if (wasRecording != _initialized) {
+		throw Util::GenericException("The simulationRecorder module can only restore a checkpoint saved while it was in the same state (recording or not).");
+	}
+	if (_initialized) _simulationWriter->readCheckpoint(in);
+
+}
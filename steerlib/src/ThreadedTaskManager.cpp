@@ -129,7 +129,11 @@ void ThreadedTaskManager::waitForAllTasksToComplete()
 
 void ThreadedTaskManager::_runWorkerThread() throw()
 {
+	// the creating thread holds the lock until all threads are in _threads, so wait for it before searching the list.
+	_lock();
 	unsigned int threadIndex = _getIndexOfCurrentWorkerThread();
+	_unlock();
+
 	while(true) {
 
 		// acquire the lock
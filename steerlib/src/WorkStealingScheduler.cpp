@@ -0,0 +1,463 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+/// @file WorkStealingScheduler.cpp
+/// @brief Implements Util::WorkStealingScheduler and Util::TaskGroup.
+
+#include <algorithm>
+#include "util/WorkStealingScheduler.h"
+#include "util/GenericException.h"
+
+using namespace Util;
+
+// identifies the scheduler and index of a worker thread, so that tasks queued from inside a task go to that thread's own deque.
+static thread_local const WorkStealingScheduler * currentScheduler = NULL;
+static thread_local unsigned int currentThreadIndex = 0;
+
+const unsigned int WorkStealingScheduler::MAX_UNPUBLISHED_TASKS;
+const unsigned int WorkStealingScheduler::MAX_STOLEN_TASKS;
+
+
+//========================================
+
+TaskGroup::TaskGroup(WorkStealingScheduler & scheduler) : _scheduler(scheduler)
+{
+	_numPendingTasks = 0;
+}
+
+TaskGroup::~TaskGroup()
+{
+	// tasks still refer to this group, so it cannot go away before they are done.
+	_scheduler._waitForGroup(*this);
+}
+
+void TaskGroup::run(const TaskFunction & task)
+{
+	WorkStealingScheduler::QueuedTask newTask;
+	newTask.function = task;
+	newTask.addedTask.function = NULL;
+	newTask.rangeBody = NULL;
+	newTask.begin = 0;
+	newTask.end = 0;
+	newTask.grainSize = 0;
+	newTask.group = this;
+
+	_numPendingTasks++;
+	_scheduler._pushTask(_scheduler._getIndexOfCurrentThread(), newTask, true);
+}
+
+void TaskGroup::wait()
+{
+	_scheduler._waitForGroup(*this);
+
+	_exceptionMutex.lock();
+	std::exception_ptr exception = _exception;
+	_exception = std::exception_ptr();
+	_exceptionMutex.unlock();
+
+	if (exception) {
+		std::rethrow_exception(exception);
+	}
+}
+
+
+//========================================
+
+WorkStealingScheduler::WorkStealingScheduler(unsigned int numThreads)
+{
+	if (numThreads == 0) {
+		throw GenericException("Cannot initialize WorkStealingScheduler with zero threads.");
+	}
+
+	_numThreads = numThreads;
+	_numQueuedTasks = 0;
+	_numSleepingThreads = 0;
+	_shuttingDown = false;
+	_deques = new TaskDeque[_numThreads];
+	for (unsigned int i=0; i < _numThreads; i++) {
+		_deques[i].numTasks = 0;
+		_deques[i].stolenTasks.reserve(MAX_STOLEN_TASKS);
+	}
+	_unpublishedTasks.reserve(MAX_UNPUBLISHED_TASKS);
+	_addedTasks = new TaskGroup(*this);
+
+	// thread index 0 is the waiting thread, so only the others need to be created.
+	try {
+		for (unsigned int i=1; i < _numThreads; i++) {
+			_threads.push_back(std::thread(&WorkStealingScheduler::_runWorkerThread, this, i));
+		}
+	}
+	catch (std::exception &e) {
+		_shuttingDown = true;
+		_wakeUpSleepingThreads();
+		for (unsigned int i=0; i < _threads.size(); i++) {
+			_threads[i].join();
+		}
+		delete _addedTasks;
+		delete [] _deques;
+		throw GenericException(std::string("Could not create the worker threads of WorkStealingScheduler: ") + e.what());
+	}
+}
+
+WorkStealingScheduler::~WorkStealingScheduler()
+{
+	try {
+		_publishTasks(true);
+	}
+	catch (...) {
+		// the tasks that could not be queued were dropped from their group, so waiting below still ends.
+	}
+	_waitForGroup(*_addedTasks);
+
+	_shuttingDown = true;
+	{
+		std::lock_guard<std::mutex> sleepLock(_sleepMutex);
+		_wakeUpCondition.notify_all();
+	}
+
+	for (unsigned int i=0; i < _threads.size(); i++) {
+		_threads[i].join();
+	}
+
+	delete _addedTasks;
+	delete [] _deques;
+}
+
+
+void WorkStealingScheduler::parallelFor(unsigned int begin, unsigned int end, unsigned int grainSize, const RangeFunction & body)
+{
+	if (begin >= end) {
+		return;
+	}
+
+	unsigned int threadIndex = _getIndexOfCurrentThread();
+
+	if (grainSize == 0) {
+		// several pieces per thread, so that threads finishing early can steal the rest.
+		grainSize = std::max(1u, (end - begin) / (8 * _numThreads));
+	}
+
+	if ((_numThreads == 1) || (end - begin <= grainSize)) {
+		body(threadIndex, begin, end);
+		return;
+	}
+
+	TaskGroup group(*this);
+	_runRange(threadIndex, body, begin, end, grainSize, &group);
+	group.wait();
+}
+
+
+void WorkStealingScheduler::addTask(const Task & newTask, bool broadcastToSleepingWorkerThreads)
+{
+	QueuedTask task;
+	task.addedTask = newTask;
+	task.rangeBody = NULL;
+	task.begin = 0;
+	task.end = 0;
+	task.grainSize = 0;
+	task.group = _addedTasks;
+
+	_addedTasks->_numPendingTasks++;
+
+	unsigned int threadIndex = _getIndexOfCurrentThread();
+	if (threadIndex != 0) {
+		_pushTask(threadIndex, task, broadcastToSleepingWorkerThreads);
+		return;
+	}
+
+	// outside the pool, tasks are collected without any lock, and queued together.
+	try {
+		_unpublishedTasks.push_back(task);
+	}
+	catch (...) {
+		_addedTasks->_numPendingTasks--;
+		throw;
+	}
+	if (broadcastToSleepingWorkerThreads || (_unpublishedTasks.size() >= MAX_UNPUBLISHED_TASKS)) {
+		_publishTasks(broadcastToSleepingWorkerThreads);
+	}
+}
+
+void WorkStealingScheduler::wakeUpAllSleepingWorkerThreads() throw()
+{
+	if (_getIndexOfCurrentThread() == 0) {
+		try {
+			_publishTasks(false);
+		}
+		catch (...) {
+			// the tasks that could not be queued were dropped from their group, and there is no way to report it here.
+		}
+	}
+	_wakeUpSleepingThreads();
+}
+
+void WorkStealingScheduler::waitForAllTasksToComplete()
+{
+	_addedTasks->wait();
+}
+
+
+//========================================
+
+void WorkStealingScheduler::_runWorkerThread(unsigned int threadIndex)
+{
+	currentScheduler = this;
+	currentThreadIndex = threadIndex;
+
+	while (true) {
+		QueuedTask task;
+		if (_popOrStealTask(threadIndex, task)) {
+			_runTask(threadIndex, task);
+			continue;
+		}
+
+		// nothing to run or steal; sleep until something is queued.
+		std::unique_lock<std::mutex> sleepLock(_sleepMutex);
+		_numSleepingThreads++;
+		while ((_numQueuedTasks == 0) && (!_shuttingDown)) {
+			_wakeUpCondition.wait(sleepLock);
+		}
+		_numSleepingThreads--;
+
+		if (_shuttingDown && (_numQueuedTasks == 0)) {
+			return;
+		}
+	}
+}
+
+unsigned int WorkStealingScheduler::_getIndexOfCurrentThread()
+{
+	return (currentScheduler == this) ? currentThreadIndex : 0;
+}
+
+void WorkStealingScheduler::_pushTask(unsigned int threadIndex, const QueuedTask & task, bool wakeUpSleepingThreads)
+{
+	// counted before it becomes visible, so the count never drops below the number of tasks in the deques.
+	_numQueuedTasks++;
+
+	TaskDeque & deque = _deques[threadIndex];
+	deque.lock.lock();
+	try {
+		deque.tasks.push_back(task);
+	}
+	catch (...) {
+		// rethrown as it is, so that e.g. std::bad_alloc is not sliced into a plain std::exception.
+		deque.lock.unlock();
+		_numQueuedTasks--;
+		task.group->_numPendingTasks--;
+		throw;
+	}
+	deque.numTasks.store((unsigned int)deque.tasks.size(), std::memory_order_relaxed);
+	deque.lock.unlock();
+
+	// one new task only needs one thread.
+	if (wakeUpSleepingThreads) {
+		_wakeUpOneSleepingThread();
+	}
+}
+
+void WorkStealingScheduler::_publishTasks(bool wakeUpSleepingThreads)
+{
+	unsigned int numTasks = (unsigned int)_unpublishedTasks.size();
+	if (numTasks == 0) {
+		return;
+	}
+
+	// counted before they become visible, so the count never drops below the number of tasks in the deques.
+	_numQueuedTasks += numTasks;
+
+	TaskDeque & deque = _deques[0];
+	deque.lock.lock();
+	try {
+		deque.tasks.insert(deque.tasks.end(), _unpublishedTasks.begin(), _unpublishedTasks.end());
+	}
+	catch (...) {
+		// inserting at the end of a deque either adds all tasks or none.
+		deque.lock.unlock();
+		_numQueuedTasks -= numTasks;
+		_addedTasks->_numPendingTasks -= numTasks;
+		_unpublishedTasks.clear();
+		throw;
+	}
+	deque.numTasks.store((unsigned int)deque.tasks.size(), std::memory_order_relaxed);
+	deque.lock.unlock();
+	_unpublishedTasks.clear();
+
+	if (wakeUpSleepingThreads) {
+		if (numTasks == 1) {
+			_wakeUpOneSleepingThread();
+		}
+		else {
+			_wakeUpSleepingThreads();
+		}
+	}
+}
+
+bool WorkStealingScheduler::_popOrStealTask(unsigned int threadIndex, QueuedTask & task)
+{
+	if (_numQueuedTasks == 0) {
+		return false;
+	}
+
+	// newest task from our own deque, which is most likely to still be in cache.
+	TaskDeque & ownDeque = _deques[threadIndex];
+	if (ownDeque.numTasks.load(std::memory_order_relaxed) != 0) {
+		ownDeque.lock.lock();
+		if (!ownDeque.tasks.empty()) {
+			task = std::move(ownDeque.tasks.back());
+			ownDeque.tasks.pop_back();
+			ownDeque.numTasks.store((unsigned int)ownDeque.tasks.size(), std::memory_order_relaxed);
+			ownDeque.lock.unlock();
+			_numQueuedTasks--;
+			return true;
+		}
+		ownDeque.lock.unlock();
+	}
+
+	// oldest task from another deque, which for a parallelFor() is the largest remaining piece.
+	for (unsigned int i=1; i < _numThreads; i++) {
+		TaskDeque & victim = _deques[(threadIndex + i) % _numThreads];
+		if (victim.numTasks.load(std::memory_order_relaxed) == 0) {
+			continue;
+		}
+
+		victim.lock.lock();
+		if (victim.tasks.empty()) {
+			victim.lock.unlock();
+			continue;
+		}
+		task = std::move(victim.tasks.front());
+		victim.tasks.pop_front();
+
+		// tasks from addTask() do not split like the pieces of a parallelFor(), so up to half of the ones
+		// at the front are taken along, instead of coming back to this lock for each of them.
+		std::vector<QueuedTask> & stolenTasks = ownDeque.stolenTasks;
+		if (task.group == _addedTasks) {
+			size_t numToSteal = victim.tasks.size() / 2;
+			while ((stolenTasks.size() < numToSteal) && (stolenTasks.size() + 1 < MAX_STOLEN_TASKS) && (victim.tasks.front().group == _addedTasks)) {
+				stolenTasks.push_back(std::move(victim.tasks.front()));
+				victim.tasks.pop_front();
+			}
+		}
+		victim.numTasks.store((unsigned int)victim.tasks.size(), std::memory_order_relaxed);
+		victim.lock.unlock();
+		_numQueuedTasks--;
+
+		if (!stolenTasks.empty()) {
+			// still counted in _numQueuedTasks, so no thread goes to sleep while they are moved.
+			ownDeque.lock.lock();
+			try {
+				ownDeque.tasks.insert(ownDeque.tasks.end(), stolenTasks.begin(), stolenTasks.end());
+				ownDeque.numTasks.store((unsigned int)ownDeque.tasks.size(), std::memory_order_relaxed);
+				ownDeque.lock.unlock();
+			}
+			catch (...) {
+				// the deque could not grow; the stolen tasks are run right here instead.
+				ownDeque.lock.unlock();
+				for (unsigned int j=0; j < stolenTasks.size(); j++) {
+					_numQueuedTasks--;
+					_runTask(threadIndex, stolenTasks[j]);
+				}
+			}
+			stolenTasks.clear();
+		}
+		return true;
+	}
+
+	return false;
+}
+
+void WorkStealingScheduler::_runTask(unsigned int threadIndex, QueuedTask & task)
+{
+	TaskGroup * group = task.group;
+
+	try {
+		if (task.rangeBody != NULL) {
+			_runRange(threadIndex, *task.rangeBody, task.begin, task.end, task.grainSize, group);
+		}
+		else if (task.addedTask.function != NULL) {
+			task.addedTask.function(threadIndex, task.addedTask.data);
+		}
+		else {
+			task.function(threadIndex);
+		}
+	}
+	catch (...) {
+		group->_exceptionMutex.lock();
+		if (!group->_exception) {
+			group->_exception = std::current_exception();
+		}
+		group->_exceptionMutex.unlock();
+	}
+
+	// the group may be destroyed as soon as the count reaches zero, so it cannot be used afterwards.
+	if (--(group->_numPendingTasks) == 0) {
+		_wakeUpSleepingThreads();
+	}
+}
+
+void WorkStealingScheduler::_runRange(unsigned int threadIndex, const RangeFunction & body, unsigned int begin, unsigned int end, unsigned int grainSize, TaskGroup * group)
+{
+	while (end - begin > grainSize) {
+		unsigned int middle = begin + (end - begin) / 2;
+
+		QueuedTask upperHalf;
+		upperHalf.addedTask.function = NULL;
+		upperHalf.rangeBody = &body;
+		upperHalf.begin = middle;
+		upperHalf.end = end;
+		upperHalf.grainSize = grainSize;
+		upperHalf.group = group;
+
+		group->_numPendingTasks++;
+		_pushTask(threadIndex, upperHalf, true);
+		end = middle;
+	}
+
+	body(threadIndex, begin, end);
+}
+
+void WorkStealingScheduler::_waitForGroup(TaskGroup & group)
+{
+	unsigned int threadIndex = _getIndexOfCurrentThread();
+
+	// tasks that addTask() is still collecting would otherwise never run.
+	if ((threadIndex == 0) && (&group == _addedTasks)) {
+		_publishTasks(true);
+	}
+
+	while (group._numPendingTasks != 0) {
+		QueuedTask task;
+		if (_popOrStealTask(threadIndex, task)) {
+			_runTask(threadIndex, task);
+			continue;
+		}
+
+		// the remaining tasks of the group are running on other threads; sleep until one finishes or more work is queued.
+		std::unique_lock<std::mutex> sleepLock(_sleepMutex);
+		_numSleepingThreads++;
+		while ((group._numPendingTasks != 0) && (_numQueuedTasks == 0)) {
+			_wakeUpCondition.wait(sleepLock);
+		}
+		_numSleepingThreads--;
+	}
+}
+
+void WorkStealingScheduler::_wakeUpSleepingThreads()
+{
+	if (_numSleepingThreads != 0) {
+		std::lock_guard<std::mutex> sleepLock(_sleepMutex);
+		_wakeUpCondition.notify_all();
+	}
+}
+
+void WorkStealingScheduler::_wakeUpOneSleepingThread()
+{
+	if (_numSleepingThreads != 0) {
+		std::lock_guard<std::mutex> sleepLock(_sleepMutex);
+		_wakeUpCondition.notify_one();
+	}
+}
@@ -0,0 +1,155 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+#ifndef __BATCH_ENGINE_DRIVER_H__
+#define __BATCH_ENGINE_DRIVER_H__
+
+/// @file BatchEngineDriver.h
+/// @brief Declares the BatchEngineDriver class
+
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include "SteerLib.h"
+
+
+/**
+ * @brief Runs many simulations in one process, each with its own SimulationEngine, and writes one results file.
+ *
+ * The jobs are listed in a manifest file, one job per line.  Each line has a test case, an AI module, and optionally
+ * more steersim command-line options that apply only to that job, for example:
+ * \code
+ * # test case            AI module   other options
+ * crossing-1.xml         sfAI        -numFrames 500
+ * bottleneck-squeeze.xml pprAI       -module steerBench,technique=composite01
+ * \endcode
+ * Empty lines and lines starting with '#' are ignored.  Each job starts from the options given to steersim itself,
+ * so options shared by all jobs (such as -moduleSearchPath) only need to be given once.
+ *
+ * Jobs run on a pool of threads, batchEngineDriverOptions.numThreads at a time.  The steerBench module is loaded
+ * for every job, so that each result includes a benchmark score.  A job that throws an exception is recorded as
+ * failed, and the remaining jobs still run.  The results are written as JSON if the results filename ends in
+ * ".json", and as CSV otherwise.
+ *
+ * With batchEngineDriverOptions.forkFrame set, every job must use the same test case and AI module.  The first
+ * forkFrame frames are then simulated only once, with the options given to steersim, and saved as an in-memory
+ * checkpoint (see SteerLib::SimulationEngine::writeCheckpoint()).  Each job builds its own engine from its own options,
+ * restores that one shared, read-only checkpoint, and simulates only the remaining frames; this way many what-if
+ * variants (e.g. different AI parameters or -randomSeed values) branch from the same state without re-simulating it.
+ * The checkpoint also holds the state of the modules, such as the metrics behind the benchmark score, so every score
+ * covers the whole simulation, shared frames included; a job can therefore not load modules that the shared frames
+ * did not, and only the modules that support checkpoints (see SteerLib::ModuleInterface::supportsCheckpoints()) can be
+ * loaded at all.
+ *
+ * With batchEngineDriverOptions.reuseEngines set (the default), every thread keeps the engine of its last job.  If the
+ * next job on that thread has the same AI module and options, and only its test case differs, it runs in that engine:
+ * the modules stay loaded and the spatial database stays allocated, and AI modules that pool their agents (see
+ * SteerLib::AgentPool) reuse the agents of the previous job, so only the state of the new simulation is initialized.
+ * Jobs are not reordered to make this more likely, so manifests should list such jobs next to each other.
+ *
+ * Every engine uses this driver as its engine controller; like the CommandLineEngineDriver, it does not
+ * support any of the engine controls, so one instance can be shared by all engines.
+ */
+class BatchEngineDriver : public SteerLib::EngineControllerInterface
+{
+public:
+	/// One line of the manifest.
+	struct Job {
+		unsigned int lineNumber;
+		std::string testCase;
+		std::string aiModule;
+		/// Additional steersim command-line options for this job.
+		std::vector<std::string> arguments;
+	};
+
+	/// The outcome of one job.
+	struct JobResult {
+		bool succeeded;
+		std::string errorMessage;
+		unsigned int numAgents;
+		/// Frames simulated by this job; when forking, the shared frames are not included.
+		unsigned int numFramesSimulated;
+		/// Seconds spent loading modules and the test case.
+		double setupTime;
+		/// Seconds spent simulating frames.
+		double simulationTime;
+		bool hasBenchmarkScore;
+		std::string benchmarkTechnique;
+		float benchmarkScore;
+	};
+
+	BatchEngineDriver();
+	~BatchEngineDriver() {}
+	void init(SteerLib::SimulationOptions * options);
+	void finish();
+	void run();
+
+	/// Returns the jobs read from the manifest.
+	inline const std::vector<Job> & getJobs() const { return _jobs; }
+	/// Returns the result of each job, in the same order as getJobs(); only valid after run().
+	inline const std::vector<JobResult> & getResults() const { return _results; }
+
+	/// @name The EngineControllerInterface
+	/// @brief The BatchEngineDriver does not support any of the engine controls.
+	//@{
+	virtual bool isStartupControlSupported() { return false; }
+	virtual bool isPausingControlSupported() { return false; }
+	virtual bool isPaused() { return false; }
+	virtual void loadSimulation() { throw Util::GenericException("BatchEngineDriver does not support loadSimulation()."); }
+	virtual void unloadSimulation() { throw Util::GenericException("BatchEngineDriver does not support unloadSimulation()."); }
+	virtual void startSimulation() { throw Util::GenericException("BatchEngineDriver does not support startSimulation()."); }
+	virtual void stopSimulation() { throw Util::GenericException("BatchEngineDriver does not support stopSimulation()."); }
+	virtual void pauseSimulation() { throw Util::GenericException("BatchEngineDriver does not support pauseSimulation()."); }
+	virtual void unpauseSimulation() { throw Util::GenericException("BatchEngineDriver does not support unpauseSimulation()."); }
+	virtual void togglePausedState() { throw Util::GenericException("BatchEngineDriver does not support togglePausedState()."); }
+	virtual void pauseAndStepOneFrame() { throw Util::GenericException("BatchEngineDriver does not support pauseAndStepOneFrame()."); }
+	//@}
+
+protected:
+	/// Reads the list of jobs from the manifest file.
+	void _readManifest(const std::string & filename);
+	/// Builds the options of one job from the options of the whole batch and the job's command-line options.
+	void _initializeJobOptions(const std::string & testCase, const std::string & aiModule, const std::vector<std::string> & jobArguments, SteerLib::SimulationOptions & jobOptions);
+	/// Simulates the frames shared by all jobs up to the fork frame, and keeps a checkpoint of the result in _forkCheckpoint.
+	void _simulateSharedFrames();
+	/// Runs one job from start to finish in the engine of the given thread, and stores its result; never throws.
+	void _runJob(unsigned int jobIndex, unsigned int threadIndex);
+	/// Finishes and deletes the engine a thread kept for its next job, if any.
+	void _finishReusableEngine(unsigned int threadIndex);
+	/// Writes one line per job, with a header line.
+	void _writeResultsAsCSV(std::ostream & out);
+	/// Writes an array with one object per job.
+	void _writeResultsAsJSON(std::ostream & out);
+
+	bool _alreadyInitialized;
+	SteerLib::SimulationOptions * _options;
+	std::vector<Job> _jobs;
+	std::vector<JobResult> _results;
+	/// The checkpoint all jobs continue from when forking; NULL otherwise.
+	std::shared_ptr<const std::vector<char> > _forkCheckpoint;
+	/// Seconds spent simulating the frames shared by all jobs.
+	double _sharedFramesTime;
+
+	/// An engine kept by a thread after a job, together with the options it was built from.
+	struct ReusableEngine {
+		ReusableEngine() : engine(NULL) { }
+		SteerLib::SimulationEngine * engine;
+		/// the engine keeps a pointer to these options, so they must live as long as the engine.
+		SteerLib::SimulationOptions options;
+		/// the AI module and options of the job the engine was built for; jobs with the same key may reuse the engine.
+		std::string key;
+	};
+	/// One engine per job thread, indexed by the thread index.
+	std::vector<ReusableEngine> _reusableEngines;
+
+private:
+	// These functions are kept here to protect us from mangling the instance.
+	BatchEngineDriver(const BatchEngineDriver & );  // not implemented, not copyable
+	BatchEngineDriver& operator= (const BatchEngineDriver & );  // not implemented, not assignable
+};
+
+#endif
@@ -0,0 +1,454 @@
+//
+// Copyright (c) 2009-2014 Shawn Singh, Glen Berseth, Mubbasir Kapadia, Petros Faloutsos, Glenn Reinman
+// See license.txt for complete license.
+//
+
+/// @file BatchEngineDriver.cpp
+/// @brief Implements the BatchEngineDriver functionality.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include "core/BatchEngineDriver.h"
+
+using namespace std;
+using namespace SteerLib;
+using namespace Util;
+
+// implemented in Main.cpp; each job's options are parsed the same way as the options of steersim itself.
+void initializeOptionsFromCommandLine( int argc, char **argv, SimulationOptions & simulationOptions );
+
+
+static std::string quoteForCSV(const std::string & field)
+{
+	if (field.find_first_of(",\"\n") == std::string::npos) {
+		return field;
+	}
+
+	std::string quoted = "\"";
+	for (unsigned int i=0; i < field.size(); i++) {
+		if (field[i] == '"') quoted += '"';
+		quoted += field[i];
+	}
+	return quoted + "\"";
+}
+
+static std::string quoteForJSON(const std::string & field)
+{
+	std::string quoted = "\"";
+	for (unsigned int i=0; i < field.size(); i++) {
+		switch (field[i]) {
+			case '"': quoted += "\\\""; break;
+			case '\\': quoted += "\\\\"; break;
+			case '\n': quoted += "\\n"; break;
+			case '\r': quoted += "\\r"; break;
+			case '\t': quoted += "\\t"; break;
+			default: quoted += field[i]; break;
+		}
+	}
+	return quoted + "\"";
+}
+
+
+//
+// constructor
+//
+BatchEngineDriver::BatchEngineDriver()
+{
+	_alreadyInitialized = false;
+	_options = NULL;
+	_sharedFramesTime = 0.0;
+}
+
+
+//
+// init()
+//
+void BatchEngineDriver::init(SteerLib::SimulationOptions * options)
+{
+	if (_alreadyInitialized) {
+		throw GenericException("BatchEngineDriver::init() - should not call this function twice.\n");
+	}
+
+	_alreadyInitialized = true;
+	_options = options;
+
+	if (_options->batchEngineDriverOptions.manifestFilename == "") {
+		throw GenericException("BatchEngineDriver needs a manifest of jobs; use the -batch option to specify one.");
+	}
+	if (_options->batchEngineDriverOptions.numThreads == 0) {
+		throw GenericException("BatchEngineDriver needs at least one thread to run jobs.");
+	}
+
+	_readManifest(_options->batchEngineDriverOptions.manifestFilename);
+
+	// the counter frequency is estimated lazily the first time it is needed; do that now, before several engines could race to do it.
+	getHighResCounterFrequency();
+}
+
+
+//
+// run() - runs all jobs and writes the results file
+//
+void BatchEngineDriver::run()
+{
+	_results.clear();
+	_results.resize(_jobs.size());
+
+	unsigned long long startTime = getHighResCounterValue();
+
+	_forkCheckpoint.reset();
+	if (_options->batchEngineDriverOptions.forkFrame != 0) {
+		_simulateSharedFrames();
+	}
+
+	_reusableEngines.clear();
+	_reusableEngines.resize(_options->batchEngineDriverOptions.numThreads);
+
+	if (_options->batchEngineDriverOptions.numThreads == 1) {
+		for (unsigned int i=0; i < _jobs.size(); i++) {
+			_runJob(i, 0);
+		}
+	}
+	else {
+		// a grain size of 1, because jobs can take very different amounts of time.
+		WorkStealingScheduler jobThreads(_options->batchEngineDriverOptions.numThreads);
+		jobThreads.parallelFor(0, (unsigned int)_jobs.size(), 1, [this](unsigned int threadIndex, unsigned int begin, unsigned int end) {
+			for (unsigned int i=begin; i < end; i++) {
+				_runJob(i, threadIndex);
+			}
+		});
+	}
+
+	for (unsigned int i=0; i < _reusableEngines.size(); i++) {
+		_finishReusableEngine(i);
+	}
+	_reusableEngines.clear();
+
+	double totalTime = (double)(getHighResCounterValue() - startTime) / (double)getHighResCounterFrequency();
+
+	const std::string & resultsFilename = _options->batchEngineDriverOptions.resultsFilename;
+	std::ofstream out(resultsFilename.c_str());
+	if (!out.is_open()) {
+		throw GenericException("BatchEngineDriver could not open results file \"" + resultsFilename + "\" for writing.");
+	}
+
+	if ((resultsFilename.size() >= 5) && (toLower(resultsFilename.substr(resultsFilename.size()-5)) == ".json")) {
+		_writeResultsAsJSON(out);
+	}
+	else {
+		_writeResultsAsCSV(out);
+	}
+	out.close();
+
+	unsigned int numFailedJobs = 0;
+	for (unsigned int i=0; i < _results.size(); i++) {
+		if (!_results[i].succeeded) {
+			std::cerr << "Job on line " << _jobs[i].lineNumber << " (" << _jobs[i].testCase << ", " << _jobs[i].aiModule << ") failed: " << _results[i].errorMessage << "\n";
+			numFailedJobs++;
+		}
+	}
+
+	if (_forkCheckpoint) {
+		std::cout << "Simulated the " << _options->batchEngineDriverOptions.forkFrame << " frames shared by all jobs once, in " << _sharedFramesTime << " seconds.\n";
+	}
+	std::cout << "Ran " << _jobs.size() << " jobs (" << numFailedJobs << " failed) in " << totalTime << " seconds; results written to " << resultsFilename << ".\n";
+}
+
+
+//
+// finish() - cleans up.
+//
+void BatchEngineDriver::finish()
+{
+	_jobs.clear();
+	_results.clear();
+	_forkCheckpoint.reset();
+}
+
+
+void BatchEngineDriver::_readManifest(const std::string & filename)
+{
+	std::ifstream manifest(filename.c_str());
+	if (!manifest.is_open()) {
+		throw GenericException("BatchEngineDriver could not open manifest \"" + filename + "\".");
+	}
+
+	std::string line;
+	unsigned int lineNumber = 0;
+	while (std::getline(manifest, line)) {
+		lineNumber++;
+
+		std::stringstream tokens(line);
+		Job job;
+		job.lineNumber = lineNumber;
+		if (!(tokens >> job.testCase) || (job.testCase[0] == '#')) {
+			continue;
+		}
+		if (!(tokens >> job.aiModule)) {
+			throw GenericException("Line " + toString(lineNumber) + " of manifest \"" + filename + "\" has a test case but no AI module.");
+		}
+
+		std::string argument;
+		while (tokens >> argument) {
+			job.arguments.push_back(argument);
+		}
+
+		_jobs.push_back(job);
+	}
+
+	if (_jobs.empty()) {
+		throw GenericException("Manifest \"" + filename + "\" does not list any jobs.");
+	}
+}
+
+
+void BatchEngineDriver::_initializeJobOptions(const std::string & testCase, const std::string & aiModule, const std::vector<std::string> & jobArguments, SimulationOptions & jobOptions)
+{
+	// start from the options of the whole batch, and parse the job's own options as if they were given to steersim.
+	jobOptions = *_options;
+	jobOptions.engineOptions.startupModules.insert("steerBench");
+
+	std::vector<std::string> arguments;
+	arguments.push_back("steersim");
+	arguments.push_back("-testcase");
+	arguments.push_back(testCase);
+	arguments.push_back("-ai");
+	arguments.push_back(aiModule);
+	arguments.insert(arguments.end(), jobArguments.begin(), jobArguments.end());
+
+	std::vector<char*> argv;
+	for (unsigned int i=0; i < arguments.size(); i++) {
+		argv.push_back(&arguments[i][0]);
+	}
+	argv.push_back(NULL);
+	initializeOptionsFromCommandLine((int)arguments.size(), &argv[0], jobOptions);
+}
+
+
+void BatchEngineDriver::_simulateSharedFrames()
+{
+	const Job & firstJob = _jobs[0];
+	for (unsigned int i=1; i < _jobs.size(); i++) {
+		if ((_jobs[i].testCase != firstJob.testCase) || (_jobs[i].aiModule != firstJob.aiModule)) {
+			throw GenericException("When forking jobs, every job must use the same test case and AI module, but line " + toString(_jobs[i].lineNumber) + " of the manifest differs from line " + toString(firstJob.lineNumber) + ".");
+		}
+	}
+
+	unsigned long long startTime = getHighResCounterValue();
+
+	// the shared frames use the options of the whole batch, without the options of any job.
+	SimulationOptions sharedOptions;
+	_initializeJobOptions(firstJob.testCase, firstJob.aiModule, std::vector<std::string>(), sharedOptions);
+	sharedOptions.engineOptions.numFramesToSimulate = _options->batchEngineDriverOptions.forkFrame;
+
+	SimulationEngine * engine = new SimulationEngine();
+	try {
+		engine->init(&sharedOptions, this);
+		engine->initializeSimulation();
+		engine->preprocessSimulation();
+
+		while (engine->update(false)) {
+		}
+
+		if (engine->getClock().getCurrentFrameNumber() != _options->batchEngineDriverOptions.forkFrame) {
+			throw GenericException("The simulation finished at frame " + toString(engine->getClock().getCurrentFrameNumber()) + ", before reaching the fork frame " + toString(_options->batchEngineDriverOptions.forkFrame) + ".");
+		}
+
+		CheckpointWriter checkpoint;
+		engine->writeCheckpoint(checkpoint);
+		_forkCheckpoint.reset(new std::vector<char>(checkpoint.getData()));
+
+		engine->postprocessSimulation();
+		engine->cleanupSimulation();
+		engine->finish();
+		delete engine;
+	}
+	catch (std::exception &e) {
+		// the engine may be in any state, so it is deliberately leaked instead of risking another exception while destroying it.
+		throw GenericException(std::string("BatchEngineDriver could not simulate the frames shared by all jobs: ") + e.what());
+	}
+
+	_sharedFramesTime = (double)(getHighResCounterValue() - startTime) / (double)getHighResCounterFrequency();
+}
+
+
+void BatchEngineDriver::_finishReusableEngine(unsigned int threadIndex)
+{
+	ReusableEngine & reusable = _reusableEngines[threadIndex];
+	if (reusable.engine != NULL) {
+		SimulationEngine * engine = reusable.engine;
+		reusable.engine = NULL;
+		engine->finish();
+		delete engine;
+	}
+}
+
+
+void BatchEngineDriver::_runJob(unsigned int jobIndex, unsigned int threadIndex)
+{
+	const Job & job = _jobs[jobIndex];
+	JobResult & result = _results[jobIndex];
+	ReusableEngine & reusable = _reusableEngines[threadIndex];
+
+	result.succeeded = false;
+	result.numAgents = 0;
+	result.numFramesSimulated = 0;
+	result.setupTime = 0.0;
+	result.simulationTime = 0.0;
+	result.hasBenchmarkScore = false;
+	result.benchmarkScore = 0.0f;
+
+	// jobs with the same AI module and options build the same engine, except for the test case.
+	std::string engineKey = job.aiModule;
+	for (unsigned int i=0; i < job.arguments.size(); i++) {
+		engineKey += "\n" + job.arguments[i];
+	}
+
+	try {
+		unsigned long long startTime = getHighResCounterValue();
+
+		if ((reusable.engine != NULL) && (reusable.key != engineKey)) {
+			_finishReusableEngine(threadIndex);
+		}
+
+		SimulationOptions & jobOptions = reusable.options;
+		SimulationEngine * engine = reusable.engine;
+		if (engine == NULL) {
+			_initializeJobOptions(job.testCase, job.aiModule, job.arguments, jobOptions);
+			reusable.key = engineKey;
+			reusable.engine = new SimulationEngine();
+			engine = reusable.engine;
+			engine->init(&jobOptions, this);
+		}
+		else {
+			jobOptions.moduleOptionsDatabase["testCasePlayer"]["testcase"] = job.testCase;
+			TestCasePlayerModule * testCasePlayer = dynamic_cast<TestCasePlayerModule*>(engine->getModule("testCasePlayer"));
+			if (testCasePlayer == NULL) {
+				throw GenericException("BatchEngineDriver can only reuse an engine whose test case is loaded by the testCasePlayer module.");
+			}
+			testCasePlayer->setTestCaseFilename(job.testCase);
+		}
+
+		engine->initializeSimulation();
+		engine->preprocessSimulation();
+
+		unsigned int firstFrame = 0;
+		if (_forkCheckpoint) {
+			// every job reads the same checkpoint; only the engine built from the job's own options differs.
+			CheckpointReader checkpoint;
+			checkpoint.loadFromMemory(_forkCheckpoint);
+			engine->readCheckpoint(checkpoint);
+			if (jobOptions.engineOptions.randomSeed != _options->engineOptions.randomSeed) {
+				engine->setRandomSeed(jobOptions.engineOptions.randomSeed);
+			}
+			firstFrame = engine->getClock().getCurrentFrameNumber();
+		}
+
+		unsigned long long setupEndTime = getHighResCounterValue();
+
+		while (engine->update(false)) {
+		}
+
+		unsigned long long simulationEndTime = getHighResCounterValue();
+
+		result.numAgents = (unsigned int)engine->getAgents().size();
+		result.numFramesSimulated = engine->getClock().getCurrentFrameNumber() - firstFrame;
+		result.setupTime = (double)(setupEndTime - startTime) / (double)getHighResCounterFrequency();
+		result.simulationTime = (double)(simulationEndTime - setupEndTime) / (double)getHighResCounterFrequency();
+
+		engine->postprocessSimulation();
+
+		// after a fork, the metrics collected during the shared frames were restored with the checkpoint, so the score is that of the whole simulation.
+		SteerBenchModule * steerBench = dynamic_cast<SteerBenchModule*>(engine->getModule("steerBench"));
+		if (steerBench != NULL) {
+			result.hasBenchmarkScore = true;
+			result.benchmarkScore = steerBench->getTotalBenchmarkScore();
+			OptionDictionary::const_iterator techniqueIter = jobOptions.moduleOptionsDatabase["steerBench"].find("technique");
+			result.benchmarkTechnique = (techniqueIter != jobOptions.moduleOptionsDatabase["steerBench"].end()) ? techniqueIter->second : "composite02";
+		}
+
+		engine->cleanupSimulation();
+		if (!_options->batchEngineDriverOptions.reuseEngines) {
+			_finishReusableEngine(threadIndex);
+		}
+
+		result.succeeded = true;
+	}
+	catch (std::exception &e) {
+		result.succeeded = false;
+		result.errorMessage = e.what();
+		// the engine may be in any state, so it is deliberately leaked instead of risking another exception while destroying it.
+		reusable.engine = NULL;
+	}
+}
+
+
+void BatchEngineDriver::_writeResultsAsCSV(std::ostream & out)
+{
+	out << "line,testcase,ai,options,status,agents,frames,setup_seconds,simulation_seconds,frames_per_second,benchmark_technique,benchmark_score,error\n";
+	out << std::setprecision(9);
+
+	for (unsigned int i=0; i < _jobs.size(); i++) {
+		const Job & job = _jobs[i];
+		const JobResult & result = _results[i];
+
+		std::string options = "";
+		for (unsigned int j=0; j < job.arguments.size(); j++) {
+			options += (j == 0 ? "" : " ") + job.arguments[j];
+		}
+
+		out << job.lineNumber << "," << quoteForCSV(job.testCase) << "," << quoteForCSV(job.aiModule) << "," << quoteForCSV(options) << ",";
+		out << (result.succeeded ? "ok" : "failed") << "," << result.numAgents << "," << result.numFramesSimulated << ",";
+		out << result.setupTime << "," << result.simulationTime << ",";
+		out << ((result.simulationTime > 0.0) ? result.numFramesSimulated / result.simulationTime : 0.0) << ",";
+		if (result.hasBenchmarkScore) {
+			out << quoteForCSV(result.benchmarkTechnique) << "," << result.benchmarkScore;
+		}
+		else {
+			out << ",";
+		}
+		out << "," << quoteForCSV(result.errorMessage) << "\n";
+	}
+}
+
+
+void BatchEngineDriver::_writeResultsAsJSON(std::ostream & out)
+{
+	out << "[\n";
+	out << std::setprecision(9);
+
+	for (unsigned int i=0; i < _jobs.size(); i++) {
+		const Job & job = _jobs[i];
+		const JobResult & result = _results[i];
+
+		out << "  {\n";
+		out << "    \"line\": " << job.lineNumber << ",\n";
+		out << "    \"testcase\": " << quoteForJSON(job.testCase) << ",\n";
+		out << "    \"ai\": " << quoteForJSON(job.aiModule) << ",\n";
+		out << "    \"options\": [";
+		for (unsigned int j=0; j < job.arguments.size(); j++) {
+			out << (j == 0 ? "" : ", ") << quoteForJSON(job.arguments[j]);
+		}
+		out << "],\n";
+		out << "    \"status\": " << (result.succeeded ? "\"ok\"" : "\"failed\"") << ",\n";
+		out << "    \"agents\": " << result.numAgents << ",\n";
+		out << "    \"frames\": " << result.numFramesSimulated << ",\n";
+		out << "    \"setup_seconds\": " << result.setupTime << ",\n";
+		out << "    \"simulation_seconds\": " << result.simulationTime << ",\n";
+		out << "    \"frames_per_second\": " << ((result.simulationTime > 0.0) ? result.numFramesSimulated / result.simulationTime : 0.0) << ",\n";
+		if (result.hasBenchmarkScore) {
+			out << "    \"benchmark_technique\": " << quoteForJSON(result.benchmarkTechnique) << ",\n";
+			out << "    \"benchmark_score\": " << result.benchmarkScore << ",\n";
+		}
+		else {
+			out << "    \"benchmark_technique\": null,\n";
+			out << "    \"benchmark_score\": null,\n";
+		}
+		out << "    \"error\": " << quoteForJSON(result.errorMessage) << "\n";
+		out << ((i+1 < _jobs.size()) ? "  },\n" : "  }\n");
+	}
+
+	out << "]\n";
+}
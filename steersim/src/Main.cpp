@@ -9,6 +9,7 @@
 #include <exception>
 #include "SteerLib.h"
 #include "core/CommandLineEngineDriver.h"
+#include "core/BatchEngineDriver.h"
 #include "core/GLFWEngineDriver.h"
 #include "core/QtEngineDriver.h"
 #include "SimulationPlugin.h"
@@ -74,6 +75,13 @@ int main(int argc, char **argv)
 			cmd->run();
 			cmd->finish();
 		}
+		else if (simulationOptions.globalOptions.engineDriver == "batch") {
+			BatchEngineDriver * batch = new BatchEngineDriver();
+			batch->init(&simulationOptions);
+			batch->run();
+			batch->finish();
+			delete batch;
+		}
 		else if (simulationOptions.globalOptions.engineDriver == "glfw") {
 #ifdef ENABLE_GUI
 #ifdef ENABLE_GLFW
@@ -422,10 +430,12 @@ void initializeOptionsFromCommandLine( int argc, char **argv, SimulationOptions
 	bool qtSpecified = false;
 	bool glfwSpecified = false;
 	bool commandLineSpecified = false;
+	bool batchSpecified = false;
 	bool animateCamera = false;
 
 	std::string engineDriverName = "";
 	std::string generateConfigFilename = "";
+	std::string batchManifestFilename = "";
 
 	std::string aiModuleName = "";
 	std::string testCaseFilename = "";
@@ -445,6 +455,15 @@ void initializeOptionsFromCommandLine( int argc, char **argv, SimulationOptions
 	opts.addOption("-GLFW", NULL, OPTION_DATA_TYPE_NO_DATA, 0, &glfwSpecified, true);
 	opts.addOption("-commandLine", NULL, OPTION_DATA_TYPE_NO_DATA, 0, &commandLineSpecified, true);
 	opts.addOption("-commandline", NULL, OPTION_DATA_TYPE_NO_DATA, 0, &commandLineSpecified, true);
+	opts.addOption("-batch", &batchManifestFilename, OPTION_DATA_TYPE_STRING);
+	opts.addOption("-batchResults", &simulationOptions.batchEngineDriverOptions.resultsFilename, OPTION_DATA_TYPE_STRING);
+	opts.addOption("-batchresults", &simulationOptions.batchEngineDriverOptions.resultsFilename, OPTION_DATA_TYPE_STRING);
+	opts.addOption("-batchThreads", &simulationOptions.batchEngineDriverOptions.numThreads, OPTION_DATA_TYPE_UNSIGNED_INT);
+	opts.addOption("-batchthreads", &simulationOptions.batchEngineDriverOptions.numThreads, OPTION_DATA_TYPE_UNSIGNED_INT);
+	opts.addOption("-batchForkFrame", &simulationOptions.batchEngineDriverOptions.forkFrame, OPTION_DATA_TYPE_UNSIGNED_INT);
+	opts.addOption("-batchforkframe", &simulationOptions.batchEngineDriverOptions.forkFrame, OPTION_DATA_TYPE_UNSIGNED_INT);
+	opts.addOption("-batchNewEngines", NULL, OPTION_DATA_TYPE_NO_DATA, 0, &simulationOptions.batchEngineDriverOptions.reuseEngines, false);
+	opts.addOption("-batchnewengines", NULL, OPTION_DATA_TYPE_NO_DATA, 0, &simulationOptions.batchEngineDriverOptions.reuseEngines, false);
 	opts.addOption("-engineDriver", &engineDriverName, OPTION_DATA_TYPE_STRING);
 	opts.addOption("-enginedriver", &engineDriverName, OPTION_DATA_TYPE_STRING);
 	opts.addOption("-generateConfig", &generateConfigFilename, OPTION_DATA_TYPE_STRING);
@@ -465,6 +484,24 @@ void initializeOptionsFromCommandLine( int argc, char **argv, SimulationOptions
 	opts.addOption( "-numframes", &simulationOptions.engineOptions.numFramesToSimulate, OPTION_DATA_TYPE_UNSIGNED_INT);
 	opts.addOption( "-numThreads", &simulationOptions.engineOptions.numThreads, OPTION_DATA_TYPE_UNSIGNED_INT);
 	opts.addOption( "-numthreads", &simulationOptions.engineOptions.numThreads, OPTION_DATA_TYPE_UNSIGNED_INT);
+	opts.addOption( "-maxDeferredFrames", &simulationOptions.engineOptions.maxDeferredFrames, OPTION_DATA_TYPE_UNSIGNED_INT);
+	opts.addOption( "-maxdeferredframes", &simulationOptions.engineOptions.maxDeferredFrames, OPTION_DATA_TYPE_UNSIGNED_INT);
+	opts.addOption( "-telemetryFrames", &simulationOptions.engineOptions.telemetryFrames, OPTION_DATA_TYPE_UNSIGNED_INT);
+	opts.addOption( "-telemetryframes", &simulationOptions.engineOptions.telemetryFrames, OPTION_DATA_TYPE_UNSIGNED_INT);
+	opts.addOption( "-telemetryFile", &simulationOptions.engineOptions.telemetryFilename, OPTION_DATA_TYPE_STRING);
+	opts.addOption( "-telemetryfile", &simulationOptions.engineOptions.telemetryFilename, OPTION_DATA_TYPE_STRING);
+	opts.addOption( "-saveCheckpoint", &simulationOptions.engineOptions.checkpointFilename, OPTION_DATA_TYPE_STRING);
+	opts.addOption( "-savecheckpoint", &simulationOptions.engineOptions.checkpointFilename, OPTION_DATA_TYPE_STRING);
+	opts.addOption( "-checkpointFrame", &simulationOptions.engineOptions.checkpointFrame, OPTION_DATA_TYPE_UNSIGNED_INT);
+	opts.addOption( "-checkpointframe", &simulationOptions.engineOptions.checkpointFrame, OPTION_DATA_TYPE_UNSIGNED_INT);
+	opts.addOption( "-restoreCheckpoint", &simulationOptions.engineOptions.restoreCheckpointFilename, OPTION_DATA_TYPE_STRING);
+	opts.addOption( "-restorecheckpoint", &simulationOptions.engineOptions.restoreCheckpointFilename, OPTION_DATA_TYPE_STRING);
+	opts.addOption( "-randomSeed", &simulationOptions.engineOptions.randomSeed, OPTION_DATA_TYPE_UNSIGNED_INT);
+	opts.addOption( "-randomseed", &simulationOptions.engineOptions.randomSeed, OPTION_DATA_TYPE_UNSIGNED_INT);
+	opts.addOption( "-rebuildAgentGrid", NULL, OPTION_DATA_TYPE_NO_DATA, 0, &simulationOptions.gridDatabaseOptions.rebuildAgentLayer, true);
+	opts.addOption( "-rebuildagentgrid", NULL, OPTION_DATA_TYPE_NO_DATA, 0, &simulationOptions.gridDatabaseOptions.rebuildAgentLayer, true);
+	opts.addOption( "-mortonGrid", NULL, OPTION_DATA_TYPE_NO_DATA, 0, &simulationOptions.gridDatabaseOptions.mortonCellOrder, true);
+	opts.addOption( "-mortongrid", NULL, OPTION_DATA_TYPE_NO_DATA, 0, &simulationOptions.gridDatabaseOptions.mortonCellOrder, true);
 	opts.addOption( "-testCaseSearchPath", &simulationOptions.engineOptions.testCaseSearchPath, OPTION_DATA_TYPE_STRING);
 	opts.addOption( "-testcasesearchpath", &simulationOptions.engineOptions.testCaseSearchPath, OPTION_DATA_TYPE_STRING);
 	opts.addOption( "-testCasePath", &simulationOptions.engineOptions.testCaseSearchPath, OPTION_DATA_TYPE_STRING);
@@ -510,6 +547,13 @@ void initializeOptionsFromCommandLine( int argc, char **argv, SimulationOptions
 		if (engineDriverName == "qt") qtSpecified = true;
 		else if (engineDriverName == "glfw") glfwSpecified = true;
 		else if (engineDriverName == "commandline") commandLineSpecified = true;
+		else if (engineDriverName == "batch") batchSpecified = true;
+	}
+
+	// giving a manifest of jobs also selects the batch engine driver.
+	if (batchManifestFilename != "") {
+		simulationOptions.batchEngineDriverOptions.manifestFilename = batchManifestFilename;
+		batchSpecified = true;
 	}
 
 	unsigned int numGUIOptionsSpecified = 0;
@@ -532,11 +576,17 @@ void initializeOptionsFromCommandLine( int argc, char **argv, SimulationOptions
 		engineDriverName = "commandline";
 	}
 
+	if (batchSpecified) {
+		numGUIOptionsSpecified++;
+		engineDriverName = "batch";
+	}
+
 	if (numGUIOptionsSpecified > 1) {
 		throw GenericException("Multiple engine drivers were specified:"
 			+ toString(commandLineSpecified ? " commandLine" : "")
 			+ toString(glfwSpecified ? " glfw" : "")
 			+ toString(qtSpecified ? " qt" : "")
+			+ toString(batchSpecified ? " batch" : "")
 			+ "; Please specify only one engine driver.");
 	}
 
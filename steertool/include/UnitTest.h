@@ -18,15 +18,19 @@ void runUnitTest(const std::string & unitTestName);
 
 
 /**
- * @brief Unit test for the SteerLib::ThreadedTaskManager
+ * @brief Unit test and benchmark for the Util::ThreadedTaskManager and Util::WorkStealingScheduler
  *
- * This test runs the ThreadedTaskManager in a variety of configurations, to make sure
+ * This test runs both thread pools in a variety of configurations, to make sure
  * that tasks perform correctly and that task-queue/worker-thread synchronization works.  To do this, four
  * different configurations are tested, ranging from 1 to MAX_NUM_THREADS, and each
  * rount of tests is repeated NUM_REPEATS number of times.  The four configurations are
  * a combination of using either a fast/light or slow/heavy task, and the method of waking
  * up worker threads when tasks are added (wake up every task, or one explicit wake after adding all tasks).
  *
+ * The WorkStealingScheduler is additionally tested with parallelFor() and nested task groups.  For both pools,
+ * the test reports throughput (fast tasks per second) and latency (time for one empty task to be
+ * added, run and waited on), so the two can be compared directly.
+ *
  */
 class ThreadPoolTest
 {
@@ -37,17 +41,26 @@ public:
 protected:
 	static void threadPoolFastTestTask( unsigned int threadIndex, void * data );
 	static void threadPoolSlowTestTask( unsigned int threadIndex, void * data );
+	static void threadPoolEmptyTestTask( unsigned int threadIndex, void * data ) { }
 
 	void _resetOutput();
-	void _addAllTasks( bool useSlowTask, bool broadcastWhenTaskAdded );
+	template < typename TaskPoolType >
+	void _addAllTasks( TaskPoolType * taskPool, bool useSlowTask, bool broadcastWhenTaskAdded );
+	/// Runs the four task queue configurations on the pool, and returns the throughput of fast tasks, in tasks per second.
+	template < typename TaskPoolType >
+	float _runTaskQueueTests( TaskPoolType * taskPool, unsigned int numThreads );
+	/// Returns the average time, in seconds, to add one empty task and wait for it.
+	template < typename TaskPoolType >
+	float _measureLatency( TaskPoolType * taskPool );
+	void _runParallelForTests( Util::WorkStealingScheduler * scheduler, unsigned int numThreads );
 	void _verifyOutputIsCorrect(unsigned int numThreads, unsigned int testSegment);
 
 	static const unsigned int NUM_TASKS = 5000;
 	static const unsigned int MAX_NUM_THREADS = 15;
 	static const unsigned int NUM_REPEATS = 5;
+	static const unsigned int NUM_LATENCY_SAMPLES = 2000;
 
 	unsigned int * _output;
-	Util::ThreadedTaskManager * _taskManager;
 };
 
 /**
@@ -62,6 +75,212 @@ public:
 	void runTest();
 };
 
+/**
+ * @brief Unit test and benchmark for the neighbor queries of SteerLib::GridDatabase2D.
+ *
+ * Fills a grid with small circles, then runs a range query around every circle with the set-based
+ * getItemsInRange(), the vector-based getItemsInRange() reusing one vector, and visitItemsInRange().
+ * All three must find the same items; the test reports how many queries per second each one runs.
+ * The vector version is also run from several threads at once, to check that concurrent queries do
+ * not disturb each other's de-duplication.  getKNearestNeighbors() is checked against a brute force search,
+ * and small grids check that a cell can hold more than maxItemsPerCell items, that a large grid only allocates the
+ * tiles of its occupied cells, that Morton cell numbering finds the same items, that deferred updates, made from one
+ * thread or from several at once, leave the cells exactly as immediate updates do, and that rebuilding the agent layer finds the same items with any number
+ * of threads.
+ */
+class NeighborQueryTest
+{
+public:
+	NeighborQueryTest() { }
+	~NeighborQueryTest() { }
+	void runTest();
+protected:
+	/// A circle that only implements what the neighbor queries need; it is an obstacle, so that getKNearestNeighbors() can measure it.
+	class TestItem : public SteerLib::ObstacleInterface {
+	public:
+		void draw() { }
+		const Util::AxisAlignedBox & getBounds() { bounds = Util::AxisAlignedBox(position.x - radius, position.x + radius, 0.0f, 0.0f, position.z - radius, position.z + radius); return bounds; }
+		void returnVertices(std::vector<Util::Vector> & vertices) { }
+		bool isAgent() { return false; }
+		bool blocksLineOfSight() { return false; }
+		float getTraversalCost() { return 0.0f; }
+		bool intersects(const Util::Ray &r, float &t) { return Util::rayIntersectsCircle2D(position, radius, r, t); }
+		bool overlaps(const Util::Point & p, float r) { return Util::circleOverlapsCircle2D(position, radius, p, r); }
+		float computePenetration(const Util::Point & p, float r) { return Util::computeCircleCirclePenetration2D(position, radius, p, r); }
+		Util::Point position;
+		float radius;
+		Util::AxisAlignedBox bounds;
+	};
+
+	/// A TestItem that the grid database keeps in its dynamic layer.
+	class TestAgent : public TestItem {
+	public:
+		bool isAgent() { return true; }
+	};
+
+	static const unsigned int NUM_ITEMS = 5000;
+	static const unsigned int NUM_REPEATS = 20;
+	static const unsigned int NUM_THREADS = 4;
+	/// The half-width of the square searched around every item.
+	static const float QUERY_RADIUS;
+	/// The number of neighbors, and the largest distance, of the k-nearest neighbor queries.
+	static const unsigned int NUM_NEAREST = 8;
+	static const float NEAREST_MAX_DISTANCE;
+};
+
+/**
+ * @brief The engine controller of unit tests that run a SimulationEngine themselves.
+ *
+ * Like the CommandLineEngineDriver, the tests do not support any of the engine controls.
+ */
+class UnitTestEngineController : public SteerLib::EngineControllerInterface
+{
+public:
+	virtual bool isStartupControlSupported() { return false; }
+	virtual bool isPausingControlSupported() { return false; }
+	virtual bool isPaused() { return false; }
+	virtual void loadSimulation() { throw Util::GenericException("Unit tests do not support loadSimulation()."); }
+	virtual void unloadSimulation() { throw Util::GenericException("Unit tests do not support unloadSimulation()."); }
+	virtual void startSimulation() { throw Util::GenericException("Unit tests do not support startSimulation()."); }
+	virtual void stopSimulation() { throw Util::GenericException("Unit tests do not support stopSimulation()."); }
+	virtual void pauseSimulation() { throw Util::GenericException("Unit tests do not support pauseSimulation()."); }
+	virtual void unpauseSimulation() { throw Util::GenericException("Unit tests do not support unpauseSimulation()."); }
+	virtual void togglePausedState() { throw Util::GenericException("Unit tests do not support togglePausedState()."); }
+	virtual void pauseAndStepOneFrame() { throw Util::GenericException("Unit tests do not support pauseAndStepOneFrame()."); }
+};
+
+/**
+ * @brief Regression test that multi-threaded agent updates give the same results as a single thread.
+ *
+ * Simulates a few test cases with the social forces AI on one thread, then again several times on 2 to
+ * MAX_NUM_THREADS threads, and compares the checkpoints of all agents after the last frame byte for byte.
+ * The sfAI plug-in and the test cases are found with the default search paths of SteerLib::SimulationOptions,
+ * so the test must run from the same directory as steersim.
+ */
+class DeterminismTest : public UnitTestEngineController
+{
+public:
+	DeterminismTest() { }
+	~DeterminismTest() { }
+	void runTest();
+
+protected:
+	/// Simulates NUM_FRAMES frames of the test case on numThreads threads, and returns the checkpoint data of all its agents.
+	std::vector<char> _simulate(const std::string & testCaseName, unsigned int numThreads);
+
+	static const unsigned int NUM_FRAMES = 150;
+	static const unsigned int MAX_NUM_THREADS = 4;
+	static const unsigned int NUM_REPEATS = 3;
+};
+
+/**
+ * @brief Unit test for SteerLib::CheckpointWriter, SteerLib::CheckpointReader and the checkpoints of SteerLib::SimulationEngine.
+ *
+ * First writes values, vectors, strings and nested blocks, and checks that they read back unchanged, and that
+ * truncated data and blocks that are not read to their end are detected.  Then simulates a test case with the
+ * social forces AI, saves a checkpoint after NUM_FRAMES frames, both in memory and to a file, and simulates
+ * NUM_FRAMES more frames; restoring either checkpoint and simulating the same frames again must end with all
+ * agents in exactly the same state and the same benchmark score, and the recorded rec file must not keep the
+ * frames that were simulated again.  Like the DeterminismTest, it must run from the same directory as steersim.
+ */
+class CheckpointTest : public UnitTestEngineController
+{
+public:
+	CheckpointTest() { }
+	~CheckpointTest() { }
+	void runTest();
+protected:
+	/// Returns the checkpoint data of all agents of the engine.
+	std::vector<char> _getAgentStates(SteerLib::SimulationEngine & engine);
+	/// Updates the engine numFrames times.
+	void _simulateFrames(SteerLib::SimulationEngine & engine, unsigned int numFrames);
+
+	static const unsigned int NUM_FRAMES = 60;
+};
+
+/**
+ * @brief Unit test for SteerLib::AgentRegistry.
+ *
+ * Adds agents of two owners, removes some of them, and adds more, checking after every step that the dense list,
+ * the owners' lists and the handles agree.  Handles of removed agents must stay stale after their slots are reused,
+ * new agents must reuse the free slots before the registry grows, and serial numbers must never repeat.  The
+ * registry never dereferences agents or owners, so the test registers addresses that are not real agents.
+ */
+class AgentRegistryTest
+{
+public:
+	AgentRegistryTest() { }
+	~AgentRegistryTest() { }
+	void runTest();
+protected:
+	/// Throws an exception unless the registry holds exactly the expected agents, each with its expected owner and handle.
+	void _checkRegistry(const SteerLib::AgentRegistry & registry, const std::map<SteerLib::AgentInterface*, std::pair<SteerLib::ModuleInterface*, SteerLib::AgentHandle> > & expected);
+
+	static const unsigned int NUM_AGENTS = 1000;
+};
+
+/**
+ * @brief Unit test for SteerLib::MultiRateScheduler.
+ *
+ * Adds NUM_TASKS tasks that run every INTERVAL frames, and checks that each one runs exactly every INTERVAL
+ * frames and that the scheduler spreads them evenly, NUM_TASKS / INTERVAL on every frame.  Then removes half of
+ * the tasks, checks that they no longer run, and that new tasks take over the offsets that were given back.  Tasks
+ * that remove themselves or another task due on the same frame, and concurrent tasks on worker threads, are
+ * checked as well.
+ */
+class MultiRateSchedulerTest
+{
+public:
+	MultiRateSchedulerTest() { }
+	~MultiRateSchedulerTest() { }
+	void runTest();
+protected:
+	static const unsigned int NUM_TASKS = 1000;
+	static const unsigned int INTERVAL = 20;
+	static const unsigned int NUM_PERIODS = 5;
+	static const unsigned int NUM_THREADS = 4;
+};
+
+/**
+ * @brief Unit test for SteerLib::DeferredWorkQueue.
+ *
+ * Checks that queued work runs highest priority first and oldest first among equal priorities, that a deadline
+ * that has passed holds work back until it waited MAX_DEFERRED_FRAMES frames, that forced work is counted per
+ * agent, and that a deadline a few milliseconds away runs some but not all of a queue of slow items.  Cancelling
+ * an agent must drop only its own work, and work queued from several threads at once, or by other work, must
+ * not be lost.  The queue never dereferences agents, so the test uses addresses that are not real agents.
+ */
+class DeferredWorkQueueTest
+{
+public:
+	DeferredWorkQueueTest() { }
+	~DeferredWorkQueueTest() { }
+	void runTest();
+protected:
+	static const unsigned int NUM_ITEMS = 1000;
+	static const unsigned int MAX_DEFERRED_FRAMES = 5;
+	static const unsigned int NUM_THREADS = 4;
+};
+
+/**
+ * @brief Unit test for Util::FrameArena, Util::FrameArenaScope and Util::ArenaAllocator.
+ *
+ * Allocates memory of many sizes and alignments, and checks that it is aligned and that no two allocations
+ * overlap.  Rewinding to a marker, also across blocks and with a FrameArenaScope, must hand out the same memory
+ * again; reset() must keep enough capacity for the next frame to allocate the same amount without growing.
+ * Arena containers must work both with an arena and without one.
+ */
+class FrameArenaTest
+{
+public:
+	FrameArenaTest() { }
+	~FrameArenaTest() { }
+	void runTest();
+protected:
+	static const unsigned int BLOCK_SIZE = 1024;
+	static const unsigned int NUM_ALLOCATIONS = 500;
+};
+
 /**
  * @brief Unit test for the helper file functions.
  */
@@ -8,6 +8,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstdio>
 
 #include "UnitTest.h"
 
@@ -37,6 +38,34 @@ void runUnitTest(const std::string & unitTestName)
 		StateMachineTest FSMTest;
 		FSMTest.runTest();
 	}
+	else if (caseInsensitiveTestName == "neighborquery") {
+		NeighborQueryTest neighborQueryTest;
+		neighborQueryTest.runTest();
+	}
+	else if (caseInsensitiveTestName == "determinism") {
+		DeterminismTest determinismTest;
+		determinismTest.runTest();
+	}
+	else if (caseInsensitiveTestName == "checkpoint") {
+		CheckpointTest checkpointTest;
+		checkpointTest.runTest();
+	}
+	else if (caseInsensitiveTestName == "agentregistry") {
+		AgentRegistryTest agentRegistryTest;
+		agentRegistryTest.runTest();
+	}
+	else if (caseInsensitiveTestName == "multiratescheduler") {
+		MultiRateSchedulerTest multiRateSchedulerTest;
+		multiRateSchedulerTest.runTest();
+	}
+	else if (caseInsensitiveTestName == "deferredworkqueue") {
+		DeferredWorkQueueTest deferredWorkQueueTest;
+		deferredWorkQueueTest.runTest();
+	}
+	else if (caseInsensitiveTestName == "framearena") {
+		FrameArenaTest frameArenaTest;
+		frameArenaTest.runTest();
+	}
 	else {
 		throw GenericException("Unknown name for unit test, \"" + unitTestName + "\"");
 	}
@@ -108,7 +137,8 @@ void ThreadPoolTest::threadPoolSlowTestTask( unsigned int threadIndex, void * da
 	}
 }
 
-void ThreadPoolTest::_addAllTasks( bool useSlowTask, bool broadcastWhenTaskAdded )
+template < typename TaskPoolType >
+void ThreadPoolTest::_addAllTasks( TaskPoolType * taskPool, bool useSlowTask, bool broadcastWhenTaskAdded )
 {
 	for (unsigned int i=0; i < NUM_TASKS; i++) {
 		Task newTask;
@@ -119,7 +149,7 @@ void ThreadPoolTest::_addAllTasks( bool useSlowTask, bool broadcastWhenTaskAdded
 		else {
 			newTask.function = ThreadPoolTest::threadPoolFastTestTask;
 		}
-		_taskManager->addTask(newTask, broadcastWhenTaskAdded);
+		taskPool->addTask(newTask, broadcastWhenTaskAdded);
 	}
 }
 
@@ -133,7 +163,8 @@ void ThreadPoolTest::_verifyOutputIsCorrect(unsigned int numThreads, unsigned in
 	}
 }
 
-void ThreadPoolTest::runTest()
+template < typename TaskPoolType >
+float ThreadPoolTest::_runTaskQueueTests( TaskPoolType * taskPool, unsigned int numThreads )
 {
 	PerformanceProfiler pp1, pp2, pp3, pp4;
 	pp1.reset();
@@ -141,103 +172,196 @@ void ThreadPoolTest::runTest()
 	pp3.reset();
 	pp4.reset();
 
+	for (unsigned int testCount=0; testCount<NUM_REPEATS; testCount++) {
+		//======================================================================
+		// test segment #1:  fast task, broadcast once after all tasks are added
+		//======================================================================
+		// initialize the data
+		_resetOutput();
 
-	// test the thread pool running from 1 to MAX_NUM_THREADS threads
-	for (unsigned int numThreads=1; numThreads<MAX_NUM_THREADS; numThreads++) {
+		pp1.start();
 
-		std::cout << "Testing ThreadedTaskManager with " << numThreads << " threads:" << std::endl;
-		// allocate new task manager
-		_taskManager = new ThreadedTaskManager(numThreads);
-		pp1.reset();
-		pp2.reset();
-		pp3.reset();
-		pp4.reset();
+		// add tasks to queue
+		_addAllTasks(taskPool,false,false);
+		taskPool->wakeUpAllSleepingWorkerThreads();
+		// wait for all tasks
+		taskPool->waitForAllTasksToComplete();
 
-		for (unsigned int testCount=0; testCount<NUM_REPEATS; testCount++) {
-			//======================================================================
-			// test segment #1:  fast task, broadcast once after all tasks are added
-			//======================================================================
-			// initialize the data
-			_resetOutput();
+		pp1.stop();
 
-			pp1.start();
+		// verify the answers are correct
+		_verifyOutputIsCorrect(numThreads, 1);
 
-			// add tasks to queue
-			_addAllTasks(false,false);
-			_taskManager->wakeUpAllSleepingWorkerThreads();
-			// wait for all tasks
-			_taskManager->waitForAllTasksToComplete();
 
-			pp1.stop();
+		//======================================================================
+		// test segment #2:  fast task, broadcast every time a task is added
+		//======================================================================
+		// initialize the data
+		_resetOutput();
 
-			// verify the answers are correct
-			_verifyOutputIsCorrect(numThreads, 1);
+		pp2.start();
 
+		// add tasks to queue
+		_addAllTasks(taskPool,false,true);
+		// wait for all tasks
+		taskPool->waitForAllTasksToComplete();
 
-			//======================================================================
-			// test segment #2:  fast task, broadcast every time a task is added
-			//======================================================================
-			// initialize the data
-			_resetOutput();
+		pp2.stop();
 
-			pp2.start();
+		// verify the answers are correct
+		_verifyOutputIsCorrect(numThreads, 2);
+		
+		//======================================================================
+		// test segment #3:  slow task, broadcast once after all tasks are added
+		//======================================================================
+		// initialize the data
+		_resetOutput();
 
-			// add tasks to queue
-			_addAllTasks(false,true);
-			// wait for all tasks
-			_taskManager->waitForAllTasksToComplete();
+		pp3.start();
 
-			pp2.stop();
+		// add tasks to queue
+		_addAllTasks(taskPool,true,false);
+		taskPool->wakeUpAllSleepingWorkerThreads();
+		// wait for all tasks
+		taskPool->waitForAllTasksToComplete();
 
-			// verify the answers are correct
-			_verifyOutputIsCorrect(numThreads, 2);
-			
-			//======================================================================
-			// test segment #3:  slow task, broadcast once after all tasks are added
-			//======================================================================
-			// initialize the data
-			_resetOutput();
+		pp3.stop();
 
-			pp3.start();
+		// verify the answers are correct
+		_verifyOutputIsCorrect(numThreads, 3);
 
-			// add tasks to queue
-			_addAllTasks(true,false);
-			_taskManager->wakeUpAllSleepingWorkerThreads();
-			// wait for all tasks
-			_taskManager->waitForAllTasksToComplete();
+		//======================================================================
+		// test segment #4:  slow task, broadcast every time a task is added
+		//======================================================================
+		// initialize the data
+		_resetOutput();
 
-			pp3.stop();
+		pp4.start();
 
-			// verify the answers are correct
-			_verifyOutputIsCorrect(numThreads, 3);
+		// add tasks to queue
+		_addAllTasks(taskPool,true,true);
+		// wait for all tasks
+		taskPool->waitForAllTasksToComplete();
 
-			//======================================================================
-			// test segment #4:  slow task, broadcast every time a task is added
-			//======================================================================
-			// initialize the data
-			_resetOutput();
+		pp4.stop();
 
-			pp4.start();
+		// verify the answers are correct
+		_verifyOutputIsCorrect(numThreads, 4);
+		
+	}
+
+	std::cout << "   Success!\n";
+	std::cout << "   avg time using fast tasks with one batched broadcast: " << pp1.getAverageExecutionTime() << "\n";
+	std::cout << "   avg time using fast tasks with a broadcast per task:  " << pp2.getAverageExecutionTime() << "\n";
+	std::cout << "   avg time using slow tasks with one batched broadcast: " << pp3.getAverageExecutionTime() << "\n";
+	std::cout << "   avg time using slow tasks with a broadcast per task:  " << pp4.getAverageExecutionTime() << "\n";
+
+	return ((float)NUM_TASKS) / pp1.getAverageExecutionTime();
+}
 
-			// add tasks to queue
-			_addAllTasks(true,true);
-			// wait for all tasks
-			_taskManager->waitForAllTasksToComplete();
+template < typename TaskPoolType >
+float ThreadPoolTest::_measureLatency( TaskPoolType * taskPool )
+{
+	Task emptyTask;
+	emptyTask.function = ThreadPoolTest::threadPoolEmptyTestTask;
+	emptyTask.data = NULL;
+
+	PerformanceProfiler pp;
+	pp.reset();
+	for (unsigned int i=0; i < NUM_LATENCY_SAMPLES; i++) {
+		pp.start();
+		taskPool->addTask(emptyTask, true);
+		taskPool->waitForAllTasksToComplete();
+		pp.stop();
+	}
+	return pp.getAverageExecutionTime();
+}
 
-			pp4.stop();
+void ThreadPoolTest::_runParallelForTests( WorkStealingScheduler * scheduler, unsigned int numThreads )
+{
+	const unsigned int numItems = NUM_TASKS*16;
+	std::vector<unsigned int> visits(numItems);
+
+	// every index must be visited exactly once, with and without an explicit grain size.
+	unsigned int grainSizes[3] = { 0, 1, 1000 };
+	for (unsigned int g=0; g < 3; g++) {
+		std::fill(visits.begin(), visits.end(), 0);
+		scheduler->parallelFor(0, numItems, grainSizes[g], [&](unsigned int threadIndex, unsigned int begin, unsigned int end) {
+			if (threadIndex >= numThreads) {
+				throw GenericException("parallelFor() gave thread index " + toString(threadIndex) + " with only " + toString(numThreads) + " threads.");
+			}
+			for (unsigned int i=begin; i < end; i++) {
+				visits[i]++;
+			}
+		});
+		for (unsigned int i=0; i < numItems; i++) {
+			if (visits[i] != 1) {
+				std::cerr << "FAILED: parallelFor visited index " << i << " " << visits[i] << " times, for " << numThreads << " threads with grain size " << grainSizes[g] << ".\n";
+				throw GenericException("Unit test for WorkStealingScheduler failed.");
+			}
+		}
+	}
 
-			// verify the answers are correct
-			_verifyOutputIsCorrect(numThreads, 4);
-			
+	// fork-join: tasks that fork and wait on their own groups.
+	std::fill(visits.begin(), visits.end(), 0);
+	{
+		TaskGroup outerGroup(*scheduler);
+		for (unsigned int i=0; i < 16; i++) {
+			outerGroup.run([&, i](unsigned int threadIndex) {
+				TaskGroup innerGroup(*scheduler);
+				for (unsigned int j=0; j < NUM_TASKS; j++) {
+					innerGroup.run([&, i, j](unsigned int threadIndex) { visits[i*NUM_TASKS + j]++; });
+				}
+				innerGroup.wait();
+			});
 		}
+		outerGroup.wait();
+	}
+	for (unsigned int i=0; i < numItems; i++) {
+		if (visits[i] != 1) {
+			std::cerr << "FAILED: nested task groups ran task " << i << " " << visits[i] << " times, for " << numThreads << " threads.\n";
+			throw GenericException("Unit test for WorkStealingScheduler failed.");
+		}
+	}
 
-		delete _taskManager;
-		std::cout << "   Success!\n";
-		std::cout << "   avg time using fast tasks with one batched broadcast: " << pp1.getAverageExecutionTime() << "\n";
-		std::cout << "   avg time using fast tasks with a broadcast per task:  " << pp2.getAverageExecutionTime() << "\n";
-		std::cout << "   avg time using slow tasks with one batched broadcast: " << pp3.getAverageExecutionTime() << "\n";
-		std::cout << "   avg time using slow tasks with a broadcast per task:  " << pp4.getAverageExecutionTime() << "\n";
-		
+	// exceptions thrown by tasks are re-thrown by wait().
+	bool caughtException = false;
+	try {
+		scheduler->parallelFor(0, numItems, 1000, [&](unsigned int threadIndex, unsigned int begin, unsigned int end) {
+			if (begin == 0) throw GenericException("expected exception");
+		});
+	}
+	catch (GenericException &) {
+		caughtException = true;
+	}
+	if (!caughtException) {
+		throw GenericException("FAILED: exception thrown inside parallelFor() was not propagated.");
+	}
+
+	std::cout << "   parallelFor and nested task groups: Success!\n";
+}
+
+void ThreadPoolTest::runTest()
+{
+	// test the thread pools running from 1 to MAX_NUM_THREADS threads
+	for (unsigned int numThreads=1; numThreads<MAX_NUM_THREADS; numThreads++) {
+
+		std::cout << "Testing ThreadedTaskManager with " << numThreads << " threads:" << std::endl;
+		ThreadedTaskManager * taskManager = new ThreadedTaskManager(numThreads);
+		float oldThroughput = _runTaskQueueTests(taskManager, numThreads);
+		float oldLatency = _measureLatency(taskManager);
+		delete taskManager;
+
+		std::cout << "Testing WorkStealingScheduler with " << numThreads << " threads:" << std::endl;
+		WorkStealingScheduler * scheduler = new WorkStealingScheduler(numThreads);
+		float newThroughput = _runTaskQueueTests(scheduler, numThreads);
+		float newLatency = _measureLatency(scheduler);
+		_runParallelForTests(scheduler, numThreads);
+		delete scheduler;
+
+		std::cout << "Comparison with " << numThreads << " threads:\n";
+		std::cout << "   fast task throughput (tasks/sec), old: " << oldThroughput << ", work stealing: " << newThroughput << "\n";
+		std::cout << "   empty task latency (sec), old: " << oldLatency << ", work stealing: " << newLatency << "\n";
 	}
 	
 }
@@ -261,6 +385,1096 @@ void TimingTest::runTest()
 	/// @todo fill in the rest of the timing test unit test
 }
 
+const float NeighborQueryTest::QUERY_RADIUS = 3.0f;
+const float NeighborQueryTest::NEAREST_MAX_DISTANCE = 6.0f;
+const unsigned int NeighborQueryTest::NUM_THREADS;
+
+void NeighborQueryTest::runTest()
+{
+	// about one item per four cells, and each item overlaps up to four cells, so most cells hold several items and most items are in several cells.
+	GridDatabase2D grid(-100.0f, 100.0f, -100.0f, 100.0f, 200, 200, 7, false);
+	std::vector<TestItem> items(NUM_ITEMS);
+	RandomStream randomStream(1);
+	for (unsigned int i=0; i < NUM_ITEMS; i++) {
+		// items on a jittered lattice, so that no grid cell has more items than it can hold.
+		items[i].position = Point(-99.0f + 2.8f * (i % 70) + (float)randomStream.rand(0.8), 0.0f, -99.0f + 2.8f * (i / 70) + (float)randomStream.rand(0.8));
+		items[i].radius = 0.5f;
+		grid.addObject(&items[i], items[i].getBounds());
+	}
+
+	// the reference results, from the set-based query.
+	std::vector< std::vector<SpatialDatabaseItemPtr> > expected(NUM_ITEMS);
+	for (unsigned int i=0; i < NUM_ITEMS; i++) {
+		std::set<SpatialDatabaseItemPtr> neighbors;
+		const Point & p = items[i].position;
+		grid.getItemsInRange(neighbors, p.x - QUERY_RADIUS, p.x + QUERY_RADIUS, p.z - QUERY_RADIUS, p.z + QUERY_RADIUS, &items[i]);
+		expected[i].assign(neighbors.begin(), neighbors.end());
+	}
+
+	// correctness of the vector and visitor versions.
+	std::vector<SpatialDatabaseItemPtr> neighborList;
+	for (unsigned int i=0; i < NUM_ITEMS; i++) {
+		const Point & p = items[i].position;
+		grid.getItemsInRange(neighborList, p.x - QUERY_RADIUS, p.x + QUERY_RADIUS, p.z - QUERY_RADIUS, p.z + QUERY_RADIUS, &items[i]);
+		std::sort(neighborList.begin(), neighborList.end());
+		if (neighborList != expected[i]) {
+			throw GenericException("FAILED: the vector version of getItemsInRange() found " + toString(neighborList.size()) + " items around item " + toString(i) + ", expected " + toString(expected[i].size()) + ".");
+		}
+		unsigned int numVisited = 0;
+		grid.visitItemsInRange(p.x - QUERY_RADIUS, p.x + QUERY_RADIUS, p.z - QUERY_RADIUS, p.z + QUERY_RADIUS, &items[i], [&](SpatialDatabaseItemPtr item) { numVisited++; });
+		if (numVisited != expected[i].size()) {
+			throw GenericException("FAILED: visitItemsInRange() visited " + toString(numVisited) + " items around item " + toString(i) + ", expected " + toString(expected[i].size()) + ".");
+		}
+	}
+	std::cout << "   set, vector and visitor queries find the same items: Success!\n";
+
+	// k-nearest neighbors, against distances to all items; only the distances are compared, since items may tie.
+	{
+		const unsigned int k = NUM_NEAREST;
+		std::vector<NearestNeighbor> nearest;
+		std::vector<float> allDistances;
+		for (unsigned int i=0; i < NUM_ITEMS; i += 7) {
+			// between the items, and on them.
+			Point p = items[i].position + Vector(1.1f * (float)(i % 3), 0.0f, -0.7f * (float)(i % 2));
+			allDistances.clear();
+			for (unsigned int j=0; j < NUM_ITEMS; j++) {
+				const AxisAlignedBox & b = items[j].getBounds();
+				unsigned int xMinIndex, xMaxIndex, zMinIndex, zMaxIndex;
+				if (!grid.getIndexRangeOfBounds(b.xmin, b.xmax, b.zmin, b.zmax, xMinIndex, xMaxIndex, zMinIndex, zMaxIndex)) continue;  // the last row sticks out of the grid.
+				float dx = std::max(std::max(b.xmin - p.x, p.x - b.xmax), 0.0f);
+				float dz = std::max(std::max(b.zmin - p.z, p.z - b.zmax), 0.0f);
+				float d = dx * dx + dz * dz;
+				if ((j != i) && (d <= NEAREST_MAX_DISTANCE * NEAREST_MAX_DISTANCE)) allDistances.push_back(d);
+			}
+			std::sort(allDistances.begin(), allDistances.end());
+			if (allDistances.size() > k) allDistances.resize(k);
+
+			grid.getKNearestNeighbors(nearest, p, k, NEAREST_MAX_DISTANCE, &items[i], NEIGHBOR_FILTER_OBSTACLES);
+			bool same = (nearest.size() == allDistances.size());
+			for (unsigned int n=0; same && (n < nearest.size()); n++) {
+				same = (nearest[n].distanceSquared == allDistances[n]);
+			}
+			if (!same) {
+				throw GenericException("FAILED: getKNearestNeighbors() found " + toString(nearest.size()) + " items near item " + toString(i) + ", expected " + toString(allDistances.size()) + " at the same distances.");
+			}
+			if (grid.getKNearestNeighbors(nearest, p, k, NEAREST_MAX_DISTANCE, &items[i], NEIGHBOR_FILTER_AGENTS) != 0) {
+				throw GenericException("FAILED: getKNearestNeighbors() found agents, but there are only obstacles.");
+			}
+		}
+		std::cout << "   k-nearest neighbor queries find the closest items: Success!\n";
+	}
+
+	// concurrent queries each use their own stamps.
+	{
+		WorkStealingScheduler scheduler(NUM_THREADS);
+		std::atomic<unsigned int> numMismatches(0);
+		for (unsigned int r=0; r < NUM_REPEATS; r++) {
+			scheduler.parallelFor(0, NUM_ITEMS, 16, [&](unsigned int threadIndex, unsigned int begin, unsigned int end) {
+				std::vector<SpatialDatabaseItemPtr> threadNeighborList;
+				for (unsigned int i=begin; i < end; i++) {
+					const Point & p = items[i].position;
+					grid.getItemsInRange(threadNeighborList, p.x - QUERY_RADIUS, p.x + QUERY_RADIUS, p.z - QUERY_RADIUS, p.z + QUERY_RADIUS, &items[i]);
+					if (threadNeighborList.size() != expected[i].size()) numMismatches++;
+				}
+			});
+		}
+		if (numMismatches.load() != 0) {
+			throw GenericException("FAILED: " + toString(numMismatches.load()) + " concurrent queries found the wrong number of items.");
+		}
+		std::cout << "   concurrent vector queries on " << NUM_THREADS << " threads: Success!\n";
+	}
+
+	// benchmark; the checksum keeps the compiler from dropping the queries.
+	unsigned long long checksum = 0;
+	unsigned int numQueries = NUM_ITEMS * NUM_REPEATS;
+	PerformanceProfiler setProfiler, vectorProfiler, visitorProfiler, nearestProfiler;
+
+	setProfiler.reset();
+	setProfiler.start();
+	for (unsigned int r=0; r < NUM_REPEATS; r++) {
+		for (unsigned int i=0; i < NUM_ITEMS; i++) {
+			std::set<SpatialDatabaseItemPtr> neighbors;
+			const Point & p = items[i].position;
+			grid.getItemsInRange(neighbors, p.x - QUERY_RADIUS, p.x + QUERY_RADIUS, p.z - QUERY_RADIUS, p.z + QUERY_RADIUS, &items[i]);
+			checksum += neighbors.size();
+		}
+	}
+	setProfiler.stop();
+
+	vectorProfiler.reset();
+	vectorProfiler.start();
+	for (unsigned int r=0; r < NUM_REPEATS; r++) {
+		for (unsigned int i=0; i < NUM_ITEMS; i++) {
+			const Point & p = items[i].position;
+			grid.getItemsInRange(neighborList, p.x - QUERY_RADIUS, p.x + QUERY_RADIUS, p.z - QUERY_RADIUS, p.z + QUERY_RADIUS, &items[i]);
+			checksum += neighborList.size();
+		}
+	}
+	vectorProfiler.stop();
+
+	visitorProfiler.reset();
+	visitorProfiler.start();
+	for (unsigned int r=0; r < NUM_REPEATS; r++) {
+		for (unsigned int i=0; i < NUM_ITEMS; i++) {
+			const Point & p = items[i].position;
+			grid.visitItemsInRange(p.x - QUERY_RADIUS, p.x + QUERY_RADIUS, p.z - QUERY_RADIUS, p.z + QUERY_RADIUS, &items[i], [&](SpatialDatabaseItemPtr item) { checksum++; });
+		}
+	}
+	visitorProfiler.stop();
+
+	std::vector<NearestNeighbor> nearest;
+	nearestProfiler.reset();
+	nearestProfiler.start();
+	for (unsigned int r=0; r < NUM_REPEATS; r++) {
+		for (unsigned int i=0; i < NUM_ITEMS; i++) {
+			checksum += grid.getKNearestNeighbors(nearest, items[i].position, NUM_NEAREST, NEAREST_MAX_DISTANCE, &items[i], NEIGHBOR_FILTER_ALL);
+		}
+	}
+	nearestProfiler.stop();
+
+	float setTime = setProfiler.getTotalTime();
+	float vectorTime = vectorProfiler.getTotalTime();
+	float visitorTime = visitorProfiler.getTotalTime();
+	std::cout << "Neighbor queries (" << numQueries << " queries, checksum " << checksum << "):\n";
+	std::cout << "   std::set (queries/sec): " << numQueries / setTime << "\n";
+	std::cout << "   reused std::vector (queries/sec): " << numQueries / vectorTime << ", " << setTime / vectorTime << "x faster\n";
+	std::cout << "   visitor (queries/sec): " << numQueries / visitorTime << ", " << setTime / visitorTime << "x faster\n";
+	std::cout << "   " << NUM_NEAREST << " nearest within " << NEAREST_MAX_DISTANCE << " (queries/sec): " << numQueries / nearestProfiler.getTotalTime() << "\n";
+
+	for (unsigned int i=0; i < NUM_ITEMS; i++) {
+		grid.removeObject(&items[i], items[i].getBounds());
+	}
+
+	// a crowd in one cell that holds only two items without its overflow list.
+	{
+		GridDatabase2D smallGrid(-10.0f, 10.0f, -10.0f, 10.0f, 20, 20, 2, false);
+		std::vector<TestItem> crowd(40);
+		for (unsigned int i=0; i < crowd.size(); i++) {
+			crowd[i].position = Point(0.5f + 0.01f * (float)i, 0.0f, 0.5f);
+			crowd[i].radius = 0.1f;
+			smallGrid.addObject(&crowd[i], crowd[i].getBounds());
+		}
+		for (unsigned int i=0; i < crowd.size(); i += 3) {
+			smallGrid.removeObject(&crowd[i], crowd[i].getBounds());
+		}
+		unsigned int numExpected = (unsigned int)crowd.size() - ((unsigned int)crowd.size() + 2) / 3;
+		smallGrid.getItemsInRange(neighborList, 0.0f, 1.0f, 0.0f, 1.0f, NULL);
+		std::set<SpatialDatabaseItemPtr> found(neighborList.begin(), neighborList.end());
+		if ((neighborList.size() != numExpected) || (found.size() != numExpected) || (found.count(&crowd[0]) != 0) || (found.count(&crowd[1]) != 1)) {
+			throw GenericException("FAILED: a grid cell with " + toString(numExpected) + " items returned " + toString(neighborList.size()) + ".");
+		}
+		for (unsigned int i=0; i < crowd.size(); i++) {
+			if (i % 3 != 0) smallGrid.removeObject(&crowd[i], crowd[i].getBounds());
+		}
+		smallGrid.getItemsInRange(neighborList, 0.0f, 1.0f, 0.0f, 1.0f, NULL);
+		if (!neighborList.empty()) {
+			throw GenericException("FAILED: a grid cell still has " + toString(neighborList.size()) + " items after all were removed.");
+		}
+		std::cout << "   grid cells with more items than maxItemsPerCell: Success!\n";
+	}
+
+	// a large, mostly empty grid only allocates the tiles of the cells that hold something.
+	{
+		GridDatabase2D sparseGrid(-256.0f, 256.0f, -256.0f, 256.0f, 1024, 1024, 7, false);
+		std::vector<TestItem> landmarks(3);
+		landmarks[0].position = Point(-252.0f, 0.0f, -252.0f);
+		landmarks[1].position = Point(204.0f, 0.0f, 4.0f);
+		landmarks[2].position = Point(252.0f, 0.0f, 252.0f);
+		for (unsigned int i=0; i < landmarks.size(); i++) {
+			landmarks[i].radius = 0.5f;
+			sparseGrid.addObject(&landmarks[i], landmarks[i].getBounds());
+		}
+		sparseGrid.getItemsInRange(neighborList, -256.0f, 256.0f, -256.0f, 256.0f, NULL);
+		Ray ray;
+		ray.initWithLengthInterval(Point(-200.0f, 0.0f, 4.0f), Vector(450.0f, 0.0f, 0.0f));
+		float t;
+		SpatialDatabaseItemPtr hitObject = NULL;
+		bool hit = sparseGrid.trace(ray, t, hitObject, NULL, false);
+		ray.initWithLengthInterval(Point(-255.0f, 0.0f, 4.0f), Vector(-50.0f, 0.0f, 0.0f));
+		bool hitOutside = sparseGrid.trace(ray, t, hitObject, NULL, false);
+		if ((sparseGrid.getNumTilesAllocated() != landmarks.size()) || (neighborList.size() != landmarks.size()) || !hit || hitOutside) {
+			throw GenericException("FAILED: a sparse grid with " + toString(landmarks.size()) + " items allocated " + toString(sparseGrid.getNumTilesAllocated()) + " tiles, and found " + toString(neighborList.size()) + " items.");
+		}
+		// removing an item from where it never was is an error, but must not allocate the tiles there.
+		TestItem stranger;
+		stranger.position = Point(0.0f, 0.0f, -200.0f);
+		stranger.radius = 0.5f;
+		bool removedStranger = true;
+		try {
+			sparseGrid.removeObject(&stranger, stranger.getBounds());
+		}
+		catch (GenericException &) {
+			removedStranger = false;
+		}
+		if (removedStranger || (sparseGrid.getNumTilesAllocated() != landmarks.size())) {
+			throw GenericException("FAILED: removing an item that was not in a sparse grid allocated " + toString(sparseGrid.getNumTilesAllocated() - landmarks.size()) + " tiles.");
+		}
+		std::cout << "   sparse grid tiles: Success!\n";
+	}
+
+	// Morton numbering changes the cell indices and the order of cells in memory, but not what the queries find.
+	{
+		GridDatabase2D oddGrid(-10.0f, 10.0f, -10.0f, 10.0f, 37, 53, 7, false);
+		oddGrid.setCellNumbering(CELL_NUMBERING_MORTON);
+		std::set<unsigned int> indices;
+		for (unsigned int x=0; x < oddGrid.getNumCellsX(); x++) {
+			for (unsigned int z=0; z < oddGrid.getNumCellsZ(); z++) {
+				unsigned int cellIndex = oddGrid.getCellIndexFromGridCoords(x, z);
+				unsigned int xIndex, zIndex;
+				oddGrid.getGridCoordinatesFromIndex(cellIndex, xIndex, zIndex);
+				if ((xIndex != x) || (zIndex != z) || (cellIndex >= oddGrid.getCellIndexLimit()) || !indices.insert(cellIndex).second) {
+					throw GenericException("FAILED: Morton cell index " + toString(cellIndex) + " of cell (" + toString(x) + "," + toString(z) + ") does not convert back.");
+				}
+			}
+		}
+
+		GridDatabase2D mortonGrid(-100.0f, 100.0f, -100.0f, 100.0f, 200, 200, 7, false);
+		mortonGrid.setCellNumbering(CELL_NUMBERING_MORTON);
+		for (unsigned int i=0; i < NUM_ITEMS; i++) {
+			mortonGrid.addObject(&items[i], items[i].getBounds());
+		}
+		for (unsigned int i=0; i < NUM_ITEMS; i++) {
+			const Point & p = items[i].position;
+			mortonGrid.getItemsInRange(neighborList, p.x - QUERY_RADIUS, p.x + QUERY_RADIUS, p.z - QUERY_RADIUS, p.z + QUERY_RADIUS, &items[i]);
+			std::sort(neighborList.begin(), neighborList.end());
+			if (neighborList != expected[i]) {
+				throw GenericException("FAILED: with Morton numbering, getItemsInRange() found " + toString(neighborList.size()) + " items around item " + toString(i) + ", expected " + toString(expected[i].size()) + ".");
+			}
+		}
+		std::cout << "   Morton cell numbering: Success!\n";
+	}
+
+	// moves applied in one deferred batch, whether made from one thread or from several, must leave the cells exactly
+	// as moves applied one at a time; the second frame reuses the buffers of the threads.
+	{
+		GridDatabase2D immediateGrid(-10.0f, 10.0f, -10.0f, 10.0f, 20, 20, 2, false);
+		GridDatabase2D batchedGrid(-10.0f, 10.0f, -10.0f, 10.0f, 20, 20, 2, false);
+		GridDatabase2D parallelGrid(-10.0f, 10.0f, -10.0f, 10.0f, 20, 20, 2, false);
+		std::vector<TestItem> walkers(60);
+		std::vector<SpatialDatabaseItemPtr> order;
+		for (unsigned int i=0; i < walkers.size(); i++) {
+			walkers[i].position = Point(-3.0f + 0.1f * (float)i, 0.0f, 0.2f * (float)(i % 7));
+			walkers[i].radius = 0.2f;
+			immediateGrid.addObject(&walkers[i], walkers[i].getBounds());
+			batchedGrid.addObject(&walkers[i], walkers[i].getBounds());
+			parallelGrid.addObject(&walkers[i], walkers[i].getBounds());
+			order.push_back(&walkers[i]);
+		}
+
+		WorkStealingScheduler scheduler(NUM_THREADS);
+		for (unsigned int frame=0; frame < 2; frame++) {
+			std::vector<AxisAlignedBox> oldBounds(walkers.size()), newBounds(walkers.size());
+			for (unsigned int i=0; i < walkers.size(); i++) {
+				oldBounds[i] = walkers[i].getBounds();
+				// most walkers stay in their cells, some cross into the next one.
+				walkers[i].position.x += (i % 4 == 0) ? 0.6f : 0.02f;
+				newBounds[i] = walkers[i].getBounds();
+				immediateGrid.updateObject(&walkers[i], oldBounds[i], newBounds[i]);
+			}
+
+			batchedGrid.beginDeferredUpdates();
+			for (unsigned int i=0; i < walkers.size(); i++) {
+				batchedGrid.updateObject(&walkers[i], oldBounds[i], newBounds[i]);
+			}
+			batchedGrid.commitDeferredUpdates(order);
+			batchedGrid.endDeferredUpdates();
+
+			parallelGrid.beginDeferredUpdates();
+			scheduler.parallelFor(0, (unsigned int)walkers.size(), 4, [&](unsigned int threadIndex, unsigned int begin, unsigned int end) {
+				for (unsigned int i=begin; i < end; i++) {
+					parallelGrid.updateObject(&walkers[i], oldBounds[i], newBounds[i]);
+				}
+			});
+			parallelGrid.commitDeferredUpdates(order);
+			parallelGrid.endDeferredUpdates();
+		}
+
+		std::vector<GridCellEntry> immediateEntries, batchedEntries, parallelEntries;
+		immediateGrid.visitEntriesInRange(-10.0f, 10.0f, -10.0f, 10.0f, NULL, [&immediateEntries](const GridCellEntry & entry) { immediateEntries.push_back(entry); });
+		batchedGrid.visitEntriesInRange(-10.0f, 10.0f, -10.0f, 10.0f, NULL, [&batchedEntries](const GridCellEntry & entry) { batchedEntries.push_back(entry); });
+		parallelGrid.visitEntriesInRange(-10.0f, 10.0f, -10.0f, 10.0f, NULL, [&parallelEntries](const GridCellEntry & entry) { parallelEntries.push_back(entry); });
+		if (immediateEntries.size() != walkers.size()) {
+			throw GenericException("FAILED: the grid holds " + toString(immediateEntries.size()) + " of " + toString(walkers.size()) + " moved items.");
+		}
+		for (unsigned int i=0; i < immediateEntries.size(); i++) {
+			if ((i >= batchedEntries.size()) || (batchedEntries[i].item != immediateEntries[i].item) || (batchedEntries[i].xmin != immediateEntries[i].xmin)) {
+				throw GenericException("FAILED: deferred updates left the grid cells different from immediate updates.");
+			}
+			if ((i >= parallelEntries.size()) || (parallelEntries[i].item != immediateEntries[i].item) || (parallelEntries[i].xmin != immediateEntries[i].xmin)) {
+				throw GenericException("FAILED: deferred updates made from " + toString(NUM_THREADS) + " threads left the grid cells different from immediate updates.");
+			}
+			TestItem * walker = dynamic_cast<TestItem*>(immediateEntries[i].item);
+			if (immediateEntries[i].xmin != walker->getBounds().xmin) {
+				throw GenericException("FAILED: a grid cell did not refresh the bounds of an item that stayed in it.");
+			}
+		}
+		std::cout << "   deferred moves from 1 and " << NUM_THREADS << " threads and immediate moves leave the same grid cells: Success!\n";
+	}
+
+	// rebuilding the agent layer must find the same agents as updating it, and must not depend on the number of threads.
+	{
+		const unsigned int numThreads = NUM_THREADS;
+		WorkStealingScheduler scheduler(numThreads);
+		GridDatabase2D updatedGrid(-10.0f, 10.0f, -10.0f, 10.0f, 20, 20, 2, false);
+		GridDatabase2D rebuiltGrid(-10.0f, 10.0f, -10.0f, 10.0f, 20, 20, 2, false);
+		GridDatabase2D parallelGrid(-10.0f, 10.0f, -10.0f, 10.0f, 20, 20, 2, false);
+		rebuiltGrid.setDynamicLayerMode(DYNAMIC_LAYER_REBUILD);
+		parallelGrid.setDynamicLayerMode(DYNAMIC_LAYER_REBUILD, &scheduler);
+		GridDatabase2D * grids[3] = { &updatedGrid, &rebuiltGrid, &parallelGrid };
+
+		std::vector<TestAgent> walkers(300);
+		for (unsigned int i=0; i < walkers.size(); i++) {
+			walkers[i].position = Point(-8.0f + 0.05f * (float)i, 0.0f, -2.0f + 0.3f * (float)(i % 13));
+			walkers[i].radius = 0.3f;
+			for (unsigned int g=0; g < 3; g++) grids[g]->addObject(&walkers[i], walkers[i].getBounds());
+		}
+
+		for (unsigned int frame=0; frame < 5; frame++) {
+			for (unsigned int g=0; g < 3; g++) grids[g]->beginDeferredUpdates();
+			for (unsigned int i=0; i < walkers.size(); i++) {
+				AxisAlignedBox oldBounds = walkers[i].getBounds();
+				walkers[i].position.x += 0.1f * (float)(i % 5);
+				for (unsigned int g=0; g < 3; g++) {
+					if (i % 50 == frame) grids[g]->removeObject(&walkers[i], oldBounds);
+					else grids[g]->updateObject(&walkers[i], oldBounds, walkers[i].getBounds());
+				}
+				if (i % 50 == frame) walkers[i].position.x = 100.0f;
+			}
+			for (unsigned int g=0; g < 3; g++) grids[g]->endDeferredUpdates();
+		}
+
+		std::vector<GridCellEntry> entries[3];
+		for (unsigned int g=0; g < 3; g++) {
+			grids[g]->visitEntriesInRange(-10.0f, 10.0f, -10.0f, 10.0f, NULL, [&entries, g](const GridCellEntry & entry) { entries[g].push_back(entry); });
+		}
+		for (unsigned int i=0; i < entries[1].size(); i++) {
+			if ((entries[1].size() != entries[2].size()) || (entries[1][i].item != entries[2][i].item)) {
+				throw GenericException("FAILED: rebuilding the agent layer on " + toString(numThreads) + " threads sorted the grid cells differently.");
+			}
+		}
+		for (unsigned int i=0; i < walkers.size(); i++) {
+			std::vector<SpatialDatabaseItemPtr> updatedNeighbors, rebuiltNeighbors;
+			const AxisAlignedBox & bounds = walkers[i].getBounds();
+			updatedGrid.getItemsInRange(updatedNeighbors, bounds.xmin - 1.0f, bounds.xmax + 1.0f, bounds.zmin - 1.0f, bounds.zmax + 1.0f, NULL);
+			rebuiltGrid.getItemsInRange(rebuiltNeighbors, bounds.xmin - 1.0f, bounds.xmax + 1.0f, bounds.zmin - 1.0f, bounds.zmax + 1.0f, NULL);
+			std::sort(updatedNeighbors.begin(), updatedNeighbors.end());
+			std::sort(rebuiltNeighbors.begin(), rebuiltNeighbors.end());
+			if (updatedNeighbors != rebuiltNeighbors) {
+				throw GenericException("FAILED: the rebuilt agent layer found " + toString(rebuiltNeighbors.size()) + " items near item " + toString(i) + ", the updated one " + toString(updatedNeighbors.size()) + ".");
+			}
+		}
+		std::cout << "   rebuilding the agent layer (" << entries[1].size() << " agents): Success!\n";
+	}
+}
+
+std::vector<char> DeterminismTest::_simulate(const std::string & testCaseName, unsigned int numThreads)
+{
+	SimulationOptions options;
+	options.engineOptions.numThreads = numThreads;
+	options.engineOptions.numFramesToSimulate = NUM_FRAMES;
+	options.engineOptions.startupModules.insert("testCasePlayer");
+	options.engineOptions.startupModules.insert("sfAI");
+	options.moduleOptionsDatabase["testCasePlayer"]["testcase"] = testCaseName;
+	options.moduleOptionsDatabase["testCasePlayer"]["ai"] = "sfAI";
+
+	SimulationEngine engine;
+	engine.init(&options, this);
+	engine.initializeSimulation();
+	engine.preprocessSimulation();
+	while (engine.update(false)) {
+	}
+
+	// only the agents; the engine's own part of a checkpoint includes the grid cells, whose order may differ.
+	CheckpointWriter agentStates;
+	const std::vector<AgentInterface*> & agents = engine.getAgents();
+	for (unsigned int i=0; i < agents.size(); i++) {
+		agents[i]->writeCheckpoint(agentStates);
+	}
+
+	engine.postprocessSimulation();
+	engine.cleanupSimulation();
+	engine.finish();
+
+	return agentStates.getData();
+}
+
+void DeterminismTest::runTest()
+{
+	const char * testCaseNames[] = { "concentric-circles_500", "bottleneck-evacuation" };
+
+	for (unsigned int t=0; t < sizeof(testCaseNames) / sizeof(testCaseNames[0]); t++) {
+		std::vector<char> reference = _simulate(testCaseNames[t], 1);
+		for (unsigned int numThreads=2; numThreads <= MAX_NUM_THREADS; numThreads++) {
+			for (unsigned int r=0; r < NUM_REPEATS; r++) {
+				if (_simulate(testCaseNames[t], numThreads) != reference) {
+					throw GenericException("FAILED: " + std::string(testCaseNames[t]) + " on " + toString(numThreads) + " threads (run " + toString(r+1) + ") ended in a different state than on 1 thread.");
+				}
+			}
+		}
+		std::cout << "   " << testCaseNames[t] << " on 1 to " << MAX_NUM_THREADS << " threads: Success!\n";
+	}
+}
+
+std::vector<char> CheckpointTest::_getAgentStates(SimulationEngine & engine)
+{
+	CheckpointWriter agentStates;
+	const std::vector<AgentInterface*> & agents = engine.getAgents();
+	for (unsigned int i=0; i < agents.size(); i++) {
+		agents[i]->writeCheckpoint(agentStates);
+	}
+	return agentStates.getData();
+}
+
+void CheckpointTest::_simulateFrames(SimulationEngine & engine, unsigned int numFrames)
+{
+	for (unsigned int i=0; i < numFrames; i++) {
+		if (!engine.update(false)) {
+			throw GenericException("FAILED: the simulation stopped after " + toString(i) + " of " + toString(numFrames) + " frames.");
+		}
+	}
+}
+
+void CheckpointTest::runTest()
+{
+	// values, vectors, strings and nested blocks must read back exactly as they were written.
+	{
+		std::vector<float> floats;
+		for (unsigned int i=0; i < 100; i++) {
+			floats.push_back(0.1f * (float)i);
+		}
+		CheckpointWriter out;
+		out.write(42u);
+		out.beginBlock();
+		out.write(Point(1.0f, 2.0f, 3.0f));
+		out.writeString("checkpoint");
+		out.beginBlock();
+		out.writeVector(floats);
+		out.endBlock();
+		out.writeItemReference(NULL);
+		out.endBlock();
+		out.beginBlock();
+		out.write(3.5);
+		out.endBlock();
+		out.writeString("");
+
+		std::shared_ptr<std::vector<char> > data(new std::vector<char>(out.getData()));
+		CheckpointReader in;
+		in.loadFromMemory(data);
+		unsigned int number;
+		Point point;
+		std::string text;
+		std::vector<float> readFloats;
+		std::string emptyText = "not empty";
+		in.read(number);
+		in.beginBlock();
+		in.read(point);
+		in.readString(text);
+		in.beginBlock();
+		in.readVector(readFloats);
+		in.endBlock();
+		SpatialDatabaseItem * item = in.readItemReference();
+		in.endBlock();
+		in.skipBlock();
+		in.readString(emptyText);
+		if ((number != 42) || (point != Point(1.0f, 2.0f, 3.0f)) || (text != "checkpoint") || (readFloats != floats) || (item != NULL) || (!emptyText.empty())) {
+			throw GenericException("FAILED: the checkpoint did not read back the values that were written.");
+		}
+		if (!in.isAtEnd()) {
+			throw GenericException("FAILED: the checkpoint has data left after everything was read.");
+		}
+		std::cout << "   values read back unchanged (" << out.getSize() << " bytes): Success!\n";
+
+		// a block that is not read to its end, and data that ends too early, must be reported.
+		bool shortBlockDetected = false;
+		CheckpointReader shortBlockReader;
+		shortBlockReader.loadFromMemory(data);
+		shortBlockReader.read(number);
+		shortBlockReader.beginBlock();
+		shortBlockReader.read(point);
+		try {
+			shortBlockReader.endBlock();
+		}
+		catch (GenericException & ) {
+			shortBlockDetected = true;
+		}
+
+		bool truncationDetected = false;
+		std::shared_ptr<std::vector<char> > truncatedData(new std::vector<char>(data->begin(), data->begin() + data->size() / 2));
+		CheckpointReader truncatedReader;
+		truncatedReader.loadFromMemory(truncatedData);
+		truncatedReader.read(number);
+		try {
+			truncatedReader.skipBlock();
+		}
+		catch (GenericException & ) {
+			truncationDetected = true;
+		}
+
+		if (!shortBlockDetected || !truncationDetected) {
+			throw GenericException("FAILED: reading a block short, or past the end of a truncated checkpoint, was not reported.");
+		}
+		std::cout << "   short blocks and truncated checkpoints are reported: Success!\n";
+	}
+
+	// restoring a checkpoint of a simulation, from memory or from a file, must repeat the frames that followed it exactly,
+	// along with the benchmark score and the frames recorded by the modules.
+	{
+		const std::string testCaseName = "bottleneck-evacuation";
+		const std::string checkpointFilename = "checkpointtest.tmp";
+		const std::string recFilename = "checkpointtest.rec";
+		SimulationOptions options;
+		options.engineOptions.numFramesToSimulate = 4 * NUM_FRAMES;
+		options.engineOptions.startupModules.insert("testCasePlayer");
+		options.engineOptions.startupModules.insert("sfAI");
+		options.engineOptions.startupModules.insert("steerBench");
+		options.engineOptions.startupModules.insert("simulationRecorder");
+		options.moduleOptionsDatabase["testCasePlayer"]["testcase"] = testCaseName;
+		options.moduleOptionsDatabase["testCasePlayer"]["ai"] = "sfAI";
+		options.moduleOptionsDatabase["simulationRecorder"]["recfile"] = recFilename;
+
+		SimulationEngine engine;
+		engine.init(&options, this);
+		engine.initializeSimulation();
+		engine.preprocessSimulation();
+		_simulateFrames(engine, NUM_FRAMES);
+
+		CheckpointWriter checkpoint;
+		engine.writeCheckpoint(checkpoint);
+		engine.saveCheckpoint(checkpointFilename);
+		std::shared_ptr<std::vector<char> > checkpointData(new std::vector<char>(checkpoint.getData()));
+		std::vector<char> statesAtCheckpoint = _getAgentStates(engine);
+
+		_simulateFrames(engine, NUM_FRAMES);
+		std::vector<char> reference = _getAgentStates(engine);
+		SteerBenchModule * steerBench = dynamic_cast<SteerBenchModule*>(engine.getModule("steerBench"));
+		float referenceScore = steerBench->getTotalBenchmarkScore();
+		if (reference == statesAtCheckpoint) {
+			throw GenericException("FAILED: the agents of " + testCaseName + " did not move after the checkpoint, so restoring it proves nothing.");
+		}
+
+		CheckpointReader memoryReader;
+		memoryReader.loadFromMemory(checkpointData);
+		engine.readCheckpoint(memoryReader);
+		if (_getAgentStates(engine) != statesAtCheckpoint) {
+			throw GenericException("FAILED: restoring the checkpoint from memory did not bring back the agents' states.");
+		}
+		_simulateFrames(engine, NUM_FRAMES);
+		if ((_getAgentStates(engine) != reference) || (steerBench->getTotalBenchmarkScore() != referenceScore)) {
+			throw GenericException("FAILED: after restoring the checkpoint from memory, the same frames ended in a different state or benchmark score.");
+		}
+
+		engine.restoreCheckpoint(checkpointFilename);
+		std::remove(checkpointFilename.c_str());
+		_simulateFrames(engine, NUM_FRAMES);
+		if ((_getAgentStates(engine) != reference) || (steerBench->getTotalBenchmarkScore() != referenceScore)) {
+			throw GenericException("FAILED: after restoring the checkpoint from a file, the same frames ended in a different state or benchmark score.");
+		}
+
+		engine.postprocessSimulation();
+		engine.cleanupSimulation();
+		engine.finish();
+
+		// the frames recorded after the checkpoint was saved were discarded on every restore.
+		unsigned int numRecordedFrames;
+		{
+			RecFileReader recording(recFilename);
+			numRecordedFrames = recording.getNumFrames();
+			recording.close();
+		}
+		std::remove(recFilename.c_str());
+		if (numRecordedFrames != 2 * NUM_FRAMES + 1) {
+			throw GenericException("FAILED: the recording has " + toString(numRecordedFrames) + " frames, expected " + toString(2 * NUM_FRAMES + 1) + ".");
+		}
+		std::cout << "   " << testCaseName << " repeats " << NUM_FRAMES << " frames after restoring a checkpoint: Success!\n";
+	}
+}
+
+void AgentRegistryTest::_checkRegistry(const AgentRegistry & registry, const std::map<AgentInterface*, std::pair<ModuleInterface*, AgentHandle> > & expected)
+{
+	const std::vector<AgentInterface*> & agents = registry.getAgents();
+	if ((registry.size() != expected.size()) || (agents.size() != expected.size())) {
+		throw GenericException("FAILED: the registry holds " + toString(registry.size()) + " agents, expected " + toString(expected.size()) + ".");
+	}
+	for (unsigned int i=0; i < agents.size(); i++) {
+		if ((expected.find(agents[i]) == expected.end()) || (registry.getDenseIndex(agents[i]) != i)) {
+			throw GenericException("FAILED: agent " + toString(i) + " of the dense list is unexpected, or does not know its position in it.");
+		}
+	}
+
+	std::map<ModuleInterface*, unsigned int> numAgentsOfOwner;
+	std::map<AgentInterface*, std::pair<ModuleInterface*, AgentHandle> >::const_iterator iter;
+	for (iter = expected.begin(); iter != expected.end(); ++iter) {
+		AgentInterface * agent = iter->first;
+		if (!registry.contains(agent) || (registry.getOwner(agent) != iter->second.first)) {
+			throw GenericException("FAILED: the registry lost an agent, or its owner.");
+		}
+		if ((registry.getHandle(agent) != iter->second.second) || (registry.getAgent(iter->second.second) != agent)) {
+			throw GenericException("FAILED: the handle of an agent changed, or no longer refers to it.");
+		}
+		const std::vector<AgentInterface*> & ownerAgents = registry.getAgentsOfOwner(iter->second.first);
+		if (std::find(ownerAgents.begin(), ownerAgents.end(), agent) == ownerAgents.end()) {
+			throw GenericException("FAILED: an agent is missing from the list of its owner.");
+		}
+		numAgentsOfOwner[iter->second.first]++;
+	}
+	std::map<ModuleInterface*, unsigned int>::iterator ownerIter;
+	for (ownerIter = numAgentsOfOwner.begin(); ownerIter != numAgentsOfOwner.end(); ++ownerIter) {
+		if (registry.getAgentsOfOwner(ownerIter->first).size() != ownerIter->second) {
+			throw GenericException("FAILED: the list of an owner has " + toString(registry.getAgentsOfOwner(ownerIter->first).size()) + " agents, expected " + toString(ownerIter->second) + ".");
+		}
+	}
+}
+
+void AgentRegistryTest::runTest()
+{
+	// addresses that stand in for agents and modules; the registry only compares them.
+	std::vector<char> agentAddresses(2 * NUM_AGENTS);
+	char moduleAddresses[2];
+	ModuleInterface * owners[2] = { reinterpret_cast<ModuleInterface*>(&moduleAddresses[0]), reinterpret_cast<ModuleInterface*>(&moduleAddresses[1]) };
+
+	AgentRegistry registry;
+	std::map<AgentInterface*, std::pair<ModuleInterface*, AgentHandle> > expected;
+	std::set<unsigned int> serialNumbers;
+
+	for (unsigned int i=0; i < NUM_AGENTS; i++) {
+		AgentInterface * agent = reinterpret_cast<AgentInterface*>(&agentAddresses[i]);
+		AgentHandle handle = registry.add(agent, owners[i % 2]);
+		expected[agent] = std::make_pair(owners[i % 2], handle);
+		serialNumbers.insert(registry.getSerialNumber(agent));
+	}
+	_checkRegistry(registry, expected);
+	std::cout << "   adding " << NUM_AGENTS << " agents: Success!\n";
+
+	// removing every third agent makes its handle stale, and moves other agents within the dense and owner lists.
+	std::vector<AgentHandle> removedHandles;
+	for (unsigned int i=0; i < NUM_AGENTS; i += 3) {
+		AgentInterface * agent = reinterpret_cast<AgentInterface*>(&agentAddresses[i]);
+		if (registry.remove(agent) != owners[i % 2]) {
+			throw GenericException("FAILED: removing an agent did not return its owner.");
+		}
+		removedHandles.push_back(expected[agent].second);
+		expected.erase(agent);
+	}
+	_checkRegistry(registry, expected);
+	for (unsigned int i=0; i < removedHandles.size(); i++) {
+		if (registry.getAgent(removedHandles[i]) != NULL) {
+			throw GenericException("FAILED: the handle of a removed agent still refers to an agent.");
+		}
+	}
+	std::cout << "   removing " << removedHandles.size() << " agents: Success!\n";
+
+	// new agents fill the free slots before the registry grows, and the old handles to those slots stay stale.
+	for (unsigned int i=0; i < removedHandles.size(); i++) {
+		AgentInterface * agent = reinterpret_cast<AgentInterface*>(&agentAddresses[NUM_AGENTS + i]);
+		AgentHandle handle = registry.add(agent, owners[1]);
+		if ((handle.index >= NUM_AGENTS) || (handle.generation == 0)) {
+			throw GenericException("FAILED: a new agent got slot " + toString(handle.index) + " of generation " + toString(handle.generation) + ", instead of reusing a free slot.");
+		}
+		if (!serialNumbers.insert(registry.getSerialNumber(agent)).second) {
+			throw GenericException("FAILED: a new agent got the serial number of a removed agent.");
+		}
+		expected[agent] = std::make_pair(owners[1], handle);
+	}
+	_checkRegistry(registry, expected);
+	for (unsigned int i=0; i < removedHandles.size(); i++) {
+		if (registry.getAgent(removedHandles[i]) != NULL) {
+			throw GenericException("FAILED: the handle of a removed agent refers to the new agent in its slot.");
+		}
+	}
+	std::cout << "   reusing " << removedHandles.size() << " slots: Success!\n";
+
+	// removing an unknown agent is an error, and clear() makes every handle stale.
+	bool unknownAgentDetected = false;
+	try {
+		registry.remove(reinterpret_cast<AgentInterface*>(&agentAddresses[0]));
+	}
+	catch (GenericException & ) {
+		unknownAgentDetected = true;
+	}
+	if (!unknownAgentDetected) {
+		throw GenericException("FAILED: removing an agent that was already removed was not reported.");
+	}
+
+	registry.clear();
+	expected.clear();
+	_checkRegistry(registry, expected);
+	if (registry.getAgentsOfOwner(owners[0]).size() + registry.getAgentsOfOwner(owners[1]).size() != 0) {
+		throw GenericException("FAILED: the owners still have agents after clear().");
+	}
+	AgentInterface * firstAgent = reinterpret_cast<AgentInterface*>(&agentAddresses[0]);
+	AgentHandle newHandle = registry.add(firstAgent, owners[0]);
+	for (unsigned int i=0; i < removedHandles.size(); i++) {
+		if (registry.getAgent(removedHandles[i]) != NULL) {
+			throw GenericException("FAILED: a handle from before clear() refers to a new agent.");
+		}
+	}
+	if ((registry.getAgent(newHandle) != firstAgent) || (registry.getSerialNumber(firstAgent) != 0)) {
+		throw GenericException("FAILED: the first agent after clear() did not get a valid handle and serial number 0.");
+	}
+	std::cout << "   clear() makes all handles stale: Success!\n";
+}
+
+const unsigned int MultiRateSchedulerTest::NUM_TASKS;
+const unsigned int MultiRateSchedulerTest::INTERVAL;
+const unsigned int MultiRateSchedulerTest::NUM_PERIODS;
+const unsigned int MultiRateSchedulerTest::NUM_THREADS;
+
+void MultiRateSchedulerTest::runTest()
+{
+	MultiRateScheduler scheduler;
+	std::vector<unsigned int> numRuns(2 * NUM_TASKS, 0);
+	std::vector<unsigned int> lastFrame(2 * NUM_TASKS, 0);
+	std::vector<unsigned int> taskIDs(2 * NUM_TASKS);
+	unsigned int numRunsThisFrame = 0;
+	bool ranTooEarly = false;
+
+	// every task checks that it runs exactly INTERVAL frames after its previous run.
+	auto makeTask = [&](unsigned int taskIndex) {
+		return [&, taskIndex](float timeStamp, float dt, unsigned int frameNumber) {
+			if ((numRuns[taskIndex] > 0) && (frameNumber != lastFrame[taskIndex] + INTERVAL)) {
+				ranTooEarly = true;
+			}
+			numRuns[taskIndex]++;
+			lastFrame[taskIndex] = frameNumber;
+			numRunsThisFrame++;
+		};
+	};
+
+	for (unsigned int i=0; i < NUM_TASKS; i++) {
+		taskIDs[i] = scheduler.addTask(INTERVAL, makeTask(i), false);
+	}
+	unsigned int frame = 1;
+	for (; frame <= INTERVAL * NUM_PERIODS; frame++) {
+		numRunsThisFrame = 0;
+		scheduler.runTasks(0.0f, 0.05f, frame, NULL);
+		if (numRunsThisFrame != NUM_TASKS / INTERVAL) {
+			throw GenericException("FAILED: frame " + toString(frame) + " ran " + toString(numRunsThisFrame) + " tasks; the offsets should spread " + toString(NUM_TASKS) + " tasks evenly over " + toString(INTERVAL) + " frames.");
+		}
+	}
+	for (unsigned int i=0; i < NUM_TASKS; i++) {
+		if (numRuns[i] != NUM_PERIODS) {
+			throw GenericException("FAILED: task " + toString(i) + " ran " + toString(numRuns[i]) + " times in " + toString(NUM_PERIODS * INTERVAL) + " frames, instead of " + toString(NUM_PERIODS) + ".");
+		}
+	}
+	if (ranTooEarly) {
+		throw GenericException("FAILED: a task did not run exactly every " + toString(INTERVAL) + " frames.");
+	}
+	std::cout << "   " << NUM_TASKS << " tasks run " << NUM_TASKS / INTERVAL << " per frame, every " << INTERVAL << " frames: Success!\n";
+
+	// removed tasks never run again, and give back their offsets, so the new tasks fill exactly the gaps they leave.
+	for (unsigned int i=0; i < NUM_TASKS; i += 2) {
+		scheduler.removeTask(taskIDs[i]);
+	}
+	std::fill(numRuns.begin(), numRuns.end(), 0);
+	for (unsigned int i=NUM_TASKS; i < NUM_TASKS + NUM_TASKS / 2; i++) {
+		taskIDs[i] = scheduler.addTask(INTERVAL, makeTask(i), false);
+	}
+	if (scheduler.getNumTasks() != NUM_TASKS) {
+		throw GenericException("FAILED: the scheduler counts " + toString(scheduler.getNumTasks()) + " tasks, expected " + toString(NUM_TASKS) + ".");
+	}
+	for (unsigned int periodEnd = frame + INTERVAL * NUM_PERIODS; frame < periodEnd; frame++) {
+		numRunsThisFrame = 0;
+		scheduler.runTasks(0.0f, 0.05f, frame, NULL);
+		if (numRunsThisFrame != NUM_TASKS / INTERVAL) {
+			throw GenericException("FAILED: after removing and adding tasks, frame " + toString(frame) + " ran " + toString(numRunsThisFrame) + " tasks instead of " + toString(NUM_TASKS / INTERVAL) + ".");
+		}
+	}
+	for (unsigned int i=0; i < NUM_TASKS + NUM_TASKS / 2; i++) {
+		unsigned int expectedRuns = ((i < NUM_TASKS) && (i % 2 == 0)) ? 0 : NUM_PERIODS;
+		if (numRuns[i] != expectedRuns) {
+			throw GenericException("FAILED: task " + toString(i) + " ran " + toString(numRuns[i]) + " times, expected " + toString(expectedRuns) + ".");
+		}
+	}
+	if (ranTooEarly) {
+		throw GenericException("FAILED: a task did not run exactly every " + toString(INTERVAL) + " frames after tasks were removed.");
+	}
+	std::cout << "   removed tasks stop, and their offsets are reused: Success!\n";
+
+	// a task may remove itself, or another task that is due on the same frame; a task with a fixed offset keeps it.
+	{
+		MultiRateScheduler selfRemovingScheduler;
+		unsigned int numSelfRemovingRuns = 0;
+		unsigned int numVictimRuns = 0;
+		unsigned int numFixedRuns = 0;
+		bool fixedOffsetWrong = false;
+		unsigned int selfRemovingID = 0;
+		unsigned int victimID = 0;
+		selfRemovingID = selfRemovingScheduler.addTaskWithOffset(4, 2, [&](float timeStamp, float dt, unsigned int frameNumber) {
+			numSelfRemovingRuns++;
+			selfRemovingScheduler.removeTask(selfRemovingID);
+			selfRemovingScheduler.removeTask(victimID);
+		}, false);
+		victimID = selfRemovingScheduler.addTaskWithOffset(4, 2, [&](float timeStamp, float dt, unsigned int frameNumber) { numVictimRuns++; }, false);
+		selfRemovingScheduler.addTaskWithOffset(3, 1, [&](float timeStamp, float dt, unsigned int frameNumber) {
+			numFixedRuns++;
+			if (frameNumber % 3 != 1) fixedOffsetWrong = true;
+		}, false);
+		for (unsigned int f=1; f <= 30; f++) {
+			selfRemovingScheduler.runTasks(0.0f, 0.05f, f, NULL);
+		}
+		if ((numSelfRemovingRuns != 1) || (numVictimRuns != 0) || (numFixedRuns != 10) || fixedOffsetWrong || (selfRemovingScheduler.getNumTasks() != 1)) {
+			throw GenericException("FAILED: removing tasks while they run, or running a task at a fixed offset, went wrong.");
+		}
+		if ((MultiRateScheduler::getNextFrame(20, 4, 2) != 22) || (MultiRateScheduler::getNextFrame(22, 4, 2) != 26) || (MultiRateScheduler::getNextFrame(7, 1, 0) != 8)) {
+			throw GenericException("FAILED: getNextFrame() returned a wrong frame.");
+		}
+		std::cout << "   tasks removing tasks, and fixed offsets: Success!\n";
+	}
+
+	// concurrent tasks on worker threads run exactly as often as on the main thread.
+	{
+		WorkStealingScheduler workerThreads(NUM_THREADS);
+		MultiRateScheduler concurrentScheduler;
+		std::vector<unsigned int> concurrentRuns(NUM_TASKS, 0);
+		for (unsigned int i=0; i < NUM_TASKS; i++) {
+			// each task only touches its own counter, as concurrent tasks must.
+			concurrentScheduler.addTask(INTERVAL, [&concurrentRuns, i](float timeStamp, float dt, unsigned int frameNumber) { concurrentRuns[i]++; }, true);
+		}
+		for (unsigned int f=1; f <= INTERVAL * NUM_PERIODS; f++) {
+			concurrentScheduler.runTasks(0.0f, 0.05f, f, &workerThreads);
+		}
+		for (unsigned int i=0; i < NUM_TASKS; i++) {
+			if (concurrentRuns[i] != NUM_PERIODS) {
+				throw GenericException("FAILED: concurrent task " + toString(i) + " ran " + toString(concurrentRuns[i]) + " times on " + toString(NUM_THREADS) + " threads, instead of " + toString(NUM_PERIODS) + ".");
+			}
+		}
+		std::cout << "   concurrent tasks on " << NUM_THREADS << " threads: Success!\n";
+	}
+}
+
+const unsigned int DeferredWorkQueueTest::NUM_ITEMS;
+const unsigned int DeferredWorkQueueTest::MAX_DEFERRED_FRAMES;
+const unsigned int DeferredWorkQueueTest::NUM_THREADS;
+
+void DeferredWorkQueueTest::runTest()
+{
+	// addresses that stand in for agents; the queue only compares them.
+	char agentAddresses[2];
+	AgentInterface * agents[2] = { reinterpret_cast<AgentInterface*>(&agentAddresses[0]), reinterpret_cast<AgentInterface*>(&agentAddresses[1]) };
+	const unsigned long long noDeadline = ~0ull;
+
+	// work runs highest priority first, and in the order it was queued among equal priorities.
+	{
+		DeferredWorkQueue queue;
+		std::vector<unsigned int> order;
+		for (unsigned int i=0; i < NUM_ITEMS; i++) {
+			queue.defer(agents[i % 2], (float)(i % 10), 0, [&order, i]() { order.push_back(i); });
+		}
+		if ((queue.runUntil(noDeadline, 0) != NUM_ITEMS) || (queue.getNumPending() != 0) || (order.size() != NUM_ITEMS)) {
+			throw GenericException("FAILED: runUntil() without a deadline did not run all " + toString(NUM_ITEMS) + " items.");
+		}
+		for (unsigned int i=1; i < order.size(); i++) {
+			unsigned int previousPriority = order[i-1] % 10;
+			unsigned int priority = order[i] % 10;
+			if ((priority > previousPriority) || ((priority == previousPriority) && (order[i] < order[i-1]))) {
+				throw GenericException("FAILED: item " + toString(order[i]) + " ran after item " + toString(order[i-1]) + ", out of the order of priority and age.");
+			}
+		}
+		std::cout << "   " << NUM_ITEMS << " items run in order of priority: Success!\n";
+	}
+
+	// while the deadline has passed, work waits, until it waited too long and runs regardless.
+	{
+		DeferredWorkQueue queue;
+		queue.setMaxDeferredFrames(MAX_DEFERRED_FRAMES);
+		unsigned int numItemsRun = 0;
+		for (unsigned int i=0; i < NUM_ITEMS; i++) {
+			queue.defer(agents[0], 1.0f, 10, [&numItemsRun]() { numItemsRun++; });
+		}
+		queue.defer(agents[1], 1.0f, 12, [&numItemsRun]() { numItemsRun++; });
+		for (unsigned int frame=10; frame < 10 + MAX_DEFERRED_FRAMES; frame++) {
+			if (queue.runUntil(0, frame) != 0) {
+				throw GenericException("FAILED: work ran on frame " + toString(frame) + " although the deadline had passed and it had not waited too long.");
+			}
+		}
+		if ((queue.runUntil(0, 10 + MAX_DEFERRED_FRAMES) != NUM_ITEMS) || (numItemsRun != NUM_ITEMS) || (queue.getNumPending() != 1)) {
+			throw GenericException("FAILED: work that waited " + toString(MAX_DEFERRED_FRAMES) + " frames did not run, or younger work ran, after the deadline.");
+		}
+		const std::map<const AgentInterface*, DeferredWorkQueue::StarvationInfo> & starved = queue.getStarvedAgents();
+		if ((queue.getNumItemsForced() != NUM_ITEMS) || (queue.getMaxFramesWaited() != MAX_DEFERRED_FRAMES) || (starved.size() != 1) ||
+			(starved.begin()->first != agents[0]) || (starved.begin()->second.numTimesStarved != NUM_ITEMS)) {
+			throw GenericException("FAILED: the work that was forced to run was not counted for its agent.");
+		}
+		std::cout << "   work waits at most " << MAX_DEFERRED_FRAMES << " frames after the deadline: Success!\n";
+	}
+
+	// a deadline a few milliseconds away lets some slow items run, but not all of them.
+	{
+		DeferredWorkQueue queue;
+		const unsigned long long itemDuration = getHighResCounterFrequency() / 1000;
+		for (unsigned int i=0; i < 100; i++) {
+			queue.defer(agents[0], 1.0f, 0, [itemDuration]() {
+				unsigned long long end = getHighResCounterValue() + itemDuration;
+				while (getHighResCounterValue() < end) { }
+			});
+		}
+		unsigned int numItemsRun = queue.runUntil(getHighResCounterValue() + 10 * itemDuration, 0);
+		if ((numItemsRun == 0) || (numItemsRun >= 100) || (queue.getNumPending() != 100 - numItemsRun)) {
+			throw GenericException("FAILED: a deadline of 10 ms ran " + toString(numItemsRun) + " of 100 items that take 1 ms each.");
+		}
+		std::cout << "   a deadline of 10 ms runs " << numItemsRun << " items of 1 ms: Success!\n";
+	}
+
+	// cancelling an agent drops only its work, and the rest still runs in order.
+	{
+		DeferredWorkQueue queue;
+		std::vector<unsigned int> order;
+		for (unsigned int i=0; i < NUM_ITEMS; i++) {
+			queue.defer(agents[i % 2], (float)(i % 7), 0, [&order, i]() { order.push_back(i); });
+		}
+		queue.cancel(agents[0]);
+		if ((queue.getNumPending() != NUM_ITEMS / 2) || (queue.runAll(0) != NUM_ITEMS / 2)) {
+			throw GenericException("FAILED: cancelling an agent left " + toString(queue.getNumPending()) + " items, expected " + toString(NUM_ITEMS / 2) + ".");
+		}
+		for (unsigned int i=0; i < order.size(); i++) {
+			if ((order[i] % 2 == 0) || ((i > 0) && (order[i] % 7 > order[i-1] % 7))) {
+				throw GenericException("FAILED: after cancelling an agent, its work ran, or the rest ran out of order.");
+			}
+		}
+		std::cout << "   cancelling an agent drops only its work: Success!\n";
+	}
+
+	// work queued from several threads at once, and work queued by other work, is not lost.
+	{
+		WorkStealingScheduler workerThreads(NUM_THREADS);
+		DeferredWorkQueue queue;
+		std::vector<unsigned int> numRuns(NUM_ITEMS, 0);
+		workerThreads.parallelFor(0, NUM_ITEMS, 0, [&](unsigned int threadIndex, unsigned int begin, unsigned int end) {
+			for (unsigned int i = begin; i < end; i++) {
+				queue.defer(agents[i % 2], 1.0f, 0, [&queue, &numRuns, &agents, i]() {
+					numRuns[i]++;
+					if (i % 2 == 0) {
+						queue.defer(agents[0], 0.0f, 0, [&numRuns, i]() { numRuns[i]++; });
+					}
+				});
+			}
+		});
+		if (queue.getNumPending() != NUM_ITEMS) {
+			throw GenericException("FAILED: " + toString(NUM_THREADS) + " threads queued " + toString(NUM_ITEMS) + " items, but the queue holds " + toString(queue.getNumPending()) + ".");
+		}
+		queue.runAll(0);
+		for (unsigned int i=0; i < NUM_ITEMS; i++) {
+			if (numRuns[i] != ((i % 2 == 0) ? 2u : 1u)) {
+				throw GenericException("FAILED: item " + toString(i) + " ran " + toString(numRuns[i]) + " times, or the work it queued was lost.");
+			}
+		}
+		std::cout << "   queueing from " << NUM_THREADS << " threads and from queued work: Success!\n";
+	}
+}
+
+const unsigned int FrameArenaTest::BLOCK_SIZE;
+const unsigned int FrameArenaTest::NUM_ALLOCATIONS;
+
+void FrameArenaTest::runTest()
+{
+	FrameArena arena(BLOCK_SIZE);
+
+	// allocations of many sizes and alignments are aligned, and do not overlap; the largest ones need blocks of their own.
+	std::vector< std::pair<unsigned char*, size_t> > allocations;
+	size_t numBytesRequested = 0;
+	for (unsigned int i=0; i < NUM_ALLOCATIONS; i++) {
+		size_t numBytes = 1 + (i * 37) % 200 + ((i % 100 == 99) ? 2 * BLOCK_SIZE : 0);
+		size_t alignment = (size_t)1 << (i % 7);
+		unsigned char * memory = static_cast<unsigned char*>(arena.allocate(numBytes, alignment));
+		if (((size_t)memory & (alignment - 1)) != 0) {
+			throw GenericException("FAILED: allocation " + toString(i) + " is not aligned to " + toString(alignment) + " bytes.");
+		}
+		memset(memory, (int)(i & 0xff), numBytes);
+		allocations.push_back(std::make_pair(memory, numBytes));
+		numBytesRequested += numBytes;
+	}
+	for (unsigned int i=0; i < allocations.size(); i++) {
+		for (size_t b=0; b < allocations[i].second; b++) {
+			if (allocations[i].first[b] != (unsigned char)(i & 0xff)) {
+				throw GenericException("FAILED: allocation " + toString(i) + " was overwritten by another allocation.");
+			}
+		}
+	}
+	if ((arena.getNumAllocations() != NUM_ALLOCATIONS) || (arena.getNumBytesAllocated() < numBytesRequested) || (arena.getCapacity() < numBytesRequested)) {
+		throw GenericException("FAILED: the arena counts " + toString(arena.getNumAllocations()) + " allocations of " + toString(arena.getNumBytesAllocated()) + " bytes, expected " + toString(NUM_ALLOCATIONS) + " of at least " + toString(numBytesRequested) + ".");
+	}
+	std::cout << "   " << NUM_ALLOCATIONS << " aligned allocations in " << arena.getCapacity() << " bytes: Success!\n";
+
+	// reset() keeps enough memory for the same allocations, in one block, so the next frame does not grow the arena.
+	size_t capacity = arena.getCapacity();
+	arena.reset();
+	if ((arena.getNumAllocations() != 0) || (arena.getNumBytesAllocated() != 0) || (arena.getCapacity() != capacity)) {
+		throw GenericException("FAILED: reset() did not clear the statistics, or changed the capacity from " + toString(capacity) + " to " + toString(arena.getCapacity()) + " bytes.");
+	}
+	unsigned char * firstMemory = static_cast<unsigned char*>(arena.allocate(allocations[0].second, 1));
+	for (unsigned int i=1; i < NUM_ALLOCATIONS; i++) {
+		arena.allocate(allocations[i].second, (size_t)1 << (i % 7));
+	}
+	if (arena.getCapacity() != capacity) {
+		throw GenericException("FAILED: after reset(), the same allocations grew the arena from " + toString(capacity) + " to " + toString(arena.getCapacity()) + " bytes.");
+	}
+	arena.reset();
+	if (arena.allocate(allocations[0].second, 1) != firstMemory) {
+		throw GenericException("FAILED: after reset(), the arena did not start over at the beginning of its memory.");
+	}
+	std::cout << "   reset() keeps " << capacity << " bytes for the next frame: Success!\n";
+
+	// rewinding to a marker hands out the same memory again, also after moving on to other blocks.
+	{
+		FrameArena smallArena(BLOCK_SIZE);
+		smallArena.allocate(100, 8);
+		FrameArena::Marker marker = smallArena.getMarker();
+		void * afterMarker = smallArena.allocate(64, 16);
+		for (unsigned int i=0; i < 10; i++) {
+			smallArena.allocate(BLOCK_SIZE / 2, 8);
+		}
+		size_t grownCapacity = smallArena.getCapacity();
+		smallArena.rewind(marker);
+		if (smallArena.allocate(64, 16) != afterMarker) {
+			throw GenericException("FAILED: after rewind(), the arena did not hand out the memory allocated after the marker again.");
+		}
+		for (unsigned int i=0; i < 10; i++) {
+			smallArena.allocate(BLOCK_SIZE / 2, 8);
+		}
+		if (smallArena.getCapacity() != grownCapacity) {
+			throw GenericException("FAILED: after rewind(), the arena allocated new blocks instead of reusing its own.");
+		}
+
+		void * inScope;
+		marker = smallArena.getMarker();
+		{
+			FrameArenaScope scope(smallArena);
+			inScope = smallArena.allocate(32, 8);
+		}
+		if (smallArena.allocate(32, 8) != inScope) {
+			throw GenericException("FAILED: a FrameArenaScope did not rewind the arena when it was destroyed.");
+		}
+		std::cout << "   rewind() and FrameArenaScope reuse memory: Success!\n";
+	}
+
+	// containers keep their contents while they grow in the arena, and work without an arena too.
+	{
+		arena.reset();
+		ArenaVector<unsigned int> arenaNumbers((ArenaAllocator<unsigned int>(&arena)));
+		ArenaVector<unsigned int> heapNumbers;
+		ArenaSet<unsigned int> arenaSet((ArenaAllocator<unsigned int>(&arena)));
+		for (unsigned int i=0; i < NUM_ALLOCATIONS; i++) {
+			arenaNumbers.push_back(i);
+			heapNumbers.push_back(i);
+			arenaSet.insert(NUM_ALLOCATIONS - i);
+		}
+		for (unsigned int i=0; i < NUM_ALLOCATIONS; i++) {
+			if ((arenaNumbers[i] != i) || (heapNumbers[i] != i)) {
+				throw GenericException("FAILED: an arena vector lost element " + toString(i) + " while it grew.");
+			}
+		}
+		if ((arenaSet.size() != NUM_ALLOCATIONS) || (*arenaSet.begin() != 1) || (arena.getNumAllocations() == 0)) {
+			throw GenericException("FAILED: an arena set lost elements, or did not take its memory from the arena.");
+		}
+		std::cout << "   arena containers: Success!\n";
+	}
+
+	arena.release();
+	if (arena.getCapacity() != 0) {
+		throw GenericException("FAILED: release() kept " + toString(arena.getCapacity()) + " bytes.");
+	}
+}
+
 void FileUtilTest::runTest()
 {
 	if (!pathExists(".")) {